@@ -83,7 +83,7 @@ int main(int argc , char * argv[])
         else
           CurrentAddress=strtoul(argv[1],0,16);
 
-       if(strstr(argv[1],"0x")==NULL)
+       if(strstr(argv[2],"0x")==NULL)
          NewAddress=atoi(argv[2]);
         else
          NewAddress=strtoul(argv[2],0,16);
@@ -95,9 +95,9 @@ int main(int argc , char * argv[])
        return (-1);
      }
 
-    if(!ValidateAddress(CurrentAddress))
+    if(!ValidateAddress(NewAddress))
      {
-       fprintf(stderr,"New I2C Address=%X is  invalid!\n",CurrentAddress);
+       fprintf(stderr,"New I2C Address=%X is  invalid!\n",NewAddress);
        return(-1);
      }
 
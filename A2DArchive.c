@@ -0,0 +1,815 @@
+#define _FILE_OFFSET_BITS 64
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "A2DArchive.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DArchive
+//
+//    Compressed archive of the samples for long recordings
+//
+//    A chunk of A2D_ARCHIVE_CHUNK samples is coded in four streams:
+//
+//    A0 , A1   deltas of the 10 bits values , zigzag then Rice code with the best k of the chunk.
+//              When the Rice code is bigger (noise) the values are packed on 10 bits.
+//    tick      difference with the expected tick (last + 1 + Overrun) , 0 bits when nothing is stamped
+//    flags     Flags and Overrun in one byte , as runs
+//
+//    A slow signal takes 3 to 5 bits per channel , against 16 bytes per sample in A2DStore.
+//    The seek table at the end has the first sample index and tick of each chunk ,
+//    one chunk is read and decoded for any sample. It is also the zone map of the chunks
+//    (time , min/max per channel , flags) used by A2DQuery.c to skip chunks.
+//
+//    The decoder takes the Rice codes with a 64 bits buffer and a count of trailing zeros ,
+//    then the zigzag and the delta sum run 4 samples per step with the gcc vector extensions.
+//
+//   to compile add A2DArchive.c to the gcc command line with -O2
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define MODE_RICE	0
+#define MODE_PACKED	1	// 10 bits values
+#define MODE_ZERO	2	// all deltas 0
+
+#define RICE_ESCAPE	32	// unary length of an escape , followed by the value on 64 bits
+#define STREAM_MAX	(A2D_ARCHIVE_CHUNK * 13 + 64)	// tick stream , all escapes
+
+enum { STREAM_A0, STREAM_A1, STREAM_TICK, STREAM_FLAGS, STREAMS };
+
+typedef struct{
+  unsigned int   Count;
+  unsigned short First[2];	// A0 , A1 of the first sample
+  unsigned long long Tick;	// tick of the first sample
+  unsigned char  Mode[3];	// A0 , A1 , tick
+  unsigned char  K[3];
+  unsigned short Reserved;
+  unsigned int   Size[STREAMS];	// bytes
+}ChunkHeader;
+
+// coder buffers of an archive: one value per sample then the streams (chunk read buffer for the reader)
+typedef struct{
+  unsigned long long Value[A2D_ARCHIVE_CHUNK];
+  unsigned char  Stream[STREAMS][STREAM_MAX];
+}ArchiveWork;
+
+typedef int ArchiveV4I __attribute__((vector_size(16)));
+
+typedef struct{
+  unsigned char * Out;
+  size_t         Size;
+  unsigned long long Buffer;
+  int            Bits;
+}BitWriter;
+
+typedef struct{
+  const unsigned char * In;
+  const unsigned char * End;
+  unsigned long long Buffer;
+  int            Bits;
+}BitReader;
+
+
+static void BitPut(BitWriter * w, unsigned long long value, int bits)
+{
+  if(bits > 32)
+    {
+      BitPut(w,value & 0xFFFFFFFFULL,32);
+      BitPut(w,value >> 32,bits - 32);
+      return;
+    }
+  w->Buffer |= (value & ((1ULL << bits) - 1)) << w->Bits;
+  w->Bits += bits;
+  while(w->Bits >= 8)
+    {
+      w->Out[w->Size++] = w->Buffer;
+      w->Buffer >>= 8;
+      w->Bits -= 8;
+    }
+}
+
+
+static void BitFlush(BitWriter * w)
+{
+  if(w->Bits)
+    w->Out[w->Size++] = w->Buffer;
+  w->Buffer = 0;
+  w->Bits = 0;
+}
+
+
+// at least 57 bits in the buffer , zeros after the end
+static inline void BitRefill(BitReader * r)
+{
+  unsigned long long word;
+
+  if((r->End - r->In) >= 8)
+    {
+      memcpy(&word,r->In,8);            // little endian
+      r->Buffer |= word << r->Bits;
+      r->In += (63 - r->Bits) >> 3;
+      r->Bits |= 56;
+      return;
+    }
+  while(r->Bits <= 56)
+    {
+      if(r->In < r->End)
+        r->Buffer |= (unsigned long long) *r->In++ << r->Bits;
+      r->Bits += 8;
+    }
+}
+
+
+static inline unsigned long long BitGet(BitReader * r, int bits)
+{
+  unsigned long long value;
+
+  if(bits == 0) return 0;
+  value = r->Buffer & ((1ULL << bits) - 1);
+  r->Buffer >>= bits;
+  r->Bits -= bits;
+  return value;
+}
+
+
+static void RicePut(BitWriter * w, unsigned long long value, int k)
+{
+  unsigned long long q = value >> k;
+
+  if(q >= RICE_ESCAPE)
+    {
+      BitPut(w,0,RICE_ESCAPE);
+      BitPut(w,1,1);
+      BitPut(w,value,64);
+      return;
+    }
+  BitPut(w,1ULL << q,q + 1);            // q zeros then a one
+  BitPut(w,value,k);
+}
+
+
+static inline int RiceGet(BitReader * r, int k, unsigned long long * value)
+{
+  int q;
+
+  BitRefill(r);
+  if((r->Buffer & ((1ULL << (RICE_ESCAPE + 1)) - 1)) == 0) return -1;
+  q = __builtin_ctzll(r->Buffer);
+  BitGet(r,q + 1);
+  if(q == RICE_ESCAPE)
+    {
+      BitRefill(r);
+      *value = BitGet(r,32);
+      BitRefill(r);
+      *value |= BitGet(r,32) << 32;
+      return 0;
+    }
+  *value = ((unsigned long long) q << k) | BitGet(r,k);
+  return 0;
+}
+
+
+static unsigned long long RiceCost(const unsigned long long * value, int n, int k)
+{
+  unsigned long long bits = 0;
+  unsigned long long q;
+  int loop;
+
+  for(loop=0;loop<n;loop++)
+   {
+     q = value[loop] >> k;
+     bits += q >= RICE_ESCAPE ? RICE_ESCAPE + 65 : q + 1 + k;
+   }
+  return bits;
+}
+
+
+// zigzag values , n entries. packed: 10 bits raw values allowed (raw != NULL)
+static size_t EncodeStream(const unsigned long long * value, const unsigned short * raw, int n,
+                           unsigned char * mode, unsigned char * k, unsigned char * out)
+{
+  BitWriter w = { out, 0, 0, 0 };
+  unsigned long long best, cost;
+  int loop, bestk = 0;
+
+  for(loop=0;(loop<n) && (value[loop]==0);loop++);
+  if(loop == n)
+    {
+      *mode = MODE_ZERO;
+      *k = 0;
+      return 0;
+    }
+
+  best = RiceCost(value,n,0);
+  for(loop=1;loop<=20;loop++)
+    if((cost = RiceCost(value,n,loop)) < best)
+      {
+        best = cost;
+        bestk = loop;
+      }
+
+  if(raw && (best >= 10ULL * n))
+    {
+      *mode = MODE_PACKED;
+      *k = 10;
+      for(loop=0;loop<n;loop++)
+        BitPut(&w,raw[loop],10);
+    }
+  else
+    {
+      *mode = MODE_RICE;
+      *k = bestk;
+      for(loop=0;loop<n;loop++)
+        RicePut(&w,value[loop],bestk);
+    }
+  BitFlush(&w);
+  return w.Size;
+}
+
+
+// the writer chunk in the file
+static int ArchiveWriteChunk(A2DArchive * archive)
+{
+  A2DArchiveChunk * c = archive->Pending;
+  ArchiveWork * work = archive->Work;
+  unsigned long long * value = work->Value;
+  unsigned char (* stream)[STREAM_MAX] = work->Stream;
+  ChunkHeader header;
+  A2DArchiveSeek * seek;
+  unsigned long long predicted;
+  long long diff;
+  unsigned int run;
+  int loop, channel, n = c->Count;
+  unsigned char flags;
+  size_t size;
+
+  if(n == 0) return 0;
+  memset(&header,0,sizeof(header));
+  header.Count = n;
+  header.First[0] = c->A0[0];
+  header.First[1] = c->A1[0];
+  header.Tick = c->Tick[0];
+
+  for(channel=0;channel<2;channel++)
+   {
+     const unsigned short * v = channel ? c->A1 : c->A0;
+
+     for(loop=1;loop<n;loop++)
+      {
+        diff = (int) v[loop] - (int) v[loop - 1];
+        value[loop - 1] = (unsigned long long) ((diff << 1) ^ (diff >> 63));
+      }
+     header.Size[channel] = EncodeStream(value,v + 1,n - 1,&header.Mode[channel],&header.K[channel],stream[channel]);
+   }
+
+  for(loop=1;loop<n;loop++)
+   {
+     predicted = c->Tick[loop - 1] + 1 + c->Overrun[loop];
+     diff = (long long) (c->Tick[loop] - predicted);
+     value[loop - 1] = (unsigned long long) ((diff << 1) ^ (diff >> 63));
+   }
+  header.Size[STREAM_TICK] = EncodeStream(value,NULL,n - 1,&header.Mode[2],&header.K[2],stream[STREAM_TICK]);
+
+  // runs of (flags , length - 1 in 7 bits groups)
+  size = 0;
+  for(loop=0;loop<n;)
+   {
+     flags = c->Flags[loop] | (c->Overrun[loop] << 5);
+     for(run=1;((loop + run) < (unsigned) n) && ((c->Flags[loop + run] | (c->Overrun[loop + run] << 5)) == flags);run++);
+     loop += run;
+     stream[STREAM_FLAGS][size++] = flags;
+     for(run--;run >= 0x80;run >>= 7)
+       stream[STREAM_FLAGS][size++] = (run & 0x7F) | 0x80;
+     stream[STREAM_FLAGS][size++] = run;
+   }
+  header.Size[STREAM_FLAGS] = size;
+
+  if(archive->Chunks >= archive->SeekMax)
+    {
+      archive->SeekMax = archive->SeekMax ? archive->SeekMax * 2 : 256;
+      seek = realloc(archive->Seek,archive->SeekMax * sizeof(A2DArchiveSeek));
+      if(seek == NULL) return -1;
+      archive->Seek = seek;
+    }
+  seek = &archive->Seek[archive->Chunks];
+  memset(seek,0,sizeof(A2DArchiveSeek));
+  seek->Sample = c->Sample;
+  seek->Tick = c->Tick[0];
+  seek->Offset = archive->Bytes;
+  seek->Time = c->Time;
+  seek->Period = c->Period;
+  seek->Count = n;
+  seek->Bytes = sizeof(header);
+  seek->Min[0] = seek->Max[0] = c->A0[0];
+  seek->Min[1] = seek->Max[1] = c->A1[0];
+  for(loop=0;loop<n;loop++)
+   {
+     if(c->A0[loop] < seek->Min[0]) seek->Min[0] = c->A0[loop];
+     if(c->A0[loop] > seek->Max[0]) seek->Max[0] = c->A0[loop];
+     if(c->A1[loop] < seek->Min[1]) seek->Min[1] = c->A1[loop];
+     if(c->A1[loop] > seek->Max[1]) seek->Max[1] = c->A1[loop];
+     if(c->Overrun[loop] > seek->Overrun) seek->Overrun = c->Overrun[loop];
+     seek->Flags |= c->Flags[loop];
+   }
+
+  if(fwrite(&header,sizeof(header),1,archive->File) != 1) return -1;
+  for(loop=0;loop<STREAMS;loop++)
+   {
+     if(header.Size[loop] && (fwrite(stream[loop],header.Size[loop],1,archive->File) != 1)) return -1;
+     seek->Bytes += header.Size[loop];
+   }
+  archive->Bytes += seek->Bytes;
+  archive->Chunks++;
+  c->Sample += n;
+  c->Count = 0;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DArchiveCreate
+//
+//    Inputs,
+//
+//    archive:   archive state
+//    filename:  archive file , replaced
+//    address:   device I2C address , 0 = unknown
+//    start:     host time of the first sample , seconds since the epoch
+//    period:    seconds between two samples
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DArchiveCreate(A2DArchive * archive, const char * filename, int address, double start, double period)
+{
+  memset(archive,0,sizeof(A2DArchive));
+  archive->Loaded = -1;
+  archive->Pending = calloc(1,sizeof(A2DArchiveChunk));
+  archive->Work = malloc(sizeof(ArchiveWork));
+  if(archive->Pending && archive->Work)
+    archive->File = fopen(filename,"wb");
+  if(archive->File == NULL)
+    {
+      free(archive->Pending);
+      free(archive->Work);
+      archive->Pending = NULL;
+      archive->Work = NULL;
+      return -1;
+    }
+  archive->Writing = 1;
+  memcpy(archive->Header.Magic,A2D_ARCHIVE_MAGIC,4);
+  archive->Header.Version = A2D_ARCHIVE_VERSION;
+  archive->Header.Start = start;
+  archive->Header.Period = period;
+  archive->Header.ChunkSize = A2D_ARCHIVE_CHUNK;
+  archive->Header.Address = address;
+  archive->Next = start;
+  archive->Period = period;
+  if(fwrite(&archive->Header,sizeof(A2DArchiveHeader),1,archive->File) != 1)
+    {
+      A2DArchiveClose(archive);
+      return -1;
+    }
+  archive->Bytes = sizeof(A2DArchiveHeader);
+  return 0;
+}
+
+
+////////////////////////////////////   A2DArchiveAppend
+//
+//    Append a decoded block. A full chunk is coded and written.
+//
+//    Return,
+//
+//    0   ok
+//    < 0 write error
+//
+int A2DArchiveAppend(A2DArchive * archive, const A2DBlock * block)
+{
+  A2DArchiveChunk * c = archive->Pending;
+  unsigned long long tick;
+  int loop, idx;
+
+  if(!archive->Writing) return -1;
+  for(loop=0;loop<block->Count;loop++)
+   {
+     if(block->Flags[loop] & A2D_FLAG_STAMP)
+       tick = block->Time[loop];
+     else
+       tick = archive->Samples ? archive->LastTick + 1 + block->Overrun[loop] : 0;
+
+     if(!archive->Synced)
+       archive->Next += (block->Overrun[loop] & 7) * archive->Period;
+     archive->Synced = 0;
+     idx = c->Count++;
+     if(idx == 0)
+       {
+         c->Time = archive->Next;
+         c->Period = archive->Period;
+       }
+     archive->Next += archive->Period;
+     c->A0[idx] = block->A0[loop] & 0x3FF;
+     c->A1[idx] = block->A1[loop] & 0x3FF;
+     c->Overrun[idx] = block->Overrun[loop] & 7;
+     c->Flags[idx] = block->Flags[loop] & 0x1F;
+     c->Tick[idx] = tick;
+     archive->LastTick = tick;
+     archive->Samples++;
+
+     if(c->Count == A2D_ARCHIVE_CHUNK)
+       if(ArchiveWriteChunk(archive) < 0) return -1;
+   }
+  return 0;
+}
+
+
+////////////////////////////////////   A2DArchiveSync
+//
+//    New time base , the samples appended don't follow the last one (a gap longer than
+//    the Overrun count , the host clock set , another period). The pending samples are
+//    written as a short chunk , the next sample starts a chunk at that time.
+//
+//    Inputs,
+//
+//    archive:   archive state
+//    time:      host time of the next sample appended
+//    period:    seconds between two samples from it
+//
+//    Return,
+//
+//    0   ok
+//    < 0 write error
+//
+int A2DArchiveSync(A2DArchive * archive, double time, double period)
+{
+  if(!archive->Writing) return -1;
+  if(ArchiveWriteChunk(archive) < 0) return -1;
+  archive->Next = time;
+  archive->Period = period;
+  archive->Synced = 1;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DArchiveOpen
+//
+//    Open an archive to read , the seek table is loaded
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error or not an archive
+//
+int A2DArchiveOpen(A2DArchive * archive, const char * filename)
+{
+  A2DArchiveFooter footer;
+
+  memset(archive,0,sizeof(A2DArchive));
+  archive->Loaded = -1;
+  archive->File = fopen(filename,"rb");
+  if(archive->File == NULL) return -1;
+
+  if((fread(&archive->Header,sizeof(A2DArchiveHeader),1,archive->File) != 1) ||
+     memcmp(archive->Header.Magic,A2D_ARCHIVE_MAGIC,4) || (archive->Header.Version != A2D_ARCHIVE_VERSION) ||
+     (archive->Header.ChunkSize != A2D_ARCHIVE_CHUNK))
+    goto fail;
+
+  if((fseeko(archive->File,-(off_t) sizeof(footer),SEEK_END) < 0) ||
+     (fread(&footer,sizeof(footer),1,archive->File) != 1) || memcmp(footer.Magic,A2D_ARCHIVE_MAGIC,4))
+    goto fail;               // not closed , the seek table is missing
+
+  archive->Chunks = footer.Chunks;
+  archive->SeekMax = footer.Chunks;
+  archive->Samples = footer.Samples;
+  archive->Seek = malloc((footer.Chunks + 1) * sizeof(A2DArchiveSeek));
+  archive->Pending = malloc(sizeof(A2DArchiveChunk));
+  archive->Work = malloc(sizeof(ArchiveWork));
+  if((archive->Seek == NULL) || (archive->Pending == NULL) || (archive->Work == NULL)) goto fail;
+  if((fseeko(archive->File,footer.SeekOffset,SEEK_SET) < 0) ||
+     (fread(archive->Seek,sizeof(A2DArchiveSeek),footer.Chunks,archive->File) != footer.Chunks))
+    goto fail;
+  return 0;
+
+fail:
+  A2DArchiveClose(archive);
+  return -1;
+}
+
+
+////////////////////////////////////   A2DArchiveClose
+//
+//    The writer codes the last chunk and adds the seek table
+//
+int A2DArchiveClose(A2DArchive * archive)
+{
+  A2DArchiveFooter footer;
+  int rc = 0;
+
+  if(archive->File == NULL) return -1;
+  if(archive->Writing)
+    {
+      if(ArchiveWriteChunk(archive) < 0) rc = -1;
+      memset(&footer,0,sizeof(footer));
+      footer.SeekOffset = archive->Bytes;
+      footer.Chunks = archive->Chunks;
+      footer.Samples = archive->Samples;
+      memcpy(footer.Magic,A2D_ARCHIVE_MAGIC,4);
+      if(archive->Chunks && (fwrite(archive->Seek,sizeof(A2DArchiveSeek),archive->Chunks,archive->File) != archive->Chunks))
+        rc = -1;
+      if(fwrite(&footer,sizeof(footer),1,archive->File) != 1) rc = -1;
+    }
+  if(fclose(archive->File) != 0) rc = -1;
+  free(archive->Seek);
+  free(archive->Pending);
+  free(archive->Work);
+  archive->File = NULL;
+  archive->Seek = NULL;
+  archive->Pending = NULL;
+  archive->Work = NULL;
+  return rc;
+}
+
+
+////////////////////////////////////   A2DArchiveFindSample
+//
+//    Return,
+//
+//    chunk holding the sample index
+//    < 0 out of the archive
+//
+long long A2DArchiveFindSample(const A2DArchive * archive, unsigned long long sample)
+{
+  long long low = 0;
+  long long high = archive->Chunks;
+  long long mid;
+
+  if(sample >= archive->Samples) return -1;
+  while((high - low) > 1)
+   {
+     mid = (low + high) / 2;
+     if(archive->Seek[mid].Sample <= sample)
+       low = mid;
+     else
+       high = mid;
+   }
+  return low;
+}
+
+
+////////////////////////////////////   A2DArchiveFindTick
+//
+//    Return,
+//
+//    last chunk starting at or before the tick , 0 if the tick is before the archive
+//    < 0 empty archive
+//
+long long A2DArchiveFindTick(const A2DArchive * archive, unsigned long long tick)
+{
+  long long low = 0;
+  long long high = archive->Chunks;
+  long long mid;
+
+  if(archive->Chunks == 0) return -1;
+  while((high - low) > 1)
+   {
+     mid = (low + high) / 2;
+     if(archive->Seek[mid].Tick <= tick)
+       low = mid;
+     else
+       high = mid;
+   }
+  return low;
+}
+
+
+// zigzag deltas to values , 4 per step
+static void DeltaSum(const int * zigzag, int n, int first, unsigned short * out)
+{
+  const ArchiveV4I zero = { 0, 0, 0, 0 };
+  const ArchiveV4I one = { 1, 1, 1, 1 };
+  const ArchiveV4I shift1 = { 0, 4, 5, 6 };
+  const ArchiveV4I shift2 = { 0, 1, 4, 5 };
+  const ArchiveV4I last = { 3, 3, 3, 3 };
+  ArchiveV4I carry = { first, first, first, first };
+  ArchiveV4I z, d;
+  int loop;
+
+  out[0] = first;
+  for(loop=0;(loop + 4)<=n;loop+=4)
+   {
+     memcpy(&z,&zigzag[loop],sizeof(z));
+     d = (ArchiveV4I) ((unsigned int __attribute__((vector_size(16)))) z >> 1) ^ -(z & one);
+     d += __builtin_shuffle(zero,d,shift1);
+     d += __builtin_shuffle(zero,d,shift2);
+     d += carry;
+     out[loop + 1] = d[0];
+     out[loop + 2] = d[1];
+     out[loop + 3] = d[2];
+     out[loop + 4] = d[3];
+     carry = __builtin_shuffle(d,last);
+   }
+  for(;loop<n;loop++)
+   {
+     carry[0] += (int) ((unsigned int) zigzag[loop] >> 1) ^ -(zigzag[loop] & 1);
+     out[loop + 1] = carry[0];
+   }
+}
+
+
+static int DecodeChannel(const unsigned char * in, size_t size, int mode, int k, int n, int first,
+                         int * zigzag, unsigned short * out)
+{
+  BitReader r = { in, in + size, 0, 0 };
+  unsigned long long value;
+  int loop;
+
+  out[0] = first;
+  if(mode == MODE_ZERO)
+    {
+      for(loop=1;loop<=n;loop++)
+        out[loop] = first;
+      return 0;
+    }
+  if(mode == MODE_PACKED)
+    {
+      for(loop=1;loop<=n;loop++)
+       {
+         BitRefill(&r);
+         out[loop] = BitGet(&r,10);
+       }
+      return 0;
+    }
+  for(loop=0;loop<n;loop++)
+   {
+     if(RiceGet(&r,k,&value) < 0) return -1;
+     zigzag[loop] = value;
+   }
+  DeltaSum(zigzag,n,first,out);
+  return 0;
+}
+
+
+////////////////////////////////////   A2DArchiveReadChunk
+//
+//    Read and decode one chunk
+//
+//    Inputs,
+//
+//    archive:   archive opened with A2DArchiveOpen
+//    chunk:     chunk number (A2DArchiveFindSample or A2DArchiveFindTick)
+//    out:       decoded samples
+//
+//    Return,
+//
+//    number of samples
+//    < 0 error
+//
+int A2DArchiveReadChunk(A2DArchive * archive, long long chunk, A2DArchiveChunk * out)
+{
+  ArchiveWork * work = archive->Work;
+  unsigned char * buffer = work->Stream[0];
+  int * zigzag = (int *) work->Value;
+  const A2DArchiveSeek * seek;
+  ChunkHeader header;
+  const unsigned char * stream;
+  BitReader r;
+  unsigned long long value, run;
+  long long diff;
+  unsigned char flags;
+  int loop, idx, n, shift;
+
+  if(archive->Writing || (chunk < 0) || ((unsigned long long) chunk >= archive->Chunks)) return -1;
+  seek = &archive->Seek[chunk];
+  if(seek->Bytes > sizeof(work->Stream)) return -1;
+  if((fseeko(archive->File,seek->Offset,SEEK_SET) < 0) ||
+     (fread(buffer,seek->Bytes,1,archive->File) != 1))
+    return -1;
+
+  memcpy(&header,buffer,sizeof(header));
+  n = header.Count;
+  if((n < 1) || (n > A2D_ARCHIVE_CHUNK)) return -1;
+  if((sizeof(header) + (unsigned long long) header.Size[0] + header.Size[1] + header.Size[2] + header.Size[3]) != seek->Bytes)
+    return -1;
+  out->Count = n;
+  out->Sample = seek->Sample;
+  out->Time = seek->Time;
+  out->Period = seek->Period;
+
+  stream = buffer + sizeof(header);
+  if(DecodeChannel(stream,header.Size[0],header.Mode[0],header.K[0],n - 1,header.First[0],zigzag,out->A0) < 0) return -1;
+  stream += header.Size[0];
+  if(DecodeChannel(stream,header.Size[1],header.Mode[1],header.K[1],n - 1,header.First[1],zigzag,out->A1) < 0) return -1;
+  stream += header.Size[1];
+
+  // flags first , the tick prediction needs the overrun
+  {
+    const unsigned char * f = stream + header.Size[2];
+    const unsigned char * end = f + header.Size[3];
+
+    for(idx=0;(idx < n) && (f < end);)
+     {
+       flags = *f++;
+       run = 0;
+       shift = 0;
+       while((f < end) && (*f & 0x80))
+         {
+           run |= (unsigned long long) (*f++ & 0x7F) << shift;
+           shift += 7;
+         }
+       if(f >= end) return -1;
+       run |= (unsigned long long) *f++ << shift;
+       if((idx + run + 1) > (unsigned long long) n) return -1;
+       memset(&out->Flags[idx],flags & 0x1F,run + 1);
+       memset(&out->Overrun[idx],flags >> 5,run + 1);
+       idx += run + 1;
+     }
+    if(idx != n) return -1;
+  }
+
+  r.In = stream;
+  r.End = stream + header.Size[2];
+  r.Buffer = 0;
+  r.Bits = 0;
+  out->Tick[0] = header.Tick;
+  for(loop=1;loop<n;loop++)
+   {
+     value = 0;
+     if((header.Mode[2] != MODE_ZERO) && (RiceGet(&r,header.K[2],&value) < 0)) return -1;
+     diff = (long long) (value >> 1) ^ -(long long) (value & 1);
+     out->Tick[loop] = out->Tick[loop - 1] + 1 + out->Overrun[loop] + diff;
+   }
+  return n;
+}
+
+
+////////////////////////////////////   A2DArchiveRead
+//
+//    Samples from an index into a block. The chunk is kept for the next call.
+//
+//    Inputs,
+//
+//    archive:   archive opened with A2DArchiveOpen
+//    sample:    first sample index
+//    block:     result , up to A2D_BLOCK_SIZE samples (not over the end of the chunk)
+//
+//    Return,
+//
+//    number of samples , 0 at the end of the archive
+//    < 0 error
+//
+int A2DArchiveRead(A2DArchive * archive, unsigned long long sample, A2DBlock * block)
+{
+  A2DArchiveChunk * c = archive->Pending;
+  long long chunk;
+  int idx, loop;
+
+  block->Count = 0;
+  chunk = A2DArchiveFindSample(archive,sample);
+  if(chunk < 0) return 0;
+  if(chunk != archive->Loaded)
+    {
+      archive->Loaded = -1;
+      if(A2DArchiveReadChunk(archive,chunk,c) < 0) return -1;
+      archive->Loaded = chunk;
+    }
+
+  idx = sample - c->Sample;
+  for(loop=0;(loop < A2D_BLOCK_SIZE) && (idx < c->Count);loop++,idx++)
+   {
+     block->A0[loop] = c->A0[idx];
+     block->A1[loop] = c->A1[idx];
+     block->Overrun[loop] = c->Overrun[idx];
+     block->Flags[loop] = c->Flags[idx];
+     block->Time[loop] = c->Tick[idx];
+   }
+  block->Count = loop;
+  return loop;
+}
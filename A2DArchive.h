@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdio.h>
+#include "A2DStream.h"
+
+// compressed archive. Samples are coded in chunks of A2D_ARCHIVE_CHUNK , each channel as
+// deltas with a Rice code (or 10 bits packed when smaller) , the flags as runs.
+// A seek table at the end gives the offset of each chunk with its first sample index and tick.
+//
+// tick: the stamp (Time) of stamped samples , else the last tick + 1 + Overrun
+// (the sample number in timer mode , lost samples included)
+//
+// each seek entry is also the zone map of its chunk: host time , min/max of each channel and
+// the flags seen , so a query skips the chunks that can't match without reading them
+//
+// a chunk has one time base: the host time of its first sample and the period. The writer
+// starts a new chunk at A2DArchiveSync() (a store page after a gap or with another period)
+
+#define A2D_ARCHIVE_MAGIC	"A2DZ"
+#define A2D_ARCHIVE_VERSION	3
+#define A2D_ARCHIVE_CHUNK	4096
+
+typedef struct{
+  char           Magic[4];
+  unsigned int   Version;
+  double         Start;		// host time of sample 0 , seconds since the epoch
+  double         Period;	// seconds between two samples , first chunk (each seek entry has its period)
+  unsigned int   ChunkSize;
+  unsigned int   Address;	// device I2C address , 0 = unknown
+}A2DArchiveHeader;
+
+typedef struct{
+  unsigned long long Sample;	// first sample index
+  unsigned long long Tick;	// first tick
+  unsigned long long Offset;	// file offset of the chunk
+  double         Time;		// host time of the first sample
+  double         Period;	// seconds between two samples of the chunk
+  unsigned int   Count;
+  unsigned int   Bytes;
+  unsigned short Min[2];	// zone map , A0 , A1
+  unsigned short Max[2];
+  unsigned char  Flags;		// OR of the sample flags
+  unsigned char  Overrun;	// max Overrun count
+  unsigned char  Reserved[6];
+}A2DArchiveSeek;
+
+typedef struct{
+  unsigned long long SeekOffset;
+  unsigned long long Chunks;
+  unsigned long long Samples;
+  char           Magic[4];
+  unsigned int   Reserved;
+}A2DArchiveFooter;
+
+// one decoded chunk
+typedef struct{
+  int            Count;
+  unsigned long long Sample;
+  double         Time;		// host time of the first sample
+  double         Period;	// seconds between two samples , sample time = Time + (index + lost samples) * Period
+  unsigned short A0[A2D_ARCHIVE_CHUNK];
+  unsigned short A1[A2D_ARCHIVE_CHUNK];
+  unsigned char  Overrun[A2D_ARCHIVE_CHUNK];
+  unsigned char  Flags[A2D_ARCHIVE_CHUNK];
+  unsigned long long Tick[A2D_ARCHIVE_CHUNK];
+}A2DArchiveChunk;
+
+typedef struct{
+  FILE *         File;
+  int            Writing;
+  A2DArchiveHeader Header;
+  A2DArchiveSeek * Seek;
+  unsigned long long Chunks;
+  unsigned long long SeekMax;
+  unsigned long long Samples;
+  unsigned long long LastTick;	// tick of the last sample appended , for the next one
+  double         Next;		// host time of the next sample appended
+  double         Period;	// period of the samples appended
+  int            Synced;	// the next sample starts at Next , its Overrun only marks the gap
+  unsigned long long Bytes;	// file size
+  A2DArchiveChunk * Pending;	// samples waiting for a full chunk (writer) , last chunk read (reader)
+  long long      Loaded;	// chunk in Pending (reader) , -1 = none
+  void *         Work;		// coder buffers
+}A2DArchive;
+
+int			A2DArchiveCreate(A2DArchive * archive, const char * filename, int address, double start, double period);
+int			A2DArchiveAppend(A2DArchive * archive, const A2DBlock * block);
+int			A2DArchiveSync(A2DArchive * archive, double time, double period);
+int			A2DArchiveOpen(A2DArchive * archive, const char * filename);
+int			A2DArchiveClose(A2DArchive * archive);
+long long		A2DArchiveFindSample(const A2DArchive * archive, unsigned long long sample);
+long long		A2DArchiveFindTick(const A2DArchive * archive, unsigned long long tick);
+int			A2DArchiveReadChunk(A2DArchive * archive, long long chunk, A2DArchiveChunk * out);
+int			A2DArchiveRead(A2DArchive * archive, unsigned long long sample, A2DBlock * block);
@@ -0,0 +1,407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include "A2DCalib.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DCalib
+//
+//    Calibrated units from the raw counts , per device and per channel.
+//    Offset/gain (or a 1024 entries table) are measured once and stored in
+//    /etc/a2d/calibration.conf , one line per channel:
+//
+//       # address channel offset gain [table file]
+//       0x20 A0 1.5 0.0019980
+//       0x20 A1 0 0.002 /etc/a2d/calib-0x20-A1.lut
+//
+//    The conversions work on 4 samples at a time with the gcc vector extensions
+//    (NEON on the Raspberry Pi , SSE on a PC).
+//
+//   to compile add A2DCalib.c to the gcc command line with -O2 and -lm
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+typedef float          CalibV4F __attribute__((vector_size(16)));
+typedef int            CalibV4I __attribute__((vector_size(16)));
+typedef unsigned short CalibV4U __attribute__((vector_size(8)));
+
+static const char * ChannelName[2] = { "A0", "A1" };
+
+
+////////////////////////////////////   A2DCalibSet
+//
+//    Set offset and gain of one channel. The table , if any , is kept.
+//
+//    Inputs,
+//
+//    calib:    device calibration
+//    channel:  0 = A0 , 1 = A1
+//    offset:   counts at 0 unit
+//    gain:     units per count
+//
+//    Return,
+//
+//    0   ok
+//    1   set , gain too large for A2DCalibFixed() (float only)
+//    < 0 invalid channel
+//
+int A2DCalibSet(A2DCalib * calib, int channel, float offset, float gain)
+{
+  A2DCalibChannel * ch;
+  double gain_fixed, offset_fixed;
+
+  if((channel < 0) || (channel > 1)) return -1;
+
+  ch = &calib->Channel[channel];
+  ch->Offset = offset;
+  ch->Gain = gain;
+  ch->GainFixed = 0;
+  ch->OffsetFixed = 0;
+  ch->Fixed = 0;
+
+  // the fixed point result has to fit 32 bits over the whole 10 bits range
+  gain_fixed = gain * 1.0e6;
+  offset_fixed = -offset * gain * 1.0e6;
+  if((fabs(offset_fixed) + fabs(gain_fixed) * 1023.0) > 2147483647.0) return 1;
+
+  ch->GainFixed = lrint(gain_fixed);
+  ch->OffsetFixed = lrint(offset_fixed);
+  ch->Fixed = 1;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DCalibDefault
+//
+//    Volts from the 2.048V reference , no offset , no table
+//
+void A2DCalibDefault(A2DCalib * calib, unsigned char address)
+{
+  memset(calib,0,sizeof(A2DCalib));
+  calib->Address = address;
+  A2DCalibSet(calib,0,0.0f,A2D_CALIB_VOLT_GAIN);
+  A2DCalibSet(calib,1,0.0f,A2D_CALIB_VOLT_GAIN);
+}
+
+
+////////////////////////////////////   A2DCalibFromPoints
+//
+//    Offset and gain from two measured points (raw count , known input in units).
+//    Use averaged raw counts , near both ends of the range.
+//
+//    Return,
+//
+//    0   ok
+//    1   set , float only (see A2DCalibSet)
+//    < 0 invalid points
+//
+int A2DCalibFromPoints(A2DCalib * calib, int channel, float raw1, float value1, float raw2, float value2)
+{
+  float gain;
+
+  if(raw1 == raw2) return -1;
+  gain = (value2 - value1) / (raw2 - raw1);
+  if(gain == 0.0f) return -1;
+  return A2DCalibSet(calib,channel,raw1 - value1 / gain,gain);
+}
+
+
+static float * LoadLut(const char * filename)
+{
+  FILE * in;
+  float * lut;
+  int loop;
+
+  in = fopen(filename,"r");
+  if(in == NULL) return NULL;
+  lut = malloc(A2D_CALIB_LUT_SIZE * sizeof(float));
+  if(lut != NULL)
+    for(loop=0;loop<A2D_CALIB_LUT_SIZE;loop++)
+      if(fscanf(in,"%f",&lut[loop]) != 1)
+        {
+          free(lut);
+          lut = NULL;
+          break;
+        }
+  fclose(in);
+  return lut;
+}
+
+
+////////////////////////////////////   A2DCalibLoad
+//
+//    Load the calibration of one device
+//
+//    Inputs,
+//
+//    calib:     result , default values for the channels not in the file
+//    address:   device address
+//    filename:  NULL = A2D_CALIB_FILE
+//
+//    Return,
+//
+//    0   both channels found
+//    1   default values used for one or both channels
+//    < 0 invalid line or table file
+//
+//    A gain too large for the micro units keeps the float calibration , A2DCalibFixed()
+//    of that channel returns -1.
+//
+int A2DCalibLoad(A2DCalib * calib, unsigned char address, const char * filename)
+{
+  FILE * in;
+  char line[512];
+  char name[8];
+  char lutfile[512];
+  unsigned int addr;
+  float offset, gain;
+  int found = 0;
+  int fields, channel;
+
+  A2DCalibDefault(calib,address);
+  if(filename == NULL) filename = A2D_CALIB_FILE;
+
+  in = fopen(filename,"r");
+  if(in == NULL) return errno == ENOENT ? 1 : -1;
+
+  while(fgets(line,sizeof(line),in))
+   {
+     if((line[0] == '#') || (line[0] == '\n')) continue;
+     fields = sscanf(line,"%i %7s %f %f %511s",&addr,name,&offset,&gain,lutfile);
+     if(fields < 4) goto invalid;
+     if(addr != address) continue;
+     if(strcmp(name,"A0") == 0)
+       channel = 0;
+     else if(strcmp(name,"A1") == 0)
+       channel = 1;
+     else
+       goto invalid;
+     if(A2DCalibSet(calib,channel,offset,gain) < 0) goto invalid;
+     if(fields == 5)
+       {
+         free(calib->Channel[channel].Lut);
+         calib->Channel[channel].Lut = LoadLut(lutfile);
+         if(calib->Channel[channel].Lut == NULL) goto invalid;
+       }
+     found |= 1 << channel;
+   }
+  fclose(in);
+  return found == 3 ? 0 : 1;
+
+invalid:
+  fclose(in);
+  A2DCalibFree(calib);
+  return -1;
+}
+
+
+////////////////////////////////////   A2DCalibSave
+//
+//    Store the calibration of one device. The lines of the other devices are kept.
+//    A table goes into calib-0xNN-An.lut next to the file. The file is replaced atomically.
+//
+//    Inputs,
+//
+//    calib:     device calibration
+//    filename:  NULL = A2D_CALIB_FILE
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DCalibSave(const A2DCalib * calib, const char * filename)
+{
+  FILE * in;
+  FILE * out;
+  char line[512];
+  char temp[512];
+  char path[512];
+  char dir[256];
+  char lutfile[512];
+  unsigned int addr;
+  int channel, loop;
+
+  if(filename == NULL) filename = A2D_CALIB_FILE;
+  snprintf(path,sizeof(path),"%s",filename);
+  snprintf(dir,sizeof(dir),"%s",dirname(path));
+  mkdir(dir,0755);
+
+  snprintf(temp,sizeof(temp),"%s.tmp",filename);
+  out = fopen(temp,"w");
+  if(out == NULL) return -1;
+
+  in = fopen(filename,"r");
+  if(in == NULL)
+    fprintf(out,"# address channel offset gain [table file]\n");
+  else
+    {
+      while(fgets(line,sizeof(line),in))
+        if((line[0] == '#') || (sscanf(line,"%i",&addr) != 1) || (addr != calib->Address))
+          fputs(line,out);
+      fclose(in);
+    }
+
+  for(channel=0;channel<2;channel++)
+   {
+     const A2DCalibChannel * ch = &calib->Channel[channel];
+
+     fprintf(out,"0x%02x %s %.6g %.9g",calib->Address,ChannelName[channel],ch->Offset,ch->Gain);
+     if(ch->Lut)
+       {
+         FILE * lut;
+
+         snprintf(lutfile,sizeof(lutfile),"%s/calib-0x%02x-%s.lut",dir,calib->Address,ChannelName[channel]);
+         lut = fopen(lutfile,"w");
+         if(lut == NULL)
+           {
+             fclose(out);
+             remove(temp);
+             return -1;
+           }
+         for(loop=0;loop<A2D_CALIB_LUT_SIZE;loop++)
+           fprintf(lut,"%.9g\n",ch->Lut[loop]);
+         fclose(lut);
+         fprintf(out," %s",lutfile);
+       }
+     fprintf(out,"\n");
+   }
+
+  if(fclose(out) != 0)
+    {
+      remove(temp);
+      return -1;
+    }
+  return rename(temp,filename);
+}
+
+
+void A2DCalibFree(A2DCalib * calib)
+{
+  free(calib->Channel[0].Lut);
+  free(calib->Channel[1].Lut);
+  calib->Channel[0].Lut = NULL;
+  calib->Channel[1].Lut = NULL;
+}
+
+
+////////////////////////////////////   A2DCalibFloat
+//
+//    Raw counts to units , 4 samples per step
+//
+//    Inputs,
+//
+//    calib:    device calibration
+//    channel:  0 = A0 , 1 = A1
+//    raw:      raw counts
+//    n:        number of samples
+//    out:      result
+//
+void A2DCalibFloat(const A2DCalib * calib, int channel, const unsigned short * raw, int n, float * out)
+{
+  const A2DCalibChannel * ch = &calib->Channel[channel & 1];
+  float offset = -ch->Offset * ch->Gain;
+  CalibV4F gain = { ch->Gain, ch->Gain, ch->Gain, ch->Gain };
+  CalibV4F base = { offset, offset, offset, offset };
+  CalibV4U r;
+  CalibV4F f;
+  int loop = 0;
+
+  if(ch->Lut)
+    {  // table lookup , no vector gather
+      for(;loop<n;loop++)
+        out[loop] = ch->Lut[raw[loop] & (A2D_CALIB_LUT_SIZE - 1)];
+      return;
+    }
+
+  for(;(loop + 4) <= n;loop+=4)
+   {
+     memcpy(&r,&raw[loop],sizeof(r));
+     f = __builtin_convertvector(r,CalibV4F) * gain + base;
+     memcpy(&out[loop],&f,sizeof(f));
+   }
+  for(;loop<n;loop++)
+    out[loop] = raw[loop] * ch->Gain + offset;
+}
+
+
+////////////////////////////////////   A2DCalibFixed
+//
+//    Raw counts to micro units (int) , 4 samples per step. No float on the way.
+//    The table , if any , is rounded to micro units.
+//
+//    Return,
+//
+//    0   ok
+//    < 0 the gain of the channel is too large for micro units , use A2DCalibFloat()
+//
+int A2DCalibFixed(const A2DCalib * calib, int channel, const unsigned short * raw, int n, int * out)
+{
+  const A2DCalibChannel * ch = &calib->Channel[channel & 1];
+  CalibV4I gain = { ch->GainFixed, ch->GainFixed, ch->GainFixed, ch->GainFixed };
+  CalibV4I base = { ch->OffsetFixed, ch->OffsetFixed, ch->OffsetFixed, ch->OffsetFixed };
+  CalibV4U r;
+  CalibV4I v;
+  int loop = 0;
+
+  if(ch->Lut)
+    {
+      for(;loop<n;loop++)
+        out[loop] = lrintf(ch->Lut[raw[loop] & (A2D_CALIB_LUT_SIZE - 1)] * 1.0e6f);
+      return 0;
+    }
+  if(!ch->Fixed) return -1;
+
+  for(;(loop + 4) <= n;loop+=4)
+   {
+     memcpy(&r,&raw[loop],sizeof(r));
+     v = __builtin_convertvector(r,CalibV4I) * gain + base;
+     memcpy(&out[loop],&v,sizeof(v));
+   }
+  for(;loop<n;loop++)
+    out[loop] = raw[loop] * ch->GainFixed + ch->OffsetFixed;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DCalibBlock
+//
+//    Both channels of a decoded block to units. a0 or a1 could be NULL.
+//    For a single channel block (A2DReadDense) the samples are in the array of the channel read.
+//
+void A2DCalibBlock(const A2DCalib * calib, const A2DBlock * block, float * a0, float * a1)
+{
+  if(a0) A2DCalibFloat(calib,0,block->A0,block->Count,a0);
+  if(a1) A2DCalibFloat(calib,1,block->A1,block->Count,a1);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "A2DStream.h"
+
+// calibrated units. Raw counts are 10 bits against the 2.048V internal reference (FVRCON)
+// value = (raw - Offset) * Gain , or Lut[raw] when the channel has a table
+
+#define A2D_CALIB_FILE		"/etc/a2d/calibration.conf"
+#define A2D_CALIB_VOLT_GAIN	(2.048f / 1024.0f)	// default , volts per count
+#define A2D_CALIB_LUT_SIZE	1024
+
+typedef struct{
+  float          Offset;	// counts
+  float          Gain;		// units per count
+  float *        Lut;		// A2D_CALIB_LUT_SIZE entries in units , NULL = none
+  int            GainFixed;	// micro units per count , for A2DCalibFixed()
+  int            OffsetFixed;	// micro units at raw 0
+  int            Fixed;		// 0 = the micro units don't fit an int , float only
+}A2DCalibChannel;
+
+typedef struct{
+  unsigned char   Address;
+  A2DCalibChannel Channel[2];	// A0 , A1
+}A2DCalib;
+
+void			A2DCalibDefault(A2DCalib * calib, unsigned char address);
+int			A2DCalibSet(A2DCalib * calib, int channel, float offset, float gain);
+int			A2DCalibFromPoints(A2DCalib * calib, int channel, float raw1, float value1, float raw2, float value2);
+int			A2DCalibLoad(A2DCalib * calib, unsigned char address, const char * filename);
+int			A2DCalibSave(const A2DCalib * calib, const char * filename);
+void			A2DCalibFree(A2DCalib * calib);
+void			A2DCalibFloat(const A2DCalib * calib, int channel, const unsigned short * raw, int n, float * out);
+int			A2DCalibFixed(const A2DCalib * calib, int channel, const unsigned short * raw, int n, int * out);
+void			A2DCalibBlock(const A2DCalib * calib, const A2DBlock * block, float * a0, float * a1);
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include "I2CWrapper.h"
+#include "A2DDevice.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DDevice
+//
+//    Device settings helpers on top of the I2C_A2D.h command macros
+//
+//   to compile add A2DDevice.c to the gcc command line
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+////////////////////////////////////   A2DHwTimerFromPeriod
+//
+//    Split a sample period into the hardware timer period and postscaler (command 14)
+//
+//    Inputs,
+//
+//    period_us:       sample period in us
+//    single_channel:  1 if the channel mask select only one channel (lower minimum)
+//    hwtimer:         result
+//
+//    Return,
+//
+//    0   exact period
+//    1   closest period possible (period_us could not be split exactly)
+//    < 0 period out of range
+//
+int A2DHwTimerFromPeriod(unsigned long period_us, int single_channel, A2D_HwTimer * hwtimer)
+{
+  unsigned long minimum = single_channel ? 50 : 100;
+  unsigned long postscale;
+  unsigned long period;
+
+  if(period_us < minimum) return -1;
+  if(period_us > (65535UL * 65535UL)) return -1;
+
+  // smallest postscaler first, it gives the less interrupts
+  for(postscale = (period_us + 65534UL) / 65535UL; postscale <= 65535UL; postscale++)
+   {
+     if((period_us / postscale) < minimum) break;
+     if((period_us % postscale) == 0)
+      {
+        hwtimer->Period = period_us / postscale;
+        hwtimer->Postscale = postscale;
+        return 0;
+      }
+   }
+
+  // no exact split, take the closest one with the smallest postscaler
+  postscale = (period_us + 65534UL) / 65535UL;
+  period = (period_us + (postscale/2)) / postscale;
+  if(period > 65535UL) period = 65535UL;
+  if(period < minimum) period = minimum;
+  hwtimer->Period = period;
+  hwtimer->Postscale = postscale;
+  return 1;
+}
+
+
+////////////////////////////////////   A2DSetSamplePeriod
+//
+//    Set the hardware sample clock (command 14)
+//
+//    Inputs,
+//
+//    handle:          IO handle
+//    period_us:       sample period in us
+//    single_channel:  1 if the channel mask select only one channel
+//
+//    Return,
+//
+//    0   ok
+//    1   ok , closest period used
+//    < 0 error
+//
+int A2DSetSamplePeriod(int handle, unsigned long period_us, int single_channel)
+{
+  A2D_HwTimer hwtimer;
+  int rcode;
+
+  rcode = A2DHwTimerFromPeriod(period_us,single_channel,&hwtimer);
+  if(rcode < 0) return rcode;
+
+  if(A2DHwTimer(handle,&hwtimer) < 0) return -1;
+  return rcode;
+}
+
+
+////////////////////////////////////   A2DBroadcast
+//
+//    Send a command to every A/D device on the bus with the I2C general call.
+//    The devices get it at the same time, so a start begins all acquisitions in the same 100us tick.
+//    Only A2D_CMD_MODE , A2D_CMD_TIMER and A2D_CMD_HW_TIMER are accepted by the firmware (version 1.5 and up).
+//
+//    Inputs,
+//
+//    handle:   IO handle
+//    cmd:      A2D command
+//    size:     number of data bytes
+//    data:     command data (little endian like the smbus commands)
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DBroadcast(int handle, unsigned char cmd, unsigned char size, const void * data)
+{
+  unsigned char frame[32];
+
+  if(size > (sizeof(frame) - 2)) return -1;
+
+  frame[0] = A2D_GENERAL_CALL_TAG;
+  frame[1] = cmd;
+  memcpy(&frame[2],data,size);
+
+  if(I2CWrapperGeneralCall(handle,size + 2,frame) < 0) return -1;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DReadLiveProfile
+//
+//    Read the current acquisition settings in the command 17 profile layout
+//
+//    Inputs,
+//
+//    handle:   IO handle
+//    profile:  result. Tag is set to A2D_PROFILE_TAG
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DReadLiveProfile(int handle, A2D_Profile * profile)
+{
+  int value;
+
+  memset(profile,0,sizeof(A2D_Profile));
+  profile->Tag = A2D_PROFILE_TAG;
+
+  if((value = A2DReadAutoStart(handle)) < 0) return -1;
+  profile->AutoStart = value;
+  if((value = I2CWrapperReadWord(handle,A2D_CMD_TIMER)) < 0) return -1;
+  profile->Timer = value;
+  if((value = A2DReadChannelMask(handle)) < 0) return -1;
+  profile->ChannelMask = value;
+  if((value = I2CWrapperReadByte(handle,A2D_CMD_EVENT)) < 0) return -1;
+  profile->EventControl = value;
+  if(A2DReadWindow(handle,&profile->Window) < 0) return -1;
+  if((value = A2DReadWatermark(handle)) < 0) return -1;
+  profile->Watermark = value;
+  if(A2DReadHwTimer(handle,&profile->HwTimer) < 0) return -1;
+  if((value = A2DReadRecordOptions(handle)) < 0) return -1;
+  profile->RecordOptions = value;
+  if(A2DReadBurst(handle,&profile->Burst) < 0) return -1;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DSaveProfile
+//
+//    Store the current acquisition settings into the device eeprom (command 09)
+//    and confirm it by reading the stored profile back (command 17).
+//    With autostart set, the device start sampling on power-up without the host.
+//
+//    Inputs,
+//
+//    handle:     IO handle
+//    autostart:  A2D_MODE_xxx to start on power-up , A2D_MODE_OFF = no autostart
+//
+//    Return,
+//
+//    0   ok , stored profile is the same as the current settings
+//    1   stored profile is different
+//    < 0 error
+//
+int A2DSaveProfile(int handle, unsigned char autostart)
+{
+  A2D_Profile live;
+  A2D_Profile stored;
+  int loop;
+
+  if(A2DAutoStart(handle,autostart) < 0) return -1;
+  if(A2DReadLiveProfile(handle,&live) < 0) return -1;
+  if(A2DFlashEeprom(handle) < 0) return -1;
+
+  // the eeprom write takes ~4ms per byte. Tag is 0 until it is done
+  for(loop=0;loop<50;loop++)
+   {
+     usleep(10000);
+     if(A2DReadProfile(handle,&stored) < 0) return -1;
+     if(stored.Tag != 0) break;
+   }
+  if(stored.Tag != A2D_PROFILE_TAG) return -1;
+
+  return memcmp(&live,&stored,sizeof(A2D_Profile)) == 0 ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "I2C_A2D.h"
+
+int			A2DHwTimerFromPeriod(unsigned long period_us, int single_channel, A2D_HwTimer * hwtimer);
+int			A2DSetSamplePeriod(int handle, unsigned long period_us, int single_channel);
+int			A2DBroadcast(int handle, unsigned char cmd, unsigned char size, const void * data);
+int			A2DReadLiveProfile(int handle, A2D_Profile * profile);
+int			A2DSaveProfile(int handle, unsigned char autostart);
+
+#define A2DBroadcastMode(HDL,MD)		A2DBroadcast(HDL,A2D_CMD_MODE,1,&(unsigned char){MD})
+#define A2DBroadcastTimer(HDL,VALUE)		A2DBroadcast(HDL,A2D_CMD_TIMER,2,&(unsigned short){VALUE})
+#define A2DBroadcastHwTimer(HDL,HWTIMER)	A2DBroadcast(HDL,A2D_CMD_HW_TIMER,sizeof(A2D_HwTimer),HWTIMER)
@@ -0,0 +1,551 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "A2DDiscover.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DDiscover
+//
+//    Bus discovery and device inventory cache
+//
+//    A2DDiscoverAll() sweeps 0x03..0x77 on every adapter , one thread per adapter.
+//    Each address gets the version read (command 07 , Id 0xE7) , then each device found gets
+//    its version , OscTune and live settings in one I2C_RDWR transaction (repeated starts).
+//
+//    A2DInventoryStartup() is the fast start: the cached inventory is only verified ,
+//    21 devices per I2C_RDWR (the 42 messages limit of i2c-dev). A batch with a missing device
+//    fails as a whole , it is split in two until the missing ones are found. The full
+//    discovery is done when there is no cache or when a device doesn't answer.
+//
+//    The wrapper functions of I2CWrapper.c exit on a NACK (ExitOnFail) , the probes here
+//    use the ioctl directly.
+//
+//   to compile add A2DDiscover.c to the gcc command line with -lpthread
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define RDWR_MAX_MSGS	42		// I2C_RDWR_IOCTL_MAX_MSGS
+#define VERIFY_BATCH	(RDWR_MAX_MSGS / 2)
+#define A2D_ID		0xE7
+
+// settings read at the discovery: command , size , offset in A2DDeviceInfo
+typedef struct{
+  unsigned char  Cmd;
+  unsigned char  Size;
+  unsigned short Offset;
+}InfoRead;
+
+#define SETTING(CMD,FIELD)	{ CMD, sizeof(((A2D_Profile *)0)->FIELD), offsetof(A2DDeviceInfo,Settings) + offsetof(A2D_Profile,FIELD) }
+
+static const InfoRead InfoReads[] = {
+  { A2D_CMD_VERSION, sizeof(A2D_Version), offsetof(A2DDeviceInfo,Version) },
+  { A2D_CMD_OSC_TUNE, 1, offsetof(A2DDeviceInfo,OscTune) },
+  SETTING(A2D_CMD_AUTOSTART,AutoStart),
+  SETTING(A2D_CMD_TIMER,Timer),
+  SETTING(A2D_CMD_CHANNEL,ChannelMask),
+  SETTING(A2D_CMD_EVENT,EventControl),
+  SETTING(A2D_CMD_WINDOW,Window),
+  SETTING(A2D_CMD_WATERMARK,Watermark),
+  SETTING(A2D_CMD_HW_TIMER,HwTimer),
+  SETTING(A2D_CMD_RECORD,RecordOptions),
+  SETTING(A2D_CMD_BURST,Burst),
+};
+
+#define INFO_READS	(sizeof(InfoReads) / sizeof(InfoRead))
+
+
+void A2DInventoryInit(A2DInventory * inventory)
+{
+  memset(inventory,0,sizeof(A2DInventory));
+}
+
+
+void A2DInventoryFree(A2DInventory * inventory)
+{
+  free(inventory->Device);
+  A2DInventoryInit(inventory);
+}
+
+
+static A2DDeviceInfo * InventoryAdd(A2DInventory * inventory)
+{
+  A2DDeviceInfo * device;
+
+  if(inventory->Count >= inventory->Size)
+    {
+      device = realloc(inventory->Device,(inventory->Size + 128) * sizeof(A2DDeviceInfo));
+      if(device == NULL) return NULL;
+      inventory->Device = device;
+      inventory->Size += 128;
+    }
+  device = &inventory->Device[inventory->Count++];
+  memset(device,0,sizeof(A2DDeviceInfo));
+  return device;
+}
+
+
+static int BusOpen(int bus)
+{
+  char name[32];
+
+  snprintf(name,sizeof(name),"/dev/i2c-%d",bus);
+  return open(name,O_RDWR | O_CLOEXEC);
+}
+
+
+static int BusTransfer(int fd, struct i2c_msg * msgs, int count)
+{
+  struct i2c_rdwr_ioctl_data rdwr;
+
+  rdwr.msgs = msgs;
+  rdwr.nmsgs = count;
+  return ioctl(fd,I2C_RDWR,&rdwr);
+}
+
+
+// version read , 1 = A2D device
+static int Probe(int fd, int address, A2D_Version * version)
+{
+  unsigned char cmd = A2D_CMD_VERSION;
+  struct i2c_msg msgs[2];
+
+  msgs[0].addr = address;
+  msgs[0].flags = 0;
+  msgs[0].len = 1;
+  msgs[0].buf = &cmd;
+  msgs[1].addr = address;
+  msgs[1].flags = I2C_M_RD;
+  msgs[1].len = sizeof(A2D_Version);
+  msgs[1].buf = (unsigned char *) version;
+  if(BusTransfer(fd,msgs,2) < 0) return 0;
+  return version->Id == A2D_ID;
+}
+
+
+// version , OscTune and settings in one transaction
+static int ReadInfo(int fd, A2DDeviceInfo * device)
+{
+  struct i2c_msg msgs[INFO_READS * 2];
+  unsigned char cmd[INFO_READS];
+  unsigned int loop;
+
+  for(loop=0;loop<INFO_READS;loop++)
+   {
+     cmd[loop] = InfoReads[loop].Cmd;
+     msgs[loop * 2].addr = device->Address;
+     msgs[loop * 2].flags = 0;
+     msgs[loop * 2].len = 1;
+     msgs[loop * 2].buf = &cmd[loop];
+     msgs[loop * 2 + 1].addr = device->Address;
+     msgs[loop * 2 + 1].flags = I2C_M_RD;
+     msgs[loop * 2 + 1].len = InfoReads[loop].Size;
+     msgs[loop * 2 + 1].buf = (unsigned char *) device + InfoReads[loop].Offset;
+   }
+  if(BusTransfer(fd,msgs,INFO_READS * 2) < 0) return -1;
+  device->Settings.Tag = A2D_PROFILE_TAG;
+  return device->Version.Id == A2D_ID ? 0 : -1;
+}
+
+
+////////////////////////////////////   A2DDiscoverBus
+//
+//    Sweep one adapter , the devices found are added to the inventory
+//
+//    Inputs,
+//
+//    bus:        adapter number (/dev/i2c-N)
+//    inventory:  result
+//
+//    Return,
+//
+//    number of devices found
+//    < 0 adapter not available
+//
+int A2DDiscoverBus(int bus, A2DInventory * inventory)
+{
+  A2DDeviceInfo * device;
+  A2D_Version version;
+  int fd, address;
+  int found = 0;
+
+  fd = BusOpen(bus);
+  if(fd < 0) return -1;
+
+  for(address=A2D_DISCOVER_FIRST;address<=A2D_DISCOVER_LAST;address++)
+   {
+     if(!Probe(fd,address,&version)) continue;
+     device = InventoryAdd(inventory);
+     if(device == NULL) break;
+     device->Bus = bus;
+     device->Address = address;
+     if(ReadInfo(fd,device) < 0)
+       {
+         inventory->Count--;            // gone between the two reads
+         continue;
+       }
+     device->Present = 1;
+     found++;
+   }
+  close(fd);
+  return found;
+}
+
+
+typedef struct{
+  int            Bus;
+  int            Result;
+  A2DInventory   Inventory;
+}DiscoverJob;
+
+
+static void * DiscoverThread(void * arg)
+{
+  DiscoverJob * job = arg;
+
+  job->Result = A2DDiscoverBus(job->Bus,&job->Inventory);
+  return NULL;
+}
+
+
+// /dev/i2c-N adapters in number order
+static int ListBuses(int * buses, int max)
+{
+  DIR * dir;
+  struct dirent * entry;
+  int count = 0;
+  int bus, loop, tmp;
+
+  dir = opendir("/dev");
+  if(dir == NULL) return 0;
+  while((entry = readdir(dir)) && (count < max))
+    if(sscanf(entry->d_name,"i2c-%d",&bus) == 1)
+      buses[count++] = bus;
+  closedir(dir);
+
+  for(loop=1;loop<count;loop++)
+    for(bus=loop;(bus > 0) && (buses[bus - 1] > buses[bus]);bus--)
+      {
+        tmp = buses[bus];
+        buses[bus] = buses[bus - 1];
+        buses[bus - 1] = tmp;
+      }
+  return count;
+}
+
+
+////////////////////////////////////   A2DDiscoverAll
+//
+//    Sweep the adapters in parallel , one thread each
+//
+//    Inputs,
+//
+//    buses:      adapter numbers , NULL = every /dev/i2c-N
+//    count:      number of adapters in buses
+//    inventory:  result , replaced
+//
+//    Return,
+//
+//    number of devices found
+//    < 0 no adapter or no memory
+//
+int A2DDiscoverAll(const int * buses, int count, A2DInventory * inventory)
+{
+  DiscoverJob job[A2D_DISCOVER_BUS_MAX];
+  pthread_t thread[A2D_DISCOVER_BUS_MAX];
+  int list[A2D_DISCOVER_BUS_MAX];
+  int started[A2D_DISCOVER_BUS_MAX];
+  int adapters = 0;
+  int loop, idx;
+  A2DDeviceInfo * device;
+
+  A2DInventoryFree(inventory);
+  if(buses == NULL)
+    {
+      count = ListBuses(list,A2D_DISCOVER_BUS_MAX);
+      buses = list;
+    }
+  if(count > A2D_DISCOVER_BUS_MAX) count = A2D_DISCOVER_BUS_MAX;
+
+  for(loop=0;loop<count;loop++)
+   {
+     job[loop].Bus = buses[loop];
+     job[loop].Result = -1;
+     A2DInventoryInit(&job[loop].Inventory);
+     started[loop] = pthread_create(&thread[loop],NULL,DiscoverThread,&job[loop]) == 0;
+     if(!started[loop])
+       DiscoverThread(&job[loop]);
+   }
+
+  for(loop=0;loop<count;loop++)
+   {
+     if(started[loop])
+       pthread_join(thread[loop],NULL);
+     if(job[loop].Result >= 0) adapters++;
+     for(idx=0;idx<job[loop].Inventory.Count;idx++)
+       if((device = InventoryAdd(inventory)))
+         *device = job[loop].Inventory.Device[idx];
+     A2DInventoryFree(&job[loop].Inventory);
+   }
+  return adapters ? inventory->Count : -1;
+}
+
+
+// version read of n devices in one transaction , split on a failure
+static void VerifyBatch(int fd, A2DDeviceInfo ** device, int n)
+{
+  struct i2c_msg msgs[RDWR_MAX_MSGS];
+  A2D_Version version[VERIFY_BATCH];
+  unsigned char cmd = A2D_CMD_VERSION;
+  int loop;
+
+  for(loop=0;loop<n;loop++)
+   {
+     msgs[loop * 2].addr = device[loop]->Address;
+     msgs[loop * 2].flags = 0;
+     msgs[loop * 2].len = 1;
+     msgs[loop * 2].buf = &cmd;
+     msgs[loop * 2 + 1].addr = device[loop]->Address;
+     msgs[loop * 2 + 1].flags = I2C_M_RD;
+     msgs[loop * 2 + 1].len = sizeof(A2D_Version);
+     msgs[loop * 2 + 1].buf = (unsigned char *) &version[loop];
+   }
+
+  if(BusTransfer(fd,msgs,n * 2) >= 0)
+    {
+      for(loop=0;loop<n;loop++)
+        device[loop]->Present = (version[loop].Id == A2D_ID) &&
+                                (version[loop].Major == device[loop]->Version.Major) &&
+                                (version[loop].Minor == device[loop]->Version.Minor);
+      return;
+    }
+
+  if(n == 1)
+    {
+      device[0]->Present = 0;
+      return;
+    }
+  VerifyBatch(fd,device,n / 2);
+  VerifyBatch(fd,device + n / 2,n - n / 2);
+}
+
+
+////////////////////////////////////   A2DInventoryVerify
+//
+//    Check that each device of the inventory answers with the same version.
+//    Present is set for each device.
+//
+//    Return,
+//
+//    number of devices missing or changed
+//
+int A2DInventoryVerify(A2DInventory * inventory)
+{
+  A2DDeviceInfo * batch[VERIFY_BATCH];
+  int missing = 0;
+  int loop, n, fd, bus;
+
+  for(loop=0;loop<inventory->Count;)
+   {
+     bus = inventory->Device[loop].Bus;
+     fd = BusOpen(bus);
+     for(n=0;(loop < inventory->Count) && (inventory->Device[loop].Bus == bus);loop++)
+      {
+        inventory->Device[loop].Present = 0;
+        if(fd < 0) continue;
+        batch[n++] = &inventory->Device[loop];
+        if(n == VERIFY_BATCH)
+          {
+            VerifyBatch(fd,batch,n);
+            n = 0;
+          }
+      }
+     if(n)
+       VerifyBatch(fd,batch,n);
+     if(fd >= 0)
+       close(fd);
+   }
+
+  for(loop=0;loop<inventory->Count;loop++)
+    if(!inventory->Device[loop].Present) missing++;
+  return missing;
+}
+
+
+////////////////////////////////////   A2DInventoryLoad
+//
+//    Inputs,
+//
+//    inventory:  result , replaced. Present is 0 until verified
+//    filename:   NULL = A2D_INVENTORY_FILE
+//
+//    Return,
+//
+//    number of devices
+//    < 0 no file or invalid line
+//
+int A2DInventoryLoad(A2DInventory * inventory, const char * filename)
+{
+  FILE * in;
+  A2DDeviceInfo * device;
+  char line[512];
+  char hex[2 * sizeof(A2D_Profile) + 2];
+  unsigned int address, major, minor, byte;
+  int bus, osctune;
+  unsigned int loop;
+
+  A2DInventoryFree(inventory);
+  if(filename == NULL) filename = A2D_INVENTORY_FILE;
+  in = fopen(filename,"r");
+  if(in == NULL) return -1;
+
+  while(fgets(line,sizeof(line),in))
+   {
+     if((line[0] == '#') || (line[0] == '\n')) continue;
+     if((sscanf(line,"%d %i %u.%u %d %65s",&bus,&address,&major,&minor,&osctune,hex) != 6) ||
+        (strlen(hex) != 2 * sizeof(A2D_Profile)) || (address < A2D_DISCOVER_FIRST) || (address > A2D_DISCOVER_LAST))
+       goto invalid;
+     device = InventoryAdd(inventory);
+     if(device == NULL) goto invalid;
+     device->Bus = bus;
+     device->Address = address;
+     device->Version.Id = A2D_ID;
+     device->Version.Tag = 0;
+     device->Version.Major = major;
+     device->Version.Minor = minor;
+     device->OscTune = osctune;
+     for(loop=0;loop<sizeof(A2D_Profile);loop++)
+      {
+        if(sscanf(&hex[loop * 2],"%2x",&byte) != 1) goto invalid;
+        ((unsigned char *) &device->Settings)[loop] = byte;
+      }
+   }
+  fclose(in);
+  return inventory->Count;
+
+invalid:
+  fclose(in);
+  A2DInventoryFree(inventory);
+  return -1;
+}
+
+
+////////////////////////////////////   A2DInventorySave
+//
+//    Store the inventory , the file is replaced atomically
+//
+//    Inputs,
+//
+//    inventory:  devices
+//    filename:   NULL = A2D_INVENTORY_FILE
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DInventorySave(const A2DInventory * inventory, const char * filename)
+{
+  FILE * out;
+  const A2DDeviceInfo * device;
+  char temp[512];
+  char path[512];
+  char dir[256];
+  int loop;
+  unsigned int idx;
+
+  if(filename == NULL) filename = A2D_INVENTORY_FILE;
+  snprintf(path,sizeof(path),"%s",filename);
+  snprintf(dir,sizeof(dir),"%s",dirname(path));
+  mkdir(dir,0755);
+
+  snprintf(temp,sizeof(temp),"%s.tmp",filename);
+  out = fopen(temp,"w");
+  if(out == NULL) return -1;
+
+  fprintf(out,"# bus address version osctune settings (command 17 profile layout)\n");
+  for(loop=0;loop<inventory->Count;loop++)
+   {
+     device = &inventory->Device[loop];
+     if(!device->Present) continue;
+     fprintf(out,"%d 0x%02x %d.%d %d ",device->Bus,device->Address,device->Version.Major,device->Version.Minor,
+             device->OscTune);
+     for(idx=0;idx<sizeof(A2D_Profile);idx++)
+       fprintf(out,"%02x",((const unsigned char *) &device->Settings)[idx]);
+     fprintf(out,"\n");
+   }
+
+  if(fclose(out) != 0)
+    {
+      remove(temp);
+      return -1;
+    }
+  return rename(temp,filename);
+}
+
+
+////////////////////////////////////   A2DInventoryStartup
+//
+//    Load and verify the cached inventory. Without a cache , or when a device
+//    doesn't answer , the buses are discovered again and the cache is replaced.
+//
+//    Inputs,
+//
+//    inventory:  result
+//    filename:   NULL = A2D_INVENTORY_FILE
+//    buses:      adapters for a discovery , NULL = every /dev/i2c-N
+//    count:      number of adapters in buses
+//
+//    Return,
+//
+//    0   cache verified
+//    1   new discovery
+//    < 0 no adapter
+//
+int A2DInventoryStartup(A2DInventory * inventory, const char * filename, const int * buses, int count)
+{
+  if(A2DInventoryLoad(inventory,filename) > 0)
+    if(A2DInventoryVerify(inventory) == 0)
+      return 0;
+
+  if(A2DDiscoverAll(buses,count,inventory) < 0) return -1;
+  A2DInventorySave(inventory,filename);
+  return 1;
+}
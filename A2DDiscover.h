@@ -0,0 +1,35 @@
+#pragma once
+
+#include "I2C_A2D.h"
+
+// bus discovery and the device inventory cache.
+// One line per device in A2D_INVENTORY_FILE: bus address version osctune settings (A2D_Profile in hex)
+
+#define A2D_INVENTORY_FILE	"/etc/a2d/inventory.conf"
+#define A2D_DISCOVER_FIRST	0x03
+#define A2D_DISCOVER_LAST	0x77
+#define A2D_DISCOVER_BUS_MAX	32
+
+typedef struct{
+  int            Bus;		// /dev/i2c-N
+  unsigned char  Address;
+  A2D_Version    Version;
+  signed char    OscTune;
+  A2D_Profile    Settings;	// live settings at the discovery (Tag = A2D_PROFILE_TAG)
+  int            Present;	// answered the last discovery or verification
+}A2DDeviceInfo;
+
+typedef struct{
+  int            Count;
+  int            Size;
+  A2DDeviceInfo * Device;	// bus then address order
+}A2DInventory;
+
+void			A2DInventoryInit(A2DInventory * inventory);
+void			A2DInventoryFree(A2DInventory * inventory);
+int			A2DDiscoverBus(int bus, A2DInventory * inventory);
+int			A2DDiscoverAll(const int * buses, int count, A2DInventory * inventory);
+int			A2DInventoryVerify(A2DInventory * inventory);
+int			A2DInventoryLoad(A2DInventory * inventory, const char * filename);
+int			A2DInventorySave(const A2DInventory * inventory, const char * filename);
+int			A2DInventoryStartup(A2DInventory * inventory, const char * filename, const int * buses, int count);
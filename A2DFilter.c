@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "A2DFilter.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DFilter
+//
+//    Streaming filters for the decoded A0/A1 arrays
+//
+//    A2DFir     polyphase FIR decimator. Only the kept outputs are computed ,
+//               the dot product runs 8 taps per step with the gcc vector extensions.
+//    A2DBiquad  cascade of biquad sections (lowpass , notch or any coefficients).
+//
+//    The fifo marks lost samples with the Overrun count. The samples on both sides of
+//    a gap don't belong to the same signal , so the filters restart there: the FIR waits
+//    for a full window again , the biquad state is set to the first sample (no step).
+//
+//   to compile add A2DFilter.c and A2DCalib.c to the gcc command line with -O2 and -lm
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+typedef float FilterV4F __attribute__((vector_size(16)));
+
+
+////////////////////////////////////   A2DFirLowpass
+//
+//    Windowed sinc lowpass (Blackman window) , unity gain at DC
+//
+//    Inputs,
+//
+//    coeff:   result , taps entries
+//    taps:    filter length
+//    cutoff:  -6dB frequency as a fraction of the input rate (0 .. 0.5).
+//             For a decimation by N , 0.4 / N keeps the alias out of the pass band
+//
+//    Return,
+//
+//    0   ok
+//    < 0 invalid parameters
+//
+int A2DFirLowpass(float * coeff, int taps, float cutoff)
+{
+  double sum = 0.0;
+  double x, w;
+  int loop;
+
+  if((taps < 1) || (cutoff <= 0.0f) || (cutoff > 0.5f)) return -1;
+
+  for(loop=0;loop<taps;loop++)
+   {
+     x = loop - (taps - 1) / 2.0;
+     w = taps > 1 ? 0.42 - 0.5 * cos(2.0 * M_PI * loop / (taps - 1)) + 0.08 * cos(4.0 * M_PI * loop / (taps - 1)) : 1.0;
+     coeff[loop] = (x == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x)) * w;
+     sum += coeff[loop];
+   }
+  for(loop=0;loop<taps;loop++)
+    coeff[loop] /= sum;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DFirInit
+//
+//    Inputs,
+//
+//    fir:         filter state
+//    coeff:       impulse response , taps entries
+//    taps:        filter length
+//    decimation:  1 = no decimation
+//
+//    Return,
+//
+//    0   ok
+//    < 0 invalid parameters or no memory
+//
+int A2DFirInit(A2DFir * fir, const float * coeff, int taps, int decimation)
+{
+  int padded = (taps + 7) & ~7;
+  int loop;
+
+  memset(fir,0,sizeof(A2DFir));
+  if((taps < 1) || (decimation < 1)) return -1;
+
+  fir->Coeff = calloc(padded,sizeof(float));
+  fir->History = calloc(padded * 2,sizeof(float));
+  if((fir->Coeff == NULL) || (fir->History == NULL))
+    {
+      A2DFirFree(fir);
+      return -1;
+    }
+
+  // reversed , the zero padding is on the oldest side
+  for(loop=0;loop<taps;loop++)
+    fir->Coeff[padded - 1 - loop] = coeff[loop];
+  fir->Taps = padded;
+  fir->Decimation = decimation;
+  fir->Fill = padded - taps;            // the padding needs no history
+  return 0;
+}
+
+
+////////////////////////////////////   A2DFirReset
+//
+//    Restart , the next output comes after a full window. The decimation phase is kept.
+//
+void A2DFirReset(A2DFir * fir)
+{
+  int taps = fir->Taps;
+  int loop;
+
+  for(loop=0;(loop < taps) && (fir->Coeff[loop] == 0.0f);loop++);
+  fir->Fill = loop;
+  fir->Gap = 1;
+}
+
+
+static inline float FirDot(const float * x, const float * h, int taps)
+{
+  FilterV4F acc0 = { 0.0f, 0.0f, 0.0f, 0.0f };
+  FilterV4F acc1 = acc0;
+  FilterV4F a0, a1, b0, b1;
+  FilterV4F sum;
+  int loop;
+
+  for(loop=0;loop<taps;loop+=8)
+   {
+     memcpy(&a0,&x[loop],sizeof(a0));
+     memcpy(&a1,&x[loop + 4],sizeof(a1));
+     memcpy(&b0,&h[loop],sizeof(b0));
+     memcpy(&b1,&h[loop + 4],sizeof(b1));
+     acc0 += a0 * b0;
+     acc1 += a1 * b1;
+   }
+  sum = acc0 + acc1;
+  return sum[0] + sum[1] + sum[2] + sum[3];
+}
+
+
+////////////////////////////////////   A2DFirProcess
+//
+//    Filter and decimate a block of samples
+//
+//    Inputs,
+//
+//    fir:      filter state
+//    in:       samples
+//    overrun:  Overrun count of each sample (A2DBlock) , NULL = no gap
+//    n:        number of samples
+//    out:      result , at least n / Decimation + 1 entries
+//    flags:    A2D_FILTER_GAP on the first output after a restart , NULL = not needed
+//
+//    Return,
+//
+//    number of outputs
+//
+int A2DFirProcess(A2DFir * fir, const float * in, const unsigned char * overrun, int n,
+                  float * out, unsigned char * flags)
+{
+  int taps = fir->Taps;
+  int count = 0;
+  int loop;
+
+  for(loop=0;loop<n;loop++)
+   {
+     if(overrun && overrun[loop])
+       {
+         A2DFirReset(fir);
+         fir->Gaps++;
+       }
+
+     fir->History[fir->Pos] = in[loop];
+     fir->History[fir->Pos + taps] = in[loop];
+     if(++fir->Pos >= taps) fir->Pos = 0;
+     if(fir->Fill < taps) fir->Fill++;
+
+     if(++fir->Phase < fir->Decimation) continue;
+     fir->Phase = 0;
+     if(fir->Fill < taps) continue;       // not a full window since the restart
+
+     out[count] = FirDot(&fir->History[fir->Pos],fir->Coeff,taps);
+     if(flags)
+        flags[count] = fir->Gap ? A2D_FILTER_GAP : 0;
+     fir->Gap = 0;
+     count++;
+   }
+  return count;
+}
+
+
+////////////////////////////////////   A2DFirBlock
+//
+//    Filter one channel of a decoded block
+//
+//    Inputs,
+//
+//    fir:      filter state
+//    block:    decoded samples
+//    channel:  0 = A0 , 1 = A1
+//    calib:    device calibration , NULL = raw counts
+//    out:      result , at least A2D_BLOCK_SIZE / Decimation + 1 entries
+//    flags:    A2D_FILTER_GAP on the first output after a restart , NULL = not needed
+//
+//    Return,
+//
+//    number of outputs
+//
+int A2DFirBlock(A2DFir * fir, const A2DBlock * block, int channel, const A2DCalib * calib,
+                float * out, unsigned char * flags)
+{
+  float in[A2D_BLOCK_SIZE];
+  const unsigned short * raw = channel ? block->A1 : block->A0;
+  int loop;
+
+  if(calib)
+    A2DCalibFloat(calib,channel,raw,block->Count,in);
+  else
+    for(loop=0;loop<block->Count;loop++)
+      in[loop] = raw[loop];
+  return A2DFirProcess(fir,in,block->Overrun,block->Count,out,flags);
+}
+
+
+void A2DFirFree(A2DFir * fir)
+{
+  free(fir->Coeff);
+  free(fir->History);
+  fir->Coeff = NULL;
+  fir->History = NULL;
+}
+
+
+void A2DBiquadInit(A2DBiquad * biquad)
+{
+  memset(biquad,0,sizeof(A2DBiquad));
+}
+
+
+////////////////////////////////////   A2DBiquadSet
+//
+//    Add a section , coefficients normalized with a0 = 1
+//
+//    Return,
+//
+//    0   ok
+//    < 0 no more section
+//
+int A2DBiquadSet(A2DBiquad * biquad, float b0, float b1, float b2, float a1, float a2)
+{
+  A2DBiquadSection * section;
+
+  if(biquad->Sections >= A2D_BIQUAD_MAX) return -1;
+  section = &biquad->Section[biquad->Sections++];
+  memset(section,0,sizeof(A2DBiquadSection));
+  section->B0 = b0;
+  section->B1 = b1;
+  section->B2 = b2;
+  section->A1 = a1;
+  section->A2 = a2;
+  biquad->Primed = 0;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DBiquadLowpass
+//
+//    Add a second order lowpass section (audio EQ cookbook)
+//
+//    Inputs,
+//
+//    rate:       sample rate (Hz)
+//    frequency:  cutoff (Hz)
+//    q:          0.7071 = butterworth. Two sections with 0.5412 and 1.3066 give a 4th order butterworth
+//
+int A2DBiquadLowpass(A2DBiquad * biquad, float rate, float frequency, float q)
+{
+  double w = 2.0 * M_PI * frequency / rate;
+  double alpha = sin(w) / (2.0 * q);
+  double a0 = 1.0 + alpha;
+  double c = cos(w);
+
+  if((frequency <= 0.0f) || (frequency >= rate / 2.0f) || (q <= 0.0f)) return -1;
+  return A2DBiquadSet(biquad,(1.0 - c) / 2.0 / a0,(1.0 - c) / a0,(1.0 - c) / 2.0 / a0,
+                      -2.0 * c / a0,(1.0 - alpha) / a0);
+}
+
+
+////////////////////////////////////   A2DBiquadNotch
+//
+//    Add a notch section , 50 or 60Hz mains for example
+//
+//    Inputs,
+//
+//    rate:       sample rate (Hz)
+//    frequency:  notch (Hz)
+//    q:          frequency / bandwidth
+//
+int A2DBiquadNotch(A2DBiquad * biquad, float rate, float frequency, float q)
+{
+  double w = 2.0 * M_PI * frequency / rate;
+  double alpha = sin(w) / (2.0 * q);
+  double a0 = 1.0 + alpha;
+  double c = cos(w);
+
+  if((frequency <= 0.0f) || (frequency >= rate / 2.0f) || (q <= 0.0f)) return -1;
+  return A2DBiquadSet(biquad,1.0 / a0,-2.0 * c / a0,1.0 / a0,-2.0 * c / a0,(1.0 - alpha) / a0);
+}
+
+
+// state of a section with x constant for ever , the output starts without a step
+static void BiquadPrime(A2DBiquad * biquad, float x)
+{
+  A2DBiquadSection * s;
+  float y;
+  int loop;
+
+  for(loop=0;loop<biquad->Sections;loop++)
+   {
+     s = &biquad->Section[loop];
+     y = x * (s->B0 + s->B1 + s->B2) / (1.0f + s->A1 + s->A2);
+     s->S2 = s->B2 * x - s->A2 * y;
+     s->S1 = s->B1 * x - s->A1 * y + s->S2;
+     x = y;
+   }
+  biquad->Primed = 1;
+}
+
+
+////////////////////////////////////   A2DBiquadProcess
+//
+//    Filter a block of samples through all the sections. in and out could be the same array.
+//
+//    Inputs,
+//
+//    biquad:   filter state
+//    in:       samples
+//    overrun:  Overrun count of each sample (A2DBlock) , NULL = no gap
+//    n:        number of samples
+//    out:      result , n entries
+//
+void A2DBiquadProcess(A2DBiquad * biquad, const float * in, const unsigned char * overrun, int n,
+                      float * out)
+{
+  A2DBiquadSection * s;
+  float x, y;
+  int loop, idx;
+
+  for(loop=0;loop<n;loop++)
+   {
+     x = in[loop];
+     if(overrun && overrun[loop])
+       {
+         biquad->Primed = 0;
+         biquad->Gaps++;
+       }
+     if(!biquad->Primed)
+       BiquadPrime(biquad,x);
+
+     for(idx=0;idx<biquad->Sections;idx++)
+      {
+        s = &biquad->Section[idx];
+        y = s->B0 * x + s->S1;
+        s->S1 = s->B1 * x - s->A1 * y + s->S2;
+        s->S2 = s->B2 * x - s->A2 * y;
+        x = y;
+      }
+     out[loop] = x;
+   }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "A2DStream.h"
+#include "A2DCalib.h"
+
+// streaming filters on one channel. The state is kept from block to block.
+// A sample with Overrun != 0 follows lost samples: the filter restarts there
+// and the first output after it is flagged A2D_FILTER_GAP
+
+#define A2D_FILTER_GAP		1
+#define A2D_BIQUAD_MAX		8	// sections
+
+typedef struct{
+  int            Taps;		// padded to a multiple of 8
+  int            Decimation;	// one output every N inputs
+  float *        Coeff;		// reversed , oldest sample first
+  float *        History;	// 2 * Taps , each sample written twice so the window is contiguous
+  int            Pos;		// next write , the oldest sample
+  int            Fill;		// samples since the last restart
+  int            Phase;		// inputs since the last output
+  int            Gap;		// restart not reported yet
+  unsigned long  Gaps;
+}A2DFir;
+
+typedef struct{
+  float          B0,B1,B2,A1,A2;	// normalized , a0 = 1
+  float          S1,S2;			// transposed direct form II state
+}A2DBiquadSection;
+
+typedef struct{
+  int              Sections;
+  A2DBiquadSection Section[A2D_BIQUAD_MAX];
+  int              Primed;	// 0 = the next sample sets the state (start or gap)
+  unsigned long    Gaps;
+}A2DBiquad;
+
+int			A2DFirLowpass(float * coeff, int taps, float cutoff);
+int			A2DFirInit(A2DFir * fir, const float * coeff, int taps, int decimation);
+void			A2DFirReset(A2DFir * fir);
+int			A2DFirProcess(A2DFir * fir, const float * in, const unsigned char * overrun, int n,
+				      float * out, unsigned char * flags);
+int			A2DFirBlock(A2DFir * fir, const A2DBlock * block, int channel, const A2DCalib * calib,
+				    float * out, unsigned char * flags);
+void			A2DFirFree(A2DFir * fir);
+
+void			A2DBiquadInit(A2DBiquad * biquad);
+int			A2DBiquadSet(A2DBiquad * biquad, float b0, float b1, float b2, float a1, float a2);
+int			A2DBiquadLowpass(A2DBiquad * biquad, float rate, float frequency, float q);
+int			A2DBiquadNotch(A2DBiquad * biquad, float rate, float frequency, float q);
+void			A2DBiquadProcess(A2DBiquad * biquad, const float * in, const unsigned char * overrun, int n,
+					 float * out);
@@ -0,0 +1,220 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include "A2DArchive.h"
+#include "A2DQuery.h"
+
+
+////////////////////////////////////////////
+//
+//    program to find samples in archives
+//
+//     usage  A2DFind [options] archive_file ...
+//
+//       -d address      only the archives of this device
+//       -c 0|1          channel tested (A0 or A1)
+//       -above N        value over N counts
+//       -below N        value under N counts
+//       -from time      time range , "2024-05-03 12:00:00" or seconds since the epoch
+//       -to time
+//       -last N[smhd]   the last N seconds , minutes , hours or days
+//       -event          samples with the event flag (window transition)
+//       -samples        one line per sample instead of ranges
+//
+//     example: when did A1 of 0x23 go over 900 counts in the last week
+//
+//        A2DFind -d 0x23 -c 1 -above 900 -last 7d /var/a2d/*.a2z
+//
+//  to compile  gcc -O2 -o A2DFind  A2DFind.c A2DQuery.c A2DArchive.c
+//
+////////////////////////////////////  GPL LICENSE ///////////////////////////////////
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+typedef struct{
+  const char *   Name;
+  int            Channel;
+}FindContext;
+
+
+double ParseTime(const char * text)
+{
+  struct tm tm;
+  char * end;
+  double value;
+
+  memset(&tm,0,sizeof(tm));
+  if((end = strptime(text,"%Y-%m-%d %H:%M:%S",&tm)) || (end = strptime(text,"%Y-%m-%dT%H:%M:%S",&tm)) ||
+     (end = strptime(text,"%Y-%m-%d",&tm)))
+    {
+      tm.tm_isdst = -1;
+      return (double) mktime(&tm);
+    }
+  value = strtod(text,&end);
+  return *end ? -1.0 : value;
+}
+
+
+double ParseDuration(const char * text)
+{
+  char * end;
+  double value = strtod(text,&end);
+
+  switch(*end)
+   {
+     case 'd': value *= 24.0;      // fall through
+     case 'h': value *= 60.0;      // fall through
+     case 'm': value *= 60.0;      // fall through
+     case 's':
+     case 0:   return value;
+   }
+  return -1.0;
+}
+
+
+void FormatTime(double t, char * text, int size)
+{
+  time_t sec = (time_t) t;
+  struct tm tm;
+  int len;
+
+  localtime_r(&sec,&tm);
+  len = strftime(text,size,"%Y-%m-%d %H:%M:%S",&tm);
+  snprintf(text + len,size - len,".%03d",(int) ((t - sec) * 1000.0));
+}
+
+
+int PrintRange(const A2DArchive * archive, const A2DQueryRange * range, void * user)
+{
+  FindContext * context = user;
+  char from[64], to[64];
+
+  FormatTime(range->Time,from,sizeof(from));
+  if(range->First == range->Last)
+    printf("%s 0x%02X A%d  %s  sample %llu  value %d\n",context->Name,archive->Header.Address,context->Channel,
+           from,range->First,range->Min);
+  else
+    {
+      FormatTime(range->End,to,sizeof(to));
+      printf("%s 0x%02X A%d  %s .. %s  samples %llu..%llu  min %d max %d\n",context->Name,archive->Header.Address,
+             context->Channel,from,strncmp(from,to,11) ? to : to + 11,range->First,range->Last,range->Min,range->Max);
+    }
+  return 0;
+}
+
+
+int main(int argc , char * argv[])
+{
+  A2DQueryPredicate predicate;
+  A2DQueryStats stats;
+  A2DArchive archive;
+  FindContext context;
+  struct timeval start, end;
+  unsigned long long chunks = 0, pruned = 0, decoded = 0, results = 0;
+  int address = -1;
+  int mode = A2D_QUERY_RANGES;
+  int files = 0;
+  int loop, rc;
+  double value;
+
+  A2DQueryInit(&predicate);
+
+  for(loop=1;loop<argc;loop++)
+   {
+     if(argv[loop][0] != '-') break;
+     if(strcmp(argv[loop],"-event") == 0)
+       predicate.Flags |= A2D_FLAG_EVENT;
+     else if(strcmp(argv[loop],"-samples") == 0)
+       mode = A2D_QUERY_SAMPLES;
+     else if((loop + 1) >= argc)
+       break;
+     else if(strcmp(argv[loop],"-d") == 0)
+       address = strtoul(argv[++loop],NULL,0);
+     else if(strcmp(argv[loop],"-c") == 0)
+       predicate.Channel = atoi(argv[++loop]) ? 1 : 0;
+     else if(strcmp(argv[loop],"-above") == 0)
+       predicate.Low = atoi(argv[++loop]) + 1;
+     else if(strcmp(argv[loop],"-below") == 0)
+       predicate.High = atoi(argv[++loop]) - 1;
+     else if(strcmp(argv[loop],"-from") == 0)
+       predicate.T0 = ParseTime(argv[++loop]);
+     else if(strcmp(argv[loop],"-to") == 0)
+       predicate.T1 = ParseTime(argv[++loop]);
+     else if(strcmp(argv[loop],"-last") == 0)
+       {
+         gettimeofday(&start,NULL);
+         value = ParseDuration(argv[++loop]);
+         predicate.T0 = value < 0.0 ? -1.0 : start.tv_sec - value;
+       }
+     else
+       break;
+   }
+
+  if((loop >= argc) || (argv[loop][0] == '-') || (predicate.T0 < 0.0) || (predicate.T1 < 0.0))
+    {
+      printf("Usage:\n         A2DFind  [-d address] [-c 0|1] [-above N] [-below N] [-from time] [-to time]\n"
+             "                  [-last N[smhd]] [-event] [-samples]  [archive file] ...\n");
+      return -1;
+    }
+  if((predicate.Channel < 0) && ((predicate.Low > 0) || (predicate.High < 1023)))
+    predicate.Channel = 0;
+
+  gettimeofday(&start,NULL);
+  for(;loop<argc;loop++)
+   {
+     if(A2DArchiveOpen(&archive,argv[loop]) < 0)
+       {
+         fprintf(stderr,"Unable to open archive %s\n",argv[loop]);
+         continue;
+       }
+     if((address >= 0) && (archive.Header.Address != (unsigned) address))
+       {
+         A2DArchiveClose(&archive);
+         continue;
+       }
+     files++;
+     context.Name = argv[loop];
+     context.Channel = predicate.Channel >= 0 ? predicate.Channel : 0;
+     rc = A2DQueryRun(&archive,&predicate,mode,PrintRange,&context,&stats);
+     if(rc < 0)
+       fprintf(stderr,"Read error in %s\n",argv[loop]);
+     else
+       results += rc;
+     chunks += stats.Chunks;
+     pruned += stats.Pruned;
+     decoded += stats.Decoded;
+     A2DArchiveClose(&archive);
+   }
+  gettimeofday(&end,NULL);
+
+  fprintf(stderr,"%d archives  %llu chunks in the time range  %llu pruned  %llu decoded  %llu results  %.3fs\n",
+          files,chunks,pruned,decoded,results,(end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6);
+  return 0;
+}
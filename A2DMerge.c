@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "A2DMerge.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DMerge
+//
+//    Time alignment of many devices on one sample clock
+//
+//    Wiring: RA5 of every PIC on one line. The master is in timer mode (sync out on RA5) ,
+//    the others in trigger mode. Arm the trigger devices first then start the master ,
+//    the first sample of every device is then the same instant (index 0).
+//
+//    Each sample gets the index of its instant , from the device stamp when there is one
+//    (A2D_RECORD_STAMP) otherwise from the count of samples and the Overrun field.
+//    The stamp is the best: the Overrun field stops at 7 and more lost samples shift the
+//    count for good. The 1us stamp of a trigger device is turned into instants from the
+//    previous sample , so the drift of its oscillator doesn't add up.
+//
+//    A2DMergeFrames() gives the frame of an instant when every device has passed it , or when
+//    the device the most ahead is Lag instants further (a device stopped or late). The missing
+//    samples are filled with the last value of the device and the Valid bit is cleared.
+//
+//   to compile add A2DMerge.c to the gcc command line with -lm
+//
+//     gcc -o A2DTest  A2DTest.c I2CWrapper.c A2DStream.c A2DMerge.c -lm
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+// a block is at most 64 samples with up to 7 lost before each one
+#define LAG_MAX		(A2D_MERGE_DEPTH - A2D_BLOCK_SIZE * 8)
+#define LAG_DEFAULT	256
+
+
+////////////////////////////////////   A2DMergeInit
+//
+//    Start a merge
+//
+//    Inputs,
+//
+//    merge:     merge state
+//    devices:   number of devices (1..A2D_MERGE_DEVICES) , the order of the values in the frames
+//    align:     A2D_ALIGN_COUNT , A2D_ALIGN_SAMPLE or A2D_ALIGN_TICK for each device , NULL = all A2D_ALIGN_COUNT
+//    period:    1us ticks between two instants (the timer of the master x 100) , used by A2D_ALIGN_TICK
+//    lag:       instants a device could be late before its samples are filled , 0 = 256
+//
+//    Return,
+//
+//    0   ok
+//    < 0 invalid parameter
+//
+int A2DMergeInit(A2DMerge * merge, int devices, const int * align, double period, unsigned int lag)
+{
+  int loop;
+
+  if((devices < 1) || (devices > A2D_MERGE_DEVICES)) return -1;
+  memset(merge,0,sizeof(A2DMerge));
+  for(loop=0;loop<devices;loop++)
+   {
+     merge->Source[loop].Align = align ? align[loop] : A2D_ALIGN_COUNT;
+     if((merge->Source[loop].Align == A2D_ALIGN_TICK) && (period <= 0.0)) return -1;
+   }
+  merge->Devices = devices;
+  merge->Period = period;
+  merge->Lag = lag ? lag : LAG_DEFAULT;
+  if(merge->Lag > LAG_MAX) merge->Lag = LAG_MAX;
+  return 0;
+}
+
+
+// instant of a sample
+static unsigned long long Index(A2DMerge * merge, A2DMergeSource * source, const A2DBlock * block, int n)
+{
+  long long step;
+
+  if(!(block->Flags[n] & A2D_FLAG_STAMP) || (source->Align == A2D_ALIGN_COUNT))
+    return source->Index + block->Overrun[n];
+
+  if(source->Align == A2D_ALIGN_SAMPLE)
+    {
+      if(!source->Started)
+        source->Origin = block->Time[n] - block->Overrun[n];
+      return block->Time[n] - source->Origin;
+    }
+
+  // 1us ticks , from the previous sample
+  if(!source->Started)
+    step = block->Overrun[n] + 1;
+  else
+    step = llround((double) (block->Time[n] - source->Last) / merge->Period);
+  source->Last = block->Time[n];
+  if(step < 1) step = 1;
+  return source->Index + step - 1;
+}
+
+
+////////////////////////////////////   A2DMergePush
+//
+//    Place the samples of a device. Call A2DMergeFrames() after each push ,
+//    a device can't be more than A2D_MERGE_DEPTH instants ahead of the frames.
+//
+//    Inputs,
+//
+//    merge:     merge state
+//    device:    device number
+//    block:     samples read from the device
+//
+//    Return,
+//
+//    number of samples placed , the others are counted in Dropped
+//    < 0 invalid device
+//
+int A2DMergePush(A2DMerge * merge, int device, const A2DBlock * block)
+{
+  A2DMergeSource * source;
+  unsigned long long index;
+  unsigned int slot;
+  int loop;
+  int placed=0;
+
+  if((device < 0) || (device >= merge->Devices)) return -1;
+  source = &merge->Source[device];
+
+  for(loop=0;loop<block->Count;loop++)
+   {
+     if(!(block->Flags[loop] & A2D_FLAG_VALID)) continue;
+     index = Index(merge,source,block,loop);
+     source->Started = 1;
+     if(index < source->Index)
+       index = source->Index;           // stamp going back , keep the order
+     source->Index = index + 1;
+
+     if(index < merge->Next)
+       {  // its frame is gone with the value held
+         source->Dropped++;
+         continue;
+       }
+     if(index >= (merge->Next + A2D_MERGE_DEPTH))
+       {  // too far ahead (stamp jump) , the frames up to it will be filled
+         source->Dropped++;
+         continue;
+       }
+     slot = index & (A2D_MERGE_DEPTH - 1);
+     source->Present[slot] = 1;
+     source->A0[slot] = block->A0[loop];
+     source->A1[slot] = block->A1[loop];
+     placed++;
+   }
+  return placed;
+}
+
+
+////////////////////////////////////   A2DMergeFrames
+//
+//    Append the frames ready to a frame block
+//
+//    Inputs,
+//
+//    merge:     merge state
+//    frames:    destination block. Frames are appended until the block is full
+//    flush:     1 = don't wait for the late devices (end of the capture)
+//
+//    Return,
+//
+//    number of frames added
+//
+int A2DMergeFrames(A2DMerge * merge, A2DFrameBlock * frames, int flush)
+{
+  A2DMergeSource * source;
+  unsigned long long low, high;
+  unsigned int slot;
+  unsigned short * value;
+  int loop;
+  int added=0;
+
+  low = high = merge->Source[0].Index;
+  for(loop=1;loop<merge->Devices;loop++)
+   {
+     if(merge->Source[loop].Index < low)  low  = merge->Source[loop].Index;
+     if(merge->Source[loop].Index > high) high = merge->Source[loop].Index;
+   }
+
+  frames->Devices = merge->Devices;
+  while((frames->Count < A2D_MERGE_FRAMES) && (merge->Next < high))
+   {
+     // wait for the devices not there yet , unless the first one is Lag ahead
+     if((merge->Next >= low) && !flush && ((high - merge->Next) <= merge->Lag)) break;
+
+     slot = merge->Next & (A2D_MERGE_DEPTH - 1);
+     value = frames->Value[frames->Count];
+     frames->Index[frames->Count] = merge->Next;
+     frames->Valid[frames->Count] = 0;
+     for(loop=0;loop<merge->Devices;loop++)
+      {
+        source = &merge->Source[loop];
+        if(source->Present[slot])
+          {
+            source->Present[slot] = 0;
+            source->Hold[0] = source->A0[slot];
+            source->Hold[1] = source->A1[slot];
+            frames->Valid[frames->Count] |= 1 << loop;
+          }
+        else
+          source->Filled++;
+        *(value++) = source->Hold[0];
+        *(value++) = source->Hold[1];
+      }
+     frames->Count++;
+     merge->Next++;
+     added++;
+   }
+  return added;
+}
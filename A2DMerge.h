@@ -0,0 +1,54 @@
+#pragma once
+
+#include "A2DStream.h"
+
+// merge of the streams of devices sampling on the same clock (one in timer mode driving RA5 ,
+// the others in trigger mode). The samples are placed by sample instant (index) and come out
+// as one frame per instant with the two channels of every device , like one wide A/D.
+// A device that lost samples (overrun) gets the last value held in the frame and its Valid bit
+// cleared.
+
+#define A2D_MERGE_DEVICES	8
+#define A2D_MERGE_DEPTH		4096	// instants kept per device , power of 2
+#define A2D_MERGE_FRAMES	64	// frames in a A2DFrameBlock
+
+// how the index of a sample is found
+#define A2D_ALIGN_COUNT		0	// count of samples plus the Overrun field (no stamp record)
+#define A2D_ALIGN_SAMPLE	1	// stamp record in timer mode , Time is the sample number
+#define A2D_ALIGN_TICK		2	// stamp record in trigger mode , Time is in 1us ticks
+
+typedef struct{
+  int            Align;
+  int            Started;
+  unsigned long long Index;	// index of the next sample
+  unsigned long long Origin;	// Time of the sample index 0 (A2D_ALIGN_SAMPLE)
+  unsigned long long Last;	// Time of the previous sample (A2D_ALIGN_TICK)
+  unsigned short Hold[2];	// last A0 , A1 , the fill value
+  unsigned long long Filled;	// instants filled
+  unsigned long long Dropped;	// samples after their frame or too far ahead
+  unsigned char  Present[A2D_MERGE_DEPTH];
+  unsigned short A0[A2D_MERGE_DEPTH];
+  unsigned short A1[A2D_MERGE_DEPTH];
+}A2DMergeSource;
+
+typedef struct{
+  int            Devices;
+  double         Period;	// 1us ticks between two instants (A2D_ALIGN_TICK)
+  unsigned int   Lag;		// instants a device could be late before its frames are filled
+  unsigned long long Next;	// index of the next frame
+  A2DMergeSource Source[A2D_MERGE_DEVICES];
+}A2DMerge;
+
+typedef struct{
+  int            Count;
+  int            Devices;
+  unsigned long long Index[A2D_MERGE_FRAMES];
+  unsigned int   Valid[A2D_MERGE_FRAMES];	// bit N = device N sampled this instant
+  unsigned short Value[A2D_MERGE_FRAMES][A2D_MERGE_DEVICES * 2];	// A0 , A1 of device 0 , then device 1 ...
+}A2DFrameBlock;
+
+#define A2DFrameBlockClear(BLOCK)	((BLOCK)->Count=0)
+
+int	A2DMergeInit(A2DMerge * merge, int devices, const int * align, double period, unsigned int lag);
+int	A2DMergePush(A2DMerge * merge, int device, const A2DBlock * block);
+int	A2DMergeFrames(A2DMerge * merge, A2DFrameBlock * frames, int flush);
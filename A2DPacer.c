@@ -0,0 +1,345 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include "I2CWrapper.h"
+#include "A2DPacer.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DPacer
+//
+//    Pace the fifo reads of timer mode with a timerfd instead of polling the data count.
+//    The reader sleeps until the fifo should hold FillTarget records. Each wake up reads the count
+//    once and corrects the record period with what came in , so the fill stays near the target
+//    even with the oscillator error. One count query per read block and no cpu between them.
+//
+//    Each wake up goes in three histograms: the wake up jitter, the service latency (programmed
+//    wake up to the end of the reads) and the fifo count. A2DPacerReport() gives the headroom ,
+//    the time left before the fifo would overrun at the worst latency seen.
+//    A2DPacerRealTime() is the opt-in real-time setting of the reader thread.
+//
+//   to compile add A2DPacer.c to the gcc command line
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+static long long PacerNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int PacerBucket(long long ns)
+{
+  long long us = ns / 1000;
+  int bucket = 0;
+
+  while((us > 0) && (bucket < (A2D_PACER_HIST - 1)))
+    {
+      us >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+static int PacerArm(A2DPacer * pacer, long long when)
+{
+  struct itimerspec its;
+
+  memset(&its,0,sizeof(its));
+  its.it_value.tv_sec = when / 1000000000LL;
+  its.it_value.tv_nsec = when % 1000000000LL;
+  pacer->Programmed = when;
+  return timerfd_settime(pacer->TimerFd,TFD_TIMER_ABSTIME,&its,NULL);
+}
+
+
+////////////////////////////////////   A2DPacerOpen
+//
+//    Get the record period from the device settings and arm the first wake up.
+//    Call it after the timer mode start.
+//
+//    Inputs,
+//
+//    pacer:        pacer state
+//    handle:       IO handle
+//    fill_target:  records wanted at each wake up (1..39 , 1..38 with the stamp record). 7 is one command 03 block ,
+//                  10 one command 04 block. Higher is less wake ups but more latency
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DPacerOpen(A2DPacer * pacer, int handle, int fill_target)
+{
+  A2D_HwTimer hwtimer;
+  double sample_ns;
+  int value;
+
+  memset(pacer,0,sizeof(A2DPacer));
+  pacer->Handle = handle;
+  pacer->TimerFd = -1;
+
+  // hardware timer first , it overrides the command 01 timer
+  if(A2DReadHwTimer(handle,&hwtimer) < 0) return -1;
+  if(hwtimer.Period)
+    sample_ns = hwtimer.Period * 1000.0 * hwtimer.Postscale;
+  else
+    {
+      if((value = I2CWrapperReadWord(handle,A2D_CMD_TIMER)) < 0) return -1;
+      sample_ns = value * 100000.0;
+    }
+
+  // single channel , two samples per record
+  if((value = A2DReadChannelMask(handle)) < 0) return -1;
+  pacer->RecordNs = value == A2D_CHANNEL_BOTH ? sample_ns : sample_ns * 2.0;
+
+  // stamp record after each sample. A sample needs two free records , the fifo stops one earlier
+  pacer->Capacity = A2D_PACER_FIFO_SIZE - 1;
+  if((value = A2DReadRecordOptions(handle)) < 0) return -1;
+  if(value & A2D_RECORD_STAMP)
+    {
+      pacer->RecordNs /= 2.0;
+      pacer->Capacity = A2D_PACER_FIFO_SIZE - 2;
+    }
+
+  if(fill_target < 1) fill_target = 1;
+  if(fill_target > pacer->Capacity) fill_target = pacer->Capacity;
+  pacer->FillTarget = fill_target;
+
+  pacer->TimerFd = timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC);
+  if(pacer->TimerFd < 0) return -1;
+
+  pacer->LastWake = PacerNow();
+  if(PacerArm(pacer,pacer->LastWake + (long long)(pacer->FillTarget * pacer->RecordNs)) < 0)
+    {
+      close(pacer->TimerFd);
+      return -1;
+    }
+  return 0;
+}
+
+
+////////////////////////////////////   A2DPacerWait
+//
+//    Sleep until the next read , then get the fifo count and arm the next wake up.
+//    The reader is expected to read all the records. If not , tell the pacer with A2DPacerLeft().
+//    An interrupted wait (signal) returns the count like a normal wake up.
+//
+//    Inputs,
+//
+//    pacer:   pacer state
+//
+//    Return,
+//
+//    number of records in the fifo
+//    < 0 error
+//
+int A2DPacerWait(A2DPacer * pacer)
+{
+  unsigned long long expirations;
+  long long now;
+  double elapse;
+  int count;
+  int arrived;
+
+  long long late;
+
+  // the reads of the last wake up are done
+  if(pacer->ServiceStart)
+    {
+      late = PacerNow() - pacer->ServiceStart;
+      pacer->Service[PacerBucket(late)]++;
+      if(late > pacer->ServiceMax) pacer->ServiceMax = late;
+    }
+
+  if(read(pacer->TimerFd,&expirations,sizeof(expirations)) < 0)
+    if(errno != EINTR) return -1;
+
+  now = PacerNow();
+  late = now - pacer->Programmed;
+  if(late < 0) late = 0;             // signal before the time
+  pacer->Jitter[PacerBucket(late)]++;
+  if(late > pacer->JitterMax) pacer->JitterMax = late;
+  pacer->ServiceStart = pacer->Programmed;
+
+  count = A2DReadDataCount(pacer->Handle);
+  if(count < 0) return -1;
+
+  pacer->Wakes++;
+  pacer->Fill[count < A2D_PACER_FIFO_SIZE ? count : A2D_PACER_FIFO_SIZE - 1]++;
+  if(count > pacer->FillMax) pacer->FillMax = count;
+  elapse = (double) (now - pacer->LastWake);
+  arrived = count - pacer->Left;
+
+  if(count >= pacer->Capacity)
+    pacer->Full++;                   // the fifo stopped , the count says nothing about the rate
+  else if((arrived > 0) && (elapse > 0))
+    pacer->RecordNs += ((elapse / arrived) - pacer->RecordNs) / 8.0;
+
+  pacer->Records += arrived > 0 ? arrived : 0;
+  pacer->LastWake = now;
+  pacer->Left = 0;
+
+  if(PacerArm(pacer,now + (long long)(pacer->FillTarget * pacer->RecordNs)) < 0) return -1;
+  return count;
+}
+
+
+////////////////////////////////////   A2DPacerLeft
+//
+//    Records not read after A2DPacerWait(). The next wake up comes earlier.
+//
+//    Inputs,
+//
+//    pacer:   pacer state
+//    left:    records still in the fifo
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DPacerLeft(A2DPacer * pacer, int left)
+{
+  int wanted;
+
+  if(left < 0) left = 0;
+  pacer->Left = left;
+  wanted = pacer->FillTarget - left;
+  if(wanted < 1) wanted = 1;
+  return PacerArm(pacer,pacer->LastWake + (long long)(wanted * pacer->RecordNs));
+}
+
+
+////////////////////////////////////   A2DPacerClose
+//
+void A2DPacerClose(A2DPacer * pacer)
+{
+  if(pacer->TimerFd >= 0)
+    close(pacer->TimerFd);
+  pacer->TimerFd = -1;
+}
+
+
+////////////////////////////////////   A2DPacerRealTime
+//
+//    Real-time setting of the calling thread , call it before A2DPacerOpen().
+//    SCHED_FIFO priority , cpu affinity , memory locked and the stack prefaulted ,
+//    so a page fault or a busy cpu don't delay a wake up. Needs root or CAP_SYS_NICE / CAP_IPC_LOCK.
+//
+//    Inputs,
+//
+//    priority:  SCHED_FIFO priority (1..99) , 0 = keep the scheduler
+//    cpu:       cpu to run on , -1 = any
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error (errno is set)
+//
+int A2DPacerRealTime(int priority, int cpu)
+{
+  struct sched_param param;
+  cpu_set_t set;
+  volatile unsigned char stack[65536];
+  unsigned int loop;
+
+  if(cpu >= 0)
+    {
+      CPU_ZERO(&set);
+      CPU_SET(cpu,&set);
+      if(sched_setaffinity(0,sizeof(set),&set) < 0) return -1;
+    }
+
+  if(priority > 0)
+    {
+      memset(&param,0,sizeof(param));
+      param.sched_priority = priority;
+      if(sched_setscheduler(0,SCHED_FIFO,&param) < 0) return -2;
+    }
+
+  if(mlockall(MCL_CURRENT | MCL_FUTURE) < 0) return -3;
+
+  // touch the stack pages now , the pacer state is prefaulted by A2DPacerOpen() memset
+  for(loop=0;loop<sizeof(stack);loop+=256)
+    stack[loop]=0;
+  return 0;
+}
+
+
+static void PacerPrintHist(const char * name, const unsigned long * hist)
+{
+  int loop;
+
+  printf("%s\n",name);
+  for(loop=0;loop<A2D_PACER_HIST;loop++)
+    {
+      if(hist[loop]==0) continue;
+      if(loop==0)
+        printf("  %8s < 1us     %lu\n","",hist[loop]);
+      else
+        printf("  %8ld .. %-8ldus %lu\n",1L << (loop-1),(1L << loop) - 1,hist[loop]);
+    }
+}
+
+
+////////////////////////////////////   A2DPacerReport
+//
+//    Print the histograms and the headroom.
+//    Headroom is the fifo time not used at the worst service latency:
+//    Capacity * RecordNs - (FillTarget * RecordNs + ServiceMax). Below 0 , an overrun is possible.
+//
+void A2DPacerReport(A2DPacer * pacer)
+{
+  double fifo_us = pacer->Capacity * pacer->RecordNs / 1000.0;
+  double headroom_us = fifo_us - (pacer->FillTarget * pacer->RecordNs + pacer->ServiceMax) / 1000.0;
+  int loop;
+
+  printf("%lu wake ups  %llu records  record period %.1fus  fifo full %lu\n",
+         pacer->Wakes,pacer->Records,pacer->RecordNs / 1000.0,pacer->Full);
+  PacerPrintHist("wake up jitter",pacer->Jitter);
+  PacerPrintHist("service latency",pacer->Service);
+  printf("fifo count at wake up\n");
+  for(loop=0;loop<A2D_PACER_FIFO_SIZE;loop++)
+    if(pacer->Fill[loop])
+      printf("  %2d  %lu\n",loop,pacer->Fill[loop]);
+  printf("max jitter %.0fus  max service %.0fus  max count %d\n",
+         pacer->JitterMax / 1000.0,pacer->ServiceMax / 1000.0,pacer->FillMax);
+  printf("fifo time %.0fus  headroom %.0fus (%.0f%%)\n",fifo_us,headroom_us,headroom_us * 100.0 / fifo_us);
+  fflush(stdout);
+}
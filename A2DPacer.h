@@ -0,0 +1,39 @@
+#pragma once
+
+#include "I2C_A2D.h"
+
+// paced fifo reads in timer mode. A timerfd wakes the reader when the fifo should hold
+// FillTarget records, from the sample period and the fill seen at each wake up
+
+#define A2D_PACER_FIFO_SIZE	40	// BUF_SIZE of the firmware
+#define A2D_PACER_HIST		24	// log2 us buckets. 0: < 1us , N: 2^(N-1) .. 2^N - 1 us
+
+typedef struct{
+  int            Handle;
+  int            TimerFd;	// CLOCK_MONOTONIC timerfd
+  int            FillTarget;	// records wanted at each wake up
+  int            Capacity;	// records in the fifo when it is full , 39 or 38 with the stamp record
+  double         RecordNs;	// record period , starts from the settings then follows the fifo
+  long long      LastWake;	// ns
+  int            Left;		// records left in the fifo by the reader (A2DPacerLeft)
+  unsigned long  Wakes;
+  unsigned long  Full;		// wake ups with the fifo full (reader too late)
+  unsigned long long Records;
+
+  // timing , filled by A2DPacerWait
+  long long      Programmed;	// wake up time asked to the timerfd (ns)
+  long long      ServiceStart;	// programmed time of the last wake up , 0 = none
+  unsigned long  Jitter[A2D_PACER_HIST];	// programmed wake up to the thread running
+  unsigned long  Service[A2D_PACER_HIST];	// programmed wake up to the end of the reads
+  unsigned long  Fill[A2D_PACER_FIFO_SIZE];	// fifo count at wake up
+  long long      JitterMax;	// ns
+  long long      ServiceMax;	// ns
+  int            FillMax;
+}A2DPacer;
+
+int			A2DPacerOpen(A2DPacer * pacer, int handle, int fill_target);
+int			A2DPacerWait(A2DPacer * pacer);
+int			A2DPacerLeft(A2DPacer * pacer, int left);
+void			A2DPacerClose(A2DPacer * pacer);
+int			A2DPacerRealTime(int priority, int cpu);
+void			A2DPacerReport(A2DPacer * pacer);
@@ -0,0 +1,260 @@
+#define _FILE_OFFSET_BITS 64
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "A2DStore.h"
+#include "A2DArchive.h"
+
+
+////////////////////////////////////////////
+//
+//    program to convert a capture store to a compressed archive and to read archives
+//
+//     usage  A2DPack  [-a address] store_file archive_file   convert a capture store (A2DStore) ,
+//                                                        it could still be written
+//            A2DPack  -i archive_file              size , samples and bytes per sample
+//            A2DPack  -x archive_file [first [count]]   print samples
+//            A2DPack  -t archive_file tick [count]      print samples from a tick
+//            A2DPack  -b archive_file              decoding speed
+//
+//  to compile  gcc -O2 -o A2DPack  A2DPack.c A2DStore.c A2DArchive.c -lm
+//
+////////////////////////////////////  GPL LICENSE ///////////////////////////////////
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+int Convert(const char * storename, const char * archivename, int address)
+{
+  A2DStore store;
+  A2DArchive archive;
+  A2DStorePage page;
+  A2DBlock block;
+  const A2DStorePage * mapped;
+  unsigned long long seq;
+  unsigned long long pages = 0;
+  unsigned long long skipped = 0;
+  double expected = 0.0;
+  double gap;
+  int loop, idx;
+  int started = 0;
+
+  if(A2DStoreOpenRead(&store,storename) < 0)
+    {
+      printf("Unable to open store %s\n",storename);
+      return -1;
+    }
+
+  for(seq=store.Tail;seq<store.Head;seq++)
+   {
+     // a copy , the capture could overwrite the page while it is converted
+     mapped = A2DStorePageGet(&store,seq);
+     if(mapped == NULL)
+       {
+         skipped++;
+         continue;
+       }
+     memcpy(&page,mapped,sizeof(page));
+     if((mapped->Header.Seq != seq) || (page.Header.Seq != seq))
+       {
+         skipped++;
+         continue;
+       }
+
+     if(!started)
+       {
+         if(A2DArchiveCreate(&archive,archivename,address,page.Header.Time,page.Header.Period) < 0)
+           {
+             printf("Unable to create %s\n",archivename);
+             A2DStoreClose(&store);
+             return -1;
+           }
+         started = 1;
+         expected = page.Header.Time;
+       }
+
+     // a few missed samples between two pages go in the Overrun count , a longer gap , a page
+     // before the last one or another period starts a chunk at the page time (Overrun 7 = gap)
+     gap = page.Header.Period > 0.0 ? (page.Header.Time - expected) / page.Header.Period : 0.0;
+     if((page.Header.Period != archive.Period) || (gap < -0.5) || (gap >= 6.5))
+       if(A2DArchiveSync(&archive,page.Header.Time,page.Header.Period) < 0)
+         {
+           printf("Unable to write %s\n",archivename);
+           A2DArchiveClose(&archive);
+           A2DStoreClose(&store);
+           return -1;
+         }
+
+     for(loop=0;loop<page.Header.Count;loop+=A2D_BLOCK_SIZE)
+       {
+         for(idx=0;(idx < A2D_BLOCK_SIZE) && ((loop + idx) < page.Header.Count);idx++)
+           {
+             block.A0[idx] = page.Record[loop + idx].A0;
+             block.A1[idx] = page.Record[loop + idx].A1;
+             block.Overrun[idx] = page.Record[loop + idx].Overrun;
+             block.Flags[idx] = page.Record[loop + idx].Flags;
+             block.Time[idx] = page.Record[loop + idx].Time;
+           }
+         block.Count = idx;
+         if((loop == 0) && (gap >= 0.5) && (lround(gap) > block.Overrun[0]))
+           block.Overrun[0] = gap >= 6.5 ? 7 : (unsigned char) lround(gap);
+         if(A2DArchiveAppend(&archive,&block) < 0)
+           {
+             printf("Unable to write %s\n",archivename);
+             A2DArchiveClose(&archive);
+             A2DStoreClose(&store);
+             return -1;
+           }
+       }
+     expected = page.Header.Time + page.Header.Count * page.Header.Period;
+     pages++;
+   }
+  A2DStoreClose(&store);
+
+  if(!started)
+    {
+      printf("Empty store %s\n",storename);
+      return -1;
+    }
+  printf("%llu pages  %llu samples  %llu pages skipped (overwritten or torn)\n",pages,archive.Samples,skipped);
+  if(A2DArchiveClose(&archive) < 0)
+    {
+      printf("Unable to write %s\n",archivename);
+      return -1;
+    }
+  return 0;
+}
+
+
+int Info(A2DArchive * archive, const char * archivename)
+{
+  struct stat st;
+  time_t t;
+
+  if(stat(archivename,&st) < 0) return -1;
+  t = (time_t) archive->Header.Start;
+  printf("start %s",ctime(&t));
+  printf("device 0x%02X  period %gs  %llu samples  %llu chunks\n",archive->Header.Address,archive->Header.Period,
+         archive->Samples,archive->Chunks);
+  if(archive->Samples)
+    printf("%lld bytes  %.2f bits/sample  %.1f times smaller than the store (16 bytes/sample)\n",(long long) st.st_size,
+           st.st_size * 8.0 / archive->Samples,archive->Samples * 16.0 / st.st_size);
+  return 0;
+}
+
+
+// count samples from first , the ones before min_tick are skipped
+void Extract(A2DArchive * archive, unsigned long long first, unsigned long long count, unsigned long long min_tick)
+{
+  A2DBlock block;
+  unsigned long long sample = first;
+  int loop, n;
+
+  while(count)
+   {
+     n = A2DArchiveRead(archive,sample,&block);
+     if(n <= 0) break;
+     for(loop=0;(loop < n) && count;loop++,sample++)
+      {
+        if(block.Time[loop] < min_tick) continue;
+        count--;
+        printf("%llu  tick %llu  A0 %4d  A1 %4d  flags %02X  overrun %d\n",sample,block.Time[loop],
+               block.A0[loop],block.A1[loop],block.Flags[loop],block.Overrun[loop]);
+      }
+   }
+}
+
+
+void Benchmark(A2DArchive * archive)
+{
+  A2DArchiveChunk * chunk = malloc(sizeof(A2DArchiveChunk));
+  struct timespec start, end;
+  unsigned long long samples = 0;
+  unsigned long long loop;
+  double elapse;
+
+  if(chunk == NULL) return;
+  clock_gettime(CLOCK_MONOTONIC,&start);
+  for(loop=0;loop<archive->Chunks;loop++)
+    if(A2DArchiveReadChunk(archive,loop,chunk) > 0)
+      samples += chunk->Count;
+  clock_gettime(CLOCK_MONOTONIC,&end);
+  elapse = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%llu samples decoded in %.3fs  %.1f Msamples/sec\n",samples,elapse,elapse > 0 ? samples / elapse / 1e6 : 0.0);
+  free(chunk);
+}
+
+
+int main(int argc , char * argv[])
+{
+  A2DArchive archive;
+  unsigned long long first = 0;
+  unsigned long long count = 100;
+  long long chunk;
+
+  if((argc == 3) && (argv[1][0] != '-'))
+    return Convert(argv[1],argv[2],0) < 0 ? -1 : 0;
+  if((argc == 5) && (strcmp(argv[1],"-a") == 0))
+    return Convert(argv[3],argv[4],strtoul(argv[2],NULL,0)) < 0 ? -1 : 0;
+
+  if((argc < 3) || (argv[1][0] != '-') || (strchr("ixtb",argv[1][1]) == NULL))
+    {
+      printf("Usage:\n         A2DPack  [-a device address]  [store file]  [archive file]\n"
+             "         A2DPack  -i [archive file]\n"
+             "         A2DPack  -x [archive file]  [first sample]  [count]\n"
+             "         A2DPack  -t [archive file]  [tick]  [count]\n"
+             "         A2DPack  -b [archive file]\n");
+      return -1;
+    }
+
+  if(A2DArchiveOpen(&archive,argv[2]) < 0)
+    {
+      printf("Unable to open archive %s\n",argv[2]);
+      return -1;
+    }
+
+  if(argc > 3) first = strtoull(argv[3],NULL,0);
+  if(argc > 4) count = strtoull(argv[4],NULL,0);
+
+  switch(argv[1][1])
+   {
+     case 'i': Info(&archive,argv[2]);
+               break;
+     case 'x': Extract(&archive,first,count,0);
+               break;
+     case 't': chunk = A2DArchiveFindTick(&archive,first);
+               if(chunk >= 0)
+                 Extract(&archive,archive.Seek[chunk].Sample,count,first);
+               break;
+     case 'b': Benchmark(&archive);
+               break;
+   }
+  A2DArchiveClose(&archive);
+  return 0;
+}
@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "A2DDiscover.h"
+
+
+////////////////////////////////////////////
+//
+//    program to set the I2C address of many devices from a plan
+//
+//     usage  A2DProvision  [-b bus] [-c cache_file] [-n] plan_file
+//
+//            -b   bus (default 1)
+//            -c   inventory file to update after the verification (A2DDiscover)
+//            -n   check the plan and print the moves only
+//
+//     plan file , one device per line:   current_address  new_address
+//
+//         # rack 3
+//         0x20  0x30
+//         0x21  0x31
+//
+//     The address changes (command 05 + command 09) are sent without waiting for the eeprom.
+//     The device answers at the new address right away and the profile tag (command 17 byte 0)
+//     reads 0 until the eeprom write is done (about 100ms) , so all the writes run at the same time.
+//     A move waits only when its new address is still used by a device not moved yet.
+//     A cycle (0x30 -> 0x31 , 0x31 -> 0x30) goes through a free address.
+//     At the end one discovery pass checks every device.
+//
+//     A plan line already done (nothing at current , a device at new not moved by the plan)
+//     is skipped , so a plan without chains can be run again after an interruption.
+//
+//  to compile  gcc -O2 -o A2DProvision  A2DProvision.c A2DDiscover.c -lpthread
+//
+////////////////////////////////////  GPL LICENSE ///////////////////////////////////
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define FLASH_TIMEOUT	1.0		// seconds for one eeprom write
+#define POLL_PERIOD	5000		// us between the profile tag polls
+
+typedef struct{
+  unsigned char  From;
+  unsigned char  To;
+  unsigned char  Final;		// plan address , To is a free address in a cycle
+  unsigned char  Line;
+  char           State;		// 0 waiting , 1 flashing , 2 done , -1 failed
+  double         Sent;
+}Move;
+
+Move          Plan[256];	// plan lines , then the cycle steps
+int           PlanCount = 0;
+int           Changed = 0;	// plan lines done
+unsigned char Used[128];	// address used by a device now
+unsigned char Busy[128];	// device at this address is writing its eeprom
+
+
+double Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int ValidateAddress(int Address)
+{
+  if((Address < A2D_DISCOVER_FIRST) || (Address > A2D_DISCOVER_LAST)) return 0;
+  return 1;
+}
+
+
+// command 05 and command 09 in one transaction (repeated start)
+int SendMove(int fd, int from, int to)
+{
+  unsigned char address[2] = { A2D_CMD_SLAVE_ADDRESS, to };
+  unsigned char flash[3] = { A2D_CMD_FLASH_SETTINGS, 0x55, 0xaa };
+  struct i2c_msg msgs[2];
+  struct i2c_rdwr_ioctl_data rdwr;
+
+  msgs[0].addr = from;
+  msgs[0].flags = 0;
+  msgs[0].len = sizeof(address);
+  msgs[0].buf = address;
+  msgs[1].addr = from;
+  msgs[1].flags = 0;
+  msgs[1].len = sizeof(flash);
+  msgs[1].buf = flash;
+  rdwr.msgs = msgs;
+  rdwr.nmsgs = 2;
+  return ioctl(fd,I2C_RDWR,&rdwr);
+}
+
+
+// profile tag , 0 = eeprom write not done
+int ReadTag(int fd, int address)
+{
+  unsigned char cmd = A2D_CMD_PROFILE;
+  unsigned char tag;
+  struct i2c_msg msgs[2];
+  struct i2c_rdwr_ioctl_data rdwr;
+
+  msgs[0].addr = address;
+  msgs[0].flags = 0;
+  msgs[0].len = 1;
+  msgs[0].buf = &cmd;
+  msgs[1].addr = address;
+  msgs[1].flags = I2C_M_RD;
+  msgs[1].len = 1;
+  msgs[1].buf = &tag;
+  rdwr.msgs = msgs;
+  rdwr.nmsgs = 2;
+  if(ioctl(fd,I2C_RDWR,&rdwr) < 0) return -1;
+  return tag;
+}
+
+
+int LoadPlan(const char * filename)
+{
+  FILE * in;
+  char line[256];
+  unsigned int from, to;
+  int number = 0;
+
+  in = fopen(filename,"r");
+  if(in == NULL)
+    {
+      printf("Unable to open %s\n",filename);
+      return -1;
+    }
+
+  while(fgets(line,sizeof(line),in))
+   {
+     number++;
+     if(line[strspn(line," \t")] == '#') continue;
+     if(sscanf(line,"%i %i",&from,&to) != 2)
+       {
+         if(strspn(line," \t\r\n") == strlen(line)) continue;
+         printf("line %d: invalid\n",number);
+         fclose(in);
+         return -1;
+       }
+     if(!ValidateAddress(from) || !ValidateAddress(to))
+       {
+         printf("line %d: address out of 0x%02X..0x%02X\n",number,A2D_DISCOVER_FIRST,A2D_DISCOVER_LAST);
+         fclose(in);
+         return -1;
+       }
+     if(PlanCount >= 128)
+       {
+         printf("line %d: too many devices\n",number);
+         fclose(in);
+         return -1;
+       }
+     Plan[PlanCount].From = from;
+     Plan[PlanCount].To = to;
+     Plan[PlanCount].Final = to;
+     Plan[PlanCount].Line = number;
+     Plan[PlanCount].State = 0;
+     PlanCount++;
+   }
+  fclose(in);
+  return PlanCount;
+}
+
+
+// every current and new address once , each current device found
+int CheckPlan(void)
+{
+  unsigned char from[128], to[128];
+  int loop, errors = 0;
+
+  memset(from,0,sizeof(from));
+  memset(to,0,sizeof(to));
+  for(loop=0;loop<PlanCount;loop++)
+   {
+     if(from[Plan[loop].From]++)
+       {
+         printf("line %d: 0x%02X is already moved\n",Plan[loop].Line,Plan[loop].From);
+         errors++;
+       }
+     if(to[Plan[loop].To]++)
+       {
+         printf("line %d: 0x%02X is already a new address\n",Plan[loop].Line,Plan[loop].To);
+         errors++;
+       }
+   }
+  if(errors) return -1;
+
+  for(loop=0;loop<PlanCount;loop++)
+   {
+     if(Plan[loop].From == Plan[loop].To)
+       Plan[loop].State = 2;
+     else if(!Used[Plan[loop].From])
+       {
+         if(Used[Plan[loop].To] && !from[Plan[loop].To])
+           Plan[loop].State = 2;           // done by a previous run
+         else
+           {
+             printf("line %d: no device at 0x%02X\n",Plan[loop].Line,Plan[loop].From);
+             errors++;
+           }
+       }
+     else if(Used[Plan[loop].To] && !from[Plan[loop].To])
+       {
+         printf("line %d: 0x%02X is used by a device not in the plan\n",Plan[loop].Line,Plan[loop].To);
+         errors++;
+       }
+   }
+  return errors ? -1 : 0;
+}
+
+
+// free address not wanted by a waiting move
+int FreeAddress(void)
+{
+  int address, loop;
+
+  for(address=A2D_DISCOVER_LAST;address>=A2D_DISCOVER_FIRST;address--)
+   {
+     if(Used[address]) continue;
+     for(loop=0;loop<PlanCount;loop++)
+       if((Plan[loop].State == 0) && (Plan[loop].To == address)) break;
+     if(loop == PlanCount) return address;
+   }
+  return -1;
+}
+
+
+// waiting move of the device at this address
+int WaitingAt(int address, int count)
+{
+  int loop;
+
+  for(loop=0;loop<count;loop++)
+    if((Plan[loop].State == 0) && (Plan[loop].From == address)) return loop;
+  return -1;
+}
+
+
+// each cycle of waiting moves goes through a free address , all the cycles at once
+int BreakCycles(void)
+{
+  int loop, next, steps, temp;
+  int broken = 0;
+  int count = PlanCount;
+
+  for(loop=0;loop<count;loop++)
+   {
+     if(Plan[loop].State != 0) continue;
+
+     // follow the devices in the way , back to loop is a cycle
+     next = WaitingAt(Plan[loop].To,count);
+     for(steps=0;(next >= 0) && (next != loop) && (steps < count);steps++)
+       next = WaitingAt(Plan[next].To,count);
+     if(next != loop) continue;
+
+     if((temp = FreeAddress()) < 0)
+       {
+         if(broken) break;          // the others at the next round
+         return -1;
+       }
+     Plan[PlanCount] = Plan[loop];
+     Plan[PlanCount].From = temp;
+     Plan[loop].To = temp;
+     PlanCount++;
+     broken++;
+   }
+  return broken;
+}
+
+
+int Provision(int fd, int dryrun)
+{
+  int loop, sent, pass, tag, temp;
+  int waiting, flashing;
+  int failed = 0;
+  double now;
+
+  while(1)
+   {
+     // every move with a free new address and a device not writing its eeprom.
+     // A device leaves its address at once , again until a chain is done
+     sent = 0;
+     do{
+        pass = sent;
+        for(loop=0;loop<PlanCount;loop++)
+         {
+           Move * move = &Plan[loop];
+
+           if((move->State != 0) || Used[move->To] || Busy[move->From]) continue;
+           if(dryrun)
+             printf("0x%02X -> 0x%02X\n",move->From,move->To);
+           else if(SendMove(fd,move->From,move->To) < 0)
+             {
+               printf("0x%02X -> 0x%02X: no answer\n",move->From,move->To);
+               move->State = -1;
+               failed++;
+               continue;
+             }
+           Used[move->From] = 0;
+           Used[move->To] = 1;
+           Busy[move->To] = !dryrun;
+           move->Sent = Now();
+           move->State = dryrun ? 2 : 1;
+           sent++;
+         }
+       }while(sent != pass);
+
+     waiting = flashing = 0;
+     for(loop=0;loop<PlanCount;loop++)
+      {
+        if(Plan[loop].State == 0) waiting++;
+        if(Plan[loop].State == 1) flashing++;
+      }
+     if(!waiting && !flashing) break;
+
+     if(!sent)
+       {
+         temp = BreakCycles();
+         if((temp < 0) && !flashing)
+           {
+             printf("No free address to break a cycle\n");
+             return -1;
+           }
+         if((temp == 0) && !flashing)
+           {  // waiting on a device that failed
+             for(loop=0;loop<PlanCount;loop++)
+               if(Plan[loop].State == 0)
+                 {
+                   printf("0x%02X -> 0x%02X: 0x%02X is still used\n",Plan[loop].From,Plan[loop].To,Plan[loop].To);
+                   Plan[loop].State = -1;
+                   failed++;
+                 }
+             break;
+           }
+         if(temp > 0) continue;
+       }
+     usleep(POLL_PERIOD);
+
+     now = Now();
+     for(loop=0;loop<PlanCount;loop++)
+      {
+        Move * move = &Plan[loop];
+
+        if(move->State != 1) continue;
+        tag = ReadTag(fd,move->To);
+        if(tag == A2D_PROFILE_TAG)
+          {
+            move->State = 2;
+            Busy[move->To] = 0;
+            if(move->To == move->Final) Changed++;
+          }
+        else if((now - move->Sent) > FLASH_TIMEOUT)
+          {
+            printf("0x%02X -> 0x%02X: eeprom write not done\n",move->From,move->To);
+            move->State = -1;
+            Busy[move->To] = 0;
+            failed++;
+          }
+      }
+   }
+  return failed ? -1 : 0;
+}
+
+
+// one discovery pass , each new address answers and each old address is free
+int Verify(int bus, A2DInventory * inventory)
+{
+  unsigned char found[128];
+  int loop, errors = 0;
+
+  A2DInventoryFree(inventory);
+  if(A2DDiscoverBus(bus,inventory) < 0) return -1;
+  memset(found,0,sizeof(found));
+  for(loop=0;loop<inventory->Count;loop++)
+    found[inventory->Device[loop].Address] = 1;
+
+  for(loop=0;loop<PlanCount;loop++)
+   {
+     if(Plan[loop].To != Plan[loop].Final) continue;       // cycle step
+     if(!found[Plan[loop].Final])
+       {
+         printf("line %d: no device at 0x%02X\n",Plan[loop].Line,Plan[loop].Final);
+         errors++;
+       }
+   }
+  for(loop=0;loop<PlanCount;loop++)
+    if(found[Plan[loop].From] && !Used[Plan[loop].From])
+      {
+        printf("line %d: a device is still at 0x%02X\n",Plan[loop].Line,Plan[loop].From);
+        errors++;
+      }
+  return errors;
+}
+
+
+void Usage(void)
+{
+  printf("usage  A2DProvision [-b bus] [-c cache_file] [-n] plan_file\n");
+  printf("       -b   bus (default 1)\n");
+  printf("       -c   inventory file to update after the verification\n");
+  printf("       -n   check the plan and print the moves only\n");
+  printf("plan file , one device per line: current_address new_address\n");
+}
+
+
+int main(int argc, char * argv[])
+{
+  A2DInventory inventory;
+  const char * cache = NULL;
+  const char * planfile = NULL;
+  char name[32];
+  int bus = 1;
+  int dryrun = 0;
+  int loop, fd, errors;
+  int moves = 0;
+  double start, sent;
+
+  for(loop=1;loop<argc;loop++)
+   {
+     if(strcmp(argv[loop],"-n")==0)
+       dryrun = 1;
+     else if((strcmp(argv[loop],"-b")==0) && ((loop + 1) < argc))
+       bus = atoi(argv[++loop]);
+     else if((strcmp(argv[loop],"-c")==0) && ((loop + 1) < argc))
+       cache = argv[++loop];
+     else if((argv[loop][0] != '-') && (planfile == NULL))
+       planfile = argv[loop];
+     else
+       {
+         Usage();
+         return -1;
+       }
+   }
+  if(planfile == NULL)
+    {
+      Usage();
+      return -1;
+    }
+
+  if(LoadPlan(planfile) < 0) return -1;
+
+  start = Now();
+  A2DInventoryInit(&inventory);
+  if(A2DDiscoverBus(bus,&inventory) < 0)
+    {
+      printf("Unable to open I2C bus %d\n",bus);
+      return -1;
+    }
+  memset(Used,0,sizeof(Used));
+  memset(Busy,0,sizeof(Busy));
+  for(loop=0;loop<inventory.Count;loop++)
+    Used[inventory.Device[loop].Address] = 1;
+  printf("%d device(s) on bus %d\n",inventory.Count,bus);
+
+  if(CheckPlan() < 0) return -1;
+  for(loop=0;loop<PlanCount;loop++)
+    if(Plan[loop].State == 0) moves++;
+  if(moves == 0)
+    {
+      printf("Nothing to do\n");
+      return 0;
+    }
+
+  snprintf(name,sizeof(name),"/dev/i2c-%d",bus);
+  fd = open(name,O_RDWR);
+  if(fd < 0)
+    {
+      printf("Unable to open %s\n",name);
+      return -1;
+    }
+
+  sent = Now();
+  errors = Provision(fd,dryrun) < 0;
+  close(fd);
+  if(dryrun) return errors ? -1 : 0;
+  printf("%d of %d address change(s) in %.0f ms\n",Changed,moves,(Now() - sent) * 1000.0);
+
+  errors += Verify(bus,&inventory);
+  if(errors)
+    {
+      printf("Verification failed\n");
+      return -1;
+    }
+  printf("%d device(s) verified , total %.0f ms\n",inventory.Count,(Now() - start) * 1000.0);
+
+  if(cache && (A2DInventorySave(&inventory,cache) < 0))
+    printf("Unable to save %s\n",cache);
+  A2DInventoryFree(&inventory);
+  return 0;
+}
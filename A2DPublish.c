@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include "I2CWrapper.h"
+#include "I2C_A2D.h"
+#include "A2DStream.h"
+#include "A2DDevice.h"
+#include "A2DPacer.h"
+#include "A2DShm.h"
+
+
+////////////////////////////////////////////
+//
+//    program to share the device streams with the local processes
+//
+//     usage  A2DPublish  [-b bus] [-t timer] [-n name] [-r records] [-k] address...
+//
+//            -b   bus (default 1)
+//            -t   timer in 100us (command 01) , timer mode is started on each device (default 10 = 1000 samples/sec)
+//            -k   keep the device settings , the devices are already running in timer mode (auto start profile)
+//            -n   shared memory name (default a2d => /dev/shm/a2d)
+//            -r   records in the ring of each device (default 65536)
+//
+//            A2DPublish  -l [name]        consumer , samples/sec and lost records of each stream
+//
+//     The publisher is the only process reading the devices , any number of consumers
+//     read the samples from /dev/shm with A2DShmAttach() , see A2DShm.c
+//     The records are decoded from the live settings of each device (stamp record , single channel)
+//     and the fifo reads are paced from its sample period (A2DPacer.c).
+//
+//  to compile  gcc -O2 -o A2DPublish  A2DPublish.c A2DShm.c A2DStream.c A2DDevice.c A2DPacer.c I2CWrapper.c
+//
+////////////////////////////////////  GPL LICENSE ///////////////////////////////////
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+extern int ExitOnFail;
+
+volatile sig_atomic_t Stop = 0;
+
+
+void StopHandler(int sig)
+{
+  (void) sig;
+  Stop = 1;
+}
+
+
+double Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int Listen(const char * name)
+{
+  A2DShm shm;
+  const A2DShmRecord * record;
+  unsigned long long count[A2D_SHM_STREAMS];
+  unsigned long long overrun[A2D_SHM_STREAMS];
+  unsigned long long lost = 0;
+  int streams, stream, n, loop;
+  double last, now;
+
+  streams = A2DShmAttach(&shm,name);
+  if(streams == -2)
+    {
+      printf("No free consumer slot\n");
+      return -1;
+    }
+  if(streams < 0)
+    {
+      printf("No publisher on /dev/shm/%s\n",name ? name : A2D_SHM_NAME);
+      return -1;
+    }
+  printf("%d stream(s) , %u records each , consumer slot %d\n",streams,shm.Header->Records,shm.Slot);
+
+  memset(count,0,sizeof(count));
+  memset(overrun,0,sizeof(overrun));
+  last = Now();
+  while(!Stop)
+   {
+     if(A2DShmWait(&shm,1000) < 0)
+       {
+         printf("Publisher gone\n");
+         break;
+       }
+
+     for(stream=0;stream<streams;stream++)
+       while((n = A2DShmRead(&shm,stream,&record)) > 0)
+        {
+          for(loop=0;loop<n;loop++)
+            overrun[stream] += record[loop].Overrun;
+          count[stream] += n;
+          A2DShmRelease(&shm,stream,n);
+        }
+
+     now = Now();
+     if((now - last) < 1.0) continue;
+     for(stream=0;stream<streams;stream++)
+       printf("0x%02X %7.1f/s  overrun %llu   ",shm.Header->Stream[stream].Address,count[stream] / (now - last),overrun[stream]);
+     printf("lost %llu\n",shm.Header->Consumer[shm.Slot].Lost - lost);
+     fflush(stdout);
+     lost = shm.Header->Consumer[shm.Slot].Lost;
+     memset(count,0,sizeof(count));
+     memset(overrun,0,sizeof(overrun));
+     last = now;
+   }
+  A2DShmDetach(&shm);
+  return 0;
+}
+
+
+void Usage(void)
+{
+  printf("usage  A2DPublish [-b bus] [-t timer] [-k] [-n name] [-r records] address...\n");
+  printf("       A2DPublish -l [name]\n");
+}
+
+
+// how to read a device , from its live settings
+typedef struct{
+  int            Handle;
+  int            Stamp;		// stamp record after each sample
+  int            Channel;	// A2D_CHANNEL_BOTH or the single channel (packed records)
+  A2DStampState  State;
+  A2DPacer       Pacer;
+}Source;
+
+
+// settings of a running device , return the sample period in seconds , < 0 not supported
+double Settings(Source * source, int address)
+{
+  A2D_Profile profile;
+  double period;
+  int mode;
+
+  mode = I2CWrapperReadByte(source->Handle,A2D_CMD_MODE);
+  if((mode < 0) || (A2DReadLiveProfile(source->Handle,&profile) < 0))
+    {
+      printf("0x%02X doesn't answer\n",address);
+      return -1;
+    }
+  if(mode != A2D_MODE_TIMER)
+    {
+      printf("0x%02X is not in timer mode\n",address);
+      return -1;
+    }
+  if(profile.Burst.Post)
+    {
+      printf("0x%02X is in burst capture , not a stream\n",address);
+      return -1;
+    }
+  source->Stamp = profile.RecordOptions & A2D_RECORD_STAMP;
+  source->Channel = profile.ChannelMask;
+  if(source->Stamp && (source->Channel != A2D_CHANNEL_BOTH))
+    {
+      printf("0x%02X stamp record with a single channel is not supported\n",address);
+      return -1;
+    }
+  if(profile.HwTimer.Period)
+    period = profile.HwTimer.Period * profile.HwTimer.Postscale / 1000000.0;
+  else
+    period = profile.Timer / 10000.0;
+  A2DStampInit(&source->State);
+  A2DStampClock(&source->State,period);    // timer mode , one tick per sample
+  return period;
+}
+
+
+int Read(Source * source, A2DBlock * block)
+{
+  if(source->Stamp)
+    return A2DReadStamped(source->Handle,&source->State,block);
+  if(source->Channel != A2D_CHANNEL_BOTH)
+    return A2DReadDense(source->Handle,source->Channel,block);
+  return A2DReadEvents(source->Handle,block);
+}
+
+
+int main(int argc, char * argv[])
+{
+  A2DShm shm;
+  A2DBlock block;
+  Source source[A2D_SHM_STREAMS];
+  struct pollfd fds[A2D_SHM_STREAMS];
+  int address[A2D_SHM_STREAMS];
+  const char * name = NULL;
+  unsigned int records = 65536;
+  int bus = 1;
+  int timer = 10;
+  int keep = 0;
+  int count = 0;
+  double period[A2D_SHM_STREAMS];
+  int loop, stream, n;
+
+  signal(SIGINT,StopHandler);
+  signal(SIGTERM,StopHandler);
+
+  for(loop=1;loop<argc;loop++)
+   {
+     if(strcmp(argv[loop],"-l")==0)
+       return Listen((loop + 1) < argc ? argv[loop + 1] : NULL);
+     else if(strcmp(argv[loop],"-k")==0)
+       keep = 1;
+     else if((strcmp(argv[loop],"-b")==0) && ((loop + 1) < argc))
+       bus = atoi(argv[++loop]);
+     else if((strcmp(argv[loop],"-t")==0) && ((loop + 1) < argc))
+       timer = atoi(argv[++loop]);
+     else if((strcmp(argv[loop],"-n")==0) && ((loop + 1) < argc))
+       name = argv[++loop];
+     else if((strcmp(argv[loop],"-r")==0) && ((loop + 1) < argc))
+       records = strtoul(argv[++loop],NULL,0);
+     else if((argv[loop][0] != '-') && (count < A2D_SHM_STREAMS))
+       address[count++] = strtoul(argv[loop],NULL,0);
+     else
+       {
+         Usage();
+         return -1;
+       }
+   }
+  if((count == 0) || (timer < 1))
+    {
+      Usage();
+      return -1;
+    }
+
+  ExitOnFail = 0;                  // a device not answering is skipped , the others go on
+  for(stream=0;stream<count;stream++)
+   {
+     source[stream].Handle = I2CWrapperOpen(bus,address[stream]);
+     if(source[stream].Handle < 0)
+       {
+         printf("Unable to open I2C bus %d\n",bus);
+         return -1;
+       }
+     if(!keep)
+       {
+         A2DMode(source[stream].Handle,A2D_MODE_OFF);
+         A2DTimer(source[stream].Handle,timer);
+         A2DMode(source[stream].Handle,A2D_MODE_TIMER);
+       }
+     // the decoding and the pace follow what the device does , not the command line
+     if((period[stream] = Settings(&source[stream],address[stream])) < 0) return -1;
+   }
+
+  if(A2DShmCreate(&shm,name,address,count,records,period[0]) < 0)
+    {
+      printf("Unable to create /dev/shm/%s\n",name ? name : A2D_SHM_NAME);
+      return -1;
+    }
+  for(stream=1;stream<count;stream++)
+    shm.Header->Stream[stream].Period = period[stream];
+
+  // one pacer per device , the fifo holds 39 records: wake up at 20
+  for(stream=0;stream<count;stream++)
+   {
+     if(A2DPacerOpen(&source[stream].Pacer,source[stream].Handle,20) < 0)
+       {
+         printf("Unable to pace 0x%02X\n",address[stream]);
+         return -1;
+       }
+     fds[stream].fd = source[stream].Pacer.TimerFd;
+     fds[stream].events = POLLIN;
+   }
+
+  while(!Stop)
+   {
+     if(poll(fds,count,1000) <= 0) continue;
+     for(stream=0;stream<count;stream++)
+      {
+        if(!(fds[stream].revents & POLLIN)) continue;
+        if(A2DPacerWait(&source[stream].Pacer) <= 0) continue;
+        do{
+           memset(&block,0,sizeof(block));   // Time is 0 without the stamp record
+           n = Read(&source[stream],&block);
+           A2DShmPublish(&shm,stream,&block);
+          }while((n > 0) && (block.Count == A2D_BLOCK_SIZE));
+      }
+   }
+
+  for(stream=0;stream<count;stream++)
+   {
+     A2DPacerClose(&source[stream].Pacer);
+     if(!keep)
+       A2DMode(source[stream].Handle,A2D_MODE_OFF);
+     close(source[stream].Handle);
+   }
+  A2DShmClose(&shm);
+  return 0;
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "A2DQuery.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DQuery
+//
+//    Range queries on archives , "when did A1 go over 900 counts last week"
+//
+//    The seek table of an archive is also its zone map. The chunks are in time order ,
+//    the first one of the range is found by a binary search and the walk stops after the last.
+//    A chunk is decoded only when its min/max and flags could match the predicate ,
+//    so a query of months reads the seek table and the few chunks with a match.
+//    The matching samples come back as ranges (runs , across chunks) or one by one.
+//    Each chunk has its own time base (host time of the first sample and period) , a run
+//    stops where a chunk doesn't follow the last sample (a gap in the capture).
+//
+//   to compile add A2DQuery.c and A2DArchive.c to the gcc command line with -O2
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+////////////////////////////////////   A2DQueryInit
+//
+//    Predicate matching everything
+//
+void A2DQueryInit(A2DQueryPredicate * predicate)
+{
+  memset(predicate,0,sizeof(A2DQueryPredicate));
+  predicate->Channel = -1;
+  predicate->Low = 0;
+  predicate->High = 1023;
+}
+
+
+// the zone map says the chunk has no match
+static int QueryPrune(const A2DArchiveSeek * seek, const A2DQueryPredicate * p)
+{
+  if(p->Channel >= 0)
+    if((seek->Max[p->Channel] < p->Low) || (seek->Min[p->Channel] > p->High)) return 1;
+  if(p->Flags && ((seek->Flags & p->Flags) == 0)) return 1;
+  return 0;
+}
+
+
+// first chunk that could hold T0
+static long long QueryFirstChunk(const A2DArchive * archive, double t0)
+{
+  long long low = 0;
+  long long high = archive->Chunks;
+  long long mid;
+
+  while((high - low) > 1)
+   {
+     mid = (low + high) / 2;
+     if(archive->Seek[mid].Time <= t0)
+       low = mid;
+     else
+       high = mid;
+   }
+  return low;
+}
+
+
+////////////////////////////////////   A2DQueryRun
+//
+//    Inputs,
+//
+//    archive:    archive opened with A2DArchiveOpen
+//    predicate:  what to find
+//    mode:       A2D_QUERY_RANGES or A2D_QUERY_SAMPLES
+//    callback:   called for each result in time order
+//    user:       given to the callback
+//    stats:      chunks pruned and decoded , NULL = not needed
+//
+//    Return,
+//
+//    number of results
+//    < 0 read error
+//
+int A2DQueryRun(A2DArchive * archive, const A2DQueryPredicate * predicate, int mode,
+                A2DQueryCallback callback, void * user, A2DQueryStats * stats)
+{
+  A2DArchiveChunk * c;
+  A2DQueryStats local;
+  A2DQueryRange range;
+  const A2DArchiveSeek * seek;
+  int channel = predicate->Channel >= 0 ? predicate->Channel : 0;
+  int open = 0;
+  int results = 0;
+  int stop = 0;
+  long long chunk;
+  double time;
+  unsigned short value;
+  int idx, match;
+
+  if(stats == NULL) stats = &local;
+  memset(stats,0,sizeof(A2DQueryStats));
+  if(archive->Chunks == 0) return 0;
+  c = malloc(sizeof(A2DArchiveChunk));
+  if(c == NULL) return -1;
+
+  chunk = predicate->T0 > 0.0 ? QueryFirstChunk(archive,predicate->T0) : 0;
+  for(;(chunk < (long long) archive->Chunks) && !stop;chunk++)
+   {
+     seek = &archive->Seek[chunk];
+     if((predicate->T1 > 0.0) && (seek->Time > predicate->T1)) break;
+     stats->Chunks++;
+
+     if(QueryPrune(seek,predicate))
+       {
+         stats->Pruned++;
+         if(open)
+           {
+             open = 0;
+             results++;
+             stats->Ranges++;
+             if(callback(archive,&range,user) < 0) stop = 1;
+           }
+         continue;
+       }
+
+     if(A2DArchiveReadChunk(archive,chunk,c) < 0)
+       {
+         free(c);
+         return -1;
+       }
+     stats->Decoded++;
+
+     time = c->Time;
+     for(idx=0;(idx < c->Count) && !stop;idx++)
+      {
+        if(idx)
+          time += c->Period * (1 + c->Overrun[idx]);
+        value = channel ? c->A1[idx] : c->A0[idx];
+
+        match = 1;
+        if((predicate->T0 > 0.0) && (time < predicate->T0)) match = 0;
+        if((predicate->T1 > 0.0) && (time > predicate->T1)) match = 0;
+        if((predicate->Channel >= 0) && ((value < predicate->Low) || (value > predicate->High))) match = 0;
+        if(predicate->Flags && ((c->Flags[idx] & predicate->Flags) == 0)) match = 0;
+        stats->Samples++;
+
+        // a lost sample or a new time base breaks a run
+        if(open && (!match || c->Overrun[idx] ||
+                    ((idx == 0) && ((time < (range.End + c->Period / 2)) || (time > (range.End + c->Period * 1.5))))))
+          {
+            open = 0;
+            results++;
+            stats->Ranges++;
+            if(callback(archive,&range,user) < 0)
+              {
+                stop = 1;
+                break;
+              }
+          }
+        if(!match) continue;
+        stats->Matches++;
+
+        if(!open)
+          {
+            range.First = c->Sample + idx;
+            range.Time = time;
+            range.Min = value;
+            range.Max = value;
+            open = 1;
+          }
+        range.Last = c->Sample + idx;
+        range.End = time;
+        if(value < range.Min) range.Min = value;
+        if(value > range.Max) range.Max = value;
+
+        if(mode == A2D_QUERY_SAMPLES)
+          {
+            open = 0;
+            results++;
+            stats->Ranges++;
+            if(callback(archive,&range,user) < 0) stop = 1;
+          }
+      }
+   }
+
+  if(open && !stop)
+    {
+      results++;
+      stats->Ranges++;
+      callback(archive,&range,user);
+    }
+  free(c);
+  return results;
+}
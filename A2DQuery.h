@@ -0,0 +1,43 @@
+#pragma once
+
+#include "A2DArchive.h"
+
+// range queries on archives. The chunks are pruned with the zone maps of the seek table
+// (time , min/max , flags) , only the chunks that could match are decoded
+
+#define A2D_QUERY_RANGES	0	// one callback per run of matching samples
+#define A2D_QUERY_SAMPLES	1	// one callback per matching sample (event list)
+
+typedef struct{
+  double         T0;		// host time range , seconds since the epoch. 0 = open
+  double         T1;
+  int            Channel;	// 0 = A0 , 1 = A1 , -1 = no value test
+  int            Low;		// value in Low..High (counts)
+  int            High;
+  unsigned char  Flags;		// one of these flags set (A2D_FLAG_EVENT ...) , 0 = no flag test
+}A2DQueryPredicate;
+
+typedef struct{
+  unsigned long long First;	// sample indexes , Last included
+  unsigned long long Last;
+  double         Time;		// host time of First
+  double         End;		// host time of Last
+  unsigned short Min;		// of the channel tested (A0 without value test)
+  unsigned short Max;
+}A2DQueryRange;
+
+typedef struct{
+  unsigned long long Chunks;	// in the time range
+  unsigned long long Pruned;	// skipped with the zone map
+  unsigned long long Decoded;
+  unsigned long long Samples;	// tested
+  unsigned long long Matches;
+  unsigned long long Ranges;
+}A2DQueryStats;
+
+// return < 0 to stop the query
+typedef int (*A2DQueryCallback)(const A2DArchive * archive, const A2DQueryRange * range, void * user);
+
+void			A2DQueryInit(A2DQueryPredicate * predicate);
+int			A2DQueryRun(A2DArchive * archive, const A2DQueryPredicate * predicate, int mode,
+				    A2DQueryCallback callback, void * user, A2DQueryStats * stats);
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "A2DDiscover.h"
+
+
+////////////////////////////////////////////
+//
+//    program to list the A2D devices of the I2C buses
+//
+//     usage  A2DScan  [-f] [-c cache_file] [-b bus]...
+//
+//            -f   full discovery , the cache is replaced
+//            -c   inventory file (default /etc/a2d/inventory.conf)
+//            -b   bus to discover , repeat it for more buses (default every /dev/i2c-N)
+//
+//     Without -f the cached inventory is verified , the discovery is only done
+//     when a device is missing.
+//
+//  to compile  gcc -O2 -o A2DScan  A2DScan.c A2DDiscover.c -lpthread
+//
+////////////////////////////////////  GPL LICENSE ///////////////////////////////////
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+void Usage(void)
+{
+  printf("usage  A2DScan [-f] [-c cache_file] [-b bus]...\n");
+  printf("       -f   full discovery , the cache is replaced\n");
+  printf("       -c   inventory file (default %s)\n",A2D_INVENTORY_FILE);
+  printf("       -b   bus to discover (default every /dev/i2c-N)\n");
+}
+
+
+double Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+int main(int argc, char * argv[])
+{
+  A2DInventory inventory;
+  A2DDeviceInfo * device;
+  const char * cache = NULL;
+  int buses[A2D_DISCOVER_BUS_MAX];
+  int count = 0;
+  int force = 0;
+  int loop, rcode;
+  double start;
+
+  for(loop=1;loop<argc;loop++)
+   {
+     if(strcmp(argv[loop],"-f")==0)
+       force = 1;
+     else if((strcmp(argv[loop],"-c")==0) && ((loop + 1) < argc))
+       cache = argv[++loop];
+     else if((strcmp(argv[loop],"-b")==0) && ((loop + 1) < argc) && (count < A2D_DISCOVER_BUS_MAX))
+       buses[count++] = atoi(argv[++loop]);
+     else
+       {
+         Usage();
+         return -1;
+       }
+   }
+
+  A2DInventoryInit(&inventory);
+  start = Now();
+  if(force)
+    {
+      rcode = A2DDiscoverAll(count ? buses : NULL,count,&inventory) < 0 ? -1 : 1;
+      if((rcode > 0) && (A2DInventorySave(&inventory,cache) < 0))
+        printf("Unable to save %s\n",cache ? cache : A2D_INVENTORY_FILE);
+    }
+  else
+    rcode = A2DInventoryStartup(&inventory,cache,count ? buses : NULL,count);
+
+  if(rcode < 0)
+    {
+      printf("No I2C bus\n");
+      return -1;
+    }
+
+  printf("bus addr  version osctune autostart timer  channel\n");
+  for(loop=0;loop<inventory.Count;loop++)
+   {
+     device = &inventory.Device[loop];
+     printf("%3d 0x%02X  %d.%d     %4d      %d     %5d  %d\n",device->Bus,device->Address,
+            device->Version.Major,device->Version.Minor,device->OscTune,
+            device->Settings.AutoStart,device->Settings.Timer,device->Settings.ChannelMask);
+   }
+  printf("%d device(s) , %s in %.1f ms\n",inventory.Count,rcode ? "discovered" : "cache verified",(Now() - start) * 1000.0);
+  A2DInventoryFree(&inventory);
+  return 0;
+}
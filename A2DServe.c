@@ -0,0 +1,712 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <libgen.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include "A2DShm.h"
+#include "A2DFilter.h"
+#include "A2DServe.h"
+
+
+////////////////////////////////////////////
+//
+//    program to serve the device streams on a local socket
+//
+//     usage  A2DServe  [-n shm_name] [-s socket]
+//
+//            -n   shared memory of A2DPublish (default a2d)
+//            -s   socket path (default /run/a2d/a2d.sock)
+//
+//     A2DServe is a consumer of A2DPublish (A2DShm.c) , it never touches the bus.
+//     For the clients that can't map the shared memory (containers , python).
+//     The protocol is in A2DServe.h. Each client subscribes to devices and channels ,
+//     raw or FIR decimated , and gets length prefixed binary frames.
+//
+//     Batching: a subscription sends a frame when its batch is full or when its oldest sample
+//     waited the latency. The batch starts at latency * rate samples. When a client doesn't read
+//     fast enough (socket full) its batches and latency double , up to 64 times , so there are
+//     less frames and less system calls. They go back down by half each second the socket stays free.
+//     A client more than 4MB late loses frames (the gap shows in First).
+//
+//  to compile  gcc -O2 -o A2DServe  A2DServe.c A2DShm.c A2DFilter.c A2DCalib.c -lm
+//
+////////////////////////////////////  GPL LICENSE ///////////////////////////////////
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define CLIENTS_MAX	256
+#define SUBS_MAX	8		// subscriptions of one client
+#define QUEUE_MAX	(4 * 1024 * 1024)
+#define SCALE_MAX	64
+#define TICK_MS		2		// shared memory poll and latency resolution
+#define TAPS_MAX	255
+#define SOCKET_BUFFER	32768		// a slow client fills it in a few seconds , not minutes
+
+typedef struct{
+  int            Active;
+  unsigned int   Address;	// I2C address , the stream is found again when the publisher restarts
+  int            Stream;	// A2DShm stream
+  int            Channels;	// mask , 1 = A0 , 2 = A1
+  int            Values;	// values per sample
+  int            Decimation;
+  double         Latency;	// seconds
+  int            Base;		// batch for the latency at the rate
+  int            Scale;		// batch and latency factor , 1 .. SCALE_MAX
+  A2DFir         Fir[2];
+  unsigned long long Index;	// next input sample index
+  unsigned int   Gap;		// samples lost before the next one (publisher restart)
+  unsigned long long First;	// batch
+  int            Count;
+  double         Start;		// time of the first sample of the batch
+  unsigned long long Dropped;
+  union{
+    unsigned short Raw[A2D_SERVE_BATCH_MAX * 2];
+    float          Value[A2D_SERVE_BATCH_MAX * 2];
+  };
+}Subscription;
+
+typedef struct{
+  int            Fd;
+  char           In[256];	// request line
+  int            InLen;
+  unsigned char * Out;		// frames not sent
+  size_t         OutPos;
+  size_t         OutLen;
+  size_t         OutSize;
+  int            Blocked;	// socket full , waiting for EPOLLOUT
+  double         LastBlocked;	// time the socket was last full
+  double         LastScale;	// time of the last batch change
+  Subscription   Sub[SUBS_MAX];
+}Client;
+
+Client *      Clients[CLIENTS_MAX];
+A2DShm        Shm;
+int           Attached = 0;
+int           Epoll;
+const char *  ShmName = NULL;
+volatile sig_atomic_t Stop = 0;
+
+
+void StopHandler(int sig)
+{
+  (void) sig;
+  Stop = 1;
+}
+
+
+double Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+unsigned long long NowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+// frame in the client queue , NULL = queue full
+unsigned char * Queue(Client * client, size_t size)
+{
+  unsigned char * buffer;
+  size_t newsize;
+
+  if((client->OutLen - client->OutPos + size) > QUEUE_MAX) return NULL;
+  if(client->OutPos && (client->OutPos == client->OutLen))
+    client->OutPos = client->OutLen = 0;
+  if((client->OutLen + size) > client->OutSize)
+    {
+      // move the unsent part to the front before growing
+      if(client->OutPos)
+        {
+          memmove(client->Out,client->Out + client->OutPos,client->OutLen - client->OutPos);
+          client->OutLen -= client->OutPos;
+          client->OutPos = 0;
+        }
+      newsize = client->OutSize ? client->OutSize : 65536;
+      while(newsize < (client->OutLen + size))
+        newsize *= 2;
+      if(newsize != client->OutSize)
+        {
+          buffer = realloc(client->Out,newsize);
+          if(buffer == NULL) return NULL;
+          client->Out = buffer;
+          client->OutSize = newsize;
+        }
+    }
+  buffer = client->Out + client->OutLen;
+  client->OutLen += size;
+  return buffer;
+}
+
+
+void Reply(Client * client, int id, const char * text)
+{
+  A2DServeHeader * header;
+  size_t length = strlen(text);
+  unsigned char * frame = Queue(client,sizeof(A2DServeHeader) + length);
+
+  if(frame == NULL) return;
+  header = (A2DServeHeader *) frame;
+  memset(header,0,sizeof(A2DServeHeader));
+  header->Length = sizeof(A2DServeHeader) - sizeof(header->Length) + length;
+  header->Type = A2D_SERVE_REPLY;
+  header->Id = id;
+  header->Sent = NowNs();
+  memcpy(frame + sizeof(A2DServeHeader),text,length);
+}
+
+
+void Flush(Client * client, int id)
+{
+  Subscription * sub = &client->Sub[id];
+  A2DServeHeader * header;
+  size_t size;
+  unsigned char * frame;
+
+  if(sub->Count == 0) return;
+  size = sub->Count * sub->Values * (sub->Decimation > 1 ? sizeof(float) : sizeof(unsigned short));
+  frame = Queue(client,sizeof(A2DServeHeader) + size);
+  if(frame == NULL)
+    sub->Dropped += sub->Count;
+  else
+    {
+      header = (A2DServeHeader *) frame;
+      header->Length = sizeof(A2DServeHeader) - sizeof(header->Length) + size;
+      header->Type = A2D_SERVE_DATA;
+      header->Id = id;
+      header->First = sub->First;
+      header->Sent = NowNs();
+      header->Count = sub->Count;
+      header->Channels = sub->Values;
+      header->Format = sub->Decimation > 1 ? A2D_SERVE_FLOAT : A2D_SERVE_U16;
+      header->Reserved = 0;
+      memcpy(frame + sizeof(A2DServeHeader),sub->Decimation > 1 ? (void *) sub->Value : (void *) sub->Raw,size);
+    }
+  sub->Count = 0;
+}
+
+
+// one sample in the batch , gap = samples lost before it
+void Add(Client * client, int id, const A2DShmRecord * record, unsigned int gap, double now)
+{
+  Subscription * sub = &client->Sub[id];
+  unsigned short raw[2] = { record->A0, record->A1 };
+  unsigned char restart = gap ? 1 : 0;
+  unsigned long long index;
+  float in, out[2];
+  int channel, n = 0;
+  int outputs = 0;
+
+  gap += sub->Gap;
+  sub->Gap = 0;
+  if(gap) restart = 1;
+  sub->Index += gap;
+  index = sub->Index++;
+
+  if(sub->Decimation > 1)
+    {
+      for(channel=0;channel<2;channel++)
+        if(sub->Channels & (1 << channel))
+          {
+            in = raw[channel];
+            outputs = A2DFirProcess(&sub->Fir[n],&in,&restart,1,&out[n],NULL);
+            n++;
+          }
+      if(outputs == 0) return;
+      index /= sub->Decimation;
+    }
+
+  if(sub->Count && ((sub->First + sub->Count) != index))
+    Flush(client,id);
+  if(sub->Count == 0)
+    {
+      sub->First = index;
+      sub->Start = now;
+    }
+
+  n = 0;
+  for(channel=0;channel<2;channel++)
+    if(sub->Channels & (1 << channel))
+      {
+        if(sub->Decimation > 1)
+          sub->Value[sub->Count * sub->Values + n] = out[n];
+        else
+          sub->Raw[sub->Count * sub->Values + n] = raw[channel];
+        n++;
+      }
+
+  if(++sub->Count >= (sub->Base * sub->Scale) || (sub->Count >= A2D_SERVE_BATCH_MAX))
+    Flush(client,id);
+}
+
+
+// batch for the latency at the rate of the stream , return the rate
+double Pace(Subscription * sub)
+{
+  double period, rate;
+
+  period = Shm.Header->Stream[sub->Stream].Period;
+  rate = period > 0 ? 1.0 / (period * sub->Decimation) : 0.0;
+  sub->Base = rate > 0 ? (int) (rate * sub->Latency) : A2D_SERVE_BATCH_MAX;
+  if(sub->Base < 1) sub->Base = 1;
+  if(sub->Base > A2D_SERVE_BATCH_MAX) sub->Base = A2D_SERVE_BATCH_MAX;
+  return rate;
+}
+
+
+void Unsubscribe(Client * client, int id)
+{
+  Subscription * sub = &client->Sub[id];
+
+  if(!sub->Active) return;
+  A2DFirFree(&sub->Fir[0]);
+  A2DFirFree(&sub->Fir[1]);
+  sub->Active = 0;
+}
+
+
+void Subscribe(Client * client, const char * line)
+{
+  Subscription * sub;
+  unsigned int address;
+  int channels, decimation = 1;
+  int latency_ms = 100;
+  int id, stream, taps;
+  double rate;
+  float coeff[TAPS_MAX];
+  char text[128];
+
+  if(sscanf(line,"subscribe %i %d %d %d",&address,&channels,&decimation,&latency_ms) < 2)
+    {
+      Reply(client,0xffff,"error usage: subscribe address channels [decimation [latency_ms]]\n");
+      return;
+    }
+  if((channels < 1) || (channels > 3) || (decimation < 1) || (decimation > 10000) || (latency_ms < 1))
+    {
+      Reply(client,0xffff,"error invalid channels , decimation or latency\n");
+      return;
+    }
+  if(!Attached)
+    {
+      Reply(client,0xffff,"error no publisher\n");
+      return;
+    }
+  for(stream=0;stream<(int) Shm.Header->Streams;stream++)
+    if(Shm.Header->Stream[stream].Address == address) break;
+  if(stream == (int) Shm.Header->Streams)
+    {
+      snprintf(text,sizeof(text),"error no device 0x%02X\n",address);
+      Reply(client,0xffff,text);
+      return;
+    }
+  for(id=0;id<SUBS_MAX;id++)
+    if(!client->Sub[id].Active) break;
+  if(id == SUBS_MAX)
+    {
+      Reply(client,0xffff,"error too many subscriptions\n");
+      return;
+    }
+
+  sub = &client->Sub[id];
+  memset(sub,0,sizeof(Subscription));
+  sub->Address = address;
+  sub->Stream = stream;
+  sub->Channels = channels;
+  sub->Values = channels == 3 ? 2 : 1;
+  sub->Decimation = decimation;
+  sub->Latency = latency_ms / 1000.0;
+  sub->Scale = 1;
+  sub->Index = Shm.Header->Consumer[Shm.Slot].Cursor[stream];
+
+  if(decimation > 1)
+    {
+      taps = 8 * decimation + 1;
+      if(taps > TAPS_MAX) taps = TAPS_MAX;
+      A2DFirLowpass(coeff,taps,0.4 / decimation);
+      if((A2DFirInit(&sub->Fir[0],coeff,taps,decimation) < 0) ||
+         ((sub->Values == 2) && (A2DFirInit(&sub->Fir[1],coeff,taps,decimation) < 0)))
+        {
+          A2DFirFree(&sub->Fir[0]);
+          Reply(client,0xffff,"error no memory\n");
+          return;
+        }
+    }
+
+  rate = Pace(sub);
+  sub->Active = 1;
+
+  snprintf(text,sizeof(text),"ok %d %.3f\n",id,rate);
+  Reply(client,id,text);
+}
+
+
+void CloseClient(int slot)
+{
+  Client * client = Clients[slot];
+  int id;
+
+  for(id=0;id<SUBS_MAX;id++)
+    Unsubscribe(client,id);
+  epoll_ctl(Epoll,EPOLL_CTL_DEL,client->Fd,NULL);
+  close(client->Fd);
+  free(client->Out);
+  free(client);
+  Clients[slot] = NULL;
+}
+
+
+void Request(Client * client, const char * line)
+{
+  int id;
+
+  if(strncmp(line,"subscribe",9)==0)
+    Subscribe(client,line);
+  else if((sscanf(line,"unsubscribe %d",&id) == 1) && (id >= 0) && (id < SUBS_MAX) && client->Sub[id].Active)
+    {
+      Unsubscribe(client,id);
+      Reply(client,id,"ok\n");
+    }
+  else
+    Reply(client,0xffff,"error unknown request\n");
+}
+
+
+// < 0 the client is gone
+int ClientRead(Client * client)
+{
+  char * end;
+  int n;
+
+  n = read(client->Fd,client->In + client->InLen,sizeof(client->In) - 1 - client->InLen);
+  if(n == 0) return -1;
+  if(n < 0) return (errno == EAGAIN) || (errno == EINTR) ? 0 : -1;
+  client->InLen += n;
+  client->In[client->InLen] = 0;
+
+  while((end = strchr(client->In,'\n')))
+   {
+     *end = 0;
+     Request(client,client->In);
+     client->InLen -= end + 1 - client->In;
+     memmove(client->In,end + 1,client->InLen + 1);
+   }
+  if(client->InLen == (int) sizeof(client->In) - 1)
+    return -1;                         // no end of line in 255 characters
+  return 0;
+}
+
+
+// the batches follow the socket , double while it stays full , halve after a second free.
+// A slow client unblocks at each of its reads , that must not bring the batches down
+void Adapt(Client * client, double now)
+{
+  int id;
+
+  if(client->Blocked)
+    {
+      client->LastBlocked = now;
+      if((now - client->LastScale) < 0.25) return;
+      for(id=0;id<SUBS_MAX;id++)
+        if(client->Sub[id].Active && (client->Sub[id].Scale < SCALE_MAX))
+          client->Sub[id].Scale *= 2;
+      client->LastScale = now;
+    }
+  else if(((now - client->LastBlocked) >= 1.0) && ((now - client->LastScale) >= 1.0))
+    {
+      for(id=0;id<SUBS_MAX;id++)
+        if(client->Sub[id].Active && (client->Sub[id].Scale > 1))
+          client->Sub[id].Scale /= 2;
+      client->LastScale = now;
+    }
+}
+
+
+// send the queue
+int ClientWrite(Client * client)
+{
+  struct epoll_event event;
+  int blocked = 0;
+  int n;
+
+  while(client->OutPos < client->OutLen)
+   {
+     n = send(client->Fd,client->Out + client->OutPos,client->OutLen - client->OutPos,MSG_NOSIGNAL | MSG_DONTWAIT);
+     if(n < 0)
+       {
+         if(errno == EINTR) continue;
+         if(errno != EAGAIN) return -1;
+         blocked = 1;
+         break;
+       }
+     client->OutPos += n;
+   }
+
+  if(blocked)
+    client->LastBlocked = Now();
+
+  if(blocked != client->Blocked)
+    {
+      event.events = blocked ? EPOLLIN | EPOLLOUT : EPOLLIN;
+      event.data.ptr = client;
+      epoll_ctl(Epoll,EPOLL_CTL_MOD,client->Fd,&event);
+      client->Blocked = blocked;
+    }
+  return 0;
+}
+
+
+void Accept(int listen_fd)
+{
+  struct epoll_event event;
+  Client * client;
+  int fd, slot, size;
+
+  while((fd = accept4(listen_fd,NULL,NULL,SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+   {
+     for(slot=0;slot<CLIENTS_MAX;slot++)
+       if(Clients[slot] == NULL) break;
+     client = slot < CLIENTS_MAX ? calloc(1,sizeof(Client)) : NULL;
+     if(client == NULL)
+       {
+         close(fd);
+         continue;
+       }
+     client->Fd = fd;
+     size = SOCKET_BUFFER;
+     setsockopt(fd,SOL_SOCKET,SO_SNDBUF,&size,sizeof(size));
+     event.events = EPOLLIN;
+     event.data.ptr = client;
+     epoll_ctl(Epoll,EPOLL_CTL_ADD,fd,&event);
+     Clients[slot] = client;
+   }
+}
+
+
+// the records published since the last call , to each subscription of the stream
+void Distribute(void)
+{
+  const A2DShmRecord * record;
+  unsigned long long * cursor;
+  unsigned long long expected;
+  unsigned int gap;
+  double now = Now();
+  int stream, slot, id, n, loop;
+
+  for(stream=0;stream<(int) Shm.Header->Streams;stream++)
+   {
+     cursor = &Shm.Header->Consumer[Shm.Slot].Cursor[stream];
+     expected = *cursor;
+     while((n = A2DShmRead(&Shm,stream,&record)) > 0)
+      {
+        for(loop=0;loop<n;loop++)
+         {
+           gap = record[loop].Overrun;
+           if(loop == 0)
+             gap += *cursor - expected;        // too late , the ring went over
+           for(slot=0;slot<CLIENTS_MAX;slot++)
+             if(Clients[slot])
+               for(id=0;id<SUBS_MAX;id++)
+                 if(Clients[slot]->Sub[id].Active && (Clients[slot]->Sub[id].Stream == stream))
+                   Add(Clients[slot],id,&record[loop],gap,now);
+         }
+        A2DShmRelease(&Shm,stream,n);
+        expected = *cursor;
+      }
+   }
+}
+
+
+// new segment of a restarted publisher , its streams could be in an other order.
+// The subscriptions follow their address , the restart is a gap
+void Reattach(void)
+{
+  Subscription * sub;
+  Client * client;
+  char text[128];
+  int slot, id, stream;
+
+  for(slot=0;slot<CLIENTS_MAX;slot++)
+   {
+     if((client = Clients[slot]) == NULL) continue;
+     for(id=0;id<SUBS_MAX;id++)
+      {
+        sub = &client->Sub[id];
+        if(!sub->Active) continue;
+        Flush(client,id);
+        for(stream=0;stream<(int) Shm.Header->Streams;stream++)
+          if(Shm.Header->Stream[stream].Address == sub->Address) break;
+        if(stream == (int) Shm.Header->Streams)
+          {
+            snprintf(text,sizeof(text),"error device 0x%02X gone\n",sub->Address);
+            Reply(client,id,text);
+            Unsubscribe(client,id);
+            continue;
+          }
+        sub->Stream = stream;
+        sub->Gap = 1;
+        Pace(sub);
+      }
+   }
+}
+
+
+void Usage(void)
+{
+  printf("usage  A2DServe [-n shm_name] [-s socket]\n");
+}
+
+
+int main(int argc, char * argv[])
+{
+  struct sockaddr_un address;
+  struct epoll_event event, events[64];
+  const char * path = A2D_SERVE_SOCKET;
+  char dir[sizeof(address.sun_path)];
+  Client * client;
+  double now, retry = 0;
+  int listen_fd, loop, slot, id, n;
+
+  for(loop=1;loop<argc;loop++)
+   {
+     if((strcmp(argv[loop],"-n")==0) && ((loop + 1) < argc))
+       ShmName = argv[++loop];
+     else if((strcmp(argv[loop],"-s")==0) && ((loop + 1) < argc))
+       path = argv[++loop];
+     else
+       {
+         Usage();
+         return -1;
+       }
+   }
+  if(strlen(path) >= sizeof(address.sun_path))
+    {
+      printf("Socket path too long\n");
+      return -1;
+    }
+
+  signal(SIGINT,StopHandler);
+  signal(SIGTERM,StopHandler);
+  signal(SIGPIPE,SIG_IGN);
+
+  snprintf(dir,sizeof(dir),"%s",path);
+  mkdir(dirname(dir),0755);
+  unlink(path);
+  memset(&address,0,sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path,path);
+  listen_fd = socket(AF_UNIX,SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,0);
+  if((listen_fd < 0) || (bind(listen_fd,(struct sockaddr *) &address,sizeof(address)) < 0) ||
+     (listen(listen_fd,64) < 0))
+    {
+      printf("Unable to listen on %s\n",path);
+      return -1;
+    }
+
+  Epoll = epoll_create1(EPOLL_CLOEXEC);
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+  epoll_ctl(Epoll,EPOLL_CTL_ADD,listen_fd,&event);
+
+  while(!Stop)
+   {
+     n = epoll_wait(Epoll,events,64,TICK_MS);
+     for(loop=0;loop<n;loop++)
+      {
+        client = events[loop].data.ptr;
+        if(client == NULL)
+          {
+            Accept(listen_fd);
+            continue;
+          }
+        for(slot=0;slot<CLIENTS_MAX;slot++)
+          if(Clients[slot] == client) break;
+        if(slot == CLIENTS_MAX) continue;          // closed by an earlier event
+        if((events[loop].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && (ClientRead(client) < 0))
+          CloseClient(slot);
+        else if((events[loop].events & EPOLLOUT) && (ClientWrite(client) < 0))
+          CloseClient(slot);
+      }
+
+     now = Now();
+     if(now >= retry)
+       {
+         // once a second , the publisher could have restarted with a new segment
+         if(Attached && ((Shm.Header->Publisher == 0) ||
+                         ((kill(Shm.Header->Publisher,0) < 0) && (errno == ESRCH))))
+           {
+             A2DShmDetach(&Shm);
+             Attached = 0;
+           }
+         if(!Attached && (A2DShmAttach(&Shm,ShmName) > 0))
+           {
+             Attached = 1;
+             Reattach();
+           }
+         retry = now + 1.0;
+       }
+     if(Attached)
+       Distribute();
+
+     for(slot=0;slot<CLIENTS_MAX;slot++)
+      {
+        if((client = Clients[slot]) == NULL) continue;
+        Adapt(client,now);
+        for(id=0;id<SUBS_MAX;id++)
+          if(client->Sub[id].Active && client->Sub[id].Count &&
+             ((now - client->Sub[id].Start) >= (client->Sub[id].Latency * client->Sub[id].Scale)))
+            Flush(client,id);
+        if((client->OutPos < client->OutLen) && !client->Blocked && (ClientWrite(client) < 0))
+          CloseClient(slot);
+      }
+   }
+
+  for(slot=0;slot<CLIENTS_MAX;slot++)
+    if(Clients[slot])
+      CloseClient(slot);
+  if(Attached)
+    A2DShmDetach(&Shm);
+  close(listen_fd);
+  unlink(path);
+  return 0;
+}
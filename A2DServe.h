@@ -0,0 +1,40 @@
+#pragma once
+
+// A2DServe protocol , local stream socket (Unix domain).
+//
+// client -> server , text lines:
+//     subscribe <address> <channels> [decimation [latency_ms]]
+//           channels 1 = A0 , 2 = A1 , 3 = both. decimation 1 = raw samples (default)
+//           latency is the longest a sample waits in a batch (default 100ms)
+//     unsubscribe <id>
+//
+// server -> client , frames: A2DServeHeader then Length - 28 bytes of data
+//     A2D_SERVE_REPLY  text line "ok <id> <rate>" or "error <reason>"
+//     A2D_SERVE_DATA   Count samples , Channels values each.
+//                      unsigned short when Format is A2D_SERVE_U16 (raw) ,
+//                      float when A2D_SERVE_FLOAT (FIR decimated)
+// The samples of a frame follow each other. A gap (overrun , slow client , publisher restart)
+// shows in First. A reply with the Id of a subscription ("error device 0x21 gone") ends it.
+// All the fields are little endian (host order of the Raspberry Pi).
+
+#define A2D_SERVE_SOCKET	"/run/a2d/a2d.sock"
+
+#define A2D_SERVE_REPLY		1
+#define A2D_SERVE_DATA		2
+
+#define A2D_SERVE_U16		1
+#define A2D_SERVE_FLOAT		2
+
+#define A2D_SERVE_BATCH_MAX	1024	// samples in a frame
+
+typedef struct{
+  unsigned int   Length;	// bytes after this field
+  unsigned short Type;		// A2D_SERVE_REPLY , A2D_SERVE_DATA
+  unsigned short Id;		// subscription
+  unsigned long long First;	// index of the first sample , at the subscription rate
+  unsigned long long Sent;	// server CLOCK_MONOTONIC (ns) when the frame was queued
+  unsigned short Count;		// samples
+  unsigned char  Channels;	// values per sample
+  unsigned char  Format;	// A2D_SERVE_U16 , A2D_SERVE_FLOAT
+  unsigned int   Reserved;
+}A2DServeHeader;
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include "A2DServe.h"
+
+
+////////////////////////////////////////////
+//
+//    load test of A2DServe , many local subscribers in one process
+//
+//     usage  A2DServeLoad  [-s socket] [-c clients] [-t seconds] [-w slow_clients] address...
+//
+//            -c   subscribers (default 100) , they take turn on the addresses and on three kinds:
+//                 raw A0+A1 20ms , FIR /10 A0 100ms , raw A1 5ms
+//            -w   clients reading only 512 bytes each 250ms (default 0 , up to -c) ,
+//                 the server should grow their batches
+//            -t   test time (default 10 seconds)
+//
+//     Each subscription checks that First follows , the result is the samples , the gaps ,
+//     the frames and the latency (server queue to client read).
+//
+//  to compile  gcc -O2 -o A2DServeLoad  A2DServeLoad.c
+//
+////////////////////////////////////  GPL LICENSE ///////////////////////////////////
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c) 2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define CLIENTS_MAX	1000
+#define BUFFER_SIZE	(256 * 1024)
+#define SLOW_READ	512		// bytes each 250ms
+
+typedef struct{
+  int            Fd;
+  int            Kind;
+  int            Slow;
+  int            Subscribed;	// reply received
+  unsigned long long Next;	// First expected
+  unsigned long long Samples;
+  unsigned long long Gaps;
+  unsigned long long Frames;
+  int            Largest;	// samples in the largest frame
+  double         Latency;	// sum , seconds
+  double         LatencyMax;
+  double         LastRead;
+  unsigned char * Buffer;
+  int            Length;
+}Subscriber;
+
+const char *  Kinds[3] = { "raw A0+A1 20ms" , "fir/10 A0 100ms" , "raw A1 5ms" };
+Subscriber    Sub[CLIENTS_MAX];
+
+
+double Now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+void Frames(Subscriber * sub, double now)
+{
+  A2DServeHeader * header;
+  int offset = 0;
+  int size;
+  double latency;
+
+  while((sub->Length - offset) >= (int) sizeof(A2DServeHeader))
+   {
+     header = (A2DServeHeader *) (sub->Buffer + offset);
+     size = sizeof(header->Length) + header->Length;
+     if((sub->Length - offset) < size) break;
+
+     if(header->Type == A2D_SERVE_REPLY)
+       {
+         if(strncmp((char *) header + sizeof(A2DServeHeader),"ok",2) != 0)
+           printf("subscriber %d: %.*s",(int) (sub - Sub),(int) (size - sizeof(A2DServeHeader)),
+                  (char *) header + sizeof(A2DServeHeader));
+         sub->Subscribed = 1;
+       }
+     else if(header->Type == A2D_SERVE_DATA)
+       {
+         if(sub->Frames && (header->First != sub->Next))
+           sub->Gaps++;
+         sub->Next = header->First + header->Count;
+         sub->Samples += header->Count;
+         sub->Frames++;
+         if(header->Count > sub->Largest) sub->Largest = header->Count;
+         latency = now - header->Sent / 1e9;
+         sub->Latency += latency;
+         if(latency > sub->LatencyMax) sub->LatencyMax = latency;
+       }
+     offset += size;
+   }
+  memmove(sub->Buffer,sub->Buffer + offset,sub->Length - offset);
+  sub->Length -= offset;
+}
+
+
+// < 0 connection closed
+int Receive(Subscriber * sub, int size)
+{
+  int n;
+
+  if(size > (BUFFER_SIZE - sub->Length)) size = BUFFER_SIZE - sub->Length;
+  n = recv(sub->Fd,sub->Buffer + sub->Length,size,MSG_DONTWAIT);
+  if(n < 0) return errno == EAGAIN ? 0 : -1;
+  if(n == 0)
+    {
+      printf("subscriber %d: connection closed\n",(int) (sub - Sub));
+      return -1;
+    }
+  sub->Length += n;
+  Frames(sub,Now());
+  return n;
+}
+
+
+int main(int argc, char * argv[])
+{
+  struct sockaddr_un address;
+  struct epoll_event event, events[64];
+  const char * path = A2D_SERVE_SOCKET;
+  int addresses[16];
+  int naddress = 0;
+  int clients = 100;
+  int slow = 0;
+  double seconds = 10.0;
+  char request[128];
+  Subscriber * sub;
+  int epoll_fd, loop, n, kind;
+  double start, now;
+  unsigned long long samples[3], frames[3], gaps[3];
+  double latency[3], latency_max[3];
+
+  for(loop=1;loop<argc;loop++)
+   {
+     if((strcmp(argv[loop],"-s")==0) && ((loop + 1) < argc))
+       path = argv[++loop];
+     else if((strcmp(argv[loop],"-c")==0) && ((loop + 1) < argc))
+       clients = atoi(argv[++loop]);
+     else if((strcmp(argv[loop],"-w")==0) && ((loop + 1) < argc))
+       slow = atoi(argv[++loop]);
+     else if((strcmp(argv[loop],"-t")==0) && ((loop + 1) < argc))
+       seconds = atof(argv[++loop]);
+     else if((argv[loop][0] != '-') && (naddress < 16))
+       addresses[naddress++] = strtoul(argv[loop],NULL,0);
+     else
+       naddress = -1000;
+   }
+  if((naddress <= 0) || (clients < 1) || (clients > CLIENTS_MAX) || (slow < 0) || (slow > clients))
+    {
+      printf("usage  A2DServeLoad [-s socket] [-c clients] [-t seconds] [-w slow_clients] address...\n");
+      return -1;
+    }
+
+  epoll_fd = epoll_create1(0);
+  memset(&address,0,sizeof(address));
+  address.sun_family = AF_UNIX;
+  snprintf(address.sun_path,sizeof(address.sun_path),"%s",path);
+
+  for(loop=0;loop<clients;loop++)
+   {
+     sub = &Sub[loop];
+     sub->Kind = loop % 3;
+     sub->Slow = loop < slow;
+     sub->Buffer = malloc(BUFFER_SIZE);
+     sub->Fd = socket(AF_UNIX,SOCK_STREAM,0);
+     if(connect(sub->Fd,(struct sockaddr *) &address,sizeof(address)) < 0)
+       {
+         printf("Unable to connect to %s (%d clients)\n",path,loop);
+         return -1;
+       }
+     if(sub->Kind == 0)
+       snprintf(request,sizeof(request),"subscribe 0x%02X 3 1 20\n",addresses[loop % naddress]);
+     else if(sub->Kind == 1)
+       snprintf(request,sizeof(request),"subscribe 0x%02X 1 10 100\n",addresses[loop % naddress]);
+     else
+       snprintf(request,sizeof(request),"subscribe 0x%02X 2 1 5\n",addresses[loop % naddress]);
+     if(write(sub->Fd,request,strlen(request)) < 0) return -1;
+     if(sub->Slow) continue;           // read in the loop , not on the events
+     event.events = EPOLLIN;
+     event.data.ptr = sub;
+     epoll_ctl(epoll_fd,EPOLL_CTL_ADD,sub->Fd,&event);
+   }
+
+  start = Now();
+  while((now = Now()) < (start + seconds))
+   {
+     n = epoll_wait(epoll_fd,events,64,10);
+     for(loop=0;loop<n;loop++)
+       if(Receive(events[loop].data.ptr,BUFFER_SIZE) < 0)
+         epoll_ctl(epoll_fd,EPOLL_CTL_DEL,((Subscriber *) events[loop].data.ptr)->Fd,NULL);
+
+     for(loop=0;loop<slow;loop++)
+       if((now - Sub[loop].LastRead) >= 0.25)
+         {
+           Sub[loop].LastRead = now;
+           Receive(&Sub[loop],SLOW_READ);
+         }
+   }
+
+  memset(samples,0,sizeof(samples));
+  memset(frames,0,sizeof(frames));
+  memset(gaps,0,sizeof(gaps));
+  memset(latency,0,sizeof(latency));
+  memset(latency_max,0,sizeof(latency_max));
+  for(loop=0;loop<clients;loop++)
+   {
+     sub = &Sub[loop];
+     if(sub->Slow) continue;
+     kind = sub->Kind;
+     samples[kind] += sub->Samples;
+     frames[kind] += sub->Frames;
+     gaps[kind] += sub->Gaps;
+     latency[kind] += sub->Latency;
+     if(sub->LatencyMax > latency_max[kind]) latency_max[kind] = sub->LatencyMax;
+   }
+
+  printf("%d subscribers , %.1f seconds\n",clients,seconds);
+  for(kind=0;kind<3;kind++)
+    if(frames[kind])
+      printf("%-16s %9llu samples %7.0f/s  %7llu frames (%5.1f samples each)  gaps %llu  latency avg %.1fms max %.1fms\n",
+             Kinds[kind],samples[kind],samples[kind] / seconds,frames[kind],(double) samples[kind] / frames[kind],gaps[kind],
+             latency[kind] * 1000.0 / frames[kind],latency_max[kind] * 1000.0);
+
+  for(loop=0;loop<slow;loop++)
+   {
+     sub = &Sub[loop];
+     printf("slow subscriber %d %-16s %9llu samples  %6llu frames (%6.1f samples each , largest %d)  gaps %llu\n",loop,Kinds[sub->Kind],
+            sub->Samples,sub->Frames,sub->Frames ? (double) sub->Samples / sub->Frames : 0.0,sub->Largest,sub->Gaps);
+   }
+  return 0;
+}
@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "A2DShm.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DShm
+//
+//    Shared memory streams between the acquisition process and local consumers
+//
+//    Only one process can read a device , the reads drain the fifo. That process publishes
+//    each decoded block with A2DShmPublish() and the consumers attach to the same segment.
+//    A consumer reads the records in place (A2DShmRead) , no copy and no system call ,
+//    and moves its cursor (A2DShmRelease). A2DShmWait() sleeps on a futex word of the header ,
+//    the publisher only calls futex wake when a consumer is waiting.
+//
+//    The publisher never waits: a consumer more than one ring behind loses the oldest records
+//    (Lost in its slot). A2DShmRelease() tells if the records were overwritten while they were read.
+//
+//   to compile add A2DShm.c to the gcc command line (-lrt with glibc older than 2.34)
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+// the publisher writes one block past Head before it moves Head
+#define IN_FLIGHT	A2D_BLOCK_SIZE
+
+#define LOAD(X)		__atomic_load_n(&(X),__ATOMIC_ACQUIRE)
+#define STORE(X,V)	__atomic_store_n(&(X),V,__ATOMIC_RELEASE)
+
+
+static int Futex(unsigned int * word, int op, unsigned int value, const struct timespec * timeout)
+{
+  // not FUTEX_PRIVATE_FLAG , the word is shared between processes
+  return syscall(SYS_futex,word,op,value,timeout,NULL,0);
+}
+
+
+static int ShmMap(A2DShm * shm, const char * name, int flags)
+{
+  snprintf(shm->Name,sizeof(shm->Name),"/%s",name ? name : A2D_SHM_NAME);
+  shm->Fd = shm_open(shm->Name,flags,0644);
+  return shm->Fd;
+}
+
+
+////////////////////////////////////   A2DShmCreate
+//
+//    Create the segment /dev/shm/<name>. An old segment is replaced.
+//
+//    Inputs,
+//
+//    shm:       publisher state
+//    name:      segment name , NULL = A2D_SHM_NAME
+//    address:   I2C address of each stream
+//    streams:   number of streams (1..A2D_SHM_STREAMS)
+//    records:   ring size of each stream , rounded up to a power of 2 (at least 1024)
+//    period:    seconds between two samples , 0 = not known
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DShmCreate(A2DShm * shm, const char * name, const int * address, int streams,
+                 unsigned int records, double period)
+{
+  A2DShmHeader * header;
+  unsigned int size = 1024;
+  int loop;
+
+  memset(shm,0,sizeof(A2DShm));
+  shm->Slot = -1;
+  if((streams < 1) || (streams > A2D_SHM_STREAMS)) return -1;
+  while((size < records) && (size < 0x40000000))
+    size <<= 1;
+
+  // the consumers of an old segment keep it until they detach
+  if(ShmMap(shm,name,O_RDWR) >= 0)
+    {
+      close(shm->Fd);
+      shm_unlink(shm->Name);
+    }
+  if(ShmMap(shm,name,O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC) < 0) return -1;
+
+  shm->Size = A2D_SHM_HEADER_SIZE + (size_t) streams * size * sizeof(A2DShmRecord);
+  if(ftruncate(shm->Fd,shm->Size) < 0) goto fail;
+  shm->Header = mmap(NULL,shm->Size,PROT_READ | PROT_WRITE,MAP_SHARED,shm->Fd,0);
+  if(shm->Header == MAP_FAILED) goto fail;
+  shm->Ring = (A2DShmRecord *) ((unsigned char *) shm->Header + A2D_SHM_HEADER_SIZE);
+  shm->Mask = size - 1;
+
+  header = shm->Header;
+  header->Version = A2D_SHM_VERSION;
+  header->Streams = streams;
+  header->Records = size;
+  for(loop=0;loop<streams;loop++)
+   {
+     header->Stream[loop].Address = address[loop];
+     header->Stream[loop].Period = period;
+   }
+  header->Publisher = getpid();
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(header->Magic,A2D_SHM_MAGIC,4);
+  return 0;
+
+fail:
+  close(shm->Fd);
+  shm_unlink(shm->Name);
+  shm->Header = NULL;
+  return -1;
+}
+
+
+////////////////////////////////////   A2DShmPublish
+//
+//    Copy a decoded block in the ring of a stream and wake up the consumers
+//
+//    Inputs,
+//
+//    shm:       publisher state
+//    stream:    stream number
+//    block:     samples
+//
+//    Return,
+//
+//    0   ok
+//    < 0 invalid stream
+//
+int A2DShmPublish(A2DShm * shm, int stream, const A2DBlock * block)
+{
+  A2DShmHeader * header = shm->Header;
+  A2DShmRecord * ring;
+  A2DShmRecord * record;
+  unsigned long long head;
+  int loop;
+
+  if((stream < 0) || (stream >= (int) header->Streams)) return -1;
+  if(block->Count <= 0) return 0;
+
+  ring = shm->Ring + (size_t) stream * header->Records;
+  head = header->Stream[stream].Head;
+  for(loop=0;loop<block->Count;loop++)
+   {
+     record = &ring[(head + loop) & shm->Mask];
+     record->A0 = block->A0[loop];
+     record->A1 = block->A1[loop];
+     record->Overrun = block->Overrun[loop];
+     record->Flags = block->Flags[loop];
+     record->Reserved = 0;
+     record->Time = block->Time[loop];
+   }
+  STORE(header->Stream[stream].Head,head + block->Count);
+
+  // a consumer going to sleep adds itself to Waiters before it reads Futex
+  __atomic_add_fetch(&header->Futex,1,__ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&header->Waiters,__ATOMIC_SEQ_CST))
+    Futex(&header->Futex,FUTEX_WAKE,INT_MAX,NULL);
+  return 0;
+}
+
+
+////////////////////////////////////   A2DShmClose
+//
+//    Publisher end , the consumers get -1 from A2DShmWait() and the segment is removed
+//
+void A2DShmClose(A2DShm * shm)
+{
+  if(shm->Header == NULL) return;
+  STORE(shm->Header->Publisher,0);
+  __atomic_add_fetch(&shm->Header->Futex,1,__ATOMIC_SEQ_CST);
+  Futex(&shm->Header->Futex,FUTEX_WAKE,INT_MAX,NULL);
+  munmap(shm->Header,shm->Size);
+  close(shm->Fd);
+  shm_unlink(shm->Name);
+  shm->Header = NULL;
+}
+
+
+static int ProcessGone(int pid)
+{
+  return (pid > 0) && (kill(pid,0) < 0) && (errno == ESRCH);
+}
+
+
+////////////////////////////////////   A2DShmAttach
+//
+//    Map the segment and take a consumer slot. The cursors start at the newest record.
+//
+//    Inputs,
+//
+//    shm:       consumer state
+//    name:      segment name , NULL = A2D_SHM_NAME
+//
+//    Return,
+//
+//    number of streams
+//    -1 no publisher
+//    -2 no free consumer slot
+//
+int A2DShmAttach(A2DShm * shm, const char * name)
+{
+  A2DShmHeader * header;
+  A2DShmConsumer * consumer;
+  struct stat info;
+  int loop, pid, expected;
+
+  memset(shm,0,sizeof(A2DShm));
+  shm->Slot = -1;
+  if(ShmMap(shm,name,O_RDWR | O_CLOEXEC) < 0) return -1;
+  if((fstat(shm->Fd,&info) < 0) || (info.st_size < (off_t) A2D_SHM_HEADER_SIZE)) goto fail;
+
+  shm->Size = info.st_size;
+  shm->Header = mmap(NULL,shm->Size,PROT_READ | PROT_WRITE,MAP_SHARED,shm->Fd,0);
+  if(shm->Header == MAP_FAILED) goto fail;
+  header = shm->Header;
+  if((memcmp(header->Magic,A2D_SHM_MAGIC,4) != 0) || (header->Version != A2D_SHM_VERSION) ||
+     (shm->Size < A2D_SHM_HEADER_SIZE + (size_t) header->Streams * header->Records * sizeof(A2DShmRecord)))
+    goto fail;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  shm->Ring = (A2DShmRecord *) ((unsigned char *) header + A2D_SHM_HEADER_SIZE);
+  shm->Mask = header->Records - 1;
+
+  // free slot , or the slot of a consumer that died
+  pid = getpid();
+  for(loop=0;loop<A2D_SHM_CONSUMERS;loop++)
+   {
+     expected = LOAD(header->Consumer[loop].Pid);
+     if((expected != 0) && !ProcessGone(expected)) continue;
+     if(__atomic_compare_exchange_n(&header->Consumer[loop].Pid,&expected,pid,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE))
+       break;
+   }
+  if(loop == A2D_SHM_CONSUMERS)
+    {
+      munmap(shm->Header,shm->Size);
+      close(shm->Fd);
+      shm->Header = NULL;
+      return -2;
+    }
+
+  shm->Slot = loop;
+  consumer = &header->Consumer[loop];
+  consumer->Lost = 0;
+  for(loop=0;loop<(int) header->Streams;loop++)
+    consumer->Cursor[loop] = LOAD(header->Stream[loop].Head);
+  return header->Streams;
+
+fail:
+  if(shm->Header && (shm->Header != MAP_FAILED))
+    munmap(shm->Header,shm->Size);
+  close(shm->Fd);
+  shm->Header = NULL;
+  return -1;
+}
+
+
+////////////////////////////////////   A2DShmRead
+//
+//    Records ready to read in a stream , in place. The count stops at the end of the ring ,
+//    the next call gives the rest. A consumer too late goes to the oldest record still valid.
+//
+//    Inputs,
+//
+//    shm:       consumer state
+//    stream:    stream number
+//    records:   pointer to the first record
+//
+//    Return,
+//
+//    number of records
+//    < 0 invalid stream
+//
+int A2DShmRead(A2DShm * shm, int stream, const A2DShmRecord ** records)
+{
+  A2DShmHeader * header = shm->Header;
+  A2DShmConsumer * consumer = &header->Consumer[shm->Slot];
+  unsigned long long head, cursor, oldest;
+  unsigned long long count;
+  unsigned int index;
+
+  if((stream < 0) || (stream >= (int) header->Streams)) return -1;
+
+  head = LOAD(header->Stream[stream].Head);
+  cursor = consumer->Cursor[stream];
+  oldest = head + IN_FLIGHT > header->Records ? head + IN_FLIGHT - header->Records : 0;
+  if(cursor < oldest)
+    {
+      consumer->Lost += oldest - cursor;
+      consumer->Cursor[stream] = cursor = oldest;
+    }
+
+  index = cursor & shm->Mask;
+  count = head - cursor;
+  if(count > header->Records - index)
+    count = header->Records - index;
+  *records = shm->Ring + (size_t) stream * header->Records + index;
+  return count;
+}
+
+
+////////////////////////////////////   A2DShmRelease
+//
+//    Move the cursor after the records used
+//
+//    Inputs,
+//
+//    shm:       consumer state
+//    stream:    stream number
+//    count:     records used (from A2DShmRead)
+//
+//    Return,
+//
+//    0   ok
+//    -1  the publisher wrote over the records while they were read , drop what was computed
+//
+int A2DShmRelease(A2DShm * shm, int stream, int count)
+{
+  A2DShmHeader * header = shm->Header;
+  A2DShmConsumer * consumer = &header->Consumer[shm->Slot];
+  unsigned long long cursor = consumer->Cursor[stream];
+  unsigned long long head;
+
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);          // the record reads are done before Head
+  head = LOAD(header->Stream[stream].Head);
+  consumer->Cursor[stream] = cursor + count;
+  if((head + IN_FLIGHT) > (cursor + header->Records))
+    {
+      consumer->Lost += count;
+      return -1;
+    }
+  return 0;
+}
+
+
+static int Ready(A2DShm * shm)
+{
+  A2DShmHeader * header = shm->Header;
+  A2DShmConsumer * consumer = &header->Consumer[shm->Slot];
+  unsigned int loop;
+
+  for(loop=0;loop<header->Streams;loop++)
+    if(LOAD(header->Stream[loop].Head) != consumer->Cursor[loop]) return 1;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DShmWait
+//
+//    Sleep until a stream has records to read
+//
+//    Inputs,
+//
+//    shm:         consumer state
+//    timeout_ms:  maximum wait , < 0 = no limit
+//
+//    Return,
+//
+//    1   records to read
+//    0   time out
+//    -1  the publisher is gone
+//
+int A2DShmWait(A2DShm * shm, int timeout_ms)
+{
+  A2DShmHeader * header = shm->Header;
+  struct timespec timeout;
+  unsigned int value;
+
+  if(Ready(shm)) return 1;
+
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+  __atomic_add_fetch(&header->Waiters,1,__ATOMIC_SEQ_CST);
+  value = __atomic_load_n(&header->Futex,__ATOMIC_SEQ_CST);
+  if(!Ready(shm) && LOAD(header->Publisher))
+    Futex(&header->Futex,FUTEX_WAIT,value,timeout_ms < 0 ? NULL : &timeout);
+  __atomic_sub_fetch(&header->Waiters,1,__ATOMIC_SEQ_CST);
+
+  if(Ready(shm)) return 1;
+  if((LOAD(header->Publisher) == 0) || ProcessGone(LOAD(header->Publisher))) return -1;
+  return 0;
+}
+
+
+////////////////////////////////////   A2DShmDetach
+//
+void A2DShmDetach(A2DShm * shm)
+{
+  if(shm->Header == NULL) return;
+  if(shm->Slot >= 0)
+    STORE(shm->Header->Consumer[shm->Slot].Pid,0);
+  munmap(shm->Header,shm->Size);
+  close(shm->Fd);
+  shm->Header = NULL;
+}
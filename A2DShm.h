@@ -0,0 +1,76 @@
+#pragma once
+
+#include "A2DStream.h"
+
+// shared memory streams. One publisher (the process reading the devices) writes the decoded
+// samples of each device in a ring , any number of local consumers read them in place
+// with their own cursor. /dev/shm/<name>: the header , then one ring per stream.
+// The publisher never waits for a consumer , a consumer too late loses the records overwritten.
+
+#define A2D_SHM_NAME		"a2d"
+#define A2D_SHM_MAGIC		"A2DM"
+#define A2D_SHM_VERSION		1
+#define A2D_SHM_STREAMS		16
+#define A2D_SHM_CONSUMERS	32
+
+typedef struct{
+  unsigned short A0;
+  unsigned short A1;
+  unsigned char  Overrun;
+  unsigned char  Flags;
+  unsigned short Reserved;
+  unsigned long long Time;	// device stamp (A2D_FLAG_STAMP)
+}A2DShmRecord;
+
+typedef struct{
+  unsigned int   Address;	// I2C address
+  unsigned int   Reserved;
+  double         Period;	// seconds between two samples , 0 = not known
+  unsigned long long Head;	// records written , record N is at N & (Records - 1)
+  unsigned char  Pad[40];	// one cache line per stream
+}A2DShmStream;
+
+typedef struct{
+  int            Pid;		// 0 = free
+  unsigned int   Reserved;
+  unsigned long long Lost;	// records overwritten before they were read
+  unsigned long long Cursor[A2D_SHM_STREAMS];	// next record to read
+}A2DShmConsumer;
+
+typedef struct{
+  char           Magic[4];
+  unsigned int   Version;
+  unsigned int   Streams;
+  unsigned int   Records;	// per stream , power of 2
+  int            Publisher;	// pid , 0 = closed
+  unsigned int   Futex;		// incremented at each publish
+  unsigned int   Waiters;	// consumers in A2DShmWait
+  unsigned int   Reserved;
+  A2DShmStream   Stream[A2D_SHM_STREAMS];
+  A2DShmConsumer Consumer[A2D_SHM_CONSUMERS];
+}A2DShmHeader;
+
+#define A2D_SHM_HEADER_SIZE	((sizeof(A2DShmHeader) + 4095) & ~4095UL)
+
+typedef struct{
+  int            Fd;
+  A2DShmHeader * Header;
+  A2DShmRecord * Ring;		// stream N starts at Ring + N * Records
+  size_t         Size;
+  unsigned int   Mask;		// Records - 1
+  int            Slot;		// consumer slot , -1 = publisher
+  char           Name[64];
+}A2DShm;
+
+// publisher
+int			A2DShmCreate(A2DShm * shm, const char * name, const int * address, int streams,
+				     unsigned int records, double period);
+int			A2DShmPublish(A2DShm * shm, int stream, const A2DBlock * block);
+void			A2DShmClose(A2DShm * shm);
+
+// consumer
+int			A2DShmAttach(A2DShm * shm, const char * name);
+int			A2DShmRead(A2DShm * shm, int stream, const A2DShmRecord ** records);
+int			A2DShmRelease(A2DShm * shm, int stream, int count);
+int			A2DShmWait(A2DShm * shm, int timeout_ms);
+void			A2DShmDetach(A2DShm * shm);
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "I2CWrapper.h"
+#include "A2DSingle.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DSingle
+//
+//    Pipelined single shot conversion. Command 04 then command 00 (single) in one I2C transaction:
+//    the record of the conversion started by the previous call is read , then the next conversion
+//    is started. One transaction per sample instead of two and the conversion runs while the
+//    host does something else. The read must come first , the single mode start clears the fifo.
+//
+//   to compile add A2DSingle.c to the gcc command line
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+static long long SingleNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void SingleWaitUntil(long long deadline)
+{
+  struct timespec ts;
+
+  if(deadline <= SingleNow()) return;
+  ts.tv_sec = deadline / 1000000000LL;
+  ts.tv_nsec = deadline % 1000000000LL;
+  while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL)==EINTR);
+}
+
+
+////////////////////////////////////   A2DSingleInit
+//
+//    Inputs,
+//
+//    single:   pipeline state
+//    handle:   IO handle
+//    address:  device address (I2C_RDWR doesn't use the handle selection)
+//
+void A2DSingleInit(A2DSingle * single, int handle, int address)
+{
+  memset(single,0,sizeof(A2DSingle));
+  single->Handle = handle;
+  single->Address = address;
+  single->ConversionUs = A2D_SINGLE_CONVERSION_US;
+}
+
+
+////////////////////////////////////   A2DSingleShot
+//
+//    Fetch the conversion started by the previous call and start the next one.
+//    If the previous start is less than ConversionUs old , wait for it first. The record is
+//    taken when the read address comes in , three bytes out of nine , so the wait is shortened
+//    by a third of the last transaction time.
+//    The sample latency is the time between two calls.
+//
+//    Inputs,
+//
+//    single:   pipeline state
+//    sample:   result
+//
+//    Return,
+//
+//    1   new valid sample
+//    0   no sample (first call , or the conversion was not done. ConversionUs is raised by 10us)
+//    < 0 error
+//
+int A2DSingleShot(A2DSingle * single, PackAnalog * sample)
+{
+  PackAnalog record;
+  unsigned char mode = A2D_MODE_SINGLE;
+  long long started = single->PendingTime;
+  int pending = single->Pending;
+  long long begin;
+
+  if(pending)
+    SingleWaitUntil(started + single->ConversionUs * 1000LL - single->LeadNs);
+
+  begin=SingleNow();
+  if(I2CWrapperReadWriteBlock(single->Handle,single->Address,A2D_CMD_READ_PACK_DATA,sizeof(PackAnalog),&record,
+                              A2D_CMD_MODE,1,&mode) < 0)
+    {
+      single->Pending=0;
+      return -1;
+    }
+
+  // the conversion starts at the end of the transaction
+  single->Pending=1;
+  single->PendingTime=SingleNow();
+  single->LeadNs = (single->PendingTime - begin) / 3;
+
+  if(!pending) return 0;          // record from an unknown start
+
+  if(!record.Valid)
+    {
+      single->Misses++;
+      if(single->ConversionUs < 1000) single->ConversionUs += 10;
+      return 0;
+    }
+
+  single->Last = record;
+  single->LastTime = started;
+  single->Samples++;
+  *sample = record;
+  return 1;
+}
+
+
+////////////////////////////////////   A2DSingleLatest
+//
+//    Latest valid sample not older than max_age_us (from the start of its conversion).
+//    The cached sample is returned without bus access if it is young enough , otherwise
+//    the pending conversion is fetched , or a new one is started and fetched.
+//    Worst case is two transactions plus ConversionUs.
+//
+//    Inputs,
+//
+//    single:      pipeline state
+//    sample:      result
+//    max_age_us:  oldest sample accepted. Below ConversionUs every call goes on the bus
+//
+//    Return,
+//
+//    1   valid sample
+//    0   no valid sample
+//    < 0 error
+//
+int A2DSingleLatest(A2DSingle * single, PackAnalog * sample, unsigned long max_age_us)
+{
+  long long now = SingleNow();
+  long long max_age = max_age_us * 1000LL;
+  PackAnalog dummy;
+
+  if(single->LastTime && ((now - single->LastTime) <= max_age))
+    {
+      *sample = single->Last;
+      return 1;
+    }
+
+  // pending conversion is too old , restart it
+  if(!single->Pending || ((now - single->PendingTime) > max_age))
+    if(A2DSingleShot(single,&dummy) < 0) return -1;
+
+  return A2DSingleShot(single,sample);
+}
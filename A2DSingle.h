@@ -0,0 +1,25 @@
+#pragma once
+
+#include "I2C_A2D.h"
+
+// pipelined single shot. Each transaction reads the conversion started by the previous one
+// and starts the next one , one I2C_RDWR with repeated starts
+
+#define A2D_SINGLE_CONVERSION_US	70	// mode write to valid record , both channels
+
+typedef struct{
+  int            Handle;
+  int            Address;
+  unsigned long  ConversionUs;	// minimum time between a start and its fetch
+  int            Pending;	// 1 = a conversion was started by the last transaction
+  long long      PendingTime;	// its start time (ns , CLOCK_MONOTONIC)
+  long long      LeadNs;		// transaction start to the read address (a third of the last one)
+  PackAnalog     Last;		// latest valid sample
+  long long      LastTime;	// its start time (ns) , 0 = none yet
+  unsigned long  Samples;
+  unsigned long  Misses;	// fetched before the conversion was done
+}A2DSingle;
+
+void			A2DSingleInit(A2DSingle * single, int handle, int address);
+int			A2DSingleShot(A2DSingle * single, PackAnalog * sample);
+int			A2DSingleLatest(A2DSingle * single, PackAnalog * sample, unsigned long max_age_us);
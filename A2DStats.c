@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include "A2DStats.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DStats
+//
+//    Incremental statistics with a summary pyramid
+//
+//    Each sample goes in the open 1 second window. A finished window is written to its file
+//    and merged in the open 1 minute window , which goes in the 1 hour window the same way.
+//    Min , max , sum and sum of squares merge exactly , so each level is the same as a scan
+//    of the raw samples.
+//
+//    The record of window N is at a fixed offset , no index is needed. A range query
+//    takes the coarsest level with at least one record per pixel and reads at most
+//    60 records per pixel , whatever the length of the recording.
+//
+//    The time of a sample is Start + index / Rate. The Overrun count of a sample
+//    adds the missed conversions to the index , so the windows stay on time after a gap.
+//
+//   to compile add A2DStats.c and A2DCalib.c to the gcc command line with -lm
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+const double A2DStatsWindow[A2D_STATS_LEVELS] = { 1.0, 60.0, 3600.0 };
+
+static const char * LevelName[A2D_STATS_LEVELS] = { "1s", "1m", "1h" };
+
+// records of the level below in one window
+static const int LevelRatio[A2D_STATS_LEVELS] = { 1, 60, 60 };
+
+
+static void StatsFileName(char * name, int size, const char * base, int level)
+{
+  snprintf(name,size,"%s.%s",base,LevelName[level]);
+}
+
+
+static void StatsClearBin(A2DStatsBin * bin)
+{
+  memset(bin,0,sizeof(A2DStatsBin));
+}
+
+
+////////////////////////////////////   A2DStatsMerge
+//
+//    Add the src window to dest
+//
+void A2DStatsMerge(A2DStatsBin * dest, const A2DStatsBin * src)
+{
+  int channel;
+
+  dest->Lost += src->Lost;
+  if(src->Count == 0) return;
+  for(channel=0;channel<2;channel++)
+   {
+     if((dest->Count == 0) || (src->Min[channel] < dest->Min[channel])) dest->Min[channel] = src->Min[channel];
+     if((dest->Count == 0) || (src->Max[channel] > dest->Max[channel])) dest->Max[channel] = src->Max[channel];
+     dest->Sum[channel] += src->Sum[channel];
+     dest->SumSq[channel] += src->SumSq[channel];
+   }
+  dest->Count += src->Count;
+}
+
+
+double A2DStatsMean(const A2DStatsBin * bin, int channel)
+{
+  return bin->Count ? bin->Sum[channel] / bin->Count : 0.0;
+}
+
+
+double A2DStatsRms(const A2DStatsBin * bin, int channel)
+{
+  return bin->Count ? sqrt(bin->SumSq[channel] / bin->Count) : 0.0;
+}
+
+
+////////////////////////////////////   A2DStatsOpen
+//
+//    Inputs,
+//
+//    stats:   statistics state
+//    base:    capture file name , the levels go in base.1s , base.1m and base.1h.
+//             NULL = memory only. Existing files are replaced.
+//    start:   time of the first sample , seconds since the epoch
+//    rate:    samples/sec per channel
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DStatsOpen(A2DStats * stats, const char * base, double start, double rate)
+{
+  A2DStatsHeader header;
+  char name[512];
+  int level;
+
+  memset(stats,0,sizeof(A2DStats));
+  stats->Start = start;
+  stats->Rate = rate;
+  for(level=0;level<A2D_STATS_LEVELS;level++)
+   {
+     stats->Current[level] = -1;
+     stats->Fd[level] = -1;
+   }
+  if(rate <= 0.0) return -1;
+  if(base == NULL) return 0;
+
+  for(level=0;level<A2D_STATS_LEVELS;level++)
+   {
+     StatsFileName(name,sizeof(name),base,level);
+     stats->Fd[level] = open(name,O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,0644);
+     if(stats->Fd[level] < 0)
+       {
+         A2DStatsClose(stats);
+         return -1;
+       }
+     memset(&header,0,sizeof(header));
+     memcpy(header.Magic,A2D_STATS_MAGIC,4);
+     header.Version = A2D_STATS_VERSION;
+     header.Start = start;
+     header.Rate = rate;
+     header.Window = A2DStatsWindow[level];
+     header.RecordSize = sizeof(A2DStatsBin);
+     if(pwrite(stats->Fd[level],&header,sizeof(header),0) != sizeof(header))
+       {
+         A2DStatsClose(stats);
+         return -1;
+       }
+   }
+  return 0;
+}
+
+
+static int StatsWrite(A2DStats * stats, int level)
+{
+  off_t offset;
+
+  if(stats->Fd[level] < 0) return 0;
+  offset = sizeof(A2DStatsHeader) + (off_t) stats->Current[level] * sizeof(A2DStatsBin);
+  if(pwrite(stats->Fd[level],&stats->Bin[level],sizeof(A2DStatsBin),offset) != sizeof(A2DStatsBin))
+    return -1;
+  return 0;
+}
+
+
+// the window of level 0 changes , close the finished windows up the pyramid
+static int StatsAdvance(A2DStats * stats, long long window)
+{
+  long long next = window;
+  int level;
+  int rc = 0;
+
+  for(level=0;level<A2D_STATS_LEVELS;level++)
+   {
+     if(level)
+       next /= LevelRatio[level];
+     if(stats->Current[level] == next) break;     // the upper levels are still open
+
+     if(stats->Current[level] >= 0)
+       {
+         if(StatsWrite(stats,level) < 0) rc = -1;
+         if((level + 1) < A2D_STATS_LEVELS)
+           A2DStatsMerge(&stats->Bin[level + 1],&stats->Bin[level]);
+       }
+     StatsClearBin(&stats->Bin[level]);
+     stats->Current[level] = next;
+   }
+  return rc;
+}
+
+
+////////////////////////////////////   A2DStatsAdd
+//
+//    Add samples in units
+//
+//    Inputs,
+//
+//    stats:    statistics state
+//    a0 , a1:  samples , n entries each. a1 could be NULL (single channel)
+//    overrun:  Overrun count of each sample (A2DBlock) , NULL = no gap
+//    n:        number of samples
+//
+//    Return,
+//
+//    0   ok
+//    < 0 write error
+//
+int A2DStatsAdd(A2DStats * stats, const float * a0, const float * a1, const unsigned char * overrun, int n)
+{
+  A2DStatsBin * bin = &stats->Bin[0];
+  long long window;
+  float value;
+  int lost;
+  int rc = 0;
+  int loop;
+
+  for(loop=0;loop<n;loop++)
+   {
+     lost = overrun ? overrun[loop] : 0;
+     stats->Sample += lost;
+
+     window = (long long) (stats->Sample / stats->Rate / A2DStatsWindow[0]);
+     if(window != stats->Current[0])
+       if(StatsAdvance(stats,window) < 0) rc = -1;
+     bin->Lost += lost;                // counted in the window of the next sample
+
+     value = a0[loop];
+     if((bin->Count == 0) || (value < bin->Min[0])) bin->Min[0] = value;
+     if((bin->Count == 0) || (value > bin->Max[0])) bin->Max[0] = value;
+     bin->Sum[0] += value;
+     bin->SumSq[0] += (double) value * value;
+
+     value = a1 ? a1[loop] : 0.0f;
+     if((bin->Count == 0) || (value < bin->Min[1])) bin->Min[1] = value;
+     if((bin->Count == 0) || (value > bin->Max[1])) bin->Max[1] = value;
+     bin->Sum[1] += value;
+     bin->SumSq[1] += (double) value * value;
+
+     bin->Count++;
+     stats->Sample++;
+   }
+  return rc;
+}
+
+
+////////////////////////////////////   A2DStatsBlock
+//
+//    Add a decoded block
+//
+//    Inputs,
+//
+//    stats:   statistics state
+//    block:   decoded samples
+//    calib:   device calibration , NULL = raw counts
+//
+int A2DStatsBlock(A2DStats * stats, const A2DBlock * block, const A2DCalib * calib)
+{
+  float a0[A2D_BLOCK_SIZE];
+  float a1[A2D_BLOCK_SIZE];
+  int loop;
+
+  if(calib)
+    A2DCalibBlock(calib,block,a0,a1);
+  else
+    for(loop=0;loop<block->Count;loop++)
+     {
+       a0[loop] = block->A0[loop];
+       a1[loop] = block->A1[loop];
+     }
+  return A2DStatsAdd(stats,a0,a1,block->Overrun,block->Count);
+}
+
+
+////////////////////////////////////   A2DStatsFlush
+//
+//    Write the open windows , partial. They are written again when they are finished.
+//    Call it from time to time so the queries see the last samples.
+//    The open window of a level doesn't hold the open windows below it yet ,
+//    so the partial 1m and 1h records get them merged in a copy.
+//
+int A2DStatsFlush(A2DStats * stats)
+{
+  A2DStatsBin saved[A2D_STATS_LEVELS];
+  int level;
+  int rc = 0;
+
+  memcpy(saved,stats->Bin,sizeof(saved));
+  for(level=0;level<A2D_STATS_LEVELS;level++)
+   {
+     if(stats->Current[level] < 0) continue;
+     if(level)
+       A2DStatsMerge(&stats->Bin[level],&stats->Bin[level - 1]);
+     if(StatsWrite(stats,level) < 0) rc = -1;
+   }
+  memcpy(stats->Bin,saved,sizeof(saved));
+  return rc;
+}
+
+
+////////////////////////////////////   A2DStatsClose
+//
+//    Flush the open windows and close the files
+//
+int A2DStatsClose(A2DStats * stats)
+{
+  int rc;
+  int level;
+
+  rc = A2DStatsFlush(stats);
+  for(level=0;level<A2D_STATS_LEVELS;level++)
+   {
+     if(stats->Fd[level] >= 0)
+       if(close(stats->Fd[level]) < 0) rc = -1;
+     stats->Fd[level] = -1;
+   }
+  return rc;
+}
+
+
+////////////////////////////////////   A2DStatsQuery
+//
+//    Statistics of a time range in equal parts (one per pixel of a plot)
+//
+//    Inputs,
+//
+//    base:    capture file name given to A2DStatsOpen
+//    t0 , t1: time range , seconds since the epoch
+//    pixels:  number of parts
+//    out:     result , pixels entries. Count = 0 when no sample
+//
+//    Return,
+//
+//    level used (0 = 1s , 1 = 1m , 2 = 1h)
+//    < 0 error
+//
+int A2DStatsQuery(const char * base, double t0, double t1, int pixels, A2DStatsBin * out)
+{
+  A2DStatsHeader header;
+  A2DStatsBin record[256];
+  char name[512];
+  double span;
+  long long first, last, index;
+  ssize_t got;
+  int level, fd, loop, pixel, n;
+
+  if((pixels < 1) || (t1 <= t0)) return -1;
+  for(loop=0;loop<pixels;loop++)
+    StatsClearBin(&out[loop]);
+  span = (t1 - t0) / pixels;
+
+  // coarsest level with one record or more per pixel
+  for(level=A2D_STATS_LEVELS - 1;level>0;level--)
+    if(A2DStatsWindow[level] <= span) break;
+
+  StatsFileName(name,sizeof(name),base,level);
+  fd = open(name,O_RDONLY | O_CLOEXEC);
+  if(fd < 0) return -1;
+  if((pread(fd,&header,sizeof(header),0) != sizeof(header)) || memcmp(header.Magic,A2D_STATS_MAGIC,4) ||
+     (header.Version != A2D_STATS_VERSION) || (header.RecordSize != sizeof(A2DStatsBin)))
+    {
+      close(fd);
+      return -1;
+    }
+
+  first = (long long) floor((t0 - header.Start) / header.Window);
+  last = (long long) ceil((t1 - header.Start) / header.Window);
+  if(first < 0) first = 0;
+
+  for(index=first;index<last;index+=n)
+   {
+     n = (last - index) > 256 ? 256 : (int) (last - index);
+     got = pread(fd,record,n * sizeof(A2DStatsBin),sizeof(header) + index * sizeof(A2DStatsBin));
+     if(got <= 0) break;                    // end of the recording
+     n = got / sizeof(A2DStatsBin);
+     if(n == 0) break;
+     for(loop=0;loop<n;loop++)
+      {
+        // the record goes in the pixel of its start , clipped to the range
+        pixel = (int) floor((header.Start + (index + loop) * header.Window - t0) / span);
+        if(pixel < 0) pixel = 0;
+        if(pixel >= pixels) pixel = pixels - 1;
+        A2DStatsMerge(&out[pixel],&record[loop]);
+      }
+   }
+  close(fd);
+  return level;
+}
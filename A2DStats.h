@@ -0,0 +1,53 @@
+#pragma once
+
+#include "A2DStream.h"
+#include "A2DCalib.h"
+
+// min/max/mean/rms per window , kept as samples arrive and rolled up in three levels.
+// Each level is a file next to the capture: <base>.1s , <base>.1m , <base>.1h
+// A 64 bytes header then one record per window at header + window * record size.
+// Windows without samples are holes (Count = 0)
+
+#define A2D_STATS_LEVELS	3
+#define A2D_STATS_MAGIC		"A2DS"
+#define A2D_STATS_VERSION	1
+
+typedef struct{
+  unsigned int   Count;		// samples in the window , 0 = empty
+  unsigned int   Lost;		// missed conversions (Overrun counts)
+  float          Min[2];	// A0 , A1
+  float          Max[2];
+  double         Sum[2];
+  double         SumSq[2];
+}A2DStatsBin;
+
+typedef struct{
+  char           Magic[4];
+  unsigned int   Version;
+  double         Start;		// time of sample 0 , seconds since the epoch
+  double         Rate;		// samples/sec per channel
+  double         Window;	// seconds per record
+  unsigned int   RecordSize;	// sizeof(A2DStatsBin)
+  unsigned char  Reserved[28];
+}A2DStatsHeader;
+
+typedef struct{
+  double              Start;
+  double              Rate;
+  unsigned long long  Sample;			// next sample index , lost samples included
+  long long           Current[A2D_STATS_LEVELS];	// open window of each level , -1 = none
+  A2DStatsBin         Bin[A2D_STATS_LEVELS];
+  int                 Fd[A2D_STATS_LEVELS];	// -1 = memory only
+}A2DStats;
+
+extern const double	A2DStatsWindow[A2D_STATS_LEVELS];
+
+int			A2DStatsOpen(A2DStats * stats, const char * base, double start, double rate);
+int			A2DStatsAdd(A2DStats * stats, const float * a0, const float * a1, const unsigned char * overrun, int n);
+int			A2DStatsBlock(A2DStats * stats, const A2DBlock * block, const A2DCalib * calib);
+int			A2DStatsFlush(A2DStats * stats);
+int			A2DStatsClose(A2DStats * stats);
+int			A2DStatsQuery(const char * base, double t0, double t1, int pixels, A2DStatsBin * out);
+void			A2DStatsMerge(A2DStatsBin * dest, const A2DStatsBin * src);
+double			A2DStatsMean(const A2DStatsBin * bin, int channel);
+double			A2DStatsRms(const A2DStatsBin * bin, int channel);
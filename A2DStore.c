@@ -0,0 +1,496 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "A2DStore.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DStore
+//
+//    Circular capture store for 24/7 acquisition with a fixed disk footprint
+//
+//    The file is allocated once (no block allocation while capturing) and mapped in memory.
+//    Records go straight in the page being filled. A full page gets its header and crc and
+//    the next page is used , the oldest page is dropped when the ring is full or when
+//    it is older than the retention time. The kernel writes back whole pages , in order ,
+//    nothing is rewritten until the ring comes around (no log rotation).
+//
+//    Page 0 has two head/tail markers written alternately , each with a crc. Every
+//    A2D_STORE_MARKER_PAGES pages , and at A2DStoreSync() , the other one is written. A restart takes
+//    the newest valid marker then checks the pages after its head (at most the marker interval),
+//    so the store is back in a few milliseconds without a scan of the file. A page is only used
+//    when its sequence number and crc are right , a page torn by a power loss is skipped.
+//
+//   to compile add A2DStore.c to the gcc command line with -lm
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define MARKER_OFFSET0	512		// one marker per 512 bytes sector
+#define MARKER_OFFSET1	1024
+
+static unsigned int CrcTable[256];
+
+
+static unsigned int StoreCrc(const void * data, size_t size)
+{
+  const unsigned char * p = data;
+  unsigned int crc = 0xFFFFFFFFUL;
+  unsigned int c;
+  int loop, bit;
+
+  if(CrcTable[1] == 0)
+    for(loop=0;loop<256;loop++)
+     {
+       c = loop;
+       for(bit=0;bit<8;bit++)
+         c = c & 1 ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+       CrcTable[loop] = c;
+     }
+
+  while(size--)
+    crc = CrcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFUL;
+}
+
+
+static A2DStorePage * StorePage(const A2DStore * store, unsigned long long seq)
+{
+  return (A2DStorePage *) (store->Map + (1 + seq % store->Pages) * (size_t) A2D_STORE_PAGE);
+}
+
+
+static unsigned int PageCrc(const A2DStorePage * page)
+{
+  size_t skip = offsetof(A2DStorePageHeader,Crc) + sizeof(page->Header.Crc);
+
+  return StoreCrc((const unsigned char *) page + skip,A2D_STORE_PAGE - skip);
+}
+
+
+static int PageValid(const A2DStorePage * page, unsigned long long seq)
+{
+  if(page->Header.Magic != A2D_STORE_PAGE_MAGIC) return 0;
+  if(page->Header.Seq != seq) return 0;
+  if(page->Header.Count > A2D_STORE_RECORDS) return 0;
+  return page->Header.Crc == PageCrc(page);
+}
+
+
+static A2DStoreMarker * StoreMarker(const A2DStore * store, int slot)
+{
+  return (A2DStoreMarker *) (store->Map + (slot ? MARKER_OFFSET1 : MARKER_OFFSET0));
+}
+
+
+static int MarkerValid(const A2DStoreMarker * marker)
+{
+  return (marker->Seq != 0) && (marker->Crc == StoreCrc(marker,offsetof(A2DStoreMarker,Crc)));
+}
+
+
+// write the other marker. flags: MS_ASYNC or MS_SYNC (data pages first)
+static int StoreMark(A2DStore * store, int flags)
+{
+  A2DStoreMarker * marker;
+  int rc = 0;
+
+  if((flags == MS_SYNC) && (msync(store->Map + A2D_STORE_PAGE,store->Size - A2D_STORE_PAGE,MS_SYNC) < 0))
+    rc = -1;
+
+  store->MarkerSeq++;
+  marker = StoreMarker(store,store->MarkerSeq & 1);
+  marker->Seq = store->MarkerSeq;
+  marker->Head = store->Head;
+  marker->Tail = store->Tail;
+  marker->Reserved = 0;
+  marker->Crc = StoreCrc(marker,offsetof(A2DStoreMarker,Crc));
+  store->Marked = store->Head;
+
+  if(msync(store->Map,A2D_STORE_PAGE,flags) < 0) rc = -1;
+  return rc;
+}
+
+
+// head and tail from the newest valid marker , then the pages written after it
+static void StoreRecover(A2DStore * store)
+{
+  A2DStoreMarker * marker, * other;
+  unsigned int loop;
+
+  marker = StoreMarker(store,0);
+  other = StoreMarker(store,1);
+  if(!MarkerValid(marker) || (MarkerValid(other) && (other->Seq > marker->Seq)))
+    marker = other;
+  if(MarkerValid(marker))
+    {
+      store->MarkerSeq = marker->Seq;
+      store->Head = marker->Head;
+      store->Tail = marker->Tail;
+    }
+
+  for(loop=0;loop<store->Pages;loop++)
+    {
+      if(!PageValid(StorePage(store,store->Head),store->Head)) break;
+      store->Head++;
+    }
+  if((store->Head - store->Tail) > store->Pages)
+    store->Tail = store->Head - store->Pages;
+}
+
+
+////////////////////////////////////   A2DStoreOpen
+//
+//    Open or create a store. An existing store goes on after its last valid page.
+//
+//    Inputs,
+//
+//    store:      store state
+//    filename:   store file
+//    size:       file size in bytes for a new store (rounded down to pages , 3 pages minimum).
+//                Ignored when the file exists.
+//    retention:  seconds kept , 0 = the whole ring. < 0 = keep the stored setting
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error
+//
+int A2DStoreOpen(A2DStore * store, const char * filename, unsigned long long size, double retention)
+{
+  A2DStoreSuper * super;
+  struct stat st;
+  int created = 0;
+
+  memset(store,0,sizeof(A2DStore));
+  store->Fd = open(filename,O_RDWR | O_CREAT | O_CLOEXEC,0644);
+  if(store->Fd < 0) return -1;
+  if(fstat(store->Fd,&st) < 0) goto fail;
+
+  if(st.st_size == 0)
+    {
+      size -= size % A2D_STORE_PAGE;
+      if(size < 3 * A2D_STORE_PAGE) size = 3 * A2D_STORE_PAGE;
+      if(posix_fallocate(store->Fd,0,size) != 0) goto fail;
+      created = 1;
+    }
+  else
+    size = st.st_size;
+
+  store->Size = size;
+  store->Map = mmap(NULL,store->Size,PROT_READ | PROT_WRITE,MAP_SHARED,store->Fd,0);
+  if(store->Map == MAP_FAILED)
+    {
+      store->Map = NULL;
+      goto fail;
+    }
+  super = (A2DStoreSuper *) store->Map;
+
+  if(created)
+    {
+      memcpy(super->Magic,A2D_STORE_MAGIC,4);
+      super->Version = A2D_STORE_VERSION;
+      super->PageSize = A2D_STORE_PAGE;
+      super->Pages = size / A2D_STORE_PAGE - 1;
+      super->Retention = retention > 0.0 ? retention : 0.0;
+    }
+  else if(memcmp(super->Magic,A2D_STORE_MAGIC,4) || (super->Version != A2D_STORE_VERSION) ||
+          (super->PageSize != A2D_STORE_PAGE) || ((super->Pages + 1ULL) * A2D_STORE_PAGE > size))
+    goto fail;
+
+  if(!created && (retention >= 0.0))
+    super->Retention = retention;
+  store->Pages = super->Pages;
+  store->Retention = super->Retention;
+
+  StoreRecover(store);
+  if(StoreMark(store,MS_SYNC) < 0) goto fail;
+  return 0;
+
+fail:
+  if(store->Map) munmap(store->Map,store->Size);
+  close(store->Fd);
+  store->Map = NULL;
+  store->Fd = -1;
+  return -1;
+}
+
+
+////////////////////////////////////   A2DStoreOpenRead
+//
+//    Open a store to read , a capture could still write it. Nothing is written.
+//    The pages kept are the ones at the open , a page overwritten since then is not valid.
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error or not a store
+//
+int A2DStoreOpenRead(A2DStore * store, const char * filename)
+{
+  A2DStoreSuper * super;
+  struct stat st;
+
+  memset(store,0,sizeof(A2DStore));
+  store->ReadOnly = 1;
+  store->Fd = open(filename,O_RDONLY | O_CLOEXEC);
+  if(store->Fd < 0) return -1;
+  if((fstat(store->Fd,&st) < 0) || (st.st_size < 3 * A2D_STORE_PAGE)) goto fail;
+
+  store->Size = st.st_size;
+  store->Map = mmap(NULL,store->Size,PROT_READ,MAP_SHARED,store->Fd,0);
+  if(store->Map == MAP_FAILED)
+    {
+      store->Map = NULL;
+      goto fail;
+    }
+  super = (A2DStoreSuper *) store->Map;
+  if(memcmp(super->Magic,A2D_STORE_MAGIC,4) || (super->Version != A2D_STORE_VERSION) ||
+     (super->PageSize != A2D_STORE_PAGE) || ((super->Pages + 1ULL) * A2D_STORE_PAGE > store->Size))
+    goto fail;
+  store->Pages = super->Pages;
+  store->Retention = super->Retention;
+  StoreRecover(store);
+  return 0;
+
+fail:
+  if(store->Map) munmap(store->Map,store->Size);
+  close(store->Fd);
+  store->Map = NULL;
+  store->Fd = -1;
+  return -1;
+}
+
+
+// finish the page being filled , drop the pages out of the retention time
+static int StoreSeal(A2DStore * store)
+{
+  A2DStorePage * page = store->Current;
+  A2DStorePage * oldest;
+  double newest;
+
+  // unused records are zero , the crc doesn't depend on data of the previous ring
+  memset(&page->Record[page->Header.Count],0,(A2D_STORE_RECORDS - page->Header.Count) * sizeof(A2DStoreRecord));
+  page->Header.Magic = A2D_STORE_PAGE_MAGIC;
+  page->Header.Crc = PageCrc(page);
+  newest = page->Header.Time + page->Header.Count * page->Header.Period;
+  store->Current = NULL;
+  store->Head++;
+
+  if(store->Retention > 0.0)
+    while(store->Tail < store->Head)
+     {
+       oldest = StorePage(store,store->Tail);
+       if(PageValid(oldest,store->Tail) &&
+          ((oldest->Header.Time + oldest->Header.Count * oldest->Header.Period) >= (newest - store->Retention)))
+         break;
+       store->Tail++;
+     }
+
+  if((store->Head - store->Marked) >= A2D_STORE_MARKER_PAGES)
+    return StoreMark(store,MS_ASYNC);
+  return 0;
+}
+
+
+////////////////////////////////////   A2DStoreAppend
+//
+//    Append a decoded block
+//
+//    Inputs,
+//
+//    store:   store state
+//    block:   decoded samples
+//    time:    host time of the first sample , seconds since the epoch
+//    period:  seconds between two samples. A page holds samples at a regular period ,
+//             a block that doesn't follow the page (gap or new period) starts a new page
+//
+//    Return,
+//
+//    0   ok
+//    < 0 error (the marker update failed)
+//
+int A2DStoreAppend(A2DStore * store, const A2DBlock * block, double time, double period)
+{
+  A2DStorePage * page;
+  A2DStoreRecord * record;
+  double t;
+  int rc = 0;
+  int loop;
+
+  if((store->Map == NULL) || store->ReadOnly) return -1;
+
+  for(loop=0;loop<block->Count;loop++)
+   {
+     t = time + loop * period;
+     page = store->Current;
+     if(page && ((page->Header.Count >= A2D_STORE_RECORDS) || (page->Header.Period != period) ||
+                 (fabs(page->Header.Time + page->Header.Count * period - t) > (period / 2.0))))
+       if(StoreSeal(store) < 0) rc = -1;
+
+     if(store->Current == NULL)
+       {
+         // the ring is full , the oldest page is overwritten
+         if((store->Head - store->Tail) >= store->Pages)
+           store->Tail = store->Head - store->Pages + 1;
+         page = StorePage(store,store->Head);
+         memset(&page->Header,0,sizeof(page->Header));
+         page->Header.Seq = store->Head;
+         page->Header.Time = t;
+         page->Header.Period = period;
+         store->Current = page;
+       }
+
+     page = store->Current;
+     record = &page->Record[page->Header.Count++];
+     record->A0 = block->A0[loop];
+     record->A1 = block->A1[loop];
+     record->Overrun = block->Overrun[loop];
+     record->Flags = block->Flags[loop];
+     record->Reserved = 0;
+     record->Time = block->Time[loop];
+   }
+  return rc;
+}
+
+
+////////////////////////////////////   A2DStoreSync
+//
+//    Finish the page being filled (even if not full) , write the marker and wait
+//    until the data and the marker are on the disk. A point to come back to after a crash.
+//
+int A2DStoreSync(A2DStore * store)
+{
+  int rc = 0;
+
+  if((store->Map == NULL) || store->ReadOnly) return -1;
+  if(store->Current)
+    if(StoreSeal(store) < 0) rc = -1;
+  if(StoreMark(store,MS_SYNC) < 0) rc = -1;
+  return rc;
+}
+
+
+////////////////////////////////////   A2DStoreClose
+//
+int A2DStoreClose(A2DStore * store)
+{
+  int rc;
+
+  if(store->Map == NULL) return -1;
+  rc = store->ReadOnly ? 0 : A2DStoreSync(store);
+  munmap(store->Map,store->Size);
+  if(close(store->Fd) < 0) rc = -1;
+  store->Map = NULL;
+  store->Fd = -1;
+  return rc;
+}
+
+
+////////////////////////////////////   A2DStorePageGet
+//
+//    Inputs,
+//
+//    store:   store state
+//    seq:     page sequence number , Tail .. Head - 1
+//
+//    Return,
+//
+//    the page in the map , valid until the ring comes around
+//    NULL = not kept or torn
+//
+const A2DStorePage * A2DStorePageGet(const A2DStore * store, unsigned long long seq)
+{
+  const A2DStorePage * page;
+
+  if((store->Map == NULL) || (seq < store->Tail) || (seq >= store->Head)) return NULL;
+  page = StorePage(store,seq);
+  return PageValid(page,seq) ? page : NULL;
+}
+
+
+// first valid page from seq , Head if none
+static unsigned long long StoreNextValid(const A2DStore * store, unsigned long long seq)
+{
+  while((seq < store->Head) && (A2DStorePageGet(store,seq) == NULL))
+    seq++;
+  return seq;
+}
+
+
+////////////////////////////////////   A2DStoreFind
+//
+//    Binary search of the page holding a time
+//
+//    Inputs,
+//
+//    store:   store state
+//    time:    seconds since the epoch
+//
+//    Return,
+//
+//    sequence number of the last page starting at or before time ,
+//    the first page if time is before it
+//    < 0 the store is empty
+//
+long long A2DStoreFind(const A2DStore * store, double time)
+{
+  unsigned long long low, high, mid, seq;
+  long long found;
+
+  low = StoreNextValid(store,store->Tail);
+  if(low >= store->Head) return -1;
+  found = low;
+  high = store->Head;
+
+  while(low < high)
+   {
+     mid = low + (high - low) / 2;
+     seq = StoreNextValid(store,mid);
+     if(seq >= high)
+       {
+         high = mid;
+         continue;
+       }
+     if(StorePage(store,seq)->Header.Time <= time)
+       {
+         found = seq;
+         low = seq + 1;
+       }
+     else
+       high = mid;
+   }
+  return found;
+}
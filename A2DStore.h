@@ -0,0 +1,78 @@
+#pragma once
+
+#include "A2DStream.h"
+
+// circular capture store. A preallocated file mapped in memory:
+// page 0 holds the settings and two head/tail markers , then Pages data pages used in a ring.
+// Each data page has a header with its sequence number and a crc , then the sample records.
+// Page sequence numbers never wrap , page N is at file page 1 + N % Pages
+
+#define A2D_STORE_PAGE		4096
+#define A2D_STORE_MAGIC		"A2DR"
+#define A2D_STORE_PAGE_MAGIC	0x50443241UL	// "A2DP"
+#define A2D_STORE_VERSION	1
+#define A2D_STORE_MARKER_PAGES	64		// pages between two marker updates
+
+typedef struct{
+  unsigned short A0;
+  unsigned short A1;
+  unsigned char  Overrun;
+  unsigned char  Flags;
+  unsigned short Reserved;
+  unsigned long long Time;	// device stamp (A2D_FLAG_STAMP)
+}A2DStoreRecord;
+
+typedef struct{
+  unsigned int   Magic;		// A2D_STORE_PAGE_MAGIC
+  unsigned int   Crc;		// crc32 of the page after this field
+  unsigned long long Seq;
+  double         Time;		// host time of the first record , seconds since the epoch
+  double         Period;	// seconds between two records
+  unsigned short Count;
+  unsigned char  Reserved[14];
+}A2DStorePageHeader;
+
+#define A2D_STORE_RECORDS	((A2D_STORE_PAGE - sizeof(A2DStorePageHeader)) / sizeof(A2DStoreRecord))
+
+typedef struct{
+  A2DStorePageHeader Header;
+  A2DStoreRecord     Record[A2D_STORE_RECORDS];
+}A2DStorePage;
+
+typedef struct{
+  unsigned long long Seq;	// marker update number , the highest valid one is used
+  unsigned long long Head;	// next page to write
+  unsigned long long Tail;	// oldest page kept
+  unsigned int   Crc;
+  unsigned int   Reserved;
+}A2DStoreMarker;
+
+typedef struct{
+  char           Magic[4];
+  unsigned int   Version;
+  unsigned int   PageSize;
+  unsigned int   Pages;		// data pages
+  double         Retention;	// seconds , 0 = the file size only
+}A2DStoreSuper;
+
+typedef struct{
+  int            Fd;
+  unsigned char * Map;
+  size_t         Size;
+  unsigned int   Pages;
+  double         Retention;
+  unsigned long long Head;	// page being filled
+  unsigned long long Tail;
+  unsigned long long MarkerSeq;
+  unsigned long long Marked;	// Head at the last marker update
+  A2DStorePage * Current;	// NULL = no page open
+  int            ReadOnly;	// A2DStoreOpenRead , the head is where it was at the open
+}A2DStore;
+
+int			A2DStoreOpen(A2DStore * store, const char * filename, unsigned long long size, double retention);
+int			A2DStoreOpenRead(A2DStore * store, const char * filename);
+int			A2DStoreAppend(A2DStore * store, const A2DBlock * block, double time, double period);
+int			A2DStoreSync(A2DStore * store);
+int			A2DStoreClose(A2DStore * store);
+const A2DStorePage *	A2DStorePageGet(const A2DStore * store, unsigned long long seq);
+long long		A2DStoreFind(const A2DStore * store, double time);
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include "I2CWrapper.h"
+#include "A2DStream.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DStream
+//
+//    Decode the A/D fifo records into sample blocks
+//
+//   to compile add A2DStream.c to the gcc command line
+//
+//     gcc -o A2DTest  A2DTest.c I2CWrapper.c A2DStream.c
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+////////////////////////////////////   A2DDecodeEvents
+//
+//    Append command 03 records to a block
+//
+//    Inputs,
+//
+//    record:  records read with A2DReadData
+//    n:       number of records
+//    block:   destination block
+//
+//    Return,
+//
+//    number of samples added. Underrun records (Valid=0) are skipped.
+//
+int A2DDecodeEvents(const EventAnalog * record, int n, A2DBlock * block)
+{
+  int loop;
+  int idx;
+  unsigned char flags;
+
+  idx = block->Count;
+
+  for(loop=0;loop<n;loop++,record++)
+   {
+     if(!record->Valid) continue;
+     if(idx >= A2D_BLOCK_SIZE) break;
+
+     flags = A2D_FLAG_VALID;
+     if(record->Inside0) flags |= A2D_FLAG_INSIDE0;
+     if(record->Inside1) flags |= A2D_FLAG_INSIDE1;
+     if(record->Event)   flags |= A2D_FLAG_EVENT;
+
+     block->A0[idx]= record->A0;
+     block->A1[idx]= record->A1;
+     block->Overrun[idx]= record->Overrun;
+     block->Flags[idx]= flags;
+     idx++;
+   }
+
+  loop = idx - block->Count;
+  block->Count = idx;
+  return loop;
+}
+
+
+////////////////////////////////////   A2DReadEvents
+//
+//    Drain the device fifo into a block.
+//    In event capture mode (command 10) the fifo only holds the window
+//    transitions and their context, so this is the event stream.
+//    Samples with A2D_FLAG_EVENT set are the transitions.
+//
+//    Inputs,
+//
+//    handle:  IO handle
+//    block:   destination block. Samples are appended until the block is full.
+//
+//    Return,
+//
+//    number of samples added
+//    < 0 error
+//
+int A2DReadEvents(int handle, A2DBlock * block)
+{
+  EventAnalog record[7];		// max for command 03 is 7 ( 7 * 4==28) < 32
+  int count;
+  int n;
+  int total=0;
+
+  count = A2DReadDataCount(handle);
+  if(count < 0) return -1;
+
+  while((count > 0) && (block->Count < A2D_BLOCK_SIZE))
+   {
+     n = count > 7 ? 7 : count;
+     if(n > (A2D_BLOCK_SIZE - block->Count))
+        n = A2D_BLOCK_SIZE - block->Count;
+
+     if(A2DReadData(handle,n,record) < 0) return -1;
+     total += A2DDecodeEvents(record,n,block);
+     count -= n;
+   }
+  return total;
+}
+
+
+////////////////////////////////////   A2DDecodeDense
+//
+//    Append single channel records (command 13 , read with command 04) to a block.
+//    Each record hold two successive samples of the same channel.
+//
+//    Inputs,
+//
+//    record:  records read with A2DReadPackData
+//    n:       number of records
+//    channel: A2D_CHANNEL_A0 or A2D_CHANNEL_A1 , select which block array receive the samples
+//    block:   destination block
+//
+//    Return,
+//
+//    number of samples added. Underrun records (Valid=0) are skipped.
+//    The overrun count (in records) goes on the first sample of the record.
+//
+int A2DDecodeDense(const DensePackAnalog * record, int n, int channel, A2DBlock * block)
+{
+  int loop;
+  int idx;
+  unsigned short * samples;
+  unsigned short * other;
+
+  if(channel == A2D_CHANNEL_A1)
+   {
+     samples = block->A1;
+     other   = block->A0;
+   }
+  else
+   {
+     samples = block->A0;
+     other   = block->A1;
+   }
+
+  idx = block->Count;
+
+  for(loop=0;loop<n;loop++,record++)
+   {
+     if(!record->Valid) continue;
+     if(idx > (A2D_BLOCK_SIZE-2)) break;
+
+     samples[idx]= record->S0;
+     other[idx]= 0;
+     block->Overrun[idx]= record->Overrun;
+     block->Flags[idx]= A2D_FLAG_VALID;
+     idx++;
+     samples[idx]= record->S1;
+     other[idx]= 0;
+     block->Overrun[idx]= 0;
+     block->Flags[idx]= A2D_FLAG_VALID;
+     idx++;
+   }
+
+  loop = idx - block->Count;
+  block->Count = idx;
+  return loop;
+}
+
+
+////////////////////////////////////   A2DReadDense
+//
+//    Drain the device fifo in single channel mode into a block.
+//    Use the packed command (10 records = 20 samples per transaction).
+//
+//    Inputs,
+//
+//    handle:  IO handle
+//    channel: A2D_CHANNEL_A0 or A2D_CHANNEL_A1
+//    block:   destination block. Samples are appended until the block is full.
+//
+//    Return,
+//
+//    number of samples added
+//    < 0 error
+//
+int A2DReadDense(int handle, int channel, A2DBlock * block)
+{
+  DensePackAnalog record[10];		// max for packdata  is 10 ( 10 * 3 ==30) < 32
+  int count;
+  int n;
+  int total=0;
+
+  count = A2DReadDataCount(handle);
+  if(count < 0) return -1;
+
+  while((count > 0) && ((A2D_BLOCK_SIZE - block->Count) >= 2))
+   {
+     n = count > 10 ? 10 : count;
+     if((n * 2) > (A2D_BLOCK_SIZE - block->Count))
+        n = (A2D_BLOCK_SIZE - block->Count) / 2;
+
+     if(A2DReadPackData(handle,n,record) < 0) return -1;
+     total += A2DDecodeDense(record,n,channel,block);
+     count -= n;
+   }
+  return total;
+}
+
+
+////////////////////////////////////   A2DStampUnwrap
+//
+//    Extend a 24 bits device stamp to 64 bits.
+//    Without A2DStampClock() the stamps are only right when the fifo is read at least once
+//    per stamp wrap (16.7 sec in trigger and single mode , 4.6 hours at 1K samples/sec in
+//    timer mode). A quiet trigger input longer than that loses whole wraps.
+//    With the tick period the host monotonic clock since the last stamp gives the number
+//    of wraps , the read latency has to stay under half a wrap.
+//
+//    Inputs,
+//
+//    state:   stamp state , cleared with A2DStampInit() when the acquisition start
+//    stamp:   24 bits stamp
+//
+//    Return,
+//
+//    unwrapped stamp
+//
+unsigned long long A2DStampUnwrap(A2DStampState * state, unsigned long stamp)
+{
+  struct timespec now;
+  unsigned long long ticks;
+  unsigned long delta;
+  double host;
+
+  delta = (stamp - (unsigned long) state->Last) & 0xffffff;
+  if(state->Tick > 0.0)
+    {
+      clock_gettime(CLOCK_MONOTONIC,&now);
+      host = now.tv_sec + now.tv_nsec / 1.0e9;
+      if((state->Host > 0.0) && (host > state->Host))
+        {
+          // the wraps that bring delta the nearest to the host time
+          ticks = (unsigned long long) ((host - state->Host) / state->Tick);
+          if(ticks > (delta + 0x800000ULL))
+            state->Last += (ticks - delta + 0x800000ULL) & ~0xffffffULL;
+        }
+      state->Host = host;
+    }
+  state->Last += delta;
+  return state->Last;
+}
+
+
+////////////////////////////////////   A2DDecodeStamped
+//
+//    Append command 03 records with timestamps (command 15) to a block.
+//    Each data record is followed by its stamp record. A data record at the end
+//    of one read is kept in the state until its stamp comes with the next read.
+//
+//    Inputs,
+//
+//    state:   stamp state
+//    record:  records read with A2DReadData
+//    n:       number of records
+//    block:   destination block
+//
+//    Return,
+//
+//    number of samples added. Underrun records (Valid=0) are skipped.
+//
+int A2DDecodeStamped(A2DStampState * state, const EventAnalog * record, int n, A2DBlock * block)
+{
+  int loop;
+  int idx;
+  unsigned char flags;
+  const StampAnalog * stamp;
+
+  idx = block->Count;
+  for(loop=0;loop<n;loop++,record++)
+   {
+     if(!record->Valid) continue;
+     if(!state->Pending)
+      {
+        state->Data = *record;
+        state->Pending=1;
+        continue;
+      }
+     state->Pending=0;
+     if(idx >= A2D_BLOCK_SIZE) break;
+     stamp = (const StampAnalog *) record;
+     flags = A2D_FLAG_VALID | A2D_FLAG_STAMP;
+     if(state->Data.Inside0) flags |= A2D_FLAG_INSIDE0;
+     if(state->Data.Inside1) flags |= A2D_FLAG_INSIDE1;
+     if(state->Data.Event)   flags |= A2D_FLAG_EVENT;
+     block->A0[idx]= state->Data.A0;
+     block->A1[idx]= state->Data.A1;
+     block->Overrun[idx]= state->Data.Overrun;
+     block->Flags[idx]= flags;
+     block->Time[idx]= A2DStampUnwrap(state,((unsigned long) stamp->High << 16) | stamp->Low);
+     idx++;
+   }
+  loop = idx - block->Count;
+  block->Count = idx;
+  return loop;
+}
+
+
+////////////////////////////////////   A2DReadStamped
+//
+//    Drain the device fifo with timestamps (command 15) into a block.
+//
+//    Inputs,
+//
+//    handle:  IO handle
+//    state:   stamp state
+//    block:   destination block. Samples are appended until the block is full.
+//
+//    Return,
+//
+//    number of samples added
+//    < 0 error
+//
+int A2DReadStamped(int handle, A2DStampState * state, A2DBlock * block)
+{
+  EventAnalog record[7];		// max for command 03 is 7 ( 7 * 4==28) < 32
+  int count;
+  int n;
+  int room;
+  int total=0;
+
+  count = A2DReadDataCount(handle);
+  if(count < 0) return -1;
+  while(count > 0)
+   {
+     // two records per sample , do not read more than the block could take
+     room = (A2D_BLOCK_SIZE - block->Count) * 2 - state->Pending;
+     if(room <= 0) break;
+     n = count > 7 ? 7 : count;
+     if(n > room) n = room;
+     if(A2DReadData(handle,n,record) < 0) return -1;
+     total += A2DDecodeStamped(state,record,n,block);
+     count -= n;
+   }
+  return total;
+}
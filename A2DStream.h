@@ -0,0 +1,50 @@
+#pragma once
+
+#include "I2C_A2D.h"
+
+// decoded samples are kept in blocks, one array per field
+
+#define A2D_BLOCK_SIZE		64
+
+#define A2D_FLAG_VALID		1
+#define A2D_FLAG_INSIDE0	2
+#define A2D_FLAG_INSIDE1	4
+#define A2D_FLAG_EVENT		8
+#define A2D_FLAG_STAMP		16	// Time is valid
+
+// stamp tick: sample number in timer mode , 1us in trigger and single mode
+
+typedef struct{
+  int            Count;
+  unsigned short A0[A2D_BLOCK_SIZE];
+  unsigned short A1[A2D_BLOCK_SIZE];
+  unsigned char  Overrun[A2D_BLOCK_SIZE];
+  unsigned char  Flags[A2D_BLOCK_SIZE];
+  unsigned long long Time[A2D_BLOCK_SIZE];
+}A2DBlock;
+
+// the device stamp is 24 bits. The host keeps the upper bits. Without a tick period the
+// fifo has to be read once per wrap , with it the host clock gives the wraps of a long gap.
+
+typedef struct{
+  unsigned long long Last;	// last unwrapped stamp
+  int            Pending;	// 1 = Data is waiting for its stamp record
+  EventAnalog    Data;
+  double         Tick;		// seconds per stamp tick , 0 = unknown
+  double         Host;		// host monotonic time of the last stamp , seconds
+}A2DStampState;
+
+#define A2DStampInit(STATE)	((STATE)->Last=0,(STATE)->Pending=0,(STATE)->Tick=0.0,(STATE)->Host=0.0)
+
+// 1us in trigger and single mode , the sample period in timer mode
+#define A2DStampClock(STATE,TICK)	((STATE)->Tick=(TICK))
+
+#define A2DBlockClear(BLOCK)	((BLOCK)->Count=0)
+
+int			A2DDecodeEvents(const EventAnalog * record, int n, A2DBlock * block);
+int			A2DReadEvents(int handle, A2DBlock * block);
+int			A2DDecodeDense(const DensePackAnalog * record, int n, int channel, A2DBlock * block);
+int			A2DReadDense(int handle, int channel, A2DBlock * block);
+unsigned long long	A2DStampUnwrap(A2DStampState * state, unsigned long stamp);
+int			A2DDecodeStamped(A2DStampState * state, const EventAnalog * record, int n, A2DBlock * block);
+int			A2DReadStamped(int handle, A2DStampState * state, A2DBlock * block);
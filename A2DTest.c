@@ -1,10 +1,26 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <sys/time.h>
 #include <math.h>
+#include <sys/resource.h>
 #include "I2CWrapper.h"
 #include "I2C_A2D.h"
+#include "A2DStream.h"
+#include "GPIOEvent.h"
+#include "A2DDevice.h"
+#include "A2DSingle.h"
+#include "A2DPacer.h"
+#include "A2DCalib.h"
+#include "A2DFilter.h"
+#include "A2DStats.h"
+#include "A2DStore.h"
+#include "A2DArchive.h"
+#include "A2DQuery.h"
+#include "A2DShm.h"
+#include "A2DMerge.h"
+#include <sys/wait.h>
 
 
 ////////////////////////////////////////////
@@ -13,7 +29,7 @@
 //    on raspberry pi I2C bus
 //    to compile
 //    
-//     gcc -o A2DTest  A2DTest.c I2CWrapper.c
+//     gcc -o A2DTest  A2DTest.c I2CWrapper.c A2DStream.c GPIOEvent.c A2DDevice.c A2DSingle.c A2DPacer.c A2DCalib.c A2DFilter.c A2DStats.c A2DStore.c A2DShm.c A2DMerge.c A2DArchive.c A2DQuery.c -O2 -lm
 //
 //
 //   programmer : Daniel Perron
@@ -143,14 +159,48 @@ printf("\n--------  Find single shot Fastest speed \n");fflush(stdout);
 }
 
 
+void TestSingleShotPipeline(int handle)
+{
+  int loop;
+  int valid=0;
+  PackAnalog  packdata = {0};
+  A2DSingle   single;
+
+printf("\n--------  Pipelined single shot (read previous + start next in one transaction)\n");fflush(stdout);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DSingleInit(&single,handle,0x20);
+
+  gettimeofday (&start, NULL) ;
+  for(loop=0;loop<2000;loop++)
+     if(A2DSingleShot(&single,&packdata)==1) valid++;
+  gettimeofday (&end, NULL) ;
+  timersub (&end, &start, &total) ;
+  elapse = TIMEVAL_CV(total);
+  printf("Pipelined  average samples/sec = %f  valid=%d  miss=%lu  conversion wait=%luus\n",
+         valid/elapse,valid,single.Misses,single.ConversionUs);
+  printf("Last       A0 : %4d      A1 : %4d\n",packdata.A0,packdata.A1);
+
+  // control loop at 1Khz , sample never older than 500us
+  valid=0;
+  for(loop=0;loop<100;loop++)
+    {
+      if(A2DSingleLatest(&single,&packdata,500)==1) valid++;
+      usleep(1000);
+    }
+  printf("Latest 500us  %d/100 valid\n",valid);
+  A2DMode(handle,A2D_MODE_OFF);
+}
+
+
 
 
   void TestTimerMode(int handle)
 {
-  int loop;
   UnpackAnalog unpackanalog[40];  // 40 samples possible in buffer
-
-  unsigned int nsample,totsample,tempsample,isample;
+  A2DPacer pacer;
+  int tempsample,isample;
+  unsigned int nsample,totsample;
   double delta;
   printf("\n--------------- Test timer mode\n");
 
@@ -161,23 +211,20 @@ printf("\n--------  Find single shot Fastest speed \n");fflush(stdout);
   A2DTimer(handle,10);
 
   A2DMode(handle,A2D_MODE_TIMER); // start timer mode
+  if(A2DPacerOpen(&pacer,handle,7) < 0) return;   // wake up when 7 samples are in
 
   gettimeofday (&start, NULL) ;
   totsample=0;
   nsample=0;
   delta=0;
    do {
-        tempsample = A2DReadDataCount(handle);
-        isample=0;
-
-        if(tempsample > 1)
-         {
-            if(tempsample>7)
-                isample=7;
-               else
-                isample=tempsample;
-			A2DReadData(handle,isample,unpackanalog);  // max for isample is 7 ( 7 * 4==28) < 32
-         }
+        tempsample = A2DPacerWait(&pacer);     // sleep instead of polling the count
+        if(tempsample < 0) break;
+        isample = tempsample > 7 ? 7 : tempsample;
+        if(isample)
+           A2DReadData(handle,isample,unpackanalog);  // max for isample is 7 ( 7 * 4==28) < 32
+        if(tempsample > isample)
+           A2DPacerLeft(&pacer,tempsample - isample);
         nsample+=isample;
         gettimeofday(&end,NULL);
         timersub(&end,&start,&total);
@@ -192,10 +239,154 @@ printf("\n--------  Find single shot Fastest speed \n");fflush(stdout);
      }
   } while (elapse  < 10.5);
 
+A2DPacerClose(&pacer);
 A2DMode(handle,A2D_MODE_OFF); 
 }
 
 
+// one 1K samples/sec run. fill=0 polls the count like the old loops
+static void PacerBenchmarkRun(int handle, int fill)
+{
+  UnpackAnalog unpackanalog[7];
+  A2DPacer pacer;
+  struct rusage usage;
+  double cpu_start,cpu;
+  unsigned long totsample=0;
+  unsigned long queries=0;
+  unsigned long reads=0;
+  int count,n;
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+  A2DMode(handle,A2D_MODE_TIMER);
+  if(fill)
+    if(A2DPacerOpen(&pacer,handle,fill) < 0) return;
+
+  getrusage(RUSAGE_SELF,&usage);
+  cpu_start = TIMEVAL_CV(usage.ru_utime) + TIMEVAL_CV(usage.ru_stime);
+  gettimeofday (&start, NULL) ;
+   do {
+        count = fill ? A2DPacerWait(&pacer) : A2DReadDataCount(handle);
+        if(count < 0) break;
+        queries++;
+        while(count > 0)
+          {
+            n = count > 7 ? 7 : count;
+            A2DReadData(handle,n,unpackanalog);
+            reads++;
+            totsample+=n;
+            count-=n;
+          }
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+  } while (elapse  < 10.0);
+
+  getrusage(RUSAGE_SELF,&usage);
+  cpu = TIMEVAL_CV(usage.ru_utime) + TIMEVAL_CV(usage.ru_stime) - cpu_start;
+  A2DMode(handle,A2D_MODE_OFF);
+
+  if(fill)
+    printf("paced fill=%-2d ",fill);
+  else
+    printf("count polling ");
+  printf("%6.0f samples/sec  cpu %5.1f%%  count reads/sample %.3f  transactions/sample %.3f",
+         totsample/elapse,cpu*100.0/elapse,(double)queries/totsample,(double)(queries+reads)/totsample);
+  if(fill)
+    {
+      printf("  fifo full %lu\n",pacer.Full);
+      A2DPacerClose(&pacer);
+    }
+  else
+    printf("\n");
+  fflush(stdout);
+}
+
+
+// 5K samples/sec , 20 records per wake up with the real-time setting , then the histograms
+void TestRealTimePacer(int handle)
+{
+  UnpackAnalog unpackanalog[7];
+  A2DPacer pacer;
+  int count,n;
+  unsigned int overrun=0;
+
+  printf("\n--------------- Real-time pacer at 5K samples/sec , fill 20\n");fflush(stdout);
+
+  // last cpu , away from the cpu 0 interrupts
+  if(A2DPacerRealTime(50,sysconf(_SC_NPROCESSORS_ONLN) - 1) < 0)
+     printf("Real-time setting failed (need root) , running without it\n");
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,2);
+  A2DMode(handle,A2D_MODE_TIMER);
+  if(A2DPacerOpen(&pacer,handle,20) < 0) return;
+
+  gettimeofday (&start, NULL) ;
+   do {
+        count = A2DPacerWait(&pacer);
+        if(count < 0) break;
+        while(count > 0)
+          {
+            n = count > 7 ? 7 : count;
+            A2DReadData(handle,n,unpackanalog);
+            if(unpackanalog[0].Overrun) overrun++;
+            count-=n;
+          }
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+  } while (elapse  < 10.0);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DPacerReport(&pacer);
+  printf("records with overrun %u\n",overrun);
+  A2DPacerClose(&pacer);
+}
+
+
+void TestPacerBenchmark(int handle)
+{
+  printf("\n--------------- Count polling against timerfd pacing at 1K samples/sec\n");fflush(stdout);
+  PacerBenchmarkRun(handle,0);
+  PacerBenchmarkRun(handle,7);
+  PacerBenchmarkRun(handle,20);
+  PacerBenchmarkRun(handle,30);
+}
+
+
+// stamp record at 1K samples/sec , the reader is 30ms late on every other wake up.
+// The fifo is full at 38 records , each late wake up must be seen as full
+void TestPacerLateReader(int handle)
+{
+  A2DPacer pacer;
+  A2DBlock block;
+  A2DStampState state;
+  int loop;
+
+  printf("\n--------------- Paced stamp reads , reader 30ms late every other wake up\n");fflush(stdout);
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+  A2DRecordOptions(handle,A2D_RECORD_STAMP);
+  A2DMode(handle,A2D_MODE_TIMER);
+  A2DStampInit(&state);
+  if(A2DPacerOpen(&pacer,handle,10) < 0) return;
+
+  for(loop=0;loop<20;loop++)
+    {
+      if(loop & 1) usleep(30000);
+      if(A2DPacerWait(&pacer) < 0) break;
+      A2DBlockClear(&block);
+      A2DReadStamped(handle,&state,&block);
+    }
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DRecordOptions(handle,0);
+  printf("capacity %d  fifo full %lu of %d late wake ups  max count %d\n",pacer.Capacity,pacer.Full,loop/2,pacer.FillMax);
+  A2DPacerClose(&pacer);
+}
+
+
 
 double  CalculateTimerRate(int handle,signed char osc)
 {
@@ -455,6 +646,858 @@ A2DMode(handle,A2D_MODE_OFF);
 }
 
 
+void  TestEventMode(int handle)
+{
+// 1000 samples/sec but only the window transitions
+// and 2 samples before / 2 samples after are stored in the fifo
+
+  A2DBlock block;
+  A2D_Window window;
+  int loop;
+  unsigned int nevent=0;
+  unsigned int nsample=0;
+
+  printf("\n--------------- Test Event capture mode\n");
+  printf("Window 200..800 on A0 and A1,  pre-context 2, post-context 2\n");
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+
+  window.A0Low=200;
+  window.A0High=800;
+  window.A1Low=200;
+  window.A1High=800;
+  A2DSetWindow(handle,&window);
+  A2DEventControl(handle,A2D_EVENT_A0 | A2D_EVENT_A1 | A2D_EVENT_PRE(2) | A2D_EVENT_POST(2));
+
+  A2DMode(handle,A2D_MODE_TIMER); // start timer mode
+
+  gettimeofday (&start, NULL) ;
+   do {
+        A2DBlockClear(&block);
+        A2DReadEvents(handle,&block);
+        for(loop=0;loop<block.Count;loop++)
+         {
+           nsample++;
+           if(block.Flags[loop] & A2D_FLAG_EVENT)
+            {
+              nevent++;
+              printf("Event A0 : %4d %s   A1 : %4d %s\n",block.A0[loop],\
+                      block.Flags[loop] & A2D_FLAG_INSIDE0 ? "in " : "out",\
+                      block.A1[loop], block.Flags[loop] & A2D_FLAG_INSIDE1 ? "in " : "out");
+              fflush(stdout);
+            }
+         }
+        usleep(10000);
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+  } while (elapse  < 10.5);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DEventControl(handle,A2D_EVENT_OFF);
+
+  printf("%d events  %d samples transfered instead of %.0f\n",nevent,nsample,elapse*1000.0);
+}
+
+
+void  TestCalibration(int handle)
+{
+// 1000 samples/sec , one block in volts with the stored calibration of 0x20
+
+  A2DBlock block;
+  A2DCalib calib;
+  float volt0[A2D_BLOCK_SIZE];
+  float volt1[A2D_BLOCK_SIZE];
+  int loop;
+
+  printf("\n--------------- Calibrated units\n");
+
+  loop = A2DCalibLoad(&calib,0x20,NULL);
+  if(loop < 0)
+   {
+     printf("Invalid %s\n",A2D_CALIB_FILE);
+     return;
+   }
+  printf("%s : A0 offset %.2f gain %g   A1 offset %.2f gain %g\n",loop == 0 ? A2D_CALIB_FILE : "default",
+         calib.Channel[0].Offset,calib.Channel[0].Gain,calib.Channel[1].Offset,calib.Channel[1].Gain);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+  A2DMode(handle,A2D_MODE_TIMER);
+  usleep(20000);
+
+  A2DBlockClear(&block);
+  A2DReadEvents(handle,&block);
+  A2DMode(handle,A2D_MODE_OFF);
+
+  A2DCalibBlock(&calib,&block,volt0,volt1);
+  for(loop=0;loop<block.Count;loop++)
+    printf("A0 : %4d %7.4f    A1 : %4d %7.4f\n",block.A0[loop],volt0[loop],block.A1[loop],volt1[loop]);
+  A2DCalibFree(&calib);
+}
+
+
+void  TestFilteredStream(int handle)
+{
+// 5000 samples/sec timer mode , A0 decimated to 50 samples/sec then smoothed by a 5Hz lowpass
+// the fifo reads are paced by A2DPacer
+
+  A2DBlock block;
+  A2DPacer pacer;
+  A2DFir fir;
+  A2DBiquad smooth;
+  float coeff[255];
+  float out[A2D_BLOCK_SIZE];
+  unsigned char flags[A2D_BLOCK_SIZE];
+  unsigned long nsample=0;
+  unsigned long nout=0;
+  int count,n,loop;
+
+  printf("\n--------------- 5K samples/sec A0 filtered to 50 samples/sec\n");fflush(stdout);
+
+  A2DFirLowpass(coeff,255,0.4 / 100);
+  if(A2DFirInit(&fir,coeff,255,100) < 0) return;
+  A2DBiquadInit(&smooth);
+  A2DBiquadLowpass(&smooth,50.0,5.0,0.7071);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,2);
+  A2DMode(handle,A2D_MODE_TIMER);
+  if(A2DPacerOpen(&pacer,handle,20) < 0) return;
+
+  gettimeofday (&start, NULL) ;
+   do {
+        count = A2DPacerWait(&pacer);
+        if(count < 0) break;
+        while(count > 0)
+          {
+            A2DBlockClear(&block);
+            if(A2DReadEvents(handle,&block) < 0) break;
+            if(block.Count == 0) break;
+            count -= block.Count;
+            nsample += block.Count;
+            n = A2DFirBlock(&fir,&block,0,NULL,out,flags);
+            A2DBiquadProcess(&smooth,out,flags,n,out);
+            for(loop=0;loop<n;loop++,nout++)
+              if((nout % 50) == 0)
+                printf("%6lu  A0 %8.2f %s\n",nout,out[loop],flags[loop] & A2D_FILTER_GAP ? "gap" : "");
+          }
+        A2DPacerLeft(&pacer,count);
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+  } while (elapse  < 10.0);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DPacerClose(&pacer);
+  printf("%lu samples  %lu filtered  %lu gaps\n",nsample,nout,fir.Gaps);
+  A2DFirFree(&fir);
+}
+
+
+static double FilterCpu(void)
+{
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF,&usage);
+  return TIMEVAL_CV(usage.ru_utime) + TIMEVAL_CV(usage.ru_stime);
+}
+
+
+// no device needed , synthetic blocks. samples/sec on one core
+void  TestFilterBenchmark(int handle)
+{
+  static const int taps[] = { 32, 64, 128, 256 };
+  static const int decimation[] = { 10, 100 };
+  A2DBlock block;
+  A2DFir fir;
+  A2DBiquad biquad;
+  float coeff[256];
+  float in[A2D_BLOCK_SIZE];
+  float out[A2D_BLOCK_SIZE];
+  unsigned long nsample;
+  double cpu;
+  int t,d,loop;
+
+  (void) handle;                     // same call as the other tests
+  printf("\n--------------- Filter throughput (one core)\n");fflush(stdout);
+
+  A2DBlockClear(&block);
+  block.Count = A2D_BLOCK_SIZE;
+  for(loop=0;loop<A2D_BLOCK_SIZE;loop++)
+    {
+      block.A0[loop] = 512 + 400 * sin(loop * 0.1);
+      in[loop] = block.A0[loop];
+    }
+
+  for(t=0;t<4;t++)
+   for(d=0;d<2;d++)
+    {
+      A2DFirLowpass(coeff,taps[t],0.4 / decimation[d]);
+      if(A2DFirInit(&fir,coeff,taps[t],decimation[d]) < 0) return;
+      nsample = 0;
+      cpu = FilterCpu();
+      do {
+           for(loop=0;loop<1000;loop++)
+             A2DFirBlock(&fir,&block,0,NULL,out,NULL);
+           nsample += 1000 * A2D_BLOCK_SIZE;
+         } while ((FilterCpu() - cpu) < 1.0);
+      cpu = FilterCpu() - cpu;
+      printf("FIR %3d taps decimation %3d : %6.1f Msamples/sec\n",taps[t],decimation[d],nsample / cpu / 1e6);
+      fflush(stdout);
+      A2DFirFree(&fir);
+    }
+
+  for(t=1;t<=4;t*=2)
+    {
+      A2DBiquadInit(&biquad);
+      for(loop=0;loop<t;loop++)
+        A2DBiquadLowpass(&biquad,5000.0,50.0,0.7071);
+      nsample = 0;
+      cpu = FilterCpu();
+      do {
+           for(loop=0;loop<1000;loop++)
+             A2DBiquadProcess(&biquad,in,NULL,A2D_BLOCK_SIZE,out);
+           nsample += 1000 * A2D_BLOCK_SIZE;
+         } while ((FilterCpu() - cpu) < 1.0);
+      cpu = FilterCpu() - cpu;
+      printf("biquad %d sections           : %6.1f Msamples/sec\n",t,nsample / cpu / 1e6);
+      fflush(stdout);
+    }
+}
+
+
+void  TestStatistics(int handle)
+{
+// 1000 samples/sec for 10 seconds in the summary pyramid /tmp/a2dtest.1s , .1m , .1h
+// then the 10 seconds in 5 parts from the files
+
+  A2DBlock block;
+  A2DStats stats;
+  A2DStatsBin part[5];
+  struct timeval now;
+  double t0;
+  int loop;
+
+  printf("\n--------------- Statistics pyramid\n");fflush(stdout);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+  gettimeofday(&now,NULL);
+  t0 = TIMEVAL_CV(now);
+  A2DMode(handle,A2D_MODE_TIMER);
+  if(A2DStatsOpen(&stats,"/tmp/a2dtest",t0,1000.0) < 0)
+   {
+     printf("Unable to create /tmp/a2dtest.1s\n");
+     A2DMode(handle,A2D_MODE_OFF);
+     return;
+   }
+
+  gettimeofday (&start, NULL) ;
+   do {
+        A2DBlockClear(&block);
+        A2DReadEvents(handle,&block);
+        A2DStatsBlock(&stats,&block,NULL);
+        usleep(10000);
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+  } while (elapse  < 10.0);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DStatsClose(&stats);
+
+  loop = A2DStatsQuery("/tmp/a2dtest",t0,t0 + 10.0,5,part);
+  printf("level %d\n",loop);
+  for(loop=0;loop<5;loop++)
+    printf("%2d..%2ds  %5u samples  A0 min %4.0f max %4.0f mean %6.1f rms %6.1f   A1 mean %6.1f  lost %u\n",
+           loop * 2,loop * 2 + 2,part[loop].Count,part[loop].Min[0],part[loop].Max[0],
+           A2DStatsMean(&part[loop],0),A2DStatsRms(&part[loop],0),A2DStatsMean(&part[loop],1),part[loop].Lost);
+}
+
+
+void  TestCaptureStore(int handle)
+{
+// 1000 samples/sec for 10 seconds in the circular store /tmp/a2dtest.ring (1MB , 60 seconds kept)
+// synced each second. Run it again , the store goes on after the last page
+
+  A2DBlock block;
+  A2DStore store;
+  const A2DStorePage * page;
+  struct timeval now;
+  double t0;
+  unsigned long long nsample=0;
+  double last_sync=0;
+  long long seq;
+  int loop;
+
+  printf("\n--------------- Circular capture store\n");fflush(stdout);
+
+  if(A2DStoreOpen(&store,"/tmp/a2dtest.ring",1024*1024,60.0) < 0)
+   {
+     printf("Unable to open /tmp/a2dtest.ring\n");
+     return;
+   }
+  printf("pages %llu .. %llu kept\n",store.Tail,store.Head);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+  gettimeofday(&now,NULL);
+  t0 = TIMEVAL_CV(now);
+  A2DMode(handle,A2D_MODE_TIMER);
+
+  gettimeofday (&start, NULL) ;
+   do {
+        A2DBlockClear(&block);
+        A2DReadEvents(handle,&block);
+        for(loop=0;loop<block.Count;loop++)
+          nsample += block.Overrun[loop];
+        if(block.Count)
+          A2DStoreAppend(&store,&block,t0 + nsample / 1000.0,1.0 / 1000.0);
+        nsample += block.Count;
+        usleep(10000);
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+        if((elapse - last_sync) >= 1.0)
+          {
+            A2DStoreSync(&store);
+            last_sync = elapse;
+          }
+  } while (elapse  < 10.0);
+
+  A2DMode(handle,A2D_MODE_OFF);
+
+  seq = A2DStoreFind(&store,t0 + 5.0);
+  page = seq < 0 ? NULL : A2DStorePageGet(&store,seq);
+  if(page)
+    printf("page %lld at %.3fs : %u records  A0 %4d  A1 %4d\n",seq,page->Header.Time - t0,page->Header.Count,
+           page->Record[0].A0,page->Record[0].A1);
+  printf("pages %llu .. %llu kept\n",store.Tail,store.Head);
+  A2DStoreClose(&store);
+}
+
+
+int  ArchiveGapRange(const A2DArchive * archive, const A2DQueryRange * range, void * user)
+{
+  (void) archive;
+  *((double *) user) = range->Time;
+  return -1;                         // the first one
+}
+
+void  TestArchiveGap(int handle)
+{
+// two 1000 samples/sec segments an hour apart in /tmp/a2dgap.ring (A0 100 then 950) ,
+// packed with ./A2DPack. A0 over 900 has to be found one hour after the start
+
+  A2DBlock block;
+  A2DStore store;
+  A2DArchive archive;
+  A2DQueryPredicate predicate;
+  double t0 = 1.0e9;
+  double t, found = 0.0;
+  int segment, loop, idx;
+
+  (void) handle;                     // same call as the other tests
+
+  printf("\n--------------- Archive of a store with a gap\n");fflush(stdout);
+
+  unlink("/tmp/a2dgap.ring");
+  if(A2DStoreOpen(&store,"/tmp/a2dgap.ring",1024*1024,0.0) < 0)
+   {
+     printf("Unable to open /tmp/a2dgap.ring\n");
+     return;
+   }
+  for(segment=0;segment<2;segment++)
+   {
+     t = t0 + segment * 3600.0;
+     for(loop=0;loop<20;loop++)
+      {
+        A2DBlockClear(&block);
+        for(idx=0;idx<A2D_BLOCK_SIZE;idx++)
+          {
+            block.A0[idx] = segment ? 950 : 100;
+            block.A1[idx] = idx;
+          }
+        block.Count = A2D_BLOCK_SIZE;
+        A2DStoreAppend(&store,&block,t,1.0 / 1000.0);
+        t += A2D_BLOCK_SIZE / 1000.0;
+      }
+   }
+  A2DStoreClose(&store);
+
+  if(system("./A2DPack /tmp/a2dgap.ring /tmp/a2dgap.a2z") != 0)
+    {
+      printf("./A2DPack failed\n");
+      return;
+    }
+  if(A2DArchiveOpen(&archive,"/tmp/a2dgap.a2z") < 0)
+    {
+      printf("Unable to open /tmp/a2dgap.a2z\n");
+      return;
+    }
+  A2DQueryInit(&predicate);
+  predicate.Channel = 0;
+  predicate.Low = 901;
+  A2DQueryRun(&archive,&predicate,A2D_QUERY_RANGES,ArchiveGapRange,&found,NULL);
+  printf("%llu chunks  A0 over 900 at %.3fs (3600.000s expected)  %s\n",archive.Chunks,found - t0,
+         fabs(found - t0 - 3600.0) < 0.001 ? "ok" : "WRONG");
+  A2DArchiveClose(&archive);
+}
+
+
+void  TestSharedStream(int handle)
+{
+// 1000 samples/sec for 10 seconds published in /dev/shm/a2dtest.
+// Three child processes read every sample from the shared memory , none of them touches the bus
+
+  A2DShm shm;
+  A2DBlock block;
+  const A2DShmRecord * record;
+  int address = 0x20;
+  unsigned long long count, overrun;
+  int loop, child, n;
+
+  printf("\n--------------- Shared memory stream (3 consumers)\n");fflush(stdout);
+
+  if(A2DShmCreate(&shm,"a2dtest",&address,1,16384,0.001) < 0)
+   {
+     printf("Unable to create /dev/shm/a2dtest\n");
+     return;
+   }
+
+  for(child=0;child<3;child++)
+    if(fork()==0)
+      {
+        A2DShm consumer;
+
+        count = overrun = 0;
+        if(A2DShmAttach(&consumer,"a2dtest") < 0) _exit(1);
+        while(A2DShmWait(&consumer,1000) >= 0)
+          while((n = A2DShmRead(&consumer,0,&record)) > 0)
+           {
+             for(loop=0;loop<n;loop++)
+               overrun += record[loop].Overrun;
+             count += n;
+             A2DShmRelease(&consumer,0,n);
+           }
+        printf("consumer %d: %llu samples  overrun %llu  lost %llu\n",child,count,overrun,
+               consumer.Header->Consumer[consumer.Slot].Lost);
+        fflush(stdout);
+        A2DShmDetach(&consumer);
+        _exit(0);
+      }
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+  A2DMode(handle,A2D_MODE_TIMER);
+
+  count = 0;
+  gettimeofday (&start, NULL) ;
+   do {
+        A2DBlockClear(&block);
+        A2DReadEvents(handle,&block);
+        A2DShmPublish(&shm,0,&block);
+        count += block.Count;
+        usleep(10000);
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+  } while (elapse  < 10.0);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  usleep(100000);
+  A2DShmClose(&shm);
+  while(wait(NULL) > 0);
+  printf("published %llu samples\n",count);
+}
+
+
+void  TestWatermarkMode(int handle)
+{
+// 1000 samples/sec , RA5 goes low when 20 samples are in the fifo
+// RA5 is connected to gpio 17 of the Raspberry Pi
+
+  GPIOEventLine line;
+  PackAnalog packanalog[10];
+  struct rusage usage;
+  unsigned int totsample=0;
+  unsigned int wakeup=0;
+  unsigned int timeout=0;
+  int count;
+  int rcode;
+  double cpu;
+
+  printf("\n--------------- Test fifo watermark with gpio line event\n");
+  printf("Timer= 10 => 1000 samples/sec, watermark=20 on RA5 -> gpio 17\n");
+
+  if(GPIOEventOpen(&line,"/dev/gpiochip0",17) < 0)
+   {
+     printf("Unable to open gpio line\n");
+     return;
+   }
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+  A2DWatermark(handle,20);
+  A2DMode(handle,A2D_MODE_TIMER); // start timer mode
+
+  gettimeofday (&start, NULL) ;
+   do {
+        rcode = GPIOEventWait(&line,50);   // 50 ms is the maximum read latency
+        if(rcode < 0) break;
+        if(rcode == 0)
+          timeout++;
+        else
+          wakeup++;
+
+        // drain the fifo  (this will release RA5)
+        count = A2DReadDataCount(handle);
+        while(count > 0)
+         {
+           rcode = count > 10 ? 10 : count;
+           A2DReadPackData(handle,rcode,packanalog);     // max for packdata  is 10 ( 10 * 3 ==30) < 32
+           totsample+=rcode;
+           count-=rcode;
+         }
+
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+  } while (elapse  < 10.5);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DWatermark(handle,0);
+  GPIOEventClose(&line);
+
+  getrusage(RUSAGE_SELF,&usage);
+  cpu = TIMEVAL_CV(usage.ru_utime) + TIMEVAL_CV(usage.ru_stime);
+  printf("%d samples  %d wakeups  %d timeouts  %.1f samples/sec\n",totsample,wakeup,timeout,totsample/elapse);
+  printf("Process cpu time %.3f sec\n",cpu);
+}
+
+
+
+void  TestSingleChannelMode(int handle)
+{
+// only A0 is converted at 10K samples/sec
+// 2 samples per fifo record
+
+  A2DBlock block;
+  unsigned int totsample=0;
+  double Rate;
+
+  printf("\n--------------- Test single channel mode\n");
+  printf("Channel A0 only, Timer= 1 => 10K samples/sec\n");
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DChannelMask(handle,A2D_CHANNEL_A0);
+  A2DTimer(handle,1);
+
+  A2DMode(handle,A2D_MODE_TIMER); // start timer mode
+  gettimeofday (&start, NULL) ;
+   do {
+        A2DBlockClear(&block);
+        if(A2DReadDense(handle,A2D_CHANNEL_A0,&block) < 0) break;
+        totsample+=block.Count;
+      }while(totsample<20000);
+   gettimeofday(&end,NULL);
+   timersub(&end,&start,&total);
+   elapse = TIMEVAL_CV(total);
+
+   A2DMode(handle,A2D_MODE_OFF);
+   A2DChannelMask(handle,A2D_CHANNEL_BOTH);
+   A2DTimer(handle,10);
+
+   Rate =  (double) totsample / elapse;
+   printf("Single channel average samples/sec = %f\n",Rate);
+}
+
+void  TestHardwareTimer(int handle)
+{
+// 250us sample period (4000 samples/sec) is not possible with the 100us software timer
+// check the rate with the timer counter
+
+  unsigned long Count1,Count2;
+  double rate;
+
+  printf("\n--------------- Test hardware timer\n");
+  printf("Period= 250us => 4000 samples/sec\n");
+
+  A2DMode(handle,A2D_MODE_OFF);
+  if(A2DSetSamplePeriod(handle,250,0) < 0)
+   {
+     printf("Invalid period\n");
+     return;
+   }
+  A2DMode(handle,A2D_MODE_TIMER); // start timer mode with the hardware clock
+
+  usleep(500000);
+  gettimeofday(&start,NULL);
+  Count1= A2DReadTimerCounterWord(handle);
+  sleep(2);
+  gettimeofday(&end,NULL);
+  Count2= A2DReadTimerCounterWord(handle);
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);            // back to the software timer
+
+  timersub(&end,&start,&total);
+  elapse = TIMEVAL_CV(total);
+  rate =  ((double) ((Count2 - Count1) & 0xffff)) / elapse;
+  printf("Rate=%.1f Sample/sec count =%ld elapse=%f\n",rate,(Count2-Count1) & 0xffff,elapse);
+}
+
+
+void  TestStampMode(int handle)
+{
+// Trigger mode with the timestamp record.  Use 2 Pics like TestTriggerMode
+// PIC at 0x20 in timer mode gives the trigger at 1000 samples/sec
+// PIC at 0x21 stamps each conversion with its 1us timer
+
+  A2DBlock block;
+  A2DStampState state;
+  int loop;
+  unsigned int nsample=0;
+  unsigned long long last=0;
+  unsigned long long delta,mindelta=~0ULL,maxdelta=0;
+
+  printf("\n--------------- Test timestamp record\n");
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+
+  I2CWrapperSlaveAddress(handle,0x21);
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DRecordOptions(handle,A2D_RECORD_STAMP);
+  A2DStampInit(&state);
+  A2DStampClock(&state,1.0e-6);        // 1us stamps , a quiet trigger over 16.7 sec is rebased
+  A2DMode(handle,A2D_MODE_TRIGGER);
+
+  I2CWrapperSlaveAddress(handle,0x20);
+  A2DMode(handle,A2D_MODE_TIMER);
+  I2CWrapperSlaveAddress(handle,0x21);
+
+  gettimeofday (&start, NULL) ;
+   do {
+        A2DBlockClear(&block);
+        A2DReadStamped(handle,&state,&block);
+        for(loop=0;loop<block.Count;loop++,nsample++)
+         {
+           if(nsample>0)
+            {
+              delta = block.Time[loop] - last;
+              if(delta < mindelta) mindelta=delta;
+              if(delta > maxdelta) maxdelta=delta;
+            }
+           last = block.Time[loop];
+         }
+        usleep(5000);
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+  } while (elapse  < 10.5);
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DRecordOptions(handle,0);
+  I2CWrapperSlaveAddress(handle,0x20);
+  A2DMode(handle,A2D_MODE_OFF);
+
+  printf("%d samples  last stamp=%lluus  trigger period min=%lluus max=%lluus\n",nsample,last,mindelta,maxdelta);
+}
+
+A2DMerge      merge;               // 8 devices x 4096 instants , too big for the stack
+
+void  TestMergedFrames(int handle)
+{
+// Two PICs like TestStampMode merged in one stream of 4 channels
+// PIC at 0x20 in timer mode at 1000 samples/sec drives RA5 , no stamp , it is the sample count
+// PIC at 0x21 in trigger mode , its stamp is in 1us
+// At 5 sec 0x21 is not read for 50ms , its fifo overrun and the merge fills the frames.
+// Put the same signal on A0 of both PICs , the difference shows the alignment.
+
+  A2DBlock block;
+  A2DFrameBlock frames;
+  A2DStampState state;
+  int align[2] = { A2D_ALIGN_COUNT , A2D_ALIGN_TICK };
+  int address[2] = { 0x20 , 0x21 };
+  int device,loop,diff;
+  int stall=0;
+  int maxdiff=0;
+  unsigned long long nframe=0,partial=0;
+
+  printf("\n--------------- Test merged frames\n");
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+
+  I2CWrapperSlaveAddress(handle,0x21);
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DRecordOptions(handle,A2D_RECORD_STAMP);
+  A2DMode(handle,A2D_MODE_TRIGGER);  // armed before the master , same first instant
+
+  A2DMergeInit(&merge,2,align,1000.0,0);
+  A2DStampInit(&state);
+  I2CWrapperSlaveAddress(handle,0x20);
+  A2DMode(handle,A2D_MODE_TIMER);
+
+  elapse=0;
+  gettimeofday (&start, NULL) ;
+   do {
+        for(device=0;device<2;device++)
+         {
+           if((device==1) && (elapse > 5.0) && (elapse < 5.05))
+             {
+               stall=1;
+               continue;
+             }
+           I2CWrapperSlaveAddress(handle,address[device]);
+           A2DBlockClear(&block);
+           if(device==0)
+             A2DReadEvents(handle,&block);
+           else
+             A2DReadStamped(handle,&state,&block);
+           A2DMergePush(&merge,device,&block);
+         }
+
+        do{
+           A2DFrameBlockClear(&frames);
+           A2DMergeFrames(&merge,&frames,0);
+           for(loop=0;loop<frames.Count;loop++,nframe++)
+            {
+              if(frames.Valid[loop] != 3)
+               {
+                 partial++;
+                 continue;
+               }
+              diff = abs(frames.Value[loop][0] - frames.Value[loop][2]);
+              if(diff > maxdiff) maxdiff=diff;
+            }
+          }while(frames.Count == A2D_MERGE_FRAMES);
+
+        usleep(2000);
+        gettimeofday(&end,NULL);
+        timersub(&end,&start,&total);
+        elapse = TIMEVAL_CV(total);
+  } while (elapse  < 10.5);
+
+  I2CWrapperSlaveAddress(handle,0x20);
+  A2DMode(handle,A2D_MODE_OFF);
+  I2CWrapperSlaveAddress(handle,0x21);
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DRecordOptions(handle,0);
+  I2CWrapperSlaveAddress(handle,0x20);
+
+  printf("%llu frames  %llu with a filled device  (0x20 filled %llu , 0x21 filled %llu%s)\n",nframe,partial,
+         merge.Source[0].Filled,merge.Source[1].Filled,stall ? " , 0x21 stalled 50ms" : "");
+  printf("dropped 0x20 %llu , 0x21 %llu   A0 difference max=%d\n",merge.Source[0].Dropped,merge.Source[1].Dropped,maxdiff);
+}
+
+void  TestProfile(int handle)
+{
+// store 1000 samples/sec timer mode as power-up profile and read it back
+// Power cycle the PIC after this test, the data count should go up without any command.
+
+  A2D_Profile profile;
+  int rcode;
+
+  printf("\n--------------- Test acquisition profile\n");
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,10);
+  rcode = A2DSaveProfile(handle,A2D_MODE_TIMER);
+  if(rcode < 0)
+   {
+     printf("Unable to store the profile\n");
+     return;
+   }
+  A2DReadProfile(handle,&profile);
+  printf("Stored profile %s  autostart=%d timer=%d channel=%d event=0x%02X watermark=%d hw period=%dus\n",\
+          rcode == 0 ? "confirmed" : "MISMATCH", profile.AutoStart, profile.Timer, profile.ChannelMask,\
+          profile.EventControl, profile.Watermark, profile.HwTimer.Period);
+}
+
+void  TestBurstMode(int handle)
+{
+// Oscilloscope mode at 5000 samples/sec. Trigger when A0 leaves the window 200..800
+// 10 samples are kept after the trigger, the fifo hold the 29 samples before it.
+
+  A2DBlock block;
+  A2D_Window window;
+  A2D_Burst burst;
+  int loop;
+  int state;
+
+  printf("\n--------------- Test burst capture\n");
+
+  A2DMode(handle,A2D_MODE_OFF);
+  A2DTimer(handle,2);                 // fastest software timer
+
+  window.A0Low=200;
+  window.A0High=800;
+  window.A1Low=0;
+  window.A1High=1023;
+  A2DSetWindow(handle,&window);
+  A2DEventControl(handle,A2D_EVENT_A0);
+  burst.Post=10;
+  burst.Source=A2D_BURST_WINDOW;
+  A2DBurst(handle,&burst);
+
+  A2DMode(handle,A2D_MODE_TIMER);   // armed
+
+  gettimeofday (&start, NULL) ;
+  do {
+       state = A2DReadBurstState(handle);
+       if(state == A2D_BURST_FROZEN) break;
+       usleep(100000);
+       gettimeofday(&end,NULL);
+       timersub(&end,&start,&total);
+       elapse = TIMEVAL_CV(total);
+  } while (elapse  < 30.0);
+
+  if(state != A2D_BURST_FROZEN)
+    printf("No trigger\n");
+  else
+   {
+     A2DBlockClear(&block);
+     A2DReadEvents(handle,&block);
+     for(loop=0;loop<block.Count;loop++)
+        printf("%3d A0=%4d A1=%4d %s\n",loop,block.A0[loop],block.A1[loop],\
+                block.Flags[loop] & A2D_FLAG_EVENT ? "<- trigger" : "");
+   }
+
+  A2DMode(handle,A2D_MODE_OFF);
+  burst.Post=0;
+  burst.Source=0;
+  A2DBurst(handle,&burst);
+  A2DEventControl(handle,A2D_EVENT_OFF);
+  A2DTimer(handle,10);
+}
+
+void  TestBroadcastStart(int handle)
+{
+//  Use 2 Pics at 0x20 and 0x21
+//  One general call start both timer modes. The timer counters should stay within one tick.
+
+  unsigned long Count20,Count21;
+
+  printf("\n--------------- Test broadcast start\n");
+  printf("Timer= 10 => 1000 samples/sec on all devices\n");
+
+  A2DBroadcastMode(handle,A2D_MODE_OFF);
+  A2DBroadcastTimer(handle,10);
+  A2DBroadcastMode(handle,A2D_MODE_TIMER);
+
+  sleep(1);
+  A2DBroadcastMode(handle,A2D_MODE_OFF);   // stop both at the same time
+
+  Count20= A2DReadTimerCounterWord(handle);
+  I2CWrapperSlaveAddress(handle,0x21);
+  Count21= A2DReadTimerCounterWord(handle);
+  I2CWrapperSlaveAddress(handle,0x20);
+
+  printf("Timer counter 0x20=%ld 0x21=%ld  difference=%ld\n",Count20,Count21,Count20 - Count21);
+}
 
 
 int main(void)
@@ -474,11 +1517,31 @@ int main(void)
    TestSingleShot(i2c_handle);
    TestSingleShotPack(i2c_handle);
 //   TestSingleShotSpeed(i2c_handle);
+//   TestSingleShotPipeline(i2c_handle);
    AdjustOscillator(i2c_handle);
    TestTimerMode(i2c_handle);
+//   TestPacerBenchmark(i2c_handle);
+//   TestPacerLateReader(i2c_handle);
+//   TestRealTimePacer(i2c_handle);
 //   TestMaxDataTransfer(i2c_handle);
 //   TestMaxPackDataTransfer(i2c_handle);
 //   TestTriggerMode(i2c_handle);
+//   TestEventMode(i2c_handle);
+//   TestWatermarkMode(i2c_handle);
+//   TestCalibration(i2c_handle);
+//   TestFilteredStream(i2c_handle);
+//   TestFilterBenchmark(i2c_handle);
+//   TestStatistics(i2c_handle);
+//   TestCaptureStore(i2c_handle);
+//   TestArchiveGap(i2c_handle);
+//   TestSharedStream(i2c_handle);
+//   TestSingleChannelMode(i2c_handle);
+//   TestHardwareTimer(i2c_handle);
+//   TestBroadcastStart(i2c_handle);
+//   TestStampMode(i2c_handle);
+//   TestMergedFrames(i2c_handle);
+//   TestProfile(i2c_handle);
+//   TestBurstMode(i2c_handle);
    close(i2c_handle);
 return 0;
 }
@@ -60,6 +60,16 @@ A2D_CMD_TIMER_COUNTER=	6
 A2D_CMD_VERSION=	7
 A2D_CMD_OSC_TUNE=	8
 A2D_CMD_FLASH_SETTINGS=	9
+A2D_CMD_EVENT=	10
+A2D_CMD_WINDOW=	11
+A2D_CMD_WATERMARK=	12
+A2D_CMD_CHANNEL=	13
+A2D_CMD_HW_TIMER=	14
+A2D_CMD_RECORD=	15
+A2D_CMD_AUTOSTART=	16
+A2D_CMD_PROFILE=	17
+A2D_CMD_BURST=	18
+A2D_CMD_BURST_STATE=	19
 
 # mode definition
 
@@ -68,6 +78,26 @@ A2D_MODE_SINGLE=	3
 A2D_MODE_TRIGGER=	5
 A2D_MODE_TIMER=		7
 
+# event capture definition
+
+A2D_EVENT_OFF=		0
+A2D_EVENT_A0=		1
+A2D_EVENT_A1=		2
+
+def A2D_EVENT_PRE(N):
+   return (N & 7) << 2
+
+def A2D_EVENT_POST(N):
+   return (N & 7) << 5
+
+# channel mask definition
+
+A2D_CHANNEL_A0=		1
+A2D_CHANNEL_A1=		2
+A2D_CHANNEL_BOTH=	3
+
+A2D_RECORD_STAMP=	1
+
 bus = smbus.SMBus(1)
 
 
@@ -136,6 +166,149 @@ def A2DReadTimerCounterWord(Address):
    data = bus.read_word_data(Address, A2D_CMD_TIMER_COUNTER)
    return data
 
+def A2DEventControl(Address, Value):
+   bus.write_byte_data(Address,A2D_CMD_EVENT,Value)
+
+def A2DSetWindow(Address, A0Low, A0High, A1Low, A1High):
+   _block = []
+   for Value in (A0Low, A0High, A1Low, A1High):
+      _block.append(Value & 0xff)
+      _block.append(Value >> 8)
+   bus.write_i2c_block_data(Address,A2D_CMD_WINDOW,_block)
+
+def A2DWatermark(Address, Value):
+   bus.write_byte_data(Address,A2D_CMD_WATERMARK,Value)
+
+def A2DChannelMask(Address, Value):
+   bus.write_byte_data(Address,A2D_CMD_CHANNEL,Value)
+
+def A2DHwTimer(Address, Period, Postscale=1):
+   # Period in us , one conversion every Postscale periods. Period=0 go back to A2DTimer
+   bus.write_i2c_block_data(Address,A2D_CMD_HW_TIMER,[Period & 0xff, Period >> 8, Postscale & 0xff, Postscale >> 8])
+
+A2D_GENERAL_CALL_TAG=	0xE6
+
+def A2DBroadcastMode(Mode):
+   # general call, every device on the bus start or stop at the same time
+   bus.write_i2c_block_data(0,A2D_GENERAL_CALL_TAG,[A2D_CMD_MODE, Mode])
+
+def A2DBroadcastTimer(TimerValue):
+   bus.write_i2c_block_data(0,A2D_GENERAL_CALL_TAG,[A2D_CMD_TIMER, TimerValue & 0xff, TimerValue >> 8])
+
+def A2DReadDenseBlock(Address,Number):
+   # single channel mode, each packed record hold 2 samples
+   SampleList = []
+   for Data in A2DReadPackDataBlock(Address,Number):
+      if Data.struct.Valid:
+         SampleList.append(Data.struct.A0)
+         SampleList.append(Data.struct.A1)
+   return SampleList
+
+def A2DReadEventBlock(Address,Number):
+   # return a list of (A0, A1, Inside0, Inside1, Event)
+   EventList = []
+   for Data in A2DReadUnpackDataBlock(Address,Number):
+      if Data.struct.Valid:
+         EventList.append((Data.struct.A0, Data.struct.A1, Data.struct.z0 & 1, (Data.struct.z0 >> 1) & 1, (Data.struct.z0 >> 2) & 1))
+   return EventList
+
+def A2DRecordOptions(Address,Options):
+   bus.write_byte_data(Address,A2D_CMD_RECORD,Options)
+
+def A2DSaveProfile(Address,AutoStartMode):
+   # store the current settings , start with AutoStartMode on power-up (A2D_MODE_OFF = no autostart)
+   bus.write_byte_data(Address,A2D_CMD_AUTOSTART,AutoStartMode)
+   bus.write_word_data(Address,A2D_CMD_FLASH_SETTINGS,0xAA55)
+
+def A2DReadProfile(Address):
+   # 22 bytes. byte 0 = 0xA5 when stored , 0 while the device is writing the eeprom
+   return bus.read_i2c_block_data(Address,A2D_CMD_PROFILE,22)
+
+A2D_BURST_EDGE=		1
+A2D_BURST_WINDOW=	2
+
+A2D_BURST_OFF=		0
+A2D_BURST_ARMED=	1
+A2D_BURST_TRIGGERED=	2
+A2D_BURST_FROZEN=	3
+
+def A2DBurst(Address,Post,Source):
+   # Post = samples kept after the trigger (0 = off)
+   bus.write_i2c_block_data(Address,A2D_CMD_BURST,[Post, Source])
+
+def A2DReadBurstState(Address):
+   return bus.read_byte_data(Address,A2D_CMD_BURST_STATE)
+
+class A2DStampState:
+   def __init__(self):
+      self.Last = 0
+      self.Pending = None
+
+   def Unwrap(self,Stamp):
+      # 24 bits device stamp to full tick count
+      # read once per wrap (16.7 sec of 1us ticks) , a longer quiet time loses whole wraps
+      self.Last += (Stamp - self.Last) & 0xffffff
+      return self.Last
+
+def A2DReadStampedBlock(Address,Number,State):
+   # with A2D_RECORD_STAMP , return a list of (Time, A0, A1)
+   # Number is in records , two records per sample
+   StampList = []
+   _block=bus.read_i2c_block_data(Address,A2D_CMD_READ_DATA,Number * 4)
+   for i in range(Number):
+      _rec = _block[i*4:i*4+4]
+      if (_rec[3] & 0x80) == 0:
+         continue
+      if State.Pending is None:
+         State.Pending = _rec
+         continue
+      _data = State.Pending
+      State.Pending = None
+      A0 = _data[0] | ((_data[1] & 3) << 8)
+      A1 = _data[2] | ((_data[3] & 3) << 8)
+      StampList.append((State.Unwrap(_rec[0] | (_rec[1] << 8) | (_rec[2] << 16)), A0, A1))
+   return StampList
+
+class A2DPacer:
+   # timer mode reader pacing , sleep until the fifo should hold Fill records
+   # instead of polling the count. The record period follows what comes in
+   def __init__(self,Address,Fill):
+      self.Address = Address
+      self.Fill = Fill
+      _hw = bus.read_i2c_block_data(Address,A2D_CMD_HW_TIMER,4)
+      _period = _hw[0] | (_hw[1] << 8)
+      if _period:
+         self.Period = _period * (_hw[2] | (_hw[3] << 8)) * 1.0e-6
+      else:
+         self.Period = bus.read_word_data(Address,A2D_CMD_TIMER) * 1.0e-4
+      if bus.read_byte_data(Address,A2D_CMD_CHANNEL) != A2D_CHANNEL_BOTH:
+         self.Period *= 2.0
+      if bus.read_byte_data(Address,A2D_CMD_RECORD) & A2D_RECORD_STAMP:
+         self.Period /= 2.0
+      self.LastWake = time.time()
+      self.NextWake = self.LastWake + Fill * self.Period
+      self.Remain = 0
+
+   def Wait(self):
+      # return the fifo count at the next wake up
+      _delay = self.NextWake - time.time()
+      if _delay > 0:
+         time.sleep(_delay)
+      _now = time.time()
+      _count = A2DReadDataCount(self.Address)
+      _arrived = _count - self.Remain
+      if (_arrived > 0) and (_count < 39):
+         self.Period += ((_now - self.LastWake) / _arrived - self.Period) / 8.0
+      self.LastWake = _now
+      self.Remain = 0
+      self.NextWake = _now + self.Fill * self.Period
+      return _count
+
+   def Left(self,Count):
+      # records not read , wake up earlier
+      self.Remain = max(Count,0)
+      self.NextWake = self.LastWake + max(self.Fill - self.Remain,1) * self.Period
+
 SlaveAddress1 = 0x20
 SlaveAddress2 = 0x21
 
@@ -223,12 +396,14 @@ def TestTimerMode():
    delta=0
    elapse=0
    t_s= time.time()
+   # sleep until 7 samples should be in the fifo instead of polling the count
+   pacer = A2DPacer(SlaveAddress1, 7)
    
    while elapse < 10.5:
-      DataCount = A2DReadDataCount(SlaveAddress1)
+      DataCount = pacer.Wait()
       isample=0;
       
-      if(DataCount > 1):
+      if(DataCount > 0):
         if(DataCount>7):
           isample=7
         else:
@@ -236,6 +411,7 @@ def TestTimerMode():
 #        print "isample = {0} elapse={1}".format(isample,elapse)
         Data=A2DReadPackDataBlock(SlaveAddress1,isample)
         nsample+= isample
+      pacer.Left(DataCount - isample)
       t_e = time.time()
       elapse = t_e - t_s
       if (elapse - delta) > 1.0:
@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <linux/gpio.h>
+#include "GPIOEvent.h"
+
+
+////////////////////////////////////////////
+//
+//    GPIOEvent
+//
+//    Wait for the A/D fifo watermark line (RA5, command 12) using the
+//    gpio character device line events and epoll. No polling of the I2C bus is needed
+//    until the line goes low.
+//
+//    RA5 is open drain active low. Connect it to a Raspberry Pi gpio (ex: gpio 17 on /dev/gpiochip0)
+//    Many A/D could share the same line.
+//
+//    To test without hardware, the gpio-sim kernel module gives a simulated gpiochip.
+//
+//      modprobe gpio-sim
+//      mkdir -p /sys/kernel/config/gpio-sim/a2d/bank0/line0
+//      echo 8 > /sys/kernel/config/gpio-sim/a2d/bank0/num_lines
+//      echo 1 > /sys/kernel/config/gpio-sim/a2d/live
+//
+//    then use the created /dev/gpiochipN , line 0 , and drive it with
+//
+//      echo pull-down > /sys/devices/platform/gpio-sim.0/gpiochipN/sim_gpio0/pull
+//      echo pull-up   > /sys/devices/platform/gpio-sim.0/gpiochipN/sim_gpio0/pull
+//
+//   to compile add GPIOEvent.c to the gcc command line
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+////////////////////////////////////   GPIOEventOpen
+//
+//    Request a gpio line as input with falling edge detection
+//
+//    Inputs,
+//
+//    event:   line structure to fill
+//    chip:    gpio chip device   (ex: "/dev/gpiochip0")
+//    offset:  line number on the chip
+//
+//    Return,
+//
+//    0  ok
+//    < 0 error
+//
+int GPIOEventOpen(GPIOEventLine * event, const char * chip, int offset)
+{
+  struct gpio_v2_line_request req;
+  struct epoll_event ev;
+  int  chip_handle;
+
+  event->Line = -1;
+  event->Epoll = -1;
+  event->Edges = 0;
+
+  chip_handle = open(chip, O_RDONLY | O_CLOEXEC);
+  if(chip_handle < 0)
+   {
+     fprintf(stderr,"Unable to open %s\n",chip);
+     return -1;
+   }
+
+  memset(&req,0,sizeof(req));
+  req.offsets[0]= offset;
+  req.num_lines = 1;
+  req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+  req.event_buffer_size = 16;
+  strncpy(req.consumer,"A2D watermark",sizeof(req.consumer)-1);
+
+  if(ioctl(chip_handle,GPIO_V2_GET_LINE_IOCTL,&req) < 0)
+   {
+     fprintf(stderr,"Unable to request line %d on %s\n",offset,chip);
+     close(chip_handle);
+     return -1;
+   }
+  close(chip_handle);   // the line request keep its own handle
+  event->Line = req.fd;
+
+  event->Epoll = epoll_create1(EPOLL_CLOEXEC);
+  if(event->Epoll < 0)
+   {
+     GPIOEventClose(event);
+     return -1;
+   }
+
+  memset(&ev,0,sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = event->Line;
+  if(epoll_ctl(event->Epoll,EPOLL_CTL_ADD,event->Line,&ev) < 0)
+   {
+     GPIOEventClose(event);
+     return -1;
+   }
+  return 0;
+}
+
+
+////////////////////////////////////   GPIOEventValue
+//
+//    Read the line level
+//
+//    Return,
+//
+//    0 or 1
+//    < 0 error
+//
+int GPIOEventValue(GPIOEventLine * event)
+{
+  struct gpio_v2_line_values values;
+
+  values.mask = 1;
+  values.bits = 0;
+  if(ioctl(event->Line,GPIO_V2_LINE_GET_VALUES_IOCTL,&values) < 0) return -1;
+  return (int) (values.bits & 1);
+}
+
+
+////////////////////////////////////   GPIOEventWait
+//
+//    Sleep until the line is low.
+//    The line is shared and active low. If it is already low (another device
+//    still over its watermark or we came back late) there is no need to wait.
+//
+//    Inputs,
+//
+//    event:       line structure
+//    timeout_ms:  maximum wait in ms (-1 = forever). Use it to bound the read latency.
+//
+//    Return,
+//
+//    1  line is low , time to drain the fifo
+//    0  timeout
+//    < 0 error
+//
+int GPIOEventWait(GPIOEventLine * event, int timeout_ms)
+{
+  struct gpio_v2_line_event edge[16];
+  struct epoll_event ev;
+  int rcode;
+
+  // drop the edges already handled by the last drain
+  while(epoll_wait(event->Epoll,&ev,1,0) > 0)
+   {
+     rcode = read(event->Line,edge,sizeof(edge));
+     if(rcode <= 0) break;
+     event->Edges += rcode / sizeof(struct gpio_v2_line_event);
+   }
+
+  // an edge after this check stays queued for epoll_wait, so none is lost
+  if(GPIOEventValue(event) == 0) return 1;
+
+  do
+   {
+     rcode = epoll_wait(event->Epoll,&ev,1,timeout_ms);
+   }while((rcode < 0) && (errno == EINTR));
+
+  if(rcode < 0) return -1;
+  if(rcode == 0) return 0;
+
+  rcode = read(event->Line,edge,sizeof(edge));
+  if(rcode < 0) return -1;
+  event->Edges += rcode / sizeof(struct gpio_v2_line_event);
+  return 1;
+}
+
+
+////////////////////////////////////   GPIOEventClose
+//
+void GPIOEventClose(GPIOEventLine * event)
+{
+  if(event->Epoll >= 0) close(event->Epoll);
+  if(event->Line >= 0) close(event->Line);
+  event->Epoll = -1;
+  event->Line = -1;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+typedef struct{
+  int Line;		// line request handle (gpio character device)
+  int Epoll;		// epoll handle waiting on Line
+  unsigned int Edges;	// number of edges seen
+}GPIOEventLine;
+
+int			GPIOEventOpen(GPIOEventLine * event, const char * chip, int offset);
+int			GPIOEventWait(GPIOEventLine * event, int timeout_ms);
+int			GPIOEventValue(GPIOEventLine * event);
+void			GPIOEventClose(GPIOEventLine * event);
@@ -14,7 +14,7 @@
 //
 //    Inputs,
 //
-//    BUS :  select  bus  (Rpi is 0 or 1)
+//    BUS :  select  bus  /dev/i2c-BUS (Rpi is 0 or 1 , more with a mux or extra adapters)
 //    SlaveAddress:  between 0x3 .. 0x77
 //
 //    Return,
@@ -44,7 +44,6 @@ int I2CWrapperOpen(int BUS, int SlaveAddress)
 	  char I2C_dev[256];
 
 	  if(BUS < 0) return -1;
-	  if(BUS > 1) return -1;
 
 	  sprintf(I2C_dev,"/dev/i2c-%d", BUS);
 
@@ -257,3 +256,123 @@ int I2CWrapperWriteWord(int handle,unsigned char cmd, unsigned short value)
 }
 
 
+////////////////////////////////////   I2CWrapperWriteBlock
+//
+//    Write N bytes  to the I2C device (maximum of 31 bytes possible)
+//
+//     inputs,
+//
+//     handle:   IO handle
+//     cmd:  Specify which is the device command (more or less the device function or register)
+//     size:     Number of bytes to write
+//     array:    the pointer array
+//
+//    Return   number of byte written if <0 error
+//
+int I2CWrapperWriteBlock(int handle, unsigned char cmd, unsigned char size, const void * array)
+{
+ struct i2c_smbus_ioctl_data  blk;
+ union i2c_smbus_data i2cdata;
+
+ if(size > I2C_SMBUS_BLOCK_MAX) return -1;
+
+ i2cdata.block[0]=size;
+ memcpy(&i2cdata.block[1],array,size);
+ blk.read_write=0;
+ blk.command=cmd;
+ blk.size=I2C_SMBUS_I2C_BLOCK_DATA;
+ blk.data= &i2cdata;
+
+  if(ioctl(handle,I2C_SMBUS,&blk)<0){
+    FailMessage("Unable to write I2C block data\n");
+    return -1;
+    }
+ return size;
+}
+
+
+////////////////////////////////////   I2CWrapperGeneralCall
+//
+//    Write N bytes to the I2C general call address (0). Every device on the bus get them.
+//    The slave address selected on the handle is not changed.
+//
+//     inputs,
+//
+//     handle:   IO handle
+//     size:     Number of bytes to write
+//     array:    the pointer array
+//
+//    Return   number of byte written if <0 error
+//
+int I2CWrapperGeneralCall(int handle, unsigned char size, const void * array)
+{
+ struct i2c_rdwr_ioctl_data  rdwr;
+ struct i2c_msg msg;
+
+ msg.addr=0;
+ msg.flags=0;
+ msg.len=size;
+ msg.buf=(unsigned char *) array;
+ rdwr.msgs=&msg;
+ rdwr.nmsgs=1;
+
+  if(ioctl(handle,I2C_RDWR,&rdwr)<0){
+    FailMessage("Unable to write I2C general call\n");
+    return -1;
+    }
+ return size;
+}
+
+
+////////////////////////////////////   I2CWrapperReadWriteBlock
+//
+//    Read N bytes then write M bytes in one I2C transaction (repeated starts , one I2C_RDWR).
+//    The read command gets the result of the previous request and the write starts the next one,
+//    without a second system call or bus arbitration between them.
+//
+//     inputs,
+//
+//     handle:        IO handle
+//     SlaveAddress:  device address (the handle selection is not used by I2C_RDWR)
+//     rcmd:          command of the read
+//     rsize:         Number of bytes to read
+//     rarray:        the read pointer array
+//     wcmd:          command of the write
+//     wsize:         Number of bytes to write (maximum of 31 bytes possible)
+//     warray:        the write pointer array
+//
+//    Return   number of byte read if <0 error
+//
+int I2CWrapperReadWriteBlock(int handle, int SlaveAddress, unsigned char rcmd, unsigned char rsize, void * rarray,
+                             unsigned char wcmd, unsigned char wsize, const void * warray)
+{
+ struct i2c_rdwr_ioctl_data  rdwr;
+ struct i2c_msg msgs[3];
+ unsigned char wbuf[I2C_SMBUS_BLOCK_MAX + 1];
+
+ if(wsize > I2C_SMBUS_BLOCK_MAX) return -1;
+
+ wbuf[0]=wcmd;
+ memcpy(&wbuf[1],warray,wsize);
+
+ msgs[0].addr=SlaveAddress;
+ msgs[0].flags=0;
+ msgs[0].len=1;
+ msgs[0].buf=&rcmd;
+ msgs[1].addr=SlaveAddress;
+ msgs[1].flags=I2C_M_RD;
+ msgs[1].len=rsize;
+ msgs[1].buf=(unsigned char *) rarray;
+ msgs[2].addr=SlaveAddress;
+ msgs[2].flags=0;
+ msgs[2].len=wsize+1;
+ msgs[2].buf=wbuf;
+ rdwr.msgs=msgs;
+ rdwr.nmsgs=3;
+
+  if(ioctl(handle,I2C_RDWR,&rdwr)<0){
+    FailMessage("Unable to read/write I2C data\n");
+    return -1;
+    }
+ return rsize;
+}
@@ -10,5 +10,9 @@ int 		 	I2CWrapperReadWord(int handle, unsigned char cmd);
 int			I2CWrapperReadByte(int handle, unsigned char cmd);
 int 			I2CWrapperWriteWord(int handle,unsigned char cmd, unsigned short value);
 int 			I2CWrapperWriteByte(int handle,unsigned char cmd, unsigned char value);
+int			I2CWrapperWriteBlock(int handle, unsigned char cmd, unsigned char size, const void * array);
+int			I2CWrapperGeneralCall(int handle, unsigned char size, const void * array);
+int			I2CWrapperReadWriteBlock(int handle, int SlaveAddress, unsigned char rcmd, unsigned char rsize, void * rarray,
+							 unsigned char wcmd, unsigned char wsize, const void * warray);
 
 #define I2CWrapperClose(HDL) close(HDL)
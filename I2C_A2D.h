@@ -17,6 +17,77 @@ typedef struct{
    unsigned char  Valid :1;
 }__attribute__((packed)) UnpackAnalog;
 
+typedef struct{
+   unsigned short A0 :10;
+   unsigned char  Inside0 :1;
+   unsigned char  Inside1 :1;
+   unsigned char  Event :1;
+   unsigned char  z0 :3;
+   unsigned short A1 :10;
+   unsigned char  z1 :2;
+   unsigned char  Overrun :3;
+   unsigned char  Valid :1;
+}__attribute__((packed)) EventAnalog;
+
+// single channel mode (command 13) , two successive samples per record
+
+typedef struct{
+  unsigned short S0 :10;
+  unsigned short S1 :10;
+  unsigned char  Overrun :3;
+  unsigned char  Valid :1;
+}__attribute__((packed)) DensePackAnalog;
+
+typedef struct{
+   unsigned short S0 :10;
+   unsigned char  z0 :6;
+   unsigned short S1 :10;
+   unsigned char  z1 :2;
+   unsigned char  Overrun :3;
+   unsigned char  Valid :1;
+}__attribute__((packed)) DenseUnpackAnalog;
+
+// timestamp record (command 15) , follows each data record read with command 03
+
+typedef struct{
+   unsigned short Low;
+   unsigned char  High;
+   unsigned char  z0 :7;
+   unsigned char  Valid :1;
+}__attribute__((packed)) StampAnalog;
+
+typedef struct{
+ unsigned short A0Low;
+ unsigned short A0High;
+ unsigned short A1Low;
+ unsigned short A1High;
+}__attribute__((packed)) A2D_Window;
+
+typedef struct{
+ unsigned short Period;		// in us
+ unsigned short Postscale;
+}__attribute__((packed)) A2D_HwTimer;
+
+typedef struct{
+ unsigned char Post;		// samples stored after the trigger , 0 = off
+ unsigned char Source;		// A2D_BURST_EDGE | A2D_BURST_WINDOW
+}__attribute__((packed)) A2D_Burst;
+
+// stored acquisition profile (command 17)
+
+typedef struct{
+ unsigned char  Tag;		// A2D_PROFILE_TAG = stored , 0 = device busy writing the eeprom
+ unsigned char  AutoStart;
+ unsigned short Timer;
+ unsigned char  ChannelMask;
+ unsigned char  EventControl;
+ A2D_Window     Window;
+ unsigned char  Watermark;
+ A2D_HwTimer    HwTimer;
+ unsigned char  RecordOptions;
+ A2D_Burst      Burst;
+}__attribute__((packed)) A2D_Profile;
+
 typedef struct  {
  unsigned char Id;
  unsigned char Tag;
@@ -35,12 +106,46 @@ typedef struct  {
 #define A2D_CMD_VERSION		7
 #define A2D_CMD_OSC_TUNE	8
 #define A2D_CMD_FLASH_SETTINGS  9
+#define A2D_CMD_EVENT		10
+#define A2D_CMD_WINDOW		11
+#define A2D_CMD_WATERMARK	12
+#define A2D_CMD_CHANNEL		13
+#define A2D_CMD_HW_TIMER	14
+#define A2D_CMD_RECORD		15
+#define A2D_CMD_AUTOSTART	16
+#define A2D_CMD_PROFILE		17
+#define A2D_CMD_BURST		18
+#define A2D_CMD_BURST_STATE	19
+
+#define A2D_GENERAL_CALL_TAG	0xE6
 
 #define A2D_MODE_OFF		0
 #define A2D_MODE_SINGLE		3
 #define A2D_MODE_TRIGGER     	5
 #define A2D_MODE_TIMER		7
 
+#define A2D_EVENT_OFF		0
+#define A2D_EVENT_A0		1
+#define A2D_EVENT_A1		2
+#define A2D_EVENT_PRE(N)	(((N) & 7) << 2)
+#define A2D_EVENT_POST(N)	(((N) & 7) << 5)
+
+#define A2D_CHANNEL_A0		1
+#define A2D_CHANNEL_A1		2
+#define A2D_CHANNEL_BOTH	3
+
+#define A2D_RECORD_STAMP	1
+
+#define A2D_PROFILE_TAG		0xA5
+
+#define A2D_BURST_EDGE		1
+#define A2D_BURST_WINDOW	2
+
+#define A2D_BURST_OFF		0
+#define A2D_BURST_ARMED		1
+#define A2D_BURST_TRIGGERED	2
+#define A2D_BURST_FROZEN	3
+
 
 #define A2DMode(HDL,MD) 		I2CWrapperWriteByte(HDL,A2D_CMD_MODE,MD)
 #define A2DReadVersion(HDL,VN) 		I2CWrapperReadBlock(HDL,A2D_CMD_VERSION,sizeof(A2D_Version),VN)
@@ -54,3 +159,20 @@ typedef struct  {
 #define A2DSetSlaveAddress(HDL,VALUE)  	I2CWrapperWriteByte(HDL,A2D_CMD_SLAVE_ADDRESS,VALUE);A2DFlashEeprom(HDL)
 #define A2DReadOscTune(HDL)            (char)I2CWrapperReadByte(HDL,A2D_CMD_OSC_TUNE)
 #define A2DSetOscTune(HDL,VALUE)	I2CWrapperWriteByte(HDL,A2D_CMD_OSC_TUNE,(unsigned char)VALUE)
+#define A2DEventControl(HDL,VALUE)	I2CWrapperWriteByte(HDL,A2D_CMD_EVENT,VALUE)
+#define A2DSetWindow(HDL,WINDOW)	I2CWrapperWriteBlock(HDL,A2D_CMD_WINDOW,sizeof(A2D_Window),WINDOW)
+#define A2DReadWindow(HDL,WINDOW)	I2CWrapperReadBlock(HDL,A2D_CMD_WINDOW,sizeof(A2D_Window),WINDOW)
+#define A2DWatermark(HDL,VALUE)		I2CWrapperWriteByte(HDL,A2D_CMD_WATERMARK,VALUE)
+#define A2DReadWatermark(HDL)		I2CWrapperReadByte(HDL,A2D_CMD_WATERMARK)
+#define A2DChannelMask(HDL,VALUE)	I2CWrapperWriteByte(HDL,A2D_CMD_CHANNEL,VALUE)
+#define A2DReadChannelMask(HDL)		I2CWrapperReadByte(HDL,A2D_CMD_CHANNEL)
+#define A2DHwTimer(HDL,HWTIMER)		I2CWrapperWriteBlock(HDL,A2D_CMD_HW_TIMER,sizeof(A2D_HwTimer),HWTIMER)
+#define A2DReadHwTimer(HDL,HWTIMER)	I2CWrapperReadBlock(HDL,A2D_CMD_HW_TIMER,sizeof(A2D_HwTimer),HWTIMER)
+#define A2DRecordOptions(HDL,VALUE)	I2CWrapperWriteByte(HDL,A2D_CMD_RECORD,VALUE)
+#define A2DReadRecordOptions(HDL)	I2CWrapperReadByte(HDL,A2D_CMD_RECORD)
+#define A2DAutoStart(HDL,MD)		I2CWrapperWriteByte(HDL,A2D_CMD_AUTOSTART,MD)
+#define A2DReadAutoStart(HDL)		I2CWrapperReadByte(HDL,A2D_CMD_AUTOSTART)
+#define A2DReadProfile(HDL,PROFILE)	I2CWrapperReadBlock(HDL,A2D_CMD_PROFILE,sizeof(A2D_Profile),PROFILE)
+#define A2DBurst(HDL,BURST)		I2CWrapperWriteBlock(HDL,A2D_CMD_BURST,sizeof(A2D_Burst),BURST)
+#define A2DReadBurst(HDL,BURST)		I2CWrapperReadBlock(HDL,A2D_CMD_BURST,sizeof(A2D_Burst),BURST)
+#define A2DReadBurstState(HDL)		I2CWrapperReadByte(HDL,A2D_CMD_BURST_STATE)
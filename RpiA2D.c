@@ -7,6 +7,9 @@
 //   Version: 1.0
 //   Processor: PIC12F1840
 //   Software: Microchip MPLAB IDE v8.90  with Hitech C (freeware version)
+//   Build:    picc --chip=12F1840 --summary=mem -ORpiA2D.hex RpiA2D.c
+//             The part has 256 bytes of RAM (3 banks of 80 + 16 common) and 4K words of flash.
+//             The fifo takes two banks , every other variable and the compiled stack share the rest.
 //   
 
 /*
@@ -42,6 +45,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
    RA3  MCLR
    RA4  Analog 1     (real analog 3)
    RA5  Trigger/Sync    I/O on input for edge detection interrupt in trigger mode. I/O on output  for start of conversion sync out.
+                        If the fifo watermark is set (command 12), RA5 is an open drain data ready output instead of sync out.
 
 Commands,
 
@@ -57,7 +61,7 @@ Commands,
      (16 bits)
        bit(0..15):    set the timing in 100us period. 
                            0 = not permitted
-                           1 = not permitted 
+                           1 = not permitted  (except in single channel mode, 10K samples/sec)
 			  Minimum = 2 (5K samples/sec)
                           Maximum = 65535  (0.153 samples/sec = 6.55 sec/sample)
        
@@ -118,7 +122,128 @@ Commands,
         (16bits)
          value as to be 0xAA55 otherwise the writing is not done
 
-        This will store the Settings structure into the eeprom.
+        This will store the Settings structure and the acquisition profile into the eeprom.
+
+
+  10: Event capture control (R/W)
+      (8 bits)
+         bit 0:      A0 window check enable
+         bit 1:      A1 window check enable
+         bit 2..4:   pre-context.  Number of samples (0..7) kept before an event
+         bit 5..7:   post-context. Number of samples (0..7) stored after an event
+
+       If bit 0 and bit 1 are both cleared, event capture is off and every conversion goes into the fifo.
+       Otherwise, in timer and trigger mode, a conversion is only stored into the fifo if one enabled
+       channel enter or leave its window, or if it is part of the pre/post context of such event.
+       The first conversion after a start is always an event. (give the initial window state)
+
+       With command 03 , the first word hold the event information
+                       bit 10          A0 inside window
+                       bit 11          A1 inside window
+                       bit 12          1= this sample is the event (window transition)  0= context sample
+       Command 04 (packed data) doesn't have room for the event bits.
+
+  11: Window limits (R/W)
+      (64 bits) => 4 x 16 bits
+         A0 low, A0 high, A1 low, A1 high    (10 bits value)
+         A channel is inside its window when  low <= value <= high.
+         For a simple threshold, set low to 0 or high to 1023.
+
+  12: Fifo watermark (R/W)
+      (8 bits)
+         0     = off (default). RA5 is the timer sync out.
+         1..39 = RA5 is pulled low when the number of data in the fifo reach the watermark
+                 and released when the master read the fifo below it.
+       RA5 works as open drain with the weak pull-up, so many devices could share the same line.
+       Not available in trigger mode since RA5 is the trigger input. Set it while the A/D is stopped.
+
+  13: Channel mask (R/W)
+      (8 bits)
+         bit 0:   A0
+         bit 1:   A1
+         3 = both channels (default).  0 is the same as 3.
+
+       With only one channel selected, timer and trigger mode convert only that channel.
+       Two successive samples are packed into one fifo entry, so the fifo hold 80 samples
+       and the timer minimum is 1 (10K samples/sec). Single shot mode always converts both channels.
+
+       Command 03:  first word bit 0..9 = sample n     second word bit 0..9 = sample n+1
+       Command 04:  bit 0..9 = sample n  bit 10..19 = sample n+1
+       Overrun count is in fifo entries (2 samples). Event capture is not done in single channel mode.
+
+  14: Hardware timer (R/W)
+      (32 bits) => 2 x 16 bits
+         bit 0..15:   period in 1us  (Timer1 , 32Mhz/4/8)
+                           0 = off. Timer mode use the 100us software timer of command 01.
+                           Minimum = 100 (10K samples/sec) , 50 in single channel mode (20K samples/sec)
+         bit 16..31:  postscaler. One conversion every postscaler periods. 0 is the same as 1.
+
+       The conversion is started by the CCP1 special event trigger. No interrupt is needed to start it,
+       the sample clock is exact to 1us and the A/D interrupt is the only one left for a postscaler of 1.
+       With a postscaler, one short CCP1 interrupt is done every period. (ex: 50000us * 100 = 5 sec/sample)
+       Writing command 01 sets the hardware timer back to off.
+       The RA5 sync out pulse comes at the end of the first conversion (~15us after the sample clock).
+
+  General call (I2C address 0)
+       All the devices on the bus receive the same command at the same time.
+       Frame:  address 0 (write) , tag 0xE6 , command , data ...
+       Only command 00 (start/stop), 01 (timer) and 14 (hardware timer) are accepted.
+       A start sent this way begins the acquisition of every device within the same 100us tick.
+       Nothing could be read with the general call.
+
+  15: Record options (R/W)
+      (8 bits)
+         bit 0:   timestamp. A stamp record follows each data record in the fifo. (fifo hold 19 samples)
+      Set it while the A/D is stopped.
+
+       Stamp record (command 03):
+                       bit 0..15       stamp bit 0..15
+                       bit 16..23      stamp bit 16..23
+                       bit 24..30      0(zero)
+                       bit 31          Valid
+       The stamp is taken when the conversion start.
+         Timer mode:          sample number (Timer counter of command 06) , 24 bits
+         Trigger/Single mode: 1us free running Timer1 , 24 bits (wrap every 16.7 sec)
+       In single channel mode, one stamp for the two samples of the entry.
+       Command 04 (packed data) doesn't have room for the stamp record.
+
+  16: Autostart (R/W)
+      (8 bits)
+         Command 00 mode to start on power-up. 0 = off (default)
+       It is stored with command 09 with the acquisition profile:
+       timer (01), channel mask (13), event control (10), window limits (11), watermark (12),
+       hardware timer (14), record options (15) and burst control (18).
+       On power-up the profile is loaded and the acquisition start right away, without the master.
+
+  17: Stored profile (Read only)
+      (176 bits) => 22 bytes, read from the eeprom
+         byte 0:       0xA5 = profile stored.  0xff = none  0 = busy writing the eeprom (command 09)
+         byte 1:       autostart
+         byte 2..3:    timer
+         byte 4:       channel mask
+         byte 5:       event control
+         byte 6..13:   window limits
+         byte 14:      watermark
+         byte 15..18:  hardware timer
+         byte 19:      record options
+         byte 20..21:  burst control
+
+  18: Burst control (R/W)
+      (16 bits)
+         bit 0..7:    post-trigger samples (1..38). 0 = burst off (default)
+         bit 8:       trigger on RA5 rising edge
+         bit 9:       trigger on a window transition (command 10 bit 0..1 select the channels , 11 the limits)
+
+       Oscilloscope mode. In timer mode the fifo becomes circular, the oldest sample is dropped when it is full.
+       On the trigger, the post-trigger samples are stored then the acquisition stop (Control reads 0).
+       The fifo keep the pre-trigger history and the trigger sample has bit 12 of the first word set (command 03).
+       With the RA5 trigger, RA5 is an input (no sync out). Otherwise RA5 works as the watermark line
+       once the burst is frozen (command 12).
+       Use the fastest timer settings (command 01 , 13 or 14) to get the full rate.
+
+  19: Burst state (Read only)
+      (8 bits)
+         0 = off   1 = armed   2 = triggered   3 = frozen (the fifo hold the burst)
 
 */
 
@@ -139,14 +264,14 @@ __IDLOC(0000);
 #define IDTAG  0xE7
 #define MARKERTAG 0xC3
 #define MAJOR_VERSION 1
-#define MINOR_VERSION 0
+#define MINOR_VERSION 8
 
 
 
 
 ////////////////   eerom storage 
 
-__EEPROM_DATA(0x20,4,0xff,0xff,0xff,0xff,0xff,0xff);  // needs to have 8 byte. This only hold the I2C Address and OSCTUNE for now
+__EEPROM_DATA(0x20,4,0xff,0xff,0xff,0xff,0xff,0xff);  // needs to have 8 byte. I2C Address , OSCTUNE and no acquisition profile
 
 // set the __EEPROM_DATA  according to the following structure
 typedef struct {
@@ -202,7 +327,35 @@ near volatile unsigned char  FirstOut=0;    // This is the First Out index
 
 near volatile unsigned char  OverrunCount=0;              // This is the number of Overrun. (How many time we can't increase First In index because First Out  is full)
 
+////////////  Event capture
+volatile unsigned char  EventControl=0;               // command 10. bit 0..1 channel window enable, bit 2..4 pre-context, bit 5..7 post-context
+volatile unsigned short WindowLimit[4]={0,1023,0,1023};   // command 11. A0 low, A0 high, A1 low, A1 high
+volatile unsigned char  EventInside;                  // last inside window state (bit 0: A0, bit 1: A1). 0xff = unknown
+volatile unsigned char  PendingCount;                 // number of pre-context samples held after FirstIn (not visible to the master yet)
+volatile unsigned char  PostCount;                    // number of post-context samples still to store
+
+#define EVENT_INSIDE0   0x0400                        // fifo A0 word flags
+#define EVENT_INSIDE1   0x0800
+#define EVENT_FLAG      0x1000
+
+////////////  Fifo watermark
+volatile unsigned char  Watermark=0;                  // command 12. 0= off  otherwise RA5 goes low when the fifo count reach it
+
+////////////  Channel selection
+volatile unsigned char  ChannelMask=3;                // command 13. bit 0: A0  bit 1: A1
+volatile unsigned char  A2DChannel=0b00000001;        // ADCON0 value of the first conversion
+volatile bit DenseMode;                               // single channel. Two samples per fifo entry
+volatile bit DenseHalf;                               // 1= first sample of the entry is in _tempAnalogValue
+
 ////////////  Timing
+typedef struct{
+  unsigned short Period;                              // command 14. Timer1 period in 1us. 0 = off
+  unsigned short Postscale;                           // conversion on every Postscale period
+}HwTimerStruct;
+
+volatile HwTimerStruct HwTimer={0,1};
+volatile unsigned short HwPostCount;                  // periods left before the next conversion
+volatile bit HwTimerRun;                              // timer mode is using Timer1/CCP1
 near volatile unsigned short  TargetTimer=10000;    // this is the Timer target value from command  1  Default = 10000 (1 sample/sec)
 near volatile unsigned short CurrentTimer=10000;     // This  is the current value of the software timer. when it reaches Zero, a conversion start and it is reload with Reg_Timing.
 
@@ -221,7 +374,93 @@ typedef union{
 
 
 volatile  IntegersStruct TimerCounter;				// This is the total  number of start conversion in  TimerMode.
-volatile  IntegersStruct _TimerCounter;
+
+////////////  Record stamp
+#define RECORD_STAMP  1
+
+volatile unsigned char RecordOptions;                 // command 15. bit 0: a stamp record follows each data record
+volatile IntegersStruct Stamp;                        // stamp of the last conversion start
+volatile unsigned char StampHigh;                     // Timer1 overflow count , bit 16..23 of the 1us stamp
+volatile bit StampRun;                                // Timer1 is free running for the stamp (single & trigger mode)
+
+////////////  Burst capture
+typedef struct{
+  unsigned char Post;                                 // command 18. samples stored after the trigger. 0 = off
+  unsigned char Source;                               // trigger source
+}BurstStruct;
+
+#define BURST_EDGE      1                             // RA5 rising edge
+#define BURST_WINDOW    2                             // window transition (command 10 & 11)
+
+#define BURST_OFF       0                             // BurstState , command 19
+#define BURST_ARMED     1                             // sampling into the circular fifo
+#define BURST_TRIGGERED 2                             // storing the post-trigger samples
+#define BURST_FROZEN    3                             // done. the fifo hold the burst
+
+volatile BurstStruct Burst;
+volatile unsigned char BurstState;
+volatile unsigned char BurstCount;                    // post-trigger samples left
+volatile bit BurstEdge;                               // trigger seen, mark the next stored sample
+////////////  Acquisition profile
+// Stored into the eeprom after the Settings with command 09 and loaded on power-up.
+// If AutoStart is set, the acquisition resume right after LoadProfile().
+
+#define PROFILE_EEPROM  2                             // eeprom address of the profile
+#define PROFILE_TAG     0xA5                          // first profile byte. Anything else = no profile stored
+#define PROFILE_SIZE    22                            // tag + all the fields
+
+volatile unsigned char AutoStart;                     // command 16. command 00 mode on power-up. 0 = off
+
+typedef struct{
+  volatile unsigned char * Address;
+  unsigned char  Size;
+}ProfileStruct;
+
+#define PROFILE_COUNT   9
+
+const ProfileStruct ProfileTable[PROFILE_COUNT]={
+   { &AutoStart,                                1},
+   { (volatile unsigned char *) &TargetTimer,   2},
+   { &ChannelMask,                              1},
+   { &EventControl,                             1},
+   { (volatile unsigned char *) WindowLimit,    8},
+   { &Watermark,                                1},
+   { (volatile unsigned char *) &HwTimer,       4},
+   { &RecordOptions,                            1},
+   { (volatile unsigned char *) &Burst,         2}
+};
+
+void LoadProfile(void)
+{
+  unsigned char idx,loop;
+  unsigned char address=PROFILE_EEPROM;
+
+  if(eeprom_read(address++) != PROFILE_TAG) return;     // keep the defaults
+
+  for(loop=0;loop<PROFILE_COUNT;loop++)
+    for(idx=0;idx<ProfileTable[loop].Size;idx++)
+      ProfileTable[loop].Address[idx]= eeprom_read(address++);
+}
+
+void SaveProfile(void)
+{
+  unsigned char idx,loop;
+  unsigned char address=PROFILE_EEPROM+1;
+
+  eeprom_write(PROFILE_EEPROM,0xff);                    // not valid until all written
+  for(loop=0;loop<PROFILE_COUNT;loop++)
+    for(idx=0;idx<ProfileTable[loop].Size;idx++)
+      eeprom_write(address++, ProfileTable[loop].Address[idx]);
+  eeprom_write(PROFILE_EEPROM,PROFILE_TAG);
+}
+
+// profile byte for command 17. Nothing is read while main is writing the eeprom
+unsigned char ProfileByte(unsigned char idx)
+{
+  if(SaveSettingsFlag) return 0;
+  return eeprom_read(PROFILE_EEPROM + idx);
+}
+
 ////////  I2C handling   variable
 
 near volatile union {
@@ -243,8 +482,62 @@ near volatile union {
 near volatile bit   GotCommandFlag=0;	// I2C interrupts flag to specify we have the command bytes. We wont use bit since we don't want to use the same byte to hold the bit
 near volatile unsigned char I2CCommand;                // I2C Command
 near volatile unsigned char I2CByteCount;			// I2C Byte Data counter. This is use to verify when we should increment First out counter
-near volatile  unsigned short I2CShortData;          // temporary variable to hold i2c short value;
-near volatile unsigned char _tempFirstIn;            // temporary variable to hold FirstIn Fifo pointer.
+near volatile unsigned char I2CTxByte;               // next byte to send. Prepared in advance so the master read only load SSPBUF
+near volatile unsigned char I2CTxIndex;              // index of I2CTxByte in the response
+near volatile unsigned char I2CTxSize;               // response size (record size for the fifo commands)
+volatile unsigned char * I2CTxSource;                // response bytes
+volatile unsigned char I2CStage[8];                  // computed response or received data bytes
+volatile bit I2CTxFifo;                              // response is a stream of fifo records
+volatile bit I2CTxEeprom;                            // response is the eeprom profile
+volatile bit I2CRecordValid;                         // the record in I2CStage is from the fifo (not an underrun)
+volatile bit I2CStaged;                              // response prepared when the command byte was received
+volatile bit I2CReading;                             // the master reads us , from the read address to its NACK
+volatile unsigned char I2CGeneralCall;               // 0 = our address  1 = general call, wait for tag  2 = tag ok  3 = not for us
+
+#define GENERAL_CALL_TAG  0xE6                       // first byte after the general call address
+
+////////  I2C command table
+// For each command, the memory the master read from or write to and its size.
+// Written bytes go into I2CStage and are copied once all of them are received.
+
+#define CMD_READ    1
+#define CMD_WRITE   2
+#define CMD_STAGE   4          // response is computed into I2CStage
+#define CMD_FIFO    8          // response is a stream of fifo records
+
+typedef struct{
+  volatile unsigned char * Address;
+  unsigned char  Size;
+  unsigned char  Flags;
+}I2CCommandStruct;
+
+#define CMD_EEPROM 16          // response is read from the eeprom profile
+
+#define I2C_CMD_COUNT  20
+
+const I2CCommandStruct I2CCommandTable[I2C_CMD_COUNT]={
+   { I2CStage,                                 1, CMD_READ | CMD_WRITE | CMD_STAGE},  // 00 control
+   { (volatile unsigned char *) &TargetTimer,  2, CMD_READ | CMD_WRITE},              // 01 timer
+   { I2CStage,                                 1, CMD_READ | CMD_STAGE},              // 02 data count
+   { I2CStage,                                 4, CMD_READ | CMD_FIFO},               // 03 data
+   { I2CStage,                                 3, CMD_READ | CMD_FIFO},               // 04 packed data
+   { 0,                                        1, CMD_WRITE},                         // 05 i2c address
+   { I2CStage,                                 4, CMD_READ | CMD_STAGE},              // 06 timer counter
+   { I2CStage,                                 4, CMD_READ | CMD_STAGE},              // 07 version
+   { (volatile unsigned char *) &Settings.OscTune, 1, CMD_READ | CMD_WRITE},          // 08 osc tune
+   { 0,                                        2, CMD_WRITE},                         // 09 flash settings
+   { &EventControl,                            1, CMD_READ | CMD_WRITE},              // 10 event control
+   { (volatile unsigned char *) WindowLimit,   8, CMD_READ | CMD_WRITE},              // 11 window limits
+   { &Watermark,                               1, CMD_READ | CMD_WRITE},              // 12 watermark
+   { &ChannelMask,                             1, CMD_READ | CMD_WRITE},              // 13 channel mask
+   { (volatile unsigned char *) &HwTimer,      4, CMD_READ | CMD_WRITE},              // 14 hardware timer
+   { &RecordOptions,                           1, CMD_READ | CMD_WRITE},              // 15 record options
+   { &AutoStart,                               1, CMD_READ | CMD_WRITE},              // 16 autostart
+   { 0,                             PROFILE_SIZE, CMD_READ | CMD_EEPROM},             // 17 stored profile
+   { (volatile unsigned char *) &Burst,        2, CMD_READ | CMD_WRITE},              // 18 burst control
+   { &BurstState,                              1, CMD_READ}                           // 19 burst state
+};
+
 //////////  I2C Initialization routine
 void I2CInit()
 {
@@ -254,7 +547,7 @@ TRISA		= 0b00111111;	// ALL INPUT
 // i2c init
 SSP1ADD  = Settings.I2C_Address << 1;
 SSP1CON1 = 0b00110110;
-SSP1CON2 = 0b00000001;
+SSP1CON2 = 0b10000001;   // general call enable and clock stretching
 SSP1CON3 = 0b00000011;
 SSP1STAT = 0b11000000;
 SSP1MSK  = 0xff;
@@ -268,22 +561,6 @@ CommandRun=0;
 }
 
 
-/////////////  I2C Write byte routine
-void I2CWrite(unsigned char value)
-{
-   while(SSP1STATbits.BF);
-
-    do 
-    {
-    SSP1CON1bits.WCOL=0;
-    SSP1BUF = value;
-    if(SSP1CON1bits.WCOL) continue;
-//    SSP1CON1bits.CKP=1;
-    break;
-    }while(1);
-} 
-
-
 void Timer0Init()
 {
  TMR0IE=0;  // disable interrupt for now
@@ -296,6 +573,9 @@ void Timer0Init()
 // 32MHZ / 4 = 125ns => 20 us =   160 => 256-160= 96
 #define DelayStart() TMR0=96; TMR0IF=0;TMR0IE=1;
 
+#define ADC_AN0  0b00000001     // ADCON0 analog channel 0 with A/D on
+#define ADC_AN3  0b00001101     // ADCON0 analog channel 3 with A/D on
+
 
 
 
@@ -308,14 +588,63 @@ ADIF=0;
 FVRCON=0b11000010;  // Vref internal 2.048V on ADC
 }
 
+// Timer1 free running at 1us for the record stamp in single and trigger mode.
+// It keeps running between single shots so they share the same time base.
+void EnableStampTimer()
+{
+ if(StampRun) return;
+ T1CON=0;
+ TMR1H=0;
+ TMR1L=0;
+ StampHigh=0;
+ TMR1IF=0;
+ TMR1IE=1;
+ StampRun=1;
+ T1CON= 0b00110001;        // Fosc/4 , prescaler 8 , timer on
+}
+
+void DisableStampTimer()
+{
+ if(StampRun)
+  {
+    StampRun=0;
+    T1CON=0;
+    TMR1IE=0;
+    TMR1IF=0;
+  }
+}
+
+// Keep the time of the conversion start. Called from interrupt only.
+// Timer mode use the sample number (TimerCounter), the other modes the 24 bits 1us Timer1 count.
+void CaptureStamp()
+{
+ if((RecordOptions & RECORD_STAMP)==0) return;
+ if(DenseMode && DenseHalf) return;      // one stamp for the two samples of the entry
+ if(CommandMode.bits.TimerMode==1)
+   {
+     Stamp.dword = TimerCounter.dword;
+     return;
+   }
+ do
+  {
+    Stamp.byte[1]=TMR1H;
+    Stamp.byte[0]=TMR1L;
+  }while(Stamp.byte[1] != TMR1H);
+ Stamp.byte[2]=StampHigh;
+ if(TMR1IF && ((Stamp.byte[1] & 0x80)==0))
+   Stamp.byte[2]++;                      // overflow not counted yet
+ Stamp.byte[3]=0;
+}
+
 void A2DStart()
 {
    // Star conversion for Analog 0
+ CaptureStamp();                 // time of this sample
  Analog0Flag=0;                  // tell system that we are doing the analog 0 channel
  ADIE=0;                              // clear interrupt flag
  ADIF=0;
  ADON=1;
- ADCON0=1;                      //  channel 0
+ ADCON0=A2DChannel;             //  channel 0  (or channel 3 in single channel A1 mode)
  DelayStart();                  // get 6us delay to charge cap. using timer0
 }
 
@@ -346,7 +675,8 @@ void EnableTimer()
 // clock of 32Mhz give  125 ns   100us / 125ns = 800
 // 800 / prescaler of 4 = 200 start count
  RA5=0;
- TRISAbits.TRISA5=0;     //RA5 output mode
+ if(Watermark==0)
+   TRISAbits.TRISA5=0;     //RA5 output mode
 RA5=0;
 T2CON=0;
  PR2 = 200;   //adjust to 199
@@ -361,343 +691,480 @@ OSCTUNE=Settings.OscTune;
 }
 
 
+// Hardware sample clock.
+// Timer1 count 1us (32Mhz /4 /8) and CCP1 in compare mode with special event trigger
+// reset Timer1 and start the A/D conversion on each period. The channel is already selected
+// so the acquisition time is the time between samples.
+void EnableHwTimer()
+{
+ RA5=0;
+ if(Watermark==0)
+   TRISAbits.TRISA5=0;     //RA5 output mode
+ T1CON=0;
+ CCP1CON=0;
+ TMR1H=0;
+ TMR1L=0;
+ CCPR1H= (HwTimer.Period-1) >> 8;
+ CCPR1L= (HwTimer.Period-1) & 0xff;
+ HwPostCount= HwTimer.Postscale;
+ TimerCounter.dword=0;
+ OSCTUNE=Settings.OscTune;
+ Analog0Flag=0;
+ ADIF=0;
+ if(HwTimer.Postscale > 1)
+   ADCON0=0;               // the CCP1 interrupt will enable the A/D one period before the conversion
+ else
+   ADCON0=A2DChannel;
+ ADIE=1;
+ CCP1IF=0;
+ CCP1IE= HwTimer.Postscale > 1 ? 1 : 0;
+ HwTimerRun=1;
+ CCP1CON= 0b00001011;      // compare mode, special event trigger
+ T1CON= 0b00110001;        // Fosc/4 , prescaler 8 , timer on
+}
+
+
 void DisableTimer()
 {
  TRISAbits.TRISA5=1;      
  TMR2IE=0;
  T2CON=0;
  TMR2IF=0;
+ if(HwTimerRun)
+  {
+    HwTimerRun=0;
+    T1CON=0;
+    CCP1CON=0;
+    CCP1IE=0;
+    CCP1IF=0;
+    ADIE=0;
+    ADCON0=0;
+  }
 }
 
 
+// Pull RA5 low (open drain) if the fifo reach the watermark
+// otherwise let the pull-up bring it back high.
+void UpdateWatermark()
+{
+  unsigned char count;
 
+  if(Watermark==0) return;
+  if(CommandMode.bits.TriggerMode==1) return;
+  if(BurstState)
+    {  // RA5 is the trigger input, or nothing to tell until the burst is frozen
+      if((BurstState != BURST_FROZEN) || (Burst.Source & BURST_EDGE)) return;
+    }
 
-///////   Interrupts I2C handler
-void ssp_handlerB(void)
+  if(FirstIn >= FirstOut)
+     count = FirstIn - FirstOut;
+  else
+     count = BUF_SIZE - FirstOut + FirstIn;
+
+  if(count >= Watermark)
+    {
+      LATA5=0;
+      TRISA5=0;
+    }
+  else
+      TRISA5=1;
+}
+
+
+
+
+// Start or stop the acquisition  (command 0)
+void StartMode(unsigned char mode)
 {
-    unsigned int i, stat;
-    unsigned char data;
+  CommandRun= (mode &1)==1 ? 1 : 0;
+  if(CommandRun==0)
+   {
+     DisableTrigger();
+     DisableTimer();
+     DisableStampTimer();
+     if(BurstState != BURST_FROZEN)
+        BurstState=BURST_OFF;
+     return;
+   }
 
-        if (SSPOV == 1)
-        {
-            SSPOV = 0;  //clear overflow
-            data = SSPBUF;
-        }
-        else
-        {
-            stat = SSPSTAT;
-            stat = stat & 0b00101101;
-            //find which state we are in
-            //state 1 Master just wrote our address
-            if ((stat ^ 0b00001001) == 0) //S=1 && RW==0 && DA==0 && BF==1
+  CurrentTimer= TargetTimer;
+  FirstIn=0;
+  FirstOut=0;
+  OverrunCount=0;
+  PendingCount=0;
+  PostCount=0;
+  EventInside=0xff;
+  DenseHalf=0;
+  BurstState=BURST_OFF;
+  BurstEdge=0;
+  if(((mode & 4)==0) || (ChannelMask==3))
+    {
+      DenseMode=0;
+      A2DChannel=ADC_AN0;
+    }
+  else
+    {
+      DenseMode=1;
+      A2DChannel= ChannelMask==2 ? ADC_AN3 : ADC_AN0;
+    }
+
+  if((mode & 4) ==0)
+    {  // single capture mode
+      CommandMode.byte = 1;
+      TRISA5 = 1;
+      DisableTrigger();
+      DisableTimer();
+      if(RecordOptions & RECORD_STAMP)
+         EnableStampTimer();
+      A2DStart();
+    }
+  else if((mode & 2) == 0)
+    {  // Trigger mode
+      CommandMode.byte= 2;
+      DisableTimer();
+      if(RecordOptions & RECORD_STAMP)
+         EnableStampTimer();
+      EnableTrigger();
+    }
+  else
+    {  // timer mode
+      CommandMode.byte=4;
+      DisableTrigger();
+      DisableTimer();
+      DisableStampTimer();      // Timer1 could be the hardware sample clock
+      if(Burst.Post)
+         BurstState=BURST_ARMED;
+      if(HwTimer.Period)
+         EnableHwTimer();
+      else
+         EnableTimer();
+      if(BurstState && (Burst.Source & BURST_EDGE))
+         EnableTrigger();       // RA5 is the burst trigger input, no sync out
+    }
+}
+
+
+// Copy the next fifo record into I2CStage in the command 03 (4 bytes) or command 04 (3 bytes) format
+void I2CStageRecord(void)
+{
+  unsigned char data;
+
+  if(FirstIn == FirstOut)
+    {  // underrun. Valid bit is 0
+      I2CRecordValid=0;
+      I2CStage[0]=0;
+      I2CStage[1]=0;
+      I2CStage[2]=0;
+      I2CStage[3]=0;
+      return;
+    }
+
+  I2CRecordValid=1;
+  I2CStage[0]= FiFo_A0[FirstOut].lsb;
+  if(I2CCommand==3)
+    {
+      I2CStage[1]= FiFo_A0[FirstOut].msb;
+      I2CStage[2]= FiFo_A1[FirstOut].lsb;
+      data = FiFo_A1[FirstOut].msb << 2;  // get overrun and valid stuff
+      data &= 0xf0;
+      data |= (FiFo_A1[FirstOut].msb) & 0x3; // get bit 8&9
+      I2CStage[3]= data;
+    }
+  else
+    {
+      data = (FiFo_A0[FirstOut].msb) & 0x03;
+      data|=  (FiFo_A1[FirstOut].lsb << 2) & 0xfc;
+      I2CStage[1]= data;
+      I2CStage[2]= (FiFo_A1[FirstOut].word >>6);
+    }
+}
+
+
+// Set the response for I2CCommand and prepare its first byte
+void I2CPrepareResponse(void)
+{
+  unsigned char flags;
+
+  I2CTxIndex=0;
+  I2CTxSize=0;
+  I2CTxFifo=0;
+  I2CTxEeprom=0;
+  I2CTxByte=0;
+
+  if(I2CCommand >= I2C_CMD_COUNT) return;
+  flags = I2CCommandTable[I2CCommand].Flags;
+  if((flags & CMD_READ)==0) return;
+
+  I2CTxSource = I2CCommandTable[I2CCommand].Address;
+  I2CTxSize   = I2CCommandTable[I2CCommand].Size;
+
+  if(flags & CMD_STAGE)
+   switch(I2CCommand)
+    {
+      case 0:  // reconstruct Control
+               I2CStage[0] = CommandRun;
+               if(CommandMode.bits.TriggerMode==1)
+                  I2CStage[0] |= 0x4;
+               else if(CommandMode.bits.TimerMode==1)
+                  I2CStage[0] |= 0x7;
+               break;
+      case 2:  // number of data in fifo
+               if(FirstIn >= FirstOut)
+                  I2CStage[0] = FirstIn - FirstOut;
+               else
+                  I2CStage[0] = BUF_SIZE - FirstOut + FirstIn;
+               break;
+      case 6:  I2CStage[0] = TimerCounter.byte[0];    // staged like the version , no 4 bytes copy
+               I2CStage[1] = TimerCounter.byte[1];
+               I2CStage[2] = TimerCounter.byte[2];
+               I2CStage[3] = TimerCounter.byte[3];
+               break;
+      case 7:  I2CStage[0] = IDTAG;
+               I2CStage[1] = MARKERTAG;
+               I2CStage[2] = MAJOR_VERSION;
+               I2CStage[3] = MINOR_VERSION;
+               break;
+    }
+
+  if(flags & CMD_FIFO)
+    {
+      I2CTxFifo=1;
+      I2CStageRecord();
+    }
+  if(flags & CMD_EEPROM)
+    {
+      I2CTxEeprom=1;
+      I2CTxByte = ProfileByte(0);
+      return;
+    }
+  I2CTxByte = I2CTxSource[0];
+}
+
+
+// The byte at I2CTxIndex is on its way to the master. Prepare the next one.
+// This runs after the clock is released.
+void I2CNextByte(void)
+{
+  I2CTxIndex++;
+  if(I2CTxFifo)
+    {
+      if(I2CTxIndex >= I2CTxSize)
+        {  // the whole record is sent
+          if(I2CRecordValid)
             {
-//                for (i=0; i<BUF_SIZE; ++i) //clear buffer
-//                    buf[i] = 0;
-                I2CByteCount=0;
-                GotCommandFlag=0;
-                //ReportAddress = SSPBUF; //read address so we know later if read or write
-                data=SSPBUF;
+              FirstOut++;
+              if(FirstOut>=BUF_SIZE) FirstOut=0;
+              UpdateWatermark();
             }
-            //state 2 Master just wrote data
-            else if ((stat ^ 0b00101001) == 0) //S=1 && RW==0 && DA==1 && BF==1
-            {
-                data = SSPBUF;
-                if(GotCommandFlag)
-                 {
-
-                       if(I2CCommand==0)
-                         {
-                                 //  run mode 
-                               if(I2CByteCount==0)
-                                 {
-
-                                    CommandRun= (data &1)==1 ? 1 : 0;
-                                      if(CommandRun==0)
-                                      {
-                                          DisableTrigger();
-                                          DisableTimer();
-                                     }
-                                    else
-                                     {                                     
-					       CurrentTimer= TargetTimer;
-                                           FirstIn=0;
-                                           FirstOut=0;
-                                           OverrunCount=0;
-                                    if((data & 4) ==0)
-                                    {  // single capture mode
-                                        CommandMode.byte = 1;
-                                   
-                                        TRISA5 = 1;
-                                        DisableTrigger();
-                                        DisableTimer();
-                                        A2DStart();
-                                   }
-                                  else if((data & 2) == 0)
-                                    {  // Trigger mode
-                                          CommandMode.byte= 2;
-                                           DisableTimer();
-                                           EnableTrigger();
-                                    }
-                                 else
-                                   {  // timer mode
-                                          CommandMode.byte=4;
-                                           DisableTrigger();
-                                           EnableTimer();
-                                   }
-                                  }
-                                  }
-                         }
-                       else if(I2CCommand==1)
-                        {  // Timer settings
-                                   if(I2CByteCount==0)
-                                          I2CShortData= data;
-                                   else if(I2CByteCount ==1)
-                                     {
-                                         I2CShortData += ((unsigned short) data << 8);
-                                         if(I2CShortData < 2)
-                                         TargetTimer = 2;   // minimum is 5Khz
-                                        else
-                                         TargetTimer = I2CShortData;
-                                     } 
-                                   else
-                                            I2CByteCount=1;  // limit the byte count since it is a word       
-                       }
-                        else if(I2CCommand==5)
-                            {   // change I2C_channel
-                                if(I2CByteCount==0)
-                                 if(data > 0x2)
-                                   if(data < 0x78)
-                                       {
-                                         // ok we are allowed to change Adress
-                                         // will be only effective if it is save on flash
-                                                 Settings.I2C_Address=data;
-                                                 // tell main program to save and reload
-                                        }
-                            } 
-                         else if(I2CCommand==8)
-                             {  //  Oscillator tune
-                                      if(I2CByteCount==0)
-                                         {
-                                           if((data & 0x20)==0x20)
-                                               data |= 0xC0;
-                                              else
-                                               data &= 0x1F;
-                                            Settings.OscTune = data;
-
-                                         }
-                             }  
-
-
-                         else if(I2CCommand==9)
-                             {  //  write flash
-                                                                             
-                                       if(I2CByteCount==0)
-                                         {
-                                             if(data != 0x55)
-                                                    I2CByteCount=2;
-                                         }
-                                     else if(I2CByteCount==1)
-                                         {
-                                              if(data == 0xaa)
-                                                SaveSettingsFlag=1;
-                                         }
-                             }  
-                    I2CByteCount++;
-                 }
-              else
-               {
-                   I2CCommand = data;
-                   GotCommandFlag=1;
-               } 
+          I2CStageRecord();
+          I2CTxIndex=0;
         }
-     		  //state 3  & 4 Master want to read data 
-              else if ((stat & 0b00001100) == 0b00001100)     
-//            else if ((stat ^ 0b00001100) == 0) //S=1 && RW==1 && DA==0 && BF==0
-//            else if ((stat ^ 0b00101100) == 0) //S=1 && RW==1 && DA==1 && BF==0            
+      I2CTxByte = I2CStage[I2CTxIndex];
+    }
+  else if(I2CTxIndex >= I2CTxSize)
+      I2CTxByte = 0;
+  else if(I2CTxEeprom)
+      I2CTxByte = ProfileByte(I2CTxIndex);
+  else
+      I2CTxByte = I2CTxSource[I2CTxIndex];
+}
+
+
+// Data byte written by the master. Once all the command bytes are received
+// they are copied to the command memory and checked.
+void I2CWriteData(unsigned char data)
 {
-                if((stat & 0b00100000)==0)
-               {
-                I2CByteCount=1;
-                //ReportAddress = SSPBUF;
-                data=SSPBUF;
-               }
+  unsigned char idx;
+  unsigned char size;
+  volatile unsigned char * address;
 
-                  if(I2CCommand==0)
-                         { // reconstruct Control
-                             if(I2CByteCount==1)
-                              {
-                               data = CommandRun;
-                               if(CommandMode.bits.TriggerMode==1)
-                                  data |= 0x4;
-                              else if(CommandMode.bits.TimerMode==1)
-                                  data |= 0x7;
-                              }
-                             else
-                                   data=0;
-                       }
-                  else if(I2CCommand ==1)
-                   {// timer
-                        if(I2CByteCount==1)
-                             data = TargetTimer & 0xff;
-                        else if(I2CByteCount == 2)
-                             data = TargetTimer >> 8;
-                        else 
-                               data=0;
-                   }   
-                  else if(I2CCommand==2)
-                   {// number of data in fifo
-                          if(I2CByteCount==1)
-                              {
-                                  if(FirstIn >= FirstOut)
-                                      data = FirstIn - FirstOut;
-                                  else
-                                      data = BUF_SIZE - FirstOut + FirstIn;
-                              } 
-                           else
-                                    data=0;
-                   }
-                  else                   if(I2CCommand==3)
-                    { //32 bit data in fifo
-
-                           if(I2CByteCount==1)
-                               {
-                                  _tempFirstIn=FirstIn;
-                                  if(_tempFirstIn == FirstOut)
-                                   data=0;
-                                 else
-                                   data = FiFo_A0[FirstOut].lsb;
-                               }
-                           else if(I2CByteCount==2)
-                               {
-                                    if(_tempFirstIn == FirstOut)
-                                     data=0;
-                                    else
-                                      data = FiFo_A0[FirstOut].msb;
-                              }
-                           else if(I2CByteCount==3)
-                               {
-                                    if(_tempFirstIn == FirstOut)
-                                     data=0;
-                                    else
-                                   data = FiFo_A1[FirstOut].lsb;
-                              }
-                           else if(I2CByteCount==4)
-                               {
-                                    if(_tempFirstIn == FirstOut)
-                                     data=0;
-                                    else
-                                     {
-                                      data = FiFo_A1[FirstOut].msb << 2;  // get overrun and valid stuff
-                                      data &= 0xf0;                         
-                                      data |= (FiFo_A1[FirstOut].msb) & 0x3; // get bit 8&9
-                                      if(CommandMode.bits.SingleMode==1)
-                                       FirstOut=1;
-                                       else
-                                            FirstOut++;
-                                      if(FirstOut>=BUF_SIZE) FirstOut=0;                                 
-                                      I2CByteCount=0;
-                                  }
-                              }
-                    }   
-                  else if(I2CCommand==4)
-                    { //24 bit Pack data in fifo
-                          if(I2CByteCount==1)
-                               {
-                                  _tempFirstIn=FirstIn;
-                                  if(_tempFirstIn == FirstOut)
-                                   data=0;
-                                 else
-                                   data = FiFo_A0[FirstOut].lsb;
-                               }
-                           else if(I2CByteCount==2)
-                               {
-                                    if(_tempFirstIn == FirstOut)
-                                     data=0;
-                                    else
-                                     {
-                                      data = (FiFo_A0[FirstOut].msb) & 0x03;
-                                      data|=  (FiFo_A1[FirstOut].lsb << 2) & 0xfc;
-                                    }
-                              }
-                           else if(I2CByteCount==3)
-                               {
-                                    if(_tempFirstIn == FirstOut)
-                                     data=0;
-                                    else
-                                     {
-                                      data = (FiFo_A1[FirstOut].word >>6);
-                    				if(CommandMode.bits.SingleMode==1)
-                                       FirstOut=1;
-                                       else
-                                      FirstOut++;
-                                      if(FirstOut>=BUF_SIZE) FirstOut=0;   
-                                      I2CByteCount=0;
-                                  }
-                              }
-                    }   
+  if(I2CCommand >= I2C_CMD_COUNT) return;
+  if((I2CCommandTable[I2CCommand].Flags & CMD_WRITE)==0) return;
 
- 
+  size = I2CCommandTable[I2CCommand].Size;
+  if(I2CByteCount >= size) return;     // extra bytes are ignored
+  I2CStage[I2CByteCount++]=data;
+  if(I2CByteCount != size) return;
+
+  if((I2CCommandTable[I2CCommand].Flags & CMD_STAGE)==0)
+    {
+      address = I2CCommandTable[I2CCommand].Address;
+      if(address)
+        for(idx=0;idx<size;idx++)
+          address[idx]=I2CStage[idx];
+    }
 
-                  else if(I2CCommand==6)
+  switch(I2CCommand)
+    {
+      case 0:  //  run mode
+               StartMode(I2CStage[0]);
+               break;
+      case 1:  // Timer settings
+               if((TargetTimer < 2) && (ChannelMask==3))
+                  TargetTimer = 2;   // minimum is 5Khz
+               else if(TargetTimer < 1)
+                  TargetTimer = 1;   // single channel minimum is 10Khz
+               HwTimer.Period=0;     // back to the software timer
+               break;
+      case 5:  // change I2C_channel
+               // will be only effective if it is save on flash
+               if((I2CStage[0] > 0x2) && (I2CStage[0] < 0x78))
+                  Settings.I2C_Address=I2CStage[0];
+               break;
+      case 8:  //  Oscillator tune (signed 6 bits)
+               if((Settings.OscTune & 0x20)==0x20)
+                  Settings.OscTune |= 0xC0;
+               else
+                  Settings.OscTune &= 0x1F;
+               break;
+      case 9:  //  write flash
+               if((I2CStage[0] == 0x55) && (I2CStage[1] == 0xaa))
+                  SaveSettingsFlag=1;
+               break;
+      case 10: //  event capture control
+               PendingCount=0;
+               PostCount=0;
+               EventInside=0xff;
+               break;
+      case 12: //  fifo watermark
+               if(Watermark >= BUF_SIZE)
+                  Watermark = BUF_SIZE-1;
+               if(CommandMode.bits.TriggerMode==0)
+                  TRISA5=1;      // release the line
+               break;
+      case 13: //  channel mask
+               ChannelMask &= 3;
+               if(ChannelMask==0) ChannelMask=3;
+               if((ChannelMask==3) && (TargetTimer < 2))
+                  TargetTimer=2;
+               break;
+      case 14: //  hardware timer
+               if(HwTimer.Postscale==0)
+                  HwTimer.Postscale=1;
+               if(HwTimer.Period)
+                 {
+                   if(ChannelMask==3)
                      {
-                        if(I2CByteCount==1)
-                         {
-                           _TimerCounter.dword=TimerCounter.dword;
-                           data = _TimerCounter.byte[0];
-                         }
-                        else if(I2CByteCount<5)
-                           data = _TimerCounter.byte[I2CByteCount-1];
-                        else
-                          data=0;
-                    }
-                 else if(I2CCommand==7)
-                  {// version
-	
- 						if(I2CByteCount==1)
-                         {
-                           data = IDTAG;
-                         }  
-                        else if(I2CByteCount ==2)
-                          {
-                           data =  MARKERTAG;
-                          }
-                        else if(I2CByteCount==3)
-                          {
-                           data = MAJOR_VERSION;
-                          } 
-                        else if(I2CByteCount==4)
-                          {
-                           data = MINOR_VERSION;
-                          }
-                        else
-                           data=0;
+                       if(HwTimer.Period < 100) HwTimer.Period=100;
+                     }
+                   else if(HwTimer.Period < 50)
+                       HwTimer.Period=50;
                  }
-                else if(I2CCommand==8)
-                    {  // OSC TUNE
-                        if(I2CByteCount==1)
-                             data = Settings.OscTune;
-                       else
-                          data= 0;
-                  }
-                I2CByteCount++;
-//                WCOL = 0;   //clear write collision flag
-//                SSPBUF = data ; //data to send
-                 I2CWrite(data);
-            }
-            //state 5 Master sends NACK to end message
-//            else if ((stat ^ 0b00101000) == 0) //S=1 && RW==0 && DA==1 && BF==0
-//            {
-//                /dat = SSPBUF;
-//            }
-            else //undefined, clear buffer
-            {   WCOL=0;
-                data = SSPBUF;
-            }
-        }
-    CKP = 1; //release the clk
-    SSPIF = 0; //clear interupt flag
+               break;
+      case 15: //  record options
+               RecordOptions &= RECORD_STAMP;
+               PendingCount=0;
+               PostCount=0;
+               break;
+      case 18: //  burst control
+               Burst.Source &= BURST_EDGE | BURST_WINDOW;
+               if(Burst.Post > (BUF_SIZE-2))
+                  Burst.Post = BUF_SIZE-2;
+               break;
+      case 16: //  autostart
+               AutoStart &= 7;
+               if((AutoStart & 1)==0)
+                  AutoStart=0;
+               break;
     }
-  
+}
+
+
+///////   Interrupts I2C handler
+// The response byte is always ready before the master ask for it.
+// The clock is released first, then the work is done while the master clocks the byte.
+void ssp_handlerB(void)
+{
+    unsigned char stat;
+    unsigned char data;
+
+    SSPIF = 0; // clear it first. A new I2C event while we work will call us again.
+
+    if (SSPOV == 1)
+      {
+        SSPOV = 0;  //clear overflow
+        data = SSPBUF;
+        CKP = 1;
+        return;
+      }
+
+    stat = SSPSTAT & 0b00101101;
+
+    //state 3  & 4 Master want to read data
+    if ((stat & 0b00001100) == 0b00001100)
+      {
+        if((stat & 0b00100000)==0)
+          {  // our address
+            data=SSPBUF;
+            if(!I2CStaged)
+               I2CPrepareResponse();   // read without a command write first
+            else if(I2CTxFifo && !I2CRecordValid)
+              {  // fifo was empty when the command came in
+                I2CStageRecord();
+                I2CTxByte = I2CStage[0];
+              }
+            I2CStaged=0;
+            I2CReading=1;
+          }
+        SSPBUF = I2CTxByte;
+        CKP = 1;                       //release the clk
+        I2CNextByte();
+        return;
+      }
+
+    data = SSPBUF;
+    //state 1 Master just wrote our address
+    if ((stat ^ 0b00001001) == 0) //S=1 && RW==0 && DA==0 && BF==1
+      {
+        I2CByteCount=0;
+        GotCommandFlag=0;
+        I2CStaged=0;
+        I2CReading=0;
+        I2CGeneralCall = data==0 ? 1 : 0;   // address 0 is the general call
+        CKP = 1;
+      }
+    //state 2 Master just wrote data
+    else if ((stat ^ 0b00101001) == 0) //S=1 && RW==0 && DA==1 && BF==1
+      {
+        CKP = 1;
+        if(I2CGeneralCall)
+          {
+            if(I2CGeneralCall==1)
+              {  // the tag keep us away from the reset and address general call of other devices
+                I2CGeneralCall = data==GENERAL_CALL_TAG ? 2 : 3;
+                return;
+              }
+            if(I2CGeneralCall==3) return;
+            if(!GotCommandFlag)
+              {  // only start, stop and timer setup could be broadcast
+                if((data!=0) && (data!=1) && (data!=14))
+                  {
+                    I2CGeneralCall=3;
+                    return;
+                  }
+                I2CCommand = data;
+                GotCommandFlag=1;
+                return;
+              }
+          }
+        if(GotCommandFlag)
+           I2CWriteData(data);
+        else
+          {
+            I2CCommand = data;
+            GotCommandFlag=1;
+            I2CPrepareResponse();      // ready if the master read after a repeated start
+            I2CStaged=1;
+          }
+      }
+    //state 5 Master sends NACK to end message
+    else //undefined, clear buffer
+      {
+        I2CReading=0;                  // the circular fifo could drop the oldest sample again
+        WCOL=0;
+        CKP = 1;
+      }
+}
 
 
 
@@ -710,6 +1177,9 @@ void ssp_handlerB(void)
 
 static void interrupt isr(void){
 volatile near unsigned char _temp;
+unsigned char _next,_idx,_inside,_size,_used;
+unsigned short _tempA1,_flags;
+unsigned char _store;
 
 
 ////////////////////////////////////////// timer0 interrupt 
@@ -736,7 +1206,7 @@ if(TMR0IF==1)
                 CurrentTimer--;
           else
             {
-               RA5=1;
+               if(Watermark==0) RA5=1;
                A2DStart();
                CurrentTimer=TargetTimer;
                TimerCounter.dword++;
@@ -744,6 +1214,28 @@ if(TMR0IF==1)
       }
    }        
 
+////////////////////////////////////////////  Timer1 interrupt
+// stamp timer overflow (every 65.536 ms)
+ if(TMR1IE==1)
+ if(TMR1IF==1)
+  {
+    TMR1IF=0;
+    StampHigh++;
+  }
+
+////////////////////////////////////////////  CCP1 interrupt
+// only used with a postscaler on the hardware timer. The conversion itself is started by the special event.
+ if(CCP1IE==1)
+ if(CCP1IF==1)
+  {
+    CCP1IF=0;
+    HwPostCount--;
+    if(HwPostCount==1)
+       ADCON0=A2DChannel;      // A/D on, the next period will start the conversion
+    else if(HwPostCount==0)
+       HwPostCount=HwTimer.Postscale;
+  }
+
 //////////////////////////////////////////  I2C Interrupt
   if(SSP1IF==1)
    {
@@ -757,39 +1249,192 @@ if(TMR0IF==1)
   if(ADIE==1)  
   if(ADIF==1)
   {// A/D CONVERSION
-         if(Analog0Flag==0)
+         if(HwTimerRun)
+          if((Analog0Flag==0) || DenseMode)
+           {  // first conversion of a sample started by the CCP1 special event
+             CaptureStamp();
+             TimerCounter.dword++;
+             if(Watermark==0) RA5=1;    // sync out pulse, RA5 is cleared below
+           }
+         if((Analog0Flag==0) && (DenseMode==0))
         {
-          ADCON0= 0b0001101;            // select  analog channel 3
+          ADCON0= ADC_AN3;            // select  analog channel 3
           DelayStart();			//use timer0 interrupt for 8us delay
-          if(CommandMode.bits.TimerMode==1)   RA5=0; //  ok toggle off RA5
+          if(CommandMode.bits.TimerMode==1)
+              if(Watermark==0) RA5=0; //  ok toggle off RA5
            _tempAnalogValue= ADRES;  // store temporary the Analog 0 value
+           Analog0Flag=1;
         }
    
      else
           {
-             _temp=FirstIn;
-             _temp++;
-             if(_temp==FirstOut)
+             _store=0;                                           // 0: nothing  1: into the fifo  2: pre-context
+             _flags=0;
+             if(DenseMode)
+              {  // single channel. Two conversions go into one fifo entry
+                if(CommandMode.bits.TimerMode==1)
+                    if(Watermark==0) RA5=0;
+                if(DenseHalf==0)
+                   _tempAnalogValue = ADRES;
+                else
+                  {
+                   _tempA1 = ADRES;
+                   _store=1;
+                  }
+                DenseHalf = !DenseHalf;
+              }
+             else
+              {
+                _tempA1 = ADRES;                                    // retreive analog 3
+                _store=1;
+                if((EventControl & 3) && (CommandMode.bits.SingleMode==0))
+                 {  // event capture. check the windows
+                   _inside=0;
+                   if((_tempAnalogValue >= WindowLimit[0]) && (_tempAnalogValue <= WindowLimit[1]))
+                        _inside |= 1;
+                   if((_tempA1 >= WindowLimit[2]) && (_tempA1 <= WindowLimit[3]))
+                        _inside |= 2;
+                   _inside &= EventControl;
+                   _flags = (unsigned short) _inside << 10;       // EVENT_INSIDE0 & EVENT_INSIDE1
+                   if(BurstState)
+                     {  // burst capture. The window is only a trigger , every sample is stored
+                        if((_inside != EventInside) && (EventInside != 0xff) && (Burst.Source & BURST_WINDOW))
+                           BurstEdge=1;
+                        EventInside = _inside;
+                     }
+                   else if(_inside != EventInside)
+                     {  // window transition. Release the pre-context samples
+                        EventInside = _inside;
+                        _flags |= EVENT_FLAG;
+                        PostCount = EventControl >> 5;
+                        _temp = FirstIn + PendingCount;
+                        if(_temp >= BUF_SIZE) _temp -= BUF_SIZE;
+                        FirstIn = _temp;
+                        PendingCount=0;
+                     }
+                   else if(PostCount)
+                        PostCount--;
+                   else
+                        _store=2;                                   // pre-context only
+                 }
+              }
+
+             _size = (RecordOptions & RECORD_STAMP) ? 2 : 1;     // fifo entries per sample. The stamp follows the data
+             if(_store && BurstEdge && (BurstState==BURST_ARMED))
+              {  // trigger. This sample is the first of the post-trigger ones
+                BurstEdge=0;
+                BurstState=BURST_TRIGGERED;
+                BurstCount=Burst.Post;
+                _temp = (BUF_SIZE-1) / _size;
+                if(BurstCount > _temp) BurstCount=_temp;
+                _flags |= EVENT_FLAG;
+              }
+             if(_store)
+              {  // fifo entries used, including the pre-context
+                _used = FirstIn + PendingCount;
+                if(_used >= BUF_SIZE) _used -= BUF_SIZE;
+                if(_used >= FirstOut)
+                   _used -= FirstOut;
+                else
+                   _used += BUF_SIZE - FirstOut;
+              }
+
+             // circular fifo , drop the oldest sample. Not while the master reads the staged oldest
+             // record (command received or read in progress): FirstOut would move under it and I2CNextByte
+             // skip one more. The new sample is lost instead. The next read stages the record again
+             if((_store==1) && (BurstState==BURST_ARMED || BurstState==BURST_TRIGGERED))
+              if(((_used + _size) >= BUF_SIZE) && !((I2CReading || I2CStaged) && I2CTxFifo && I2CRecordValid))
                {
-                OverrunCount++;
-               if(OverrunCount>7)
-                     OverrunCount=7;
-                
+                 FirstOut += _size;
+                 if(FirstOut >= BUF_SIZE) FirstOut -= BUF_SIZE;
+                 _used -= _size;
                }
-             else
+
+             if(_store==1)
               {
-                 FiFo_A0[FirstIn].word= _tempAnalogValue;                                         // store analog 0 value
-              _tempAnalogValue= ADRES;		  					   // retreive analog 3
-                _tempAnalogValue |= (unsigned short) OverrunCount << 12; //add the overrun count
-                 FiFo_A1[FirstIn].word= _tempAnalogValue | 0x2000;                         // store value and set it valid
-                  OverrunCount=0;
-                 FirstIn++;
-                 if(FirstIn>=BUF_SIZE) FirstIn=0;
+                if((_used + _size) >= BUF_SIZE)
+                  {
+                    OverrunCount++;
+                    if(OverrunCount>7)
+                       OverrunCount=7;
+                  }
+                else
+                  {
+                    FiFo_A0[FirstIn].word= _tempAnalogValue | _flags;                             // store analog 0 value
+                    FiFo_A1[FirstIn].word= _tempA1 | ((unsigned short) OverrunCount << 10) | 0x2000;   // add the overrun count and set it valid
+                    OverrunCount=0;
+                    _temp=FirstIn;
+                    _temp++;
+                    if(_temp>=BUF_SIZE) _temp=0;
+                    if(_size==2)
+                      {
+                        FiFo_A0[_temp].word= Stamp.word[0];
+                        FiFo_A1[_temp].word= (Stamp.word[1] & 0xff) | 0x2000;
+                        _temp++;
+                        if(_temp>=BUF_SIZE) _temp=0;
+                      }
+                    FirstIn=_temp;
+                    if(BurstState==BURST_TRIGGERED)
+                      if(--BurstCount==0)
+                        {  // burst done. stop and keep it for the master
+                          BurstState=BURST_FROZEN;
+                          CommandRun=0;
+                          DisableTrigger();
+                          DisableTimer();
+                        }
+                  }
+              }
+             else if((_store==2) && (EventControl & 0x1c))
+              {  // hold it after FirstIn as pre-context. Drop the oldest one if we have enough.
+                _temp=0xff;
+                if(PendingCount < (((EventControl >> 2) & 7) * _size))
+                  if((_used + _size) < BUF_SIZE)
+                    {
+                      _temp = FirstIn + PendingCount;
+                      if(_temp >= BUF_SIZE) _temp -= BUF_SIZE;
+                      PendingCount += _size;
+                    }
+                if((_temp==0xff) && PendingCount)
+                  {
+                    _temp = FirstIn;
+                    for(_idx=_size;_idx<PendingCount;_idx++)
+                      {
+                        _next = _temp+_size;
+                        if(_next >= BUF_SIZE) _next -= BUF_SIZE;
+                        FiFo_A0[_temp].word = FiFo_A0[_next].word;
+                        FiFo_A1[_temp].word = FiFo_A1[_next].word;
+                        _temp++;
+                        if(_temp >= BUF_SIZE) _temp=0;
+                      }
+                  }
+                if(_temp != 0xff)
+                  {
+                    FiFo_A0[_temp].word= _tempAnalogValue | _flags;
+                    FiFo_A1[_temp].word= _tempA1 | 0x2000;
+                    if(_size==2)
+                      {
+                        _temp++;
+                        if(_temp >= BUF_SIZE) _temp=0;
+                        FiFo_A0[_temp].word= Stamp.word[0];
+                        FiFo_A1[_temp].word= (Stamp.word[1] & 0xff) | 0x2000;
+                      }
+                  }
               }
-                 ADCON0=0;
-                 ADIE=0;                 
+                 UpdateWatermark();
+                 Analog0Flag=0;
+                 if(HwTimerRun)
+                    {  // ready for the next special event
+                      if(HwTimer.Postscale > 1)
+                         ADCON0=0;
+                      else
+                         ADCON0=A2DChannel;
+                    }
+                 else
+                    {
+                      ADCON0=0;
+                      ADIE=0;                 
+                    }
            }
-    Analog0Flag=1;
     ADIF=0;
   }
 
@@ -797,7 +1442,10 @@ if(TMR0IF==1)
  if(IOCAF5==1)
   {
           IOCAF5=0;
-          A2DStart();
+          if(BurstState)
+            BurstEdge=1;          // burst trigger , the sampling is done by the timer
+          else
+            A2DStart();
    }
 
 }
@@ -818,8 +1466,9 @@ void main(void){
     INTCON			= 0b00000000;	// no interrupt  
 
 
-// get the I2C address from the eeprom
+// get the I2C address and the acquisition profile from the eeprom
   LoadSettings();
+  LoadProfile();
 
 CommandRun=0;
 
@@ -827,12 +1476,20 @@ Timer0Init();		// TIMER0 is used to delay A/D conversion needed for capacitor ch
 A2DInit();		//  Set A/D with  internal 2.048 Volt Reference. Range is then 0..2.048V
 I2CInit();            // Enable I2C services.
 
+if(AutoStart)
+  {  // resume the acquisition without waiting for the master
+    GIE=0;
+    StartMode(AutoStart);
+    GIE=1;
+  }
+
    while(1){
 
      if(SaveSettingsFlag==1)   // Do we need to save settings in eeprom;
            {
                 SSP1ADD  = Settings.I2C_Address << 1;
                 SaveSettings();
+                SaveProfile();
                 SaveSettingsFlag=0;
            } 
      }
@@ -0,0 +1,526 @@
+#define FUSE_USE_VERSION 31
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <cuse_lowlevel.h>
+#include <fuse_opt.h>
+#include "A2DSimBus.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DCuse
+//
+//    User space /dev/i2c-N (CUSE) with simulated RpiA2D devices on it.
+//    The i2c-dev ioctls used by the tools are implemented (I2C_SLAVE, I2C_SMBUS,
+//    I2C_RDWR, I2C_FUNCS) and read()/write() on the selected slave.
+//    A2DTest, A2DAddress and AdTest.py run without change on it.
+//
+//    Each transfer holds the caller for the time it takes at the bus speed,
+//    one transfer at a time like a real adapter. The numbers of a load test are
+//    then the ones of a real bus with the same device count.
+//
+//   to compile (from the sim folder, needs libfuse3-dev)
+//
+//     gcc -Wall -o A2DCuse A2DCuse.c A2DSimBus.c A2DSimDevice.c $(pkg-config fuse3 --cflags --libs) -lm
+//
+//   to run   (as root , cuse module loaded)
+//
+//     ./A2DCuse -f --bus=9 --devices=0x03-0x77 --speed=400000
+//
+//     --bus=N          /dev/i2c-N  (default 9 , keep it away from the real busses)
+//     --devices=list   device addresses like 0x20-0x2f,0x40 (default 0x20)
+//     --speed=Hz       SCL frequency (default 100000)
+//     --stretch=us     clock stretch per byte added by the firmware (default 17)
+//     --nowait         don't wait for the bus time , only count it
+//
+//     -f stay in foreground , the statistics are printed on exit (ctrl-c)
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define MAX_RDWR_MSGS   42        // same limit as i2c-dev (I2C_RDWR_IOCTL_MAX_MSGS)
+#define MAX_MSG_LEN     8192
+
+
+struct CuseParam{
+  unsigned  Bus;
+  char *    Devices;
+  unsigned  Speed;
+  unsigned  Stretch;
+  int       NoWait;
+  int       Help;
+};
+
+static const struct fuse_opt CuseOpts[] = {
+  { "--bus=%u",     offsetof(struct CuseParam, Bus), 0 },
+  { "--devices=%s", offsetof(struct CuseParam, Devices), 0 },
+  { "--speed=%u",   offsetof(struct CuseParam, Speed), 0 },
+  { "--stretch=%u", offsetof(struct CuseParam, Stretch), 0 },
+  { "--nowait",     offsetof(struct CuseParam, NoWait), 1 },
+  { "-h",           offsetof(struct CuseParam, Help), 1 },
+  { "--help",       offsetof(struct CuseParam, Help), 1 },
+  FUSE_OPT_END
+};
+
+
+// slave address selected by I2C_SLAVE , one per open file
+typedef struct{
+  unsigned short Address;
+}CuseClient;
+
+
+static A2DSimBus Bus;
+static pthread_mutex_t BusLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void CuseOpen(fuse_req_t req, struct fuse_file_info * fi)
+{
+  CuseClient * client = calloc(1,sizeof(CuseClient));
+
+  if(client==NULL)
+    {
+      fuse_reply_err(req,ENOMEM);
+      return;
+    }
+  fi->fh = (uint64_t) (uintptr_t) client;
+  fuse_reply_open(req,fi);
+}
+
+static void CuseRelease(fuse_req_t req, struct fuse_file_info * fi)
+{
+  free((CuseClient *) (uintptr_t) fi->fh);
+  fuse_reply_err(req,0);
+}
+
+
+static int CuseTransfer(struct i2c_msg * msgs, int count)
+{
+  int rcode;
+
+  pthread_mutex_lock(&BusLock);
+  rcode = A2DSimBusTransfer(&Bus,msgs,count);
+  pthread_mutex_unlock(&BusLock);
+  return rcode;
+}
+
+
+////////////////////////////////////   CuseRead
+//
+//    read() , plain I2C read from the selected slave
+//
+static void CuseRead(fuse_req_t req, size_t size, off_t off, struct fuse_file_info * fi)
+{
+  CuseClient * client = (CuseClient *) (uintptr_t) fi->fh;
+  unsigned char buffer[MAX_MSG_LEN];
+  struct i2c_msg msg;
+  int rcode;
+
+  if(size > MAX_MSG_LEN) size = MAX_MSG_LEN;
+  msg.addr = client->Address;
+  msg.flags = I2C_M_RD;
+  msg.len = size;
+  msg.buf = buffer;
+  rcode = CuseTransfer(&msg,1);
+  if(rcode < 0)
+    fuse_reply_err(req,-rcode);
+  else
+    fuse_reply_buf(req,(char *) buffer,size);
+}
+
+
+////////////////////////////////////   CuseWrite
+//
+//    write() , plain I2C write to the selected slave
+//
+static void CuseWrite(fuse_req_t req, const char * buf, size_t size, off_t off, struct fuse_file_info * fi)
+{
+  CuseClient * client = (CuseClient *) (uintptr_t) fi->fh;
+  struct i2c_msg msg;
+  int rcode;
+
+  if(size > MAX_MSG_LEN)
+    {
+      fuse_reply_err(req,EINVAL);
+      return;
+    }
+  msg.addr = client->Address;
+  msg.flags = 0;
+  msg.len = size;
+  msg.buf = (unsigned char *) buf;
+  rcode = CuseTransfer(&msg,1);
+  if(rcode < 0)
+    fuse_reply_err(req,-rcode);
+  else
+    fuse_reply_write(req,size);
+}
+
+
+////////////////////////////////////   CuseSmbus
+//
+//    I2C_SMBUS ioctl
+//
+//    CUSE only copies what it is asked for. The first pass gets the
+//    i2c_smbus_ioctl_data , the second one the data union (in and out).
+//
+static void CuseSmbus(fuse_req_t req, CuseClient * client, void * arg,
+                      const void * in_buf, size_t in_bufsz)
+{
+  struct i2c_smbus_ioctl_data blk;
+  union i2c_smbus_data data;
+  struct iovec in_iov[2];
+  struct iovec out_iov;
+  int useData, rcode;
+
+  in_iov[0].iov_base = arg;
+  in_iov[0].iov_len = sizeof(blk);
+
+  if(in_bufsz < sizeof(blk))
+    {
+      fuse_reply_ioctl_retry(req,in_iov,1,NULL,0);
+      return;
+    }
+  memcpy(&blk,in_buf,sizeof(blk));
+
+  // same rule as i2c-dev , quick and send byte don't use the data
+  useData = !((blk.size==I2C_SMBUS_QUICK) ||
+             ((blk.size==I2C_SMBUS_BYTE) && (blk.read_write==I2C_SMBUS_WRITE)));
+
+  if(useData && (blk.data==NULL))
+    {
+      fuse_reply_err(req,EINVAL);
+      return;
+    }
+
+  if(useData && (in_bufsz < sizeof(blk) + sizeof(data)))
+    {
+      in_iov[1].iov_base = blk.data;
+      in_iov[1].iov_len = sizeof(data);
+      out_iov.iov_base = blk.data;
+      out_iov.iov_len = sizeof(data);
+      fuse_reply_ioctl_retry(req,in_iov,2,&out_iov,blk.read_write==I2C_SMBUS_READ ? 1 : 0);
+      return;
+    }
+
+  memset(&data,0,sizeof(data));
+  if(useData)
+    memcpy(&data,(const char *) in_buf + sizeof(blk),sizeof(data));
+
+  pthread_mutex_lock(&BusLock);
+  rcode = A2DSimBusSmbus(&Bus,client->Address,blk.read_write,blk.command,blk.size,&data);
+  pthread_mutex_unlock(&BusLock);
+
+  if(rcode < 0)
+    fuse_reply_err(req,-rcode);
+  else if(useData && (blk.read_write==I2C_SMBUS_READ))
+    fuse_reply_ioctl(req,0,&data,sizeof(data));
+  else
+    fuse_reply_ioctl(req,0,NULL,0);
+}
+
+
+////////////////////////////////////   CuseRdwr
+//
+//    I2C_RDWR ioctl , three passes
+//
+//    1 - get the i2c_rdwr_ioctl_data
+//    2 - get the message array
+//    3 - get the write buffers and map the read buffers as output
+//
+//    The read buffers are returned one after the other in the reply ,
+//    CUSE spreads them on the output iovec.
+//
+static void CuseRdwr(fuse_req_t req, void * arg, const void * in_buf,
+                     size_t in_bufsz, size_t out_bufsz)
+{
+  struct i2c_rdwr_ioctl_data rdwr;
+  struct i2c_msg msgs[MAX_RDWR_MSGS];
+  unsigned short length[MAX_RDWR_MSGS];
+  struct iovec in_iov[MAX_RDWR_MSGS + 2];
+  struct iovec out_iov[MAX_RDWR_MSGS];
+  const unsigned char * wdata;
+  unsigned char * rbuf;
+  unsigned char * rptr;
+  size_t base, wtotal=0, rtotal=0;
+  unsigned loop;
+  int in_count, out_count=0, rcode;
+
+  in_iov[0].iov_base = arg;
+  in_iov[0].iov_len = sizeof(rdwr);
+
+  if(in_bufsz < sizeof(rdwr))
+    {
+      fuse_reply_ioctl_retry(req,in_iov,1,NULL,0);
+      return;
+    }
+  memcpy(&rdwr,in_buf,sizeof(rdwr));
+
+  if((rdwr.nmsgs==0) || (rdwr.nmsgs > MAX_RDWR_MSGS) || (rdwr.msgs==NULL))
+    {
+      fuse_reply_err(req,EINVAL);
+      return;
+    }
+
+  base = sizeof(rdwr) + rdwr.nmsgs * sizeof(struct i2c_msg);
+  in_iov[1].iov_base = rdwr.msgs;
+  in_iov[1].iov_len = rdwr.nmsgs * sizeof(struct i2c_msg);
+
+  if(in_bufsz < base)
+    {
+      fuse_reply_ioctl_retry(req,in_iov,2,NULL,0);
+      return;
+    }
+  memcpy(msgs,(const char *) in_buf + sizeof(rdwr),rdwr.nmsgs * sizeof(struct i2c_msg));
+
+  in_count=2;
+  for(loop=0;loop<rdwr.nmsgs;loop++)
+    {
+      length[loop]= msgs[loop].len;
+      if((msgs[loop].len > MAX_MSG_LEN) || (msgs[loop].buf==NULL && msgs[loop].len))
+        {
+          fuse_reply_err(req,EINVAL);
+          return;
+        }
+      if(msgs[loop].flags & I2C_M_RD)
+        {
+          // like i2c-dev , the buffer must hold the largest block
+          if((msgs[loop].flags & I2C_M_RECV_LEN) && (msgs[loop].len < I2C_SMBUS_BLOCK_MAX + 1))
+            {
+              fuse_reply_err(req,EINVAL);
+              return;
+            }
+          out_iov[out_count].iov_base = msgs[loop].buf;
+          out_iov[out_count++].iov_len = msgs[loop].len;
+          rtotal+= msgs[loop].len;
+        }
+      else if(msgs[loop].len)
+        {
+          in_iov[in_count].iov_base = msgs[loop].buf;
+          in_iov[in_count++].iov_len = msgs[loop].len;
+          wtotal+= msgs[loop].len;
+        }
+    }
+
+  if((in_bufsz < base + wtotal) || (out_bufsz < rtotal))
+    {
+      fuse_reply_ioctl_retry(req,in_iov,in_count,out_iov,out_count);
+      return;
+    }
+
+  rbuf = calloc(1,rtotal ? rtotal : 1);
+  if(rbuf==NULL)
+    {
+      fuse_reply_err(req,ENOMEM);
+      return;
+    }
+
+  // point the messages to the local copies
+  wdata = (const unsigned char *) in_buf + base;
+  rptr = rbuf;
+  for(loop=0;loop<rdwr.nmsgs;loop++)
+    if(msgs[loop].flags & I2C_M_RD)
+      {
+        msgs[loop].buf = rptr;
+        rptr += length[loop];
+      }
+    else
+      {
+        msgs[loop].buf = (unsigned char *) wdata;
+        wdata += length[loop];
+      }
+
+  rcode = CuseTransfer(msgs,rdwr.nmsgs);
+
+  if(rcode < 0)
+    fuse_reply_err(req,-rcode);
+  else
+    fuse_reply_ioctl(req,rcode,rbuf,rtotal);
+  free(rbuf);
+}
+
+
+////////////////////////////////////   CuseIoctl
+//
+//    i2c-dev ioctls
+//
+static void CuseIoctl(fuse_req_t req, int cmd, void * arg, struct fuse_file_info * fi,
+                      unsigned flags, const void * in_buf, size_t in_bufsz, size_t out_bufsz)
+{
+  CuseClient * client = (CuseClient *) (uintptr_t) fi->fh;
+  unsigned long funcs;
+  struct iovec iov;
+
+  if(flags & FUSE_IOCTL_COMPAT)
+    {
+      // 32 bits client on 64 bits host , the structures are different
+      fuse_reply_err(req,ENOSYS);
+      return;
+    }
+
+  switch(cmd)
+   {
+     case I2C_SLAVE:
+     case I2C_SLAVE_FORCE:
+          if((uintptr_t) arg > 0x7f)
+            {
+              fuse_reply_err(req,EINVAL);
+              return;
+            }
+          client->Address = (uintptr_t) arg;
+          fuse_reply_ioctl(req,0,NULL,0);
+          break;
+
+     case I2C_TENBIT:
+          if(arg)
+            fuse_reply_err(req,EINVAL);
+          else
+            fuse_reply_ioctl(req,0,NULL,0);
+          break;
+
+     case I2C_PEC:
+     case I2C_RETRIES:
+     case I2C_TIMEOUT:
+          fuse_reply_ioctl(req,0,NULL,0);
+          break;
+
+     case I2C_FUNCS:
+          if(out_bufsz < sizeof(funcs))
+            {
+              iov.iov_base = arg;
+              iov.iov_len = sizeof(funcs);
+              fuse_reply_ioctl_retry(req,NULL,0,&iov,1);
+              return;
+            }
+          funcs = I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+          fuse_reply_ioctl(req,0,&funcs,sizeof(funcs));
+          break;
+
+     case I2C_SMBUS:
+          CuseSmbus(req,client,arg,in_buf,in_bufsz);
+          break;
+
+     case I2C_RDWR:
+          CuseRdwr(req,arg,in_buf,in_bufsz,out_bufsz);
+          break;
+
+     default:
+          fuse_reply_err(req,ENOTTY);
+   }
+}
+
+
+static const struct cuse_lowlevel_ops CuseOps = {
+  .open    = CuseOpen,
+  .release = CuseRelease,
+  .read    = CuseRead,
+  .write   = CuseWrite,
+  .ioctl   = CuseIoctl,
+};
+
+
+static void PrintStats(void)
+{
+  unsigned long long conversions=0;
+  unsigned long overruns=0;
+  double elapse;
+  int loop;
+
+  for(loop=0;loop<Bus.Count;loop++)
+    {
+      conversions += Bus.Device[loop]->Conversions;
+      if(Bus.Device[loop]->OverrunCount)
+        overruns++;
+    }
+  elapse = (A2DSimBusNow() - Bus.Start) / 1.0e9;
+  printf("\n%d devices  %.1f sec\n",Bus.Count,elapse);
+  printf("transfers %llu  bytes %llu  nack %llu\n",Bus.Transfers,Bus.Bytes,Bus.Nacks);
+  printf("bus busy %.1f%%  conversions %llu  devices with fifo overrun %lu\n",
+         elapse > 0 ? Bus.BusyTime / (elapse * 1.0e7) : 0.0,conversions,overruns);
+}
+
+
+static void Usage(void)
+{
+  printf("usage: A2DCuse [-f] [--bus=N] [--devices=0x20-0x2f,0x40] [--speed=Hz] [--stretch=us] [--nowait]\n");
+}
+
+
+int main(int argc, char * argv[])
+{
+  struct fuse_args args = FUSE_ARGS_INIT(argc,argv);
+  struct CuseParam param;
+  struct cuse_info ci;
+  char devname[32];
+  const char * dev_info_argv[] = { devname };
+  int rcode;
+
+  memset(&param,0,sizeof(param));
+  param.Bus = 9;
+  param.Speed = 100000;
+  param.Stretch = 17;
+
+  if(fuse_opt_parse(&args,&param,CuseOpts,NULL))
+    {
+      Usage();
+      return 1;
+    }
+  if(param.Help)
+    {
+      Usage();
+      return 0;
+    }
+
+  A2DSimBusInit(&Bus,param.Speed);
+  Bus.Stretch = param.Stretch * 1000L;
+  Bus.NoWait = param.NoWait;
+  if(A2DSimBusAddRange(&Bus,param.Devices ? param.Devices : "0x20") <= 0)
+    {
+      printf("Invalid device list\n");
+      return 1;
+    }
+
+  snprintf(devname,sizeof(devname),"DEVNAME=i2c-%u",param.Bus);
+  memset(&ci,0,sizeof(ci));
+  ci.dev_info_argc = 1;
+  ci.dev_info_argv = dev_info_argv;
+  ci.flags = CUSE_UNRESTRICTED_IOCTL;
+
+  printf("/dev/i2c-%u  %d devices  %u Hz\n",param.Bus,Bus.Count,param.Speed);
+  fflush(stdout);
+
+  rcode = cuse_lowlevel_main(args.argc,args.argv,&ci,&CuseOps,NULL);
+  PrintStats();
+  fuse_opt_free_args(&args);
+  return rcode;
+}
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <linux/i2c.h>
+#include "A2DSimBus.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DSimBus
+//
+//    I2C bus emulation for the simulated RpiA2D devices (A2DSimDevice.c)
+//
+//   to compile add A2DSimBus.c and A2DSimDevice.c to the gcc command line with -lm
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+long long A2DSimBusNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+void A2DSimBusInit(A2DSimBus * bus, long speed)
+{
+  memset(bus,0,sizeof(A2DSimBus));
+  bus->Speed = speed > 0 ? speed : 100000;
+  bus->Start = A2DSimBusNow();
+}
+
+
+////////////////////////////////////   A2DSimBusAdd
+//
+//    Add a device at power-up state
+//
+//    Return,
+//
+//    the device or NULL if the address is not valid or already used
+//
+A2DSimDevice * A2DSimBusAdd(A2DSimBus * bus, unsigned char address)
+{
+  A2DSimDevice * dev;
+  int loop;
+
+  if((address < 0x3) || (address > 0x77)) return NULL;
+  if(bus->Count >= A2DSIM_MAX_DEVICE) return NULL;
+  for(loop=0;loop<bus->Count;loop++)
+    if(bus->Device[loop]->Address == address) return NULL;
+  dev = malloc(sizeof(A2DSimDevice));
+  if(dev==NULL) return NULL;
+  A2DSimDeviceInit(dev,address,A2DSimBusNow());
+  bus->Device[bus->Count++]=dev;
+  return dev;
+}
+
+
+////////////////////////////////////   A2DSimBusAddRange
+//
+//    Add devices from a list like "0x20-0x2f,0x40"
+//
+//    Return,
+//
+//    number of devices added or -1 if the list is not valid
+//
+int A2DSimBusAddRange(A2DSimBus * bus, const char * list)
+{
+  const char * p = list;
+  char * end;
+  long first, last, address;
+  int count=0;
+
+  while(*p)
+    {
+      first = strtol(p,&end,0);
+      if(end==p) return -1;
+      last=first;
+      p=end;
+      if(*p=='-')
+        {
+          p++;
+          last = strtol(p,&end,0);
+          if(end==p) return -1;
+          p=end;
+        }
+      for(address=first;address<=last;address++)
+        if(A2DSimBusAdd(bus,address)) count++;
+      if(*p==',') p++;
+      else if(*p) return -1;
+    }
+  return count;
+}
+
+
+static A2DSimDevice * Find(A2DSimBus * bus, unsigned char address)
+{
+  int loop;
+
+  for(loop=0;loop<bus->Count;loop++)
+    if(bus->Device[loop]->Address == address)
+      return bus->Device[loop];
+  return NULL;
+}
+
+// RA5 is one line , driven by the first device in timer mode with the sync out
+static A2DSimDevice * SyncDriver(A2DSimBus * bus)
+{
+  int loop;
+
+  for(loop=0;loop<bus->Count;loop++)
+    if(bus->Device[loop]->Run && (bus->Device[loop]->Mode==4) && !bus->Device[loop]->Reg.Watermark)
+      return bus->Device[loop];
+  return NULL;
+}
+
+// hold the caller for the time the transfer takes on the bus
+static void BusTime(A2DSimBus * bus, long bytes, int starts)
+{
+  long long now = A2DSimBusNow();
+  long long duration;
+  struct timespec ts;
+
+  // 9 clocks per byte , about one clock for each start and for the stop
+  duration = ((bytes * 9 + starts + 1) * 1000000000LL) / bus->Speed + bytes * bus->Stretch;
+  if(bus->Free < now) bus->Free=now;
+  bus->Free += duration;
+  bus->BusyTime += duration;
+  if(bus->NoWait) return;
+  ts.tv_sec = bus->Free / 1000000000LL;
+  ts.tv_nsec = bus->Free % 1000000000LL;
+  while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL)==EINTR);
+}
+
+
+////////////////////////////////////   A2DSimBusTransfer
+//
+//    I2C_RDWR transfer. Each message after the first one begins with a repeated start.
+//
+//    Inputs,
+//
+//    msgs:   messages like struct i2c_rdwr_ioctl_data. I2C_M_RD and I2C_M_RECV_LEN are supported
+//    count:  number of messages
+//
+//    Return,
+//
+//    count or -EREMOTEIO if an address is not acknowledged
+//
+int A2DSimBusTransfer(A2DSimBus * bus, struct i2c_msg * msgs, int count)
+{
+  A2DSimDevice * dev;
+  long long now = bus->Free > A2DSimBusNow() ? bus->Free : A2DSimBusNow();
+  long bytes=0;
+  int loop, idx, len, read;
+  int result=count;
+
+  for(loop=0;loop<count;loop++)
+    {
+      struct i2c_msg * msg = &msgs[loop];
+
+      if(msg->flags & I2C_M_TEN)
+        {
+          result=-EINVAL;
+          break;
+        }
+      read = msg->flags & I2C_M_RD ? 1 : 0;
+      bytes++;                                      // address byte
+
+      if(msg->addr==0)
+        {  // general call. Every device gets the bytes
+          if(read)
+            {
+              result=-EREMOTEIO;
+              break;
+            }
+          for(idx=0;idx<bus->Count;idx++)
+            {
+              A2DSimDeviceStart(bus->Device[idx],0,1,now);
+              for(len=0;len<msg->len;len++)
+                A2DSimDeviceWrite(bus->Device[idx],msg->buf[len]);
+            }
+          bytes += msg->len;
+          continue;
+        }
+
+      dev = Find(bus,msg->addr);
+      if(dev==NULL)
+        {
+          bus->Nacks++;
+          result=-EREMOTEIO;
+          break;
+        }
+      if(dev->Mode==2)
+        dev->Sync = SyncDriver(bus);
+      A2DSimDeviceStart(dev,read,0,now);
+      if(!read)
+        {
+          for(len=0;len<msg->len;len++)
+            A2DSimDeviceWrite(dev,msg->buf[len]);
+          bytes += msg->len;
+          continue;
+        }
+      len = msg->len;
+      idx = 0;
+      if(msg->flags & I2C_M_RECV_LEN)
+        {  // the first byte is the count
+          msg->buf[0] = A2DSimDeviceRead(dev);
+          if(msg->buf[0] > I2C_SMBUS_BLOCK_MAX) msg->buf[0]=I2C_SMBUS_BLOCK_MAX;
+          len = msg->buf[0] + 1;
+          msg->len = len;
+          idx = 1;
+        }
+      for(;idx<len;idx++)
+        msg->buf[idx]=A2DSimDeviceRead(dev);
+      bytes += len;
+    }
+
+  bus->Transfers++;
+  bus->Bytes += bytes;
+  BusTime(bus,bytes,loop < count ? loop + 1 : count);
+  return result;
+}
+
+
+////////////////////////////////////   A2DSimBusSmbus
+//
+//    I2C_SMBUS transfer done with I2C messages , like the kernel does for a plain I2C adapter
+//
+//    Return,
+//
+//    0 or -errno
+//
+int A2DSimBusSmbus(A2DSimBus * bus, unsigned char address, char read_write,
+                   unsigned char command, int size, union i2c_smbus_data * data)
+{
+  unsigned char wbuf[I2C_SMBUS_BLOCK_MAX + 3];
+  unsigned char rbuf[I2C_SMBUS_BLOCK_MAX + 2];
+  struct i2c_msg msgs[2] = {
+       { address, 0, 1, wbuf },
+       { address, I2C_M_RD, 0, rbuf } };
+  int count = read_write==I2C_SMBUS_READ ? 2 : 1;
+  int result, loop;
+
+  wbuf[0]=command;
+  switch(size)
+   {
+     case I2C_SMBUS_QUICK:
+          msgs[0].len=0;
+          msgs[0].flags = read_write==I2C_SMBUS_READ ? I2C_M_RD : 0;
+          count=1;
+          break;
+     case I2C_SMBUS_BYTE:
+          if(read_write==I2C_SMBUS_READ)
+            {  // receive byte , no command
+              msgs[0].flags=I2C_M_RD;
+              msgs[0].buf=rbuf;
+              count=1;
+            }
+          break;
+     case I2C_SMBUS_BYTE_DATA:
+          if(read_write==I2C_SMBUS_READ)
+             msgs[1].len=1;
+          else
+            {
+              msgs[0].len=2;
+              wbuf[1]=data->byte;
+            }
+          break;
+     case I2C_SMBUS_WORD_DATA:
+          if(read_write==I2C_SMBUS_READ)
+             msgs[1].len=2;
+          else
+            {
+              msgs[0].len=3;
+              wbuf[1]=data->word & 0xff;
+              wbuf[2]=data->word >> 8;
+            }
+          break;
+     case I2C_SMBUS_BLOCK_DATA:
+          if(read_write==I2C_SMBUS_READ)
+            {
+              msgs[1].flags |= I2C_M_RECV_LEN;
+              msgs[1].len=1;
+            }
+          else
+            {
+              if(data->block[0] > I2C_SMBUS_BLOCK_MAX) return -EINVAL;
+              msgs[0].len = data->block[0] + 2;
+              memcpy(&wbuf[1],data->block,data->block[0]+1);
+            }
+          break;
+     case I2C_SMBUS_I2C_BLOCK_DATA:
+          if(data->block[0] > I2C_SMBUS_BLOCK_MAX) return -EINVAL;
+          if(read_write==I2C_SMBUS_READ)
+             msgs[1].len=data->block[0];
+          else
+            {
+              msgs[0].len = data->block[0] + 1;
+              memcpy(&wbuf[1],&data->block[1],data->block[0]);
+            }
+          break;
+     default:
+          return -EOPNOTSUPP;
+   }
+
+  result = A2DSimBusTransfer(bus,msgs,count);
+  if(result < 0) return result;
+  if(read_write!=I2C_SMBUS_READ) return 0;
+
+  switch(size)
+   {
+     case I2C_SMBUS_BYTE:       data->byte=rbuf[0]; break;
+     case I2C_SMBUS_BYTE_DATA:  data->byte=rbuf[0]; break;
+     case I2C_SMBUS_WORD_DATA:  data->word=rbuf[0] | (rbuf[1] << 8); break;
+     case I2C_SMBUS_BLOCK_DATA:
+          for(loop=0;loop<=rbuf[0];loop++)
+            data->block[loop]=rbuf[loop];
+          break;
+     case I2C_SMBUS_I2C_BLOCK_DATA:
+          for(loop=0;loop<data->block[0];loop++)
+            data->block[loop+1]=rbuf[loop];
+          break;
+   }
+  return 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <linux/i2c.h>
+#include "A2DSimDevice.h"
+
+////////////////////////////////////////////
+//
+//    A2DSimBus
+//
+//    I2C bus with simulated RpiA2D devices. The transfers are the ones of the
+//    i2c-dev ioctls (I2C_RDWR messages and I2C_SMBUS). Each transfer takes the time
+//    it would take on the real bus and the caller waits for it, so the throughput
+//    of a tool is the one it would get with the same number of devices.
+//
+
+#define A2DSIM_MAX_DEVICE  128
+
+typedef struct{
+  A2DSimDevice *  Device[A2DSIM_MAX_DEVICE];
+  int             Count;
+  long            Speed;          // SCL frequency (Hz)
+  long            Stretch;        // clock stretch per byte (ns) added by the device
+  int             NoWait;         // 1= don't sleep for the bus time
+  long long       Free;           // time the bus is released (ns)
+  unsigned long long Transfers;
+  unsigned long long Bytes;
+  unsigned long long Nacks;
+  long long       BusyTime;       // ns
+  long long       Start;          // time of A2DSimBusInit (ns)
+}A2DSimBus;
+
+
+void           A2DSimBusInit(A2DSimBus * bus, long speed);
+A2DSimDevice * A2DSimBusAdd(A2DSimBus * bus, unsigned char address);
+int            A2DSimBusAddRange(A2DSimBus * bus, const char * list);
+long long      A2DSimBusNow(void);
+int            A2DSimBusTransfer(A2DSimBus * bus, struct i2c_msg * msgs, int count);
+int            A2DSimBusSmbus(A2DSimBus * bus, unsigned char address, char read_write,
+                              unsigned char command, int size, union i2c_smbus_data * data);
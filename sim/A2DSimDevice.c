@@ -0,0 +1,588 @@
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include "A2DSimDevice.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DSimDevice
+//
+//    Behavior model of the RpiA2D firmware for the I2C bus emulation (A2DSimBus.c).
+//    Times are in ns from any fixed origin (CLOCK_MONOTONIC for A2DCuse).
+//
+//   to compile add A2DSimDevice.c to the gcc command line with -lm
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define NEVER           0x7fffffffffffffffLL
+#define SINGLE_DELAY    70000LL          // single shot conversion time (2 x (20us + 11.5 TAD) + isr)
+#define TIMER_TICK      100000LL         // software timer tick (100us)
+#define SYNC_DELAY      15000LL          // RA5 sync out pulse after the sample clock (end of the first conversion)
+#define EEPROM_WRITE    4000000LL        // data eeprom byte write time (4ms)
+
+#define PROFILE_EEPROM  2
+#define PROFILE_SIZE    22
+
+#define CMD_READ    1
+#define CMD_WRITE   2
+#define CMD_STAGE   4          // response is computed
+#define CMD_FIFO    8          // response is a stream of fifo records
+#define CMD_EEPROM  16         // response is read from the eeprom profile
+
+#define REG(NAME)   offsetof(A2DSimRegisters,NAME)
+#define NO_REG      0xff
+
+typedef struct{
+  unsigned char Offset;        // into A2DSimRegisters
+  unsigned char Size;
+  unsigned char Flags;
+}A2DSimCommand;
+
+static const A2DSimCommand CommandTable[A2DSIM_CMD_COUNT]={
+   { NO_REG,               1, CMD_READ | CMD_WRITE | CMD_STAGE},  // 00 control
+   { REG(TargetTimer),     2, CMD_READ | CMD_WRITE},              // 01 timer
+   { NO_REG,               1, CMD_READ | CMD_STAGE},              // 02 data count
+   { NO_REG,               4, CMD_READ | CMD_FIFO},               // 03 data
+   { NO_REG,               3, CMD_READ | CMD_FIFO},               // 04 packed data
+   { NO_REG,               1, CMD_WRITE},                         // 05 i2c address
+   { NO_REG,               4, CMD_READ | CMD_STAGE},              // 06 timer counter
+   { NO_REG,               4, CMD_READ | CMD_STAGE},              // 07 version
+   { REG(OscTune),         1, CMD_READ | CMD_WRITE},              // 08 osc tune
+   { NO_REG,               2, CMD_WRITE},                         // 09 flash settings
+   { REG(EventControl),    1, CMD_READ | CMD_WRITE},              // 10 event control
+   { REG(WindowLimit),     8, CMD_READ | CMD_WRITE},              // 11 window limits
+   { REG(Watermark),       1, CMD_READ | CMD_WRITE},              // 12 watermark
+   { REG(ChannelMask),     1, CMD_READ | CMD_WRITE},              // 13 channel mask
+   { REG(HwTimer),         4, CMD_READ | CMD_WRITE},              // 14 hardware timer
+   { REG(RecordOptions),   1, CMD_READ | CMD_WRITE},              // 15 record options
+   { REG(AutoStart),       1, CMD_READ | CMD_WRITE},              // 16 autostart
+   { NO_REG,    PROFILE_SIZE, CMD_READ | CMD_EEPROM},             // 17 stored profile
+   { REG(Burst),           2, CMD_READ | CMD_WRITE},              // 18 burst control
+   { REG(BurstState),      1, CMD_READ}                           // 19 burst state
+};
+
+// eeprom profile , same order as the firmware ProfileTable
+static const struct{ unsigned char Offset; unsigned char Size; } ProfileTable[]={
+   { REG(AutoStart),      1},
+   { REG(TargetTimer),    2},
+   { REG(ChannelMask),    1},
+   { REG(EventControl),   1},
+   { REG(WindowLimit),    8},
+   { REG(Watermark),      1},
+   { REG(HwTimer),        4},
+   { REG(RecordOptions),  1},
+   { REG(Burst),          2}
+};
+
+#define PROFILE_COUNT (sizeof(ProfileTable)/sizeof(ProfileTable[0]))
+
+
+static unsigned char * RegByte(A2DSimDevice * dev, unsigned char offset)
+{
+  return ((unsigned char *) &dev->Reg) + offset;
+}
+
+
+////////////  fifo
+
+int A2DSimDeviceFifoCount(A2DSimDevice * dev)
+{
+  if(dev->FirstIn >= dev->FirstOut)
+     return dev->FirstIn - dev->FirstOut;
+  return A2DSIM_FIFO_SIZE - dev->FirstOut + dev->FirstIn;
+}
+
+static unsigned short SignalValue(A2DSimDevice * dev, int channel, long long t)
+{
+  double sec = t / 1e9;
+  double phase = dev->Address / 128.0;
+
+  if(channel==0)
+     return 512 + (int) (400.0 * sin(2 * M_PI * (10.0 * sec + phase)));
+  return (unsigned short) (1023.0 * (sec + phase - floor(sec + phase)));
+}
+
+static unsigned long StampValue(A2DSimDevice * dev, long long t)
+{
+  if(dev->Mode==4) return dev->TimerCounter;
+  return ((t - dev->StampZero) / 1000) & 0xffffff;
+}
+
+// fifo entries per sample. The stamp follows the data
+static int RecordSize(A2DSimDevice * dev)
+{
+  return (dev->Reg.RecordOptions & A2D_RECORD_STAMP) ? 2 : 1;
+}
+
+// store one conversion (both channels or one in dense mode)
+static void Convert(A2DSimDevice * dev, long long t)
+{
+  unsigned short a0, a1;
+  unsigned long stamp;
+  int size = RecordSize(dev);
+  unsigned char next;
+
+  dev->Conversions++;
+  if(dev->Dense)
+    {
+      a1 = SignalValue(dev, dev->Reg.ChannelMask==2 ? 1 : 0, t);
+      if(!dev->DenseHalf)
+        {
+          dev->DenseHalf=1;
+          dev->DenseFirst=a1;
+          return;
+        }
+      dev->DenseHalf=0;
+      a0=dev->DenseFirst;
+    }
+  else
+    {
+      a0 = SignalValue(dev,0,t);
+      a1 = SignalValue(dev,1,t);
+    }
+
+  if(A2DSimDeviceFifoCount(dev) + size >= A2DSIM_FIFO_SIZE)
+    {
+      if(dev->OverrunCount < 7) dev->OverrunCount++;
+      return;
+    }
+  stamp = StampValue(dev,t);
+  next = dev->FirstIn;
+  dev->FiFo_A0[next]= a0;
+  dev->FiFo_A1[next]= a1 | (dev->OverrunCount << 10) | 0x2000;
+  dev->OverrunCount=0;
+  if(++next >= A2DSIM_FIFO_SIZE) next=0;
+  if(size==2)
+    {
+      dev->FiFo_A0[next]= stamp & 0xffff;
+      dev->FiFo_A1[next]= ((stamp >> 16) & 0xff) | 0x2000;
+      if(++next >= A2DSIM_FIFO_SIZE) next=0;
+    }
+  dev->FirstIn=next;
+}
+
+////////////////////////////////////   A2DSimDeviceUpdate
+//
+//    Do the conversions due up to now
+//
+void A2DSimDeviceUpdate(A2DSimDevice * dev, long long now)
+{
+  A2DSimDevice * sync = dev->Sync;
+  long long count;
+
+  if(!dev->Run) return;
+  if(dev->Mode==1)
+    {  // single shot
+      if(now >= dev->NextSample)
+        {
+          Convert(dev,dev->NextSample);
+          dev->NextSample=NEVER;
+        }
+      return;
+    }
+  if(dev->Mode==2)
+    {  // RA5 rising edges from the sync out of the driver
+      if((sync==NULL) || !sync->Run || (sync->Mode!=4) || sync->Reg.Watermark) return;
+      if(dev->SyncOrigin != sync->SyncOrigin)
+        {  // first edge after the arming (NextSample) or after a restart of the driver
+          count = (dev->NextSample - sync->SyncOrigin - SYNC_DELAY) / sync->Period + 1;
+          if(count < 1) count=1;
+          dev->SyncOrigin = sync->SyncOrigin;
+          dev->NextSample = sync->SyncOrigin + count * sync->Period + SYNC_DELAY;
+        }
+      while(dev->NextSample <= now)
+        {
+          Convert(dev,dev->NextSample);
+          dev->NextSample += sync->Period;
+        }
+      return;
+    }
+  if(dev->Mode!=4) return;
+
+  while(dev->NextSample <= now)
+    {
+      if((dev->OverrunCount==7) && !dev->Dense && (A2DSimDeviceFifoCount(dev) + RecordSize(dev) >= A2DSIM_FIFO_SIZE))
+        {  // full and nothing more to count. Skip to now
+          count = (now - dev->NextSample) / dev->Period + 1;
+          dev->TimerCounter += count;
+          dev->Conversions += count;
+          dev->NextSample += count * dev->Period;
+          break;
+        }
+      dev->TimerCounter++;
+      Convert(dev,dev->NextSample);
+      dev->NextSample += dev->Period;
+    }
+}
+
+
+////////////  command 00
+
+static void StartMode(A2DSimDevice * dev, unsigned char mode, long long now)
+{
+  dev->Run = mode & 1;
+  if(!dev->Run) return;
+
+  dev->FirstIn=0;
+  dev->FirstOut=0;
+  dev->OverrunCount=0;
+  dev->DenseHalf=0;
+  dev->Reg.BurstState=A2D_BURST_OFF;
+  dev->Dense = (mode & 4) && (dev->Reg.ChannelMask != 3);
+
+  if((mode & 4)==0)
+    {
+      dev->Mode=1;
+      dev->NextSample = now + SINGLE_DELAY;
+    }
+  else if((mode & 2)==0)
+    {
+      dev->Mode=2;
+      dev->NextSample=now;            // armed , the edges before are not seen
+      dev->SyncOrigin=0;
+    }
+  else
+    {
+      dev->Mode=4;
+      dev->TimerCounter=0;
+      dev->SyncOrigin=now;
+      if(dev->Reg.HwTimer.Period)
+         dev->Period = (long long) dev->Reg.HwTimer.Period * dev->Reg.HwTimer.Postscale * 1000;
+      else
+         dev->Period = dev->Reg.TargetTimer * TIMER_TICK;
+      dev->NextSample = now + dev->Period;
+    }
+}
+
+
+////////////  eeprom
+
+// the new address is used at once , the profile reads 0 until the last byte is written
+static void SaveSettings(A2DSimDevice * dev, long long now)
+{
+  unsigned int loop, idx;
+  unsigned char address=PROFILE_EEPROM+1;
+
+  dev->EepromBusy = now + (PROFILE_SIZE + 3) * EEPROM_WRITE;   // settings , tag 0xff , profile , tag
+  dev->Address=dev->NewAddress;
+  dev->Eeprom[0]=dev->NewAddress;
+  dev->Eeprom[1]=dev->Reg.OscTune;
+  for(loop=0;loop<PROFILE_COUNT;loop++)
+    for(idx=0;idx<ProfileTable[loop].Size;idx++)
+      dev->Eeprom[address++]= *RegByte(dev,ProfileTable[loop].Offset+idx);
+  dev->Eeprom[PROFILE_EEPROM]=A2D_PROFILE_TAG;
+}
+
+static void LoadSettings(A2DSimDevice * dev)
+{
+  unsigned int loop, idx;
+  unsigned char address=PROFILE_EEPROM+1;
+
+  dev->Reg.OscTune=dev->Eeprom[1];
+  if(dev->Eeprom[PROFILE_EEPROM] != A2D_PROFILE_TAG) return;
+  for(loop=0;loop<PROFILE_COUNT;loop++)
+    for(idx=0;idx<ProfileTable[loop].Size;idx++)
+      *RegByte(dev,ProfileTable[loop].Offset+idx) = dev->Eeprom[address++];
+}
+
+
+////////////////////////////////////   A2DSimDeviceInit
+//
+//    Power-up of a device
+//
+//    Inputs,
+//
+//    dev:      device
+//    address:  I2C address (7 bits). Also the eeprom address
+//    now:      time (ns)
+//
+void A2DSimDeviceInit(A2DSimDevice * dev, unsigned char address, long long now)
+{
+  memset(dev,0,sizeof(A2DSimDevice));
+  memset(dev->Eeprom,0xff,sizeof(dev->Eeprom));
+  dev->Eeprom[0]=address;
+  dev->Eeprom[1]=4;
+  dev->Address=address;
+  dev->NewAddress=address;
+  dev->Reg.TargetTimer=10000;
+  dev->Reg.WindowLimit[1]=1023;
+  dev->Reg.WindowLimit[3]=1023;
+  dev->Reg.ChannelMask=3;
+  dev->Reg.HwTimer.Postscale=1;
+  dev->StampZero=now;
+  LoadSettings(dev);
+  if(dev->Reg.AutoStart)
+     StartMode(dev,dev->Reg.AutoStart,now);
+}
+
+
+////////////  I2C slave
+
+static void StageRecord(A2DSimDevice * dev)
+{
+  unsigned short a0, a1;
+
+  if(dev->FirstIn == dev->FirstOut)
+    {  // underrun. Valid bit is 0
+      dev->RecordValid=0;
+      memset(dev->Tx,0,4);
+      return;
+    }
+  dev->RecordValid=1;
+  a0 = dev->FiFo_A0[dev->FirstOut];
+  a1 = dev->FiFo_A1[dev->FirstOut];
+  dev->Tx[0]= a0 & 0xff;
+  if(dev->Command==3)
+    {
+      dev->Tx[1]= a0 >> 8;
+      dev->Tx[2]= a1 & 0xff;
+      dev->Tx[3]= (((a1 >> 8) << 2) & 0xf0) | ((a1 >> 8) & 3);
+    }
+  else
+    {
+      dev->Tx[1]= ((a0 >> 8) & 3) | ((a1 << 2) & 0xfc);
+      dev->Tx[2]= a1 >> 6;
+    }
+}
+
+static void PrepareResponse(A2DSimDevice * dev)
+{
+  const A2DSimCommand * cmd;
+  unsigned long value;
+  int count;
+
+  dev->TxIndex=0;
+  dev->TxSize=0;
+  dev->TxFifo=0;
+  if(dev->Command >= A2DSIM_CMD_COUNT) return;
+  cmd = &CommandTable[dev->Command];
+  if((cmd->Flags & CMD_READ)==0) return;
+  dev->TxSize=cmd->Size;
+
+  if(cmd->Flags & CMD_FIFO)
+    {
+      dev->TxFifo=1;
+      StageRecord(dev);
+    }
+  else if(cmd->Flags & CMD_EEPROM)
+    {
+      if(dev->Now < dev->EepromBusy)
+        memset(dev->Tx,0,PROFILE_SIZE);
+      else
+        memcpy(dev->Tx,&dev->Eeprom[PROFILE_EEPROM],PROFILE_SIZE);
+    }
+  else if(cmd->Offset != NO_REG)
+      memcpy(dev->Tx,RegByte(dev,cmd->Offset),cmd->Size);
+  else
+   switch(dev->Command)
+    {
+      case 0:  // reconstruct Control
+               dev->Tx[0] = dev->Run;
+               if(dev->Mode==2)
+                  dev->Tx[0] |= 0x4;
+               else if(dev->Mode==4)
+                  dev->Tx[0] |= 0x7;
+               break;
+      case 2:  count = A2DSimDeviceFifoCount(dev);
+               dev->Tx[0] = count;
+               break;
+      case 6:  value = dev->TimerCounter;
+               dev->Tx[0] = value;
+               dev->Tx[1] = value >> 8;
+               dev->Tx[2] = value >> 16;
+               dev->Tx[3] = value >> 24;
+               break;
+      case 7:  dev->Tx[0] = 0xE7;
+               dev->Tx[1] = 0xC3;
+               dev->Tx[2] = A2DSIM_VERSION_MAJOR;
+               dev->Tx[3] = A2DSIM_VERSION_MINOR;
+               break;
+    }
+}
+
+static void WriteData(A2DSimDevice * dev, unsigned char data, long long now)
+{
+  const A2DSimCommand * cmd;
+  int idx;
+
+  if(dev->Command >= A2DSIM_CMD_COUNT) return;
+  cmd = &CommandTable[dev->Command];
+  if((cmd->Flags & CMD_WRITE)==0) return;
+  if(dev->ByteCount >= cmd->Size) return;          // extra bytes are ignored
+  dev->Stage[dev->ByteCount++]=data;
+  if(dev->ByteCount != cmd->Size) return;
+
+  if(cmd->Offset != NO_REG)
+    for(idx=0;idx<cmd->Size;idx++)
+      *RegByte(dev,cmd->Offset+idx)=dev->Stage[idx];
+
+  switch(dev->Command)
+    {
+      case 0:  StartMode(dev,dev->Stage[0],now);
+               break;
+      case 1:  if((dev->Reg.TargetTimer < 2) && (dev->Reg.ChannelMask==3))
+                  dev->Reg.TargetTimer = 2;
+               else if(dev->Reg.TargetTimer < 1)
+                  dev->Reg.TargetTimer = 1;
+               dev->Reg.HwTimer.Period=0;
+               break;
+      case 5:  if((dev->Stage[0] > 0x2) && (dev->Stage[0] < 0x78))
+                  dev->NewAddress=dev->Stage[0];
+               break;
+      case 8:  if(dev->Reg.OscTune & 0x20)
+                  dev->Reg.OscTune |= 0xC0;
+               else
+                  dev->Reg.OscTune &= 0x1F;
+               break;
+      case 9:  if(now < dev->EepromBusy)
+                  break;                   // the firmware clears its flag at the end of the write
+               if((dev->Stage[0] == 0x55) && (dev->Stage[1] == 0xaa))
+                  SaveSettings(dev,now);
+               break;
+      case 12: if(dev->Reg.Watermark >= A2DSIM_FIFO_SIZE)
+                  dev->Reg.Watermark = A2DSIM_FIFO_SIZE-1;
+               break;
+      case 13: dev->Reg.ChannelMask &= 3;
+               if(dev->Reg.ChannelMask==0) dev->Reg.ChannelMask=3;
+               if((dev->Reg.ChannelMask==3) && (dev->Reg.TargetTimer < 2))
+                  dev->Reg.TargetTimer=2;
+               break;
+      case 14: if(dev->Reg.HwTimer.Postscale==0)
+                  dev->Reg.HwTimer.Postscale=1;
+               if(dev->Reg.HwTimer.Period)
+                 {
+                   if(dev->Reg.ChannelMask==3)
+                     {
+                       if(dev->Reg.HwTimer.Period < 100) dev->Reg.HwTimer.Period=100;
+                     }
+                   else if(dev->Reg.HwTimer.Period < 50)
+                       dev->Reg.HwTimer.Period=50;
+                 }
+               break;
+      case 15: dev->Reg.RecordOptions &= A2D_RECORD_STAMP;
+               break;
+      case 16: dev->Reg.AutoStart &= 7;
+               if((dev->Reg.AutoStart & 1)==0)
+                  dev->Reg.AutoStart=0;
+               break;
+      case 18: dev->Reg.Burst.Source &= A2D_BURST_EDGE | A2D_BURST_WINDOW;
+               if(dev->Reg.Burst.Post > (A2DSIM_FIFO_SIZE-2))
+                  dev->Reg.Burst.Post = A2DSIM_FIFO_SIZE-2;
+               break;
+    }
+}
+
+////////////////////////////////////   A2DSimDeviceStart
+//
+//    Start or repeated start with the device address (or the general call)
+//
+//    Inputs,
+//
+//    dev:      device
+//    read:     1= master read
+//    general:  1= general call address
+//    now:      time (ns)
+//
+void A2DSimDeviceStart(A2DSimDevice * dev, int read, int general, long long now)
+{
+  dev->Now=now;
+  A2DSimDeviceUpdate(dev,now);
+  if(read)
+    {
+      if(!dev->Staged)
+         PrepareResponse(dev);       // read without a command write first
+      else if(dev->TxFifo && !dev->RecordValid)
+         StageRecord(dev);           // the fifo was empty when the command came in
+      dev->Staged=0;
+      return;
+    }
+  dev->ByteCount=0;
+  dev->GotCommand=0;
+  dev->Staged=0;
+  dev->GeneralCall = general ? 1 : 0;
+}
+
+////////////////////////////////////   A2DSimDeviceWrite
+//
+//    Byte written by the master
+//
+void A2DSimDeviceWrite(A2DSimDevice * dev, unsigned char data)
+{
+  if(dev->GeneralCall)
+    {
+      if(dev->GeneralCall==1)
+        {
+          dev->GeneralCall = data==A2D_GENERAL_CALL_TAG ? 2 : 3;
+          return;
+        }
+      if(dev->GeneralCall==3) return;
+      if(!dev->GotCommand)
+        {  // only start, stop and timer setup could be broadcast
+          if((data!=0) && (data!=1) && (data!=14))
+            {
+              dev->GeneralCall=3;
+              return;
+            }
+          dev->Command=data;
+          dev->GotCommand=1;
+          return;
+        }
+    }
+  if(dev->GotCommand)
+     WriteData(dev,data,dev->Now);
+  else
+    {
+      dev->Command=data;
+      dev->GotCommand=1;
+      PrepareResponse(dev);
+      dev->Staged=1;
+    }
+}
+
+////////////////////////////////////   A2DSimDeviceRead
+//
+//    Byte read by the master
+//
+unsigned char A2DSimDeviceRead(A2DSimDevice * dev)
+{
+  unsigned char data = dev->TxIndex < dev->TxSize ? dev->Tx[dev->TxIndex] : 0;
+
+  dev->TxIndex++;
+  if(dev->TxFifo && (dev->TxIndex >= dev->TxSize))
+    {  // the whole record is sent
+      if(dev->RecordValid)
+        {
+          dev->FirstOut++;
+          if(dev->FirstOut >= A2DSIM_FIFO_SIZE) dev->FirstOut=0;
+        }
+      StageRecord(dev);
+      dev->TxIndex=0;
+    }
+  return data;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "../I2C_A2D.h"
+
+////////////////////////////////////////////
+//
+//    A2DSimDevice
+//
+//    Behavior model of one RpiA2D (firmware 1.8) on the I2C bus.
+//    The command table, the fifo records and the write checks are the ones of RpiA2D.c.
+//    Samples are generated from the time given by the bus. A0 is a 10Hz sine and A1
+//    a 1Hz ramp, the phase depends on the address so every device is different.
+//
+//    All the devices of a bus share one RA5 line. A device in trigger mode converts
+//    15us after each sample clock of the first device in timer mode with the sync out (Sync).
+//    Not modelled: event capture (10 & 11) and burst capture (18 & 19) only keep
+//    the values written.
+//
+
+#define A2DSIM_FIFO_SIZE   40
+#define A2DSIM_CMD_COUNT   20
+#define A2DSIM_VERSION_MAJOR 1
+#define A2DSIM_VERSION_MINOR 8
+
+// registers reached with the command table. Same order and size as the firmware variables
+typedef struct{
+  unsigned short  TargetTimer;
+  unsigned char   OscTune;
+  unsigned char   EventControl;
+  unsigned short  WindowLimit[4];
+  unsigned char   Watermark;
+  unsigned char   ChannelMask;
+  A2D_HwTimer     HwTimer;
+  unsigned char   RecordOptions;
+  unsigned char   AutoStart;
+  A2D_Burst       Burst;
+  unsigned char   BurstState;
+}__attribute__((packed)) A2DSimRegisters;
+
+typedef struct A2DSimDevice{
+  unsigned char   Address;                 // 7 bits I2C address
+  unsigned char   NewAddress;              // command 05 , used after command 09
+  unsigned char   Eeprom[256];             // settings and stored profile
+  long long       EepromBusy;              // end of the command 09 eeprom write (ns)
+  A2DSimRegisters Reg;
+
+  // acquisition
+  unsigned char   Run;
+  unsigned char   Mode;                    // 1 single 2 trigger 4 timer (firmware CommandMode)
+  unsigned char   Dense;                   // single channel , two samples per record
+  unsigned char   DenseHalf;
+  unsigned short  DenseFirst;
+  long long       Period;                  // ns between conversions in timer mode
+  long long       NextSample;              // time of the next conversion (ns)
+  long long       SyncOrigin;              // timer mode start , the sync out pulses are at SyncOrigin + k x Period
+  struct A2DSimDevice * Sync;              // RA5 driver in trigger mode , set by the bus
+  long long       StampZero;               // start of the 1us stamp counter
+  unsigned long   TimerCounter;
+  unsigned long   TimerCounterCopy;        // command 06 snapshot
+
+  // fifo
+  unsigned short  FiFo_A0[A2DSIM_FIFO_SIZE];
+  unsigned short  FiFo_A1[A2DSIM_FIFO_SIZE];
+  unsigned char   FirstIn;
+  unsigned char   FirstOut;
+  unsigned char   OverrunCount;
+
+  // I2C slave
+  unsigned char   Command;
+  unsigned char   GotCommand;
+  unsigned char   Staged;                  // response prepared by the command byte
+  unsigned char   GeneralCall;             // 0 none , 1 waiting for the tag , 2 ok , 3 ignore
+  unsigned char   ByteCount;
+  unsigned char   Stage[32];
+  unsigned char   Tx[32];
+  unsigned char   TxSize;
+  unsigned char   TxIndex;
+  unsigned char   TxFifo;
+  unsigned char   RecordValid;
+  long long       Now;                     // time of the running transaction
+
+  unsigned long long Conversions;
+}A2DSimDevice;
+
+
+void          A2DSimDeviceInit(A2DSimDevice * dev, unsigned char address, long long now);
+void          A2DSimDeviceUpdate(A2DSimDevice * dev, long long now);
+void          A2DSimDeviceStart(A2DSimDevice * dev, int read, int general, long long now);
+void          A2DSimDeviceWrite(A2DSimDevice * dev, unsigned char data);
+unsigned char A2DSimDeviceRead(A2DSimDevice * dev);
+int           A2DSimDeviceFifoCount(A2DSimDevice * dev);
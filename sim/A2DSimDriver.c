@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <linux/i2c.h>
+#include "A2DSimBus.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DSimDriver
+//
+//    Host driver of the simulated bus , without libfuse or the cuse module.
+//    The transfers are the ones A2DCuse gets from the i2c-dev ioctls of the tools
+//    (SMBus byte , word and I2C block , I2C_RDWR with a repeated start , general call)
+//    and go to the same A2DSimBus and A2DSimDevice. Each step is checked:
+//
+//      scan      every address , only the devices answer (nack -EREMOTEIO on the others)
+//      version   command 7 block read , E7 C3 1.8
+//      timer     command 1 word written and read back , a different value per device
+//      start     general call timer and start (0xE6 01 ... , 0xE6 00 07)
+//      stream    command 2 count then command 3 records in one I2C_RDWR , the samples
+//                must be valid , the A0 sine continuous and every conversion accounted
+//                (samples + overrun field + fifo left = timer counter)
+//      stop      general call 0xE6 00 00 , command 0 reads 0
+//
+//    The bus time is waited like A2DCuse , the load numbers are the ones of a real bus.
+//
+//   to compile (from the sim folder)
+//
+//     gcc -Wall -O2 -o A2DSimDriver A2DSimDriver.c A2DSimBus.c A2DSimDevice.c -lm
+//
+//   usage
+//
+//     ./A2DSimDriver [devices] [speed] [timer] [seconds] [nowait]
+//
+//     devices   address list like 0x20-0x2f,0x40 (default 0x20-0x21)
+//     speed     SCL frequency (default 400000)
+//     timer     sample period in 100us (default 100 , 10ms)
+//     seconds   time of the stream check (default 2)
+//     nowait    1= don't wait for the bus time
+//
+//     ./A2DSimDriver 0x03-0x77 400000 1000 5
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define MAX_RECORD   39            // fifo records in one read
+
+
+static A2DSimBus Bus;
+static int Failed=0;
+
+
+typedef struct{
+  unsigned long long Samples;
+  unsigned long long Lost;         // overrun field
+  unsigned long long Jumps;        // A0 step larger than the sine could do
+  unsigned long long Invalid;
+  unsigned long long Full;         // overrun field at 7
+  int                Last;         // previous A0 , -1 none
+}DriverStream;
+
+
+static void Check(const char * name, int ok, const char * detail)
+{
+  printf("%-10s %s  %s\n",name, ok ? "ok  " : "FAIL",detail);
+  if(!ok) Failed++;
+}
+
+
+// SMBus transfer on a device like the I2C_SMBUS ioctl
+static int Smbus(unsigned char address, char read_write, unsigned char command,
+                 int size, union i2c_smbus_data * data)
+{
+  return A2DSimBusSmbus(&Bus,address,read_write,command,size,data);
+}
+
+static int WriteWord(unsigned char address, unsigned char command, unsigned short value)
+{
+  union i2c_smbus_data data;
+
+  data.word=value;
+  return Smbus(address,I2C_SMBUS_WRITE,command,I2C_SMBUS_WORD_DATA,&data);
+}
+
+static int ReadWord(unsigned char address, unsigned char command)
+{
+  union i2c_smbus_data data;
+  int rcode = Smbus(address,I2C_SMBUS_READ,command,I2C_SMBUS_WORD_DATA,&data);
+
+  return rcode < 0 ? rcode : data.word;
+}
+
+static int ReadByte(unsigned char address, unsigned char command)
+{
+  union i2c_smbus_data data;
+  int rcode = Smbus(address,I2C_SMBUS_READ,command,I2C_SMBUS_BYTE_DATA,&data);
+
+  return rcode < 0 ? rcode : data.byte;
+}
+
+static int ReadBlock(unsigned char address, unsigned char command, unsigned char size, unsigned char * array)
+{
+  union i2c_smbus_data data;
+  int rcode;
+
+  data.block[0]=size;
+  rcode = Smbus(address,I2C_SMBUS_READ,command,I2C_SMBUS_I2C_BLOCK_DATA,&data);
+  if(rcode < 0) return rcode;
+  memcpy(array,&data.block[1],size);
+  return size;
+}
+
+// general call , the bytes after the tag
+static int GeneralCall(const unsigned char * array, int size)
+{
+  unsigned char buffer[8];
+  struct i2c_msg msg = { 0, 0, size + 1, buffer };
+
+  buffer[0]=A2D_GENERAL_CALL_TAG;
+  memcpy(&buffer[1],array,size);
+  return A2DSimBusTransfer(&Bus,&msg,1);
+}
+
+
+////////////////////////////////////   ReadStream
+//
+//    Read the fifo of one device , command 2 then command 3 with a repeated start
+//
+static int ReadStream(A2DSimDevice * dev, DriverStream * stream, double step)
+{
+  unsigned char command = A2D_CMD_READ_DATA;
+  unsigned char buffer[MAX_RECORD * 4];
+  struct i2c_msg msgs[2] = {
+       { dev->Address, 0, 1, &command },
+       { dev->Address, I2C_M_RD, 0, buffer } };
+  UnpackAnalog * record;
+  int count, loop, rcode;
+
+  count = ReadByte(dev->Address,A2D_CMD_DATA_NUMBER);
+  if(count < 0) return count;
+  if(count > MAX_RECORD) count = MAX_RECORD;
+  if(count==0) return 0;
+
+  msgs[1].len = count * 4;
+  rcode = A2DSimBusTransfer(&Bus,msgs,2);
+  if(rcode < 0) return rcode;
+
+  for(loop=0;loop<count;loop++)
+   {
+     record = (UnpackAnalog *) &buffer[loop*4];
+     if(!record->Valid)
+       {
+         stream->Invalid++;
+         continue;
+       }
+     stream->Samples++;
+     stream->Lost += record->Overrun;
+     if(record->Overrun==7) stream->Full++;
+     // 10Hz sine of 400 , the largest step is 400 x 2pi x 10 x period. Unknown at 7 lost
+     if((stream->Last >= 0) && (record->Overrun < 7) && (abs(record->A0 - stream->Last) > (int) (step * (record->Overrun + 1)) + 2))
+       stream->Jumps++;
+     stream->Last = record->A0;
+   }
+  return count;
+}
+
+
+int main(int argc, char * argv[])
+{
+  const char * list = argc > 1 ? argv[1] : "0x20-0x21";
+  long speed = argc > 2 ? atol(argv[2]) : 400000;
+  int timer = argc > 3 ? atoi(argv[3]) : 100;
+  double seconds = argc > 4 ? atof(argv[4]) : 2.0;
+  DriverStream * stream;
+  A2DSimDevice * dev;
+  unsigned char array[8];
+  unsigned char version[4];
+  unsigned long long samples=0, lost=0, full=0, jumps=0, invalid=0, left=0, counter=0, conversions=0;
+  struct timespec pause;
+  char detail[128];
+  long long start, end;
+  double elapse, step;
+  int loop, address, count, bad;
+
+  if((speed <= 0) || (timer < 2))
+    {
+      printf("usage: A2DSimDriver [devices] [speed] [timer] [seconds] [nowait]\n");
+      return 1;
+    }
+  A2DSimBusInit(&Bus,speed);
+  Bus.Stretch = 17000;
+  Bus.NoWait = argc > 5 ? atoi(argv[5]) : 0;
+  if(A2DSimBusAddRange(&Bus,list) <= 0)
+    {
+      printf("Invalid device list\n");
+      return 1;
+    }
+  stream = calloc(Bus.Count,sizeof(DriverStream));
+  if(stream==NULL) return 1;
+  printf("%d devices  %ld Hz  timer %d x 100us\n\n",Bus.Count,speed,timer);
+
+  // scan like A2DAddress , a read of command 7 on every address
+  count=0; bad=0;
+  for(address=3;address<0x78;address++)
+    {
+      int found=0;
+
+      for(loop=0;loop<Bus.Count;loop++)
+        if(Bus.Device[loop]->Address==address) found=1;
+      if(ReadByte(address,A2D_CMD_VERSION) >= 0)
+        {
+          count++;
+          if(!found) bad++;
+        }
+      else if(found)
+        bad++;
+    }
+  sprintf(detail,"%d answered  %d wrong  %llu nack",count,bad,Bus.Nacks);
+  Check("scan",(count==Bus.Count) && !bad,detail);
+
+  bad=0;
+  for(loop=0;loop<Bus.Count;loop++)
+    if((ReadBlock(Bus.Device[loop]->Address,A2D_CMD_VERSION,4,version)!=4) ||
+       (version[0]!=0xE7) || (version[1]!=0xC3) ||
+       (version[2]!=A2DSIM_VERSION_MAJOR) || (version[3]!=A2DSIM_VERSION_MINOR))
+      bad++;
+  sprintf(detail,"%d wrong",bad);
+  Check("version",!bad,detail);
+
+  bad=0;
+  for(loop=0;loop<Bus.Count;loop++)
+    {
+      dev = Bus.Device[loop];
+      if((WriteWord(dev->Address,A2D_CMD_TIMER,1000 + dev->Address) < 0) ||
+         (ReadWord(dev->Address,A2D_CMD_TIMER)!=(1000 + dev->Address)))
+        bad++;
+    }
+  sprintf(detail,"%d wrong",bad);
+  Check("timer",!bad,detail);
+
+  // every device on the same period then started at once
+  array[0]=A2D_CMD_TIMER;
+  array[1]=timer & 0xff;
+  array[2]=timer >> 8;
+  GeneralCall(array,3);
+  array[0]=A2D_CMD_MODE;
+  array[1]=A2D_MODE_TIMER;
+  GeneralCall(array,2);
+  bad=0;
+  for(loop=0;loop<Bus.Count;loop++)
+    {
+      dev = Bus.Device[loop];
+      if((ReadWord(dev->Address,A2D_CMD_TIMER)!=timer) || (ReadByte(dev->Address,A2D_CMD_MODE)!=A2D_MODE_TIMER))
+        bad++;
+      stream[loop].Last=-1;
+    }
+  sprintf(detail,"%d not running",bad);
+  Check("start",!bad,detail);
+
+  // read the devices in turn like A2DStream
+  step = 400.0 * 2 * M_PI * 10.0 * timer * 100e-6;
+  start = A2DSimBusNow();
+  end = start + (long long) (seconds * 1e9);
+  bad=0;
+  while(A2DSimBusNow() < end)
+    for(loop=0;loop<Bus.Count;loop++)
+      if(ReadStream(Bus.Device[loop],&stream[loop],step) < 0)
+        bad++;
+
+  // stop then account every conversion of the timer counter
+  array[0]=A2D_CMD_MODE;
+  array[1]=A2D_MODE_OFF;
+  GeneralCall(array,2);
+  elapse = (A2DSimBusNow() - start) / 1.0e9;
+  for(loop=0;loop<Bus.Count;loop++)
+    {
+      dev = Bus.Device[loop];
+      samples += stream[loop].Samples;
+      lost += stream[loop].Lost;
+      full += stream[loop].Full;
+      jumps += stream[loop].Jumps;
+      invalid += stream[loop].Invalid;
+      left += A2DSimDeviceFifoCount(dev) + dev->OverrunCount;
+      counter += dev->TimerCounter;
+      conversions += dev->Conversions;
+    }
+  sprintf(detail,"%llu samples  %llu lost  %llu left  counter %llu  %llu invalid  %llu jump",
+          samples,lost,left,counter,invalid,jumps);
+  // an overrun field at 7 could hide more lost samples
+  Check("stream",!bad && !invalid && !jumps &&
+                 (full ? (samples + lost + left <= counter) : (samples + lost + left == counter)),detail);
+
+  // no conversion after the stop , command 0 still reads the mode so look at the fifo count
+  pause.tv_sec = (timer * 300) / 1000000;
+  pause.tv_nsec = ((timer * 300) % 1000000) * 1000L;
+  nanosleep(&pause,NULL);
+  bad=0;
+  for(loop=0;loop<Bus.Count;loop++)
+    if(ReadByte(Bus.Device[loop]->Address,A2D_CMD_DATA_NUMBER) < 0)
+      bad++;
+  for(loop=0;loop<Bus.Count;loop++)
+    conversions -= Bus.Device[loop]->Conversions;
+  sprintf(detail,"%d failed transfers  %lld conversions after",bad,-(long long) conversions);
+  Check("stop",!bad && !conversions,detail);
+
+  printf("\n%.2f sec  %.0f samples/sec  transfers %llu  bytes %llu  nack %llu  bus busy %.1f%%\n",
+         elapse,samples / elapse,Bus.Transfers,Bus.Bytes,Bus.Nacks,
+         Bus.BusyTime / ((A2DSimBusNow() - Bus.Start) * 1.0e-2));
+  free(stream);
+  return Failed ? 2 : 0;
+}
@@ -0,0 +1,295 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "A2DSimBus.h"
+
+
+////////////////////////////////////////////
+//
+//    A2DSimShim
+//
+//    Simulated bus for the tools without libfuse or the cuse module. The library is
+//    preloaded and takes open() , close() , ioctl() , read() and write() on any /dev/i2c-N.
+//    Every bus number goes to the same A2DSimBus with the simulated devices , the other
+//    files are passed to the C library. The i2c-dev ioctls are the ones of A2DCuse
+//    (I2C_SLAVE , I2C_SMBUS , I2C_RDWR , I2C_FUNCS) and one transfer at a time holds the
+//    bus for its time at the bus speed. The bus statistics are printed on exit.
+//
+//    Only the tools in C are covered , a python module opening /dev/i2c-N from its own
+//    C code would need to be loaded in the same process (AdTest.py needs A2DCuse).
+//
+//   to compile (from the sim folder)
+//
+//     gcc -Wall -O2 -shared -fPIC -o libA2DSim.so A2DSimShim.c A2DSimBus.c A2DSimDevice.c -ldl -lm -lpthread
+//
+//   usage
+//
+//     A2DSIM_DEVICES=0x20-0x21 A2DSIM_SPEED=400000 LD_PRELOAD=./sim/libA2DSim.so ./A2DTest
+//
+//     A2DSIM_DEVICES   address list like 0x20-0x2f,0x40 (default 0x20-0x21)
+//     A2DSIM_SPEED     SCL frequency (default 400000)
+//     A2DSIM_STRETCH   clock stretch per byte in us (default 17)
+//     A2DSIM_NOWAIT    1= don't wait for the bus time , only count it
+//
+//    The devices live as long as the process , a second tool starts with new devices.
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#define MAX_FD          1024
+#define MAX_MSG_LEN     8192
+
+
+static A2DSimBus Bus;
+static pthread_mutex_t BusLock = PTHREAD_MUTEX_INITIALIZER;
+
+// slave address selected by I2C_SLAVE , -1 not a i2c file
+static int Slave[MAX_FD];
+
+static int     (*LibcOpen)(const char *, int, ...);
+static int     (*LibcClose)(int);
+static int     (*LibcIoctl)(int, unsigned long, ...);
+static ssize_t (*LibcRead)(int, void *, size_t);
+static ssize_t (*LibcWrite)(int, const void *, size_t);
+
+
+__attribute__((constructor)) static void ShimInit(void)
+{
+  const char * value;
+  int loop;
+
+  LibcOpen  = dlsym(RTLD_NEXT,"open");
+  LibcClose = dlsym(RTLD_NEXT,"close");
+  LibcIoctl = dlsym(RTLD_NEXT,"ioctl");
+  LibcRead  = dlsym(RTLD_NEXT,"read");
+  LibcWrite = dlsym(RTLD_NEXT,"write");
+  for(loop=0;loop<MAX_FD;loop++)
+    Slave[loop]=-1;
+
+  value = getenv("A2DSIM_SPEED");
+  A2DSimBusInit(&Bus,value ? atol(value) : 400000);
+  value = getenv("A2DSIM_STRETCH");
+  Bus.Stretch = (value ? atol(value) : 17) * 1000L;
+  value = getenv("A2DSIM_NOWAIT");
+  Bus.NoWait = value ? atoi(value) : 0;
+  value = getenv("A2DSIM_DEVICES");
+  if(A2DSimBusAddRange(&Bus,value ? value : "0x20-0x21") <= 0)
+    fprintf(stderr,"A2DSimShim: invalid device list\n");
+}
+
+__attribute__((destructor)) static void ShimExit(void)
+{
+  double elapse = (A2DSimBusNow() - Bus.Start) / 1.0e9;
+
+  fprintf(stderr,"[A2DSim] %d devices %.1f sec  transfers %llu  bytes %llu  nack %llu  bus busy %.1f%%\n",
+          Bus.Count,elapse,Bus.Transfers,Bus.Bytes,Bus.Nacks,
+          elapse > 0 ? Bus.BusyTime / (elapse * 1.0e7) : 0.0);
+}
+
+
+static int IsBus(int fd)
+{
+  return (fd >= 0) && (fd < MAX_FD) && (Slave[fd] >= 0);
+}
+
+static int Transfer(struct i2c_msg * msgs, int count)
+{
+  int rcode;
+
+  pthread_mutex_lock(&BusLock);
+  rcode = A2DSimBusTransfer(&Bus,msgs,count);
+  pthread_mutex_unlock(&BusLock);
+  return rcode;
+}
+
+
+////////////  libc entry points
+
+int open(const char * path, int flags, ...)
+{
+  va_list ap;
+  mode_t mode=0;
+  int fd;
+
+  if(flags & (O_CREAT | O_TMPFILE))
+    {
+      va_start(ap,flags);
+      mode = va_arg(ap,int);
+      va_end(ap);
+    }
+
+  if(strncmp(path,"/dev/i2c-",9))
+    return LibcOpen(path,flags,mode);
+
+  // a real file descriptor to own the number
+  fd = LibcOpen("/dev/null",O_RDWR);
+  if(fd >= MAX_FD)
+    {
+      LibcClose(fd);
+      errno=EMFILE;
+      return -1;
+    }
+  if(fd >= 0)
+    Slave[fd]=0;
+  return fd;
+}
+
+int open64(const char * path, int flags, ...) __attribute__((alias("open")));
+
+
+int close(int fd)
+{
+  if(IsBus(fd))
+    Slave[fd]=-1;
+  return LibcClose(fd);
+}
+
+
+int ioctl(int fd, unsigned long request, ...)
+{
+  struct i2c_smbus_ioctl_data * smbus;
+  struct i2c_rdwr_ioctl_data * rdwr;
+  va_list ap;
+  void * arg;
+  int rcode;
+
+  va_start(ap,request);
+  arg = va_arg(ap,void *);
+  va_end(ap);
+
+  if(!IsBus(fd))
+    return LibcIoctl(fd,request,arg);
+
+  switch(request)
+   {
+     case I2C_SLAVE:
+     case I2C_SLAVE_FORCE:
+          if((uintptr_t) arg > 0x7f)
+            {
+              rcode=-EINVAL;
+              break;
+            }
+          Slave[fd] = (uintptr_t) arg;
+          return 0;
+
+     case I2C_TENBIT:
+          rcode = arg ? -EINVAL : 0;
+          break;
+
+     case I2C_PEC:
+     case I2C_RETRIES:
+     case I2C_TIMEOUT:
+          return 0;
+
+     case I2C_FUNCS:
+          *((unsigned long *) arg) = I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+          return 0;
+
+     case I2C_SMBUS:
+          smbus = arg;
+          pthread_mutex_lock(&BusLock);
+          rcode = A2DSimBusSmbus(&Bus,Slave[fd],smbus->read_write,smbus->command,smbus->size,smbus->data);
+          pthread_mutex_unlock(&BusLock);
+          break;
+
+     case I2C_RDWR:
+          rdwr = arg;
+          if((rdwr->nmsgs==0) || (rdwr->nmsgs > I2C_RDWR_IOCTL_MAX_MSGS) || (rdwr->msgs==NULL))
+            rcode=-EINVAL;
+          else
+            rcode = Transfer(rdwr->msgs,rdwr->nmsgs);
+          break;
+
+     default:
+          rcode=-ENOTTY;
+   }
+  if(rcode < 0)
+    {
+      errno=-rcode;
+      return -1;
+    }
+  return rcode;
+}
+
+
+ssize_t read(int fd, void * buf, size_t count)
+{
+  struct i2c_msg msg;
+  int rcode;
+
+  if(!IsBus(fd))
+    return LibcRead(fd,buf,count);
+  if(count > MAX_MSG_LEN) count = MAX_MSG_LEN;
+  msg.addr = Slave[fd];
+  msg.flags = I2C_M_RD;
+  msg.len = count;
+  msg.buf = buf;
+  rcode = Transfer(&msg,1);
+  if(rcode < 0)
+    {
+      errno=-rcode;
+      return -1;
+    }
+  return count;
+}
+
+
+ssize_t write(int fd, const void * buf, size_t count)
+{
+  struct i2c_msg msg;
+  int rcode;
+
+  if(!IsBus(fd))
+    return LibcWrite(fd,buf,count);
+  if(count > MAX_MSG_LEN)
+    {
+      errno=EINVAL;
+      return -1;
+    }
+  msg.addr = Slave[fd];
+  msg.flags = 0;
+  msg.len = count;
+  msg.buf = (unsigned char *) buf;
+  rcode = Transfer(&msg,1);
+  if(rcode < 0)
+    {
+      errno=-rcode;
+      return -1;
+    }
+  return count;
+}
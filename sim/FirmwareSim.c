@@ -0,0 +1,71 @@
+////////////////////////////////////////////
+//
+//    FirmwareSim
+//
+//    RpiA2D.c built for Linux against the htc.h of this folder.
+//    This is the only file compiled with the block counter and the function hooks,
+//    the simulator itself (PicSim.c) is not instrumented.
+//
+//   to compile  (from the sim folder)
+//
+//     gcc -O0 -g -I. -fsanitize-coverage=trace-pc -finstrument-functions -c FirmwareSim.c
+//     gcc -O0 -g -I. -c PicSim.c
+//     gcc -rdynamic -o PicSim PicSim.o FirmwareSim.o -ldl -lm
+//
+//   An other firmware version could be built with -DFIRMWARE=\"file.c\"
+//   (ex: git show <older commit>:RpiA2D.c > /tmp/old.c  and  -DFIRMWARE=\"/tmp/old.c\")
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef FIRMWARE
+#define FIRMWARE "../RpiA2D.c"
+#endif
+
+#define main FirmwareMain
+#include FIRMWARE
+#undef main
+
+
+// entry points for the simulator. They are not counted.
+
+#if __GNUC__ >= 12
+#define SIM_ENTRY __attribute__((no_instrument_function, no_sanitize_coverage))
+#else
+#define SIM_ENTRY __attribute__((no_instrument_function))
+#endif
+
+SIM_ENTRY void SimIsr(void)
+{
+  isr();
+}
+
+SIM_ENTRY void SimMain(void)
+{
+  FirmwareMain();
+}
+
+void (* const SimIsrAddress)(void) = isr;
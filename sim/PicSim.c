@@ -0,0 +1,1331 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <ucontext.h>
+#include "htc.h"
+#undef while
+
+
+////////////////////////////////////////////
+//
+//    PicSim
+//
+//    Run the RpiA2D firmware on Linux with a model of the PIC12F1840 peripherals
+//    used by it (SSP1 slave, A/D, Timer0, Timer1/CCP1, Timer2 and RA5 change interrupt)
+//    and a I2C master. The script (see *.sim) drive the master and the analog inputs.
+//    The same script gives the same interrupt sequence, so a firmware change could be
+//    checked against the previous one.
+//
+//    The firmware (FirmwareSim.c) is compiled with the gcc basic block counter.
+//    Each block is converted to PIC cycles with an average (command "cycles").
+//    The numbers are estimates, the worst cases and the difference between
+//    two firmware versions are what to look at.
+//
+//   to compile  (from the sim folder)
+//
+//     gcc -O0 -g -I. -fsanitize-coverage=trace-pc -finstrument-functions -c FirmwareSim.c
+//     gcc -O0 -g -I. -c PicSim.c
+//     gcc -rdynamic -o PicSim PicSim.o FirmwareSim.o -ldl -lm
+//
+//   usage
+//
+//     ./PicSim Timer5K.sim
+//
+
+/*
+
+The MIT License (MIT)
+
+Copyright (c)  2013 Daniel Perron
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+// from FirmwareSim.c
+void SimIsr(void);
+void SimMain(void);
+extern void (* const SimIsrAddress)(void);
+
+
+#define NEVER      0x7fffffffffffffffLL
+#define CYCLE_NS   125                  // 32Mhz / 4
+#define US         1000LL
+#define MS         1000000LL
+#define SEC        1000000000LL
+
+
+////////////  registers
+
+static volatile SimRegStruct  SimRegs;
+volatile SimRegStruct * const SimRoot = &SimRegs;
+const SimBitsStruct           SimBits = { &SimRegs };
+
+volatile unsigned char  ANSELA, WPUA, OSCCON, OSCTUNE, VREGCON, FVRCON, ADCON1;
+volatile unsigned char  SSP1ADD, SSP1MSK, SSP1CON3;
+volatile unsigned char  PR2, TMR2, CCP1CON, CCPR1H, CCPR1L;
+volatile unsigned short ADRES;
+
+static volatile unsigned char CkpReg=1;
+static volatile unsigned char SspBufReg;
+static volatile unsigned char Tmr0Reg;
+static volatile unsigned char Tmr1Reg[2];
+
+static unsigned char Eeprom[256];
+
+
+////////////  cpu time
+
+static long long        SimNow;          // time of the event in process (ns)
+static long long        CpuFree;         // end of the running interrupt
+static unsigned long long Blocks;        // firmware basic blocks executed
+static unsigned long long SliceBlocks;   // Blocks at the start of the running slice
+static long long        SliceStart;      // time of the first block of the slice
+static int              InIsr;
+static int              InMain;
+
+static double           CyclesPerBlock=6.0;
+static int              IsrEntry=12;     // latency, context save and compiler prologue
+static int              IsrExit=8;       // epilogue and retfie
+
+static long long CpuTime(void)
+{
+  if(!InIsr) return SimNow;
+  return SliceStart + (long long) ((double)(Blocks - SliceBlocks) * CyclesPerBlock * CYCLE_NS);
+}
+
+
+////////////  interrupt sources
+
+enum { SRC_TMR0, SRC_TMR2, SRC_TMR1, SRC_CCP1, SRC_SSP1, SRC_AD, SRC_IOC, SRC_COUNT };
+
+static const char * SrcName[SRC_COUNT] = { "TMR0", "TMR2", "TMR1", "CCP1", "SSP1", "AD", "IOC" };
+
+typedef struct{
+  long long     SetTime;
+  int           Armed;        // the source was enabled when the flag was set
+  int           Seen;         // entry latency already counted
+  long long     Count;
+  long long     Sum;
+  long long     Max;
+  long long     ServiceMax;   // flag set to flag cleared by the firmware
+}SourceStat;
+
+static SourceStat Source[SRC_COUNT];
+
+static int SrcFlag(int src)
+{
+  switch(src)
+   {
+     case SRC_TMR0: return TMR0IF;
+     case SRC_TMR2: return TMR2IF;
+     case SRC_TMR1: return TMR1IF;
+     case SRC_CCP1: return CCP1IF;
+     case SRC_SSP1: return SSP1IF;
+     case SRC_AD:   return ADIF;
+     case SRC_IOC:  return IOCAF != 0;
+   }
+  return 0;
+}
+
+static int SrcEnable(int src)
+{
+  switch(src)
+   {
+     case SRC_TMR0: return TMR0IE;
+     case SRC_TMR2: return PEIE && TMR2IE;
+     case SRC_TMR1: return PEIE && TMR1IE;
+     case SRC_CCP1: return PEIE && CCP1IE;
+     case SRC_SSP1: return PEIE && SSP1IE;
+     case SRC_AD:   return PEIE && ADIE;
+     case SRC_IOC:  return IOCIE;
+   }
+  return 0;
+}
+
+static int PendingMask(void)
+{
+  int src, mask=0;
+
+  for(src=0;src<SRC_COUNT;src++)
+    if(SrcFlag(src) && SrcEnable(src))
+      mask |= 1 << src;
+  return mask;
+}
+
+
+////////////  register watch
+// The firmware registers are plain memory. They are compared after each basic block
+// to know when the firmware started something.
+
+static unsigned char    WatchPIR1, WatchTMR0IF, WatchIOCAF;
+static unsigned char    WatchT1CON, WatchT2CON, WatchCCP1CON, WatchPR2, WatchADGO, WatchCkp;
+static int              Tmr0Touched, Tmr1Touched, CkpTouched;
+static long long        Tmr0Time, CkpTime;
+
+static void Raise(int src, long long t)
+{
+  if(!SrcFlag(src))
+    {
+      Source[src].SetTime=t;
+      Source[src].Armed=SrcEnable(src);      // only enabled sources have a latency
+      Source[src].Seen=!Source[src].Armed;
+    }
+  switch(src)
+   {
+     case SRC_TMR0: TMR0IF=1; WatchTMR0IF=1; break;
+     case SRC_TMR2: TMR2IF=1; break;
+     case SRC_TMR1: TMR1IF=1; break;
+     case SRC_CCP1: CCP1IF=1; break;
+     case SRC_SSP1: SSP1IF=1; break;
+     case SRC_AD:   ADIF=1; break;
+     case SRC_IOC:  IOCAF5=1; IOCIF=1; WatchIOCAF=IOCAF; break;
+   }
+  WatchPIR1=PIR1;
+}
+
+static void FlagCleared(int src, long long t)
+{
+  SourceStat * stat = &Source[src];
+
+  if(!stat->Armed) return;
+  stat->Armed=0;
+  if(t - stat->SetTime > stat->ServiceMax)
+     stat->ServiceMax = t - stat->SetTime;
+}
+
+static void T2Config(long long t);
+static void T1Config(long long t);
+static void T1Commit(long long t);
+static void AdcStart(long long t);
+static void BusRelease(long long t);
+static void Tmr0Load(long long t);
+
+static void Watch(void)
+{
+  static const int pir1src[8]={ SRC_TMR1, SRC_TMR2, SRC_CCP1, SRC_SSP1, -1, -1, SRC_AD, -1 };
+  long long t = CpuTime();
+  unsigned char cleared;
+  int loop;
+
+  if(Tmr1Touched) T1Commit(t);
+  if(Tmr0Touched) Tmr0Load(Tmr0Time);
+
+  if((T2CON != WatchT2CON) || (PR2 != WatchPR2))
+     T2Config(t);
+  if((T1CON != WatchT1CON) || (CCP1CON != WatchCCP1CON))
+     T1Config(t);
+
+  if(ADGO != WatchADGO)
+    {
+      WatchADGO=ADGO;
+      if(ADGO) AdcStart(t);
+    }
+
+  cleared = WatchPIR1 & ~PIR1;
+  if(cleared)
+    for(loop=0;loop<8;loop++)
+      if((cleared & (1<<loop)) && (pir1src[loop]>=0))
+         FlagCleared(pir1src[loop],t);
+  WatchPIR1=PIR1;
+  if(WatchTMR0IF && !TMR0IF) FlagCleared(SRC_TMR0,t);
+  WatchTMR0IF=TMR0IF;
+  if(WatchIOCAF && !IOCAF)
+    {
+      FlagCleared(SRC_IOC,t);
+      IOCIF=0;
+    }
+  WatchIOCAF=IOCAF;
+
+  if(CkpTouched)
+    {
+      CkpTouched=0;
+      if(CkpReg && !WatchCkp)
+         BusRelease(CkpTime);
+      WatchCkp=CkpReg;
+    }
+}
+
+
+////////////  block counter and function hooks
+
+typedef struct{
+  void *        Fn;
+  const char *  Name;
+  long long     Calls;
+  unsigned long long Sum;
+  unsigned long long Max;
+}FunctionStat;
+
+#define MAX_FUNCTION 64
+#define MAX_DEPTH    32
+
+static FunctionStat     Function[MAX_FUNCTION];
+static int              FunctionCount;
+static struct{ void * Fn; unsigned long long Blocks; } CallStack[MAX_DEPTH];
+static int              CallDepth;
+
+void __sanitizer_cov_trace_pc(void)
+{
+  Blocks++;
+  if(InIsr || InMain) Watch();
+}
+
+void __cyg_profile_func_enter(void * fn, void * site)
+{
+  if(!InIsr) return;
+  if(CallDepth < MAX_DEPTH)
+    {
+      CallStack[CallDepth].Fn=fn;
+      CallStack[CallDepth].Blocks=Blocks;
+    }
+  CallDepth++;
+}
+
+static FunctionStat * FindFunction(void * fn)
+{
+  Dl_info info;
+  int loop;
+
+  for(loop=0;loop<FunctionCount;loop++)
+    if(Function[loop].Fn == fn) return &Function[loop];
+  if(FunctionCount >= MAX_FUNCTION) return NULL;
+  Function[FunctionCount].Fn=fn;
+  if(fn == (void *) SimIsrAddress)
+     Function[FunctionCount].Name="isr";
+  else if(dladdr(fn,&info) && info.dli_sname)
+     Function[FunctionCount].Name=info.dli_sname;
+  else
+     Function[FunctionCount].Name="?";
+  return &Function[FunctionCount++];
+}
+
+void __cyg_profile_func_exit(void * fn, void * site)
+{
+  FunctionStat * stat;
+  unsigned long long blocks;
+
+  if(!InIsr || CallDepth==0) return;
+  CallDepth--;
+  if(CallDepth >= MAX_DEPTH) return;
+  stat = FindFunction(CallStack[CallDepth].Fn);
+  if(stat==NULL) return;
+  blocks = Blocks - CallStack[CallDepth].Blocks;
+  stat->Calls++;
+  stat->Sum += blocks;
+  if(blocks > stat->Max) stat->Max=blocks;
+}
+
+
+////////////  eeprom
+
+void SimEepromInit(unsigned char a, unsigned char b, unsigned char c, unsigned char d,
+                   unsigned char e, unsigned char f, unsigned char g, unsigned char h)
+{
+  unsigned char data[8]={a,b,c,d,e,f,g,h};
+
+  memset(Eeprom,0xff,sizeof(Eeprom));
+  memcpy(Eeprom,data,8);
+}
+
+unsigned char eeprom_read(unsigned char address)
+{
+  return Eeprom[address];
+}
+
+void eeprom_write(unsigned char address, unsigned char value)
+{
+  Eeprom[address]=value;
+}
+
+
+////////////  Timer0
+// Free running at Fosc/4. A write restart the count 2 cycles later.
+
+static long long T0Next=256*CYCLE_NS;
+
+volatile unsigned char * SimTmr0(void)
+{
+  Tmr0Touched=1;
+  Tmr0Time=CpuTime();
+  return &Tmr0Reg;
+}
+
+static void Tmr0Load(long long t)
+{
+  Tmr0Touched=0;
+  T0Next = t + (256 - Tmr0Reg + 2) * CYCLE_NS;
+}
+
+static void T0Event(long long t)
+{
+  Raise(SRC_TMR0,t);
+  Tmr0Reg=0;
+  T0Next = t + 256 * CYCLE_NS;
+}
+
+
+////////////  Timer2
+
+static long long T2Next=NEVER;
+static int       T2Post;
+
+static long long T2Tick(void)
+{
+  static const int prescale[4]={1,4,16,64};
+  return prescale[T2CON & 3] * CYCLE_NS;
+}
+
+static void T2Config(long long t)
+{
+  int was_on = WatchT2CON & 4;
+
+  WatchT2CON=T2CON;
+  WatchPR2=PR2;
+  if((T2CON & 4)==0)
+     T2Next=NEVER;
+  else if(!was_on)
+    {
+      T2Post=0;
+      T2Next = t + (PR2 + 1 - TMR2) * T2Tick();
+    }
+}
+
+static void T2Event(long long t)
+{
+  T2Next = t + (PR2 + 1) * T2Tick();
+  if(++T2Post > ((T2CON >> 3) & 15))
+    {
+      T2Post=0;
+      Raise(SRC_TMR2,t);
+    }
+}
+
+
+////////////  Timer1 and CCP1 special event trigger
+
+static long long T1Next=NEVER;
+static long long T1Zero;                // time of count 0 while running
+static unsigned  T1Count;               // count while stopped
+
+static long long T1Tick(void)
+{
+  return (1 << ((T1CON >> 4) & 3)) * CYCLE_NS;
+}
+
+static int T1SpecialEvent(void)
+{
+  return (CCP1CON & 0x0f) == 0x0b;
+}
+
+static unsigned T1Value(long long t)
+{
+  if((T1CON & 1)==0) return T1Count;
+  return ((t - T1Zero) / T1Tick()) & 0xffff;
+}
+
+static void T1Schedule(void)
+{
+  unsigned period;
+
+  if((T1CON & 1)==0)
+    {
+      T1Next=NEVER;
+      return;
+    }
+  period = T1SpecialEvent() ? ((CCPR1H << 8) | CCPR1L) + 1 : 65536;
+  T1Next = T1Zero + period * T1Tick();
+}
+
+static void T1Config(long long t)
+{
+  int was_on = WatchT1CON & 1;
+
+  if(was_on && ((T1CON & 1)==0))
+     T1Count = ((t - T1Zero) / T1Tick()) & 0xffff;
+  if(!was_on && (T1CON & 1))
+     T1Zero = t - (long long) T1Count * T1Tick();
+  WatchT1CON=T1CON;
+  WatchCCP1CON=CCP1CON;
+  T1Schedule();
+}
+
+// the firmware wrote TMR1H or TMR1L
+static void T1Commit(long long t)
+{
+  unsigned value = T1Value(t);
+  unsigned wrote = (Tmr1Reg[1] << 8) | Tmr1Reg[0];
+
+  Tmr1Touched=0;
+  if(wrote == value) return;
+  if(T1CON & 1)
+     T1Zero = t - (long long) wrote * T1Tick();
+  else
+     T1Count = wrote;
+  T1Schedule();
+}
+
+volatile unsigned char * SimTmr1(int high)
+{
+  long long t = CpuTime();
+  unsigned value;
+
+  if(Tmr1Touched) T1Commit(t);
+  value = T1Value(t);
+  Tmr1Reg[0]= value & 0xff;
+  Tmr1Reg[1]= value >> 8;
+  Tmr1Touched=1;
+  return &Tmr1Reg[high ? 1 : 0];
+}
+
+static void T1Event(long long t)
+{
+  T1Zero=t;
+  if(T1SpecialEvent())
+    {
+      Raise(SRC_CCP1,t);
+      if(ADON && !ADGO)
+        {
+          ADGO=1;
+          WatchADGO=1;
+          AdcStart(t);
+        }
+    }
+  else
+     Raise(SRC_TMR1,t);
+  T1Schedule();
+}
+
+
+////////////  analog inputs
+
+enum { SIGNAL_CONST, SIGNAL_SINE, SIGNAL_SQUARE, SIGNAL_RAMP };
+
+typedef struct{
+  int    Kind;
+  double A, B, Freq;           // const: A  sine: amplitude A offset B  square & ramp: low A high B
+}SignalStruct;
+
+static SignalStruct Signal[2] = { { SIGNAL_CONST, 0.5, 0, 0 }, { SIGNAL_CONST, 1.0, 0, 0 } };
+
+static unsigned short SignalValue(int input, long long t)
+{
+  SignalStruct * sig = &Signal[input];
+  double sec = (double) t / SEC;
+  double phase = sig->Freq * sec - floor(sig->Freq * sec);
+  double volt;
+  int value;
+
+  switch(sig->Kind)
+   {
+     case SIGNAL_SINE:   volt = sig->B + sig->A * sin(2 * M_PI * phase); break;
+     case SIGNAL_SQUARE: volt = phase < 0.5 ? sig->A : sig->B; break;
+     case SIGNAL_RAMP:   volt = sig->A + (sig->B - sig->A) * phase; break;
+     default:            volt = sig->A; break;
+   }
+  value = (int) (volt * 1024.0 / 2.048);     // internal 2.048V reference
+  if(value < 0) value=0;
+  if(value > 1023) value=1023;
+  return value;
+}
+
+
+////////////  A/D converter
+
+typedef struct{
+  long long Count;
+  long long Last;
+  long long Min;
+  long long Max;
+  long long Sum;
+}IntervalStat;
+
+static long long     AdcNext=NEVER;
+static unsigned short AdcValue;
+static IntervalStat  AdcStart0, AdcStart3;
+static long long     Conversions;
+
+static long long AdcTad(void)
+{
+  static const int divider[8]={2,8,32,0,4,16,64,0};
+  int div = divider[(ADCON1 >> 4) & 7];
+
+  if(div==0) return 1600;                      // FRC
+  return div * CYCLE_NS / 4;
+}
+
+static void IntervalAdd(IntervalStat * stat, long long t)
+{
+  long long delta;
+
+  if(stat->Count++ == 0)
+    {
+      stat->Last=t;
+      return;
+    }
+  delta = t - stat->Last;
+  stat->Last=t;
+  if((stat->Count==2) || (delta < stat->Min)) stat->Min=delta;
+  if(delta > stat->Max) stat->Max=delta;
+  stat->Sum += delta;
+}
+
+static void AdcStart(long long t)
+{
+  int channel = (ADCON0 >> 2) & 0x1f;
+
+  if(!ADON) return;
+  AdcValue = SignalValue(channel==3 ? 1 : 0, t);
+  AdcNext = t + (AdcTad() * 23) / 2;              // 11.5 TAD
+  if(channel==3)
+     IntervalAdd(&AdcStart3,t);
+  else
+     IntervalAdd(&AdcStart0,t);
+}
+
+static void AdcEvent(long long t)
+{
+  AdcNext=NEVER;
+  ADRES=AdcValue;
+  ADGO=0;
+  WatchADGO=0;
+  Conversions++;
+  Raise(SRC_AD,t);
+}
+
+
+////////////  RA5
+
+static void Ra5Edge(long long t, int rising)
+{
+  if(!TRISA5) return;                  // output
+  if(rising ? IOCAP5 : IOCAN5)
+     Raise(SRC_IOC,t);
+}
+
+
+////////////  I2C master
+// The SSP1 slave hold the clock after each byte until the firmware set CKP.
+// With AHEN/DHEN (SSP1CON3) the hold is on the 8th clock and the ack follows the release.
+
+enum { KIND_ADDR_W, KIND_DATA_W, KIND_ADDR_R, KIND_DATA_R, KIND_COUNT };
+
+static const char * KindName[KIND_COUNT] = { "addr write", "data write", "addr read", "data read" };
+
+typedef struct{
+  unsigned char Addr;              // 7 bits. 0 is the general call
+  unsigned char Write[40];         // command and data bytes
+  int           WriteCount;
+  int           ReadCount;
+  int           Print;
+}I2CTransaction;
+
+#define QUEUE_SIZE 32
+
+static I2CTransaction   Queue[QUEUE_SIZE];
+static int              QueueHead, QueueCount;
+static long long        QueueDropped;
+
+enum { BUS_IDLE, BUS_CLOCK, BUS_STRETCH };
+
+static long long        BusHz=100000;
+static unsigned char    SlaveAddress=0x20;
+static int              BusState=BUS_IDLE;
+static long long        BusNext=NEVER;
+static long long        BusStart;
+static long long        BusBusy;
+static I2CTransaction   Current;
+static int              WriteIndex;
+static unsigned char    ReadBuf[40];
+static int              ReadIndex;
+static int              ByteKind;
+static int              ByteHeld8;       // hold on the 8th clock
+static long long        StretchStart;
+static IntervalStat     Stretch[KIND_COUNT];
+static long long        Transactions, Nacks;
+static long long        RecordValid, RecordUnderrun, RecordOverrun;
+static FILE *           Trace;
+
+static long long Scl(void)
+{
+  return SEC / BusHz;
+}
+
+volatile unsigned char * SimSspBuf(void)
+{
+  BF=0;                                // a read empty the buffer, a write is sent
+  return &SspBufReg;
+}
+
+volatile unsigned char * SimCkp(void)
+{
+  CkpTouched=1;
+  CkpTime=CpuTime();
+  return &CkpReg;
+}
+
+static void StretchAdd(int kind, long long t)
+{
+  IntervalStat * stat = &Stretch[kind];
+  long long delta = t - StretchStart;
+
+  if((stat->Count==0) || (delta < stat->Min)) stat->Min=delta;
+  if(delta > stat->Max) stat->Max=delta;
+  stat->Sum += delta;
+  stat->Count++;
+}
+
+// start the next byte the master write
+static void BusClockOut(int kind, long long t)
+{
+  int hold = kind==KIND_ADDR_W ? (SSP1CON3 & 2) : (SSP1CON3 & 1);
+
+  ByteKind=kind;
+  ByteHeld8 = kind!=KIND_ADDR_R && hold;
+  BusState=BUS_CLOCK;
+  BusNext = t + (ByteHeld8 ? 8 : 9) * Scl();
+}
+
+static void BusStop(long long t)
+{
+  int loop;
+
+  BusState=BUS_IDLE;
+  BusBusy += t + Scl() - BusStart;
+  BusNext = QueueCount ? t + Scl() : NEVER;
+  Transactions++;
+
+  if(Current.Addr && Current.ReadCount && (Current.Write[0]==3 || Current.Write[0]==4))
+    {  // fifo records
+      int size = Current.Write[0]==3 ? 4 : 3;
+      for(loop=0; loop + size <= ReadIndex; loop+=size)
+        {
+          unsigned char flags = ReadBuf[loop+size-1];
+          if(flags & 0x80)
+            {
+              RecordValid++;
+              RecordOverrun += (flags >> 4) & 7;
+            }
+          else
+              RecordUnderrun++;
+        }
+    }
+
+  if(Current.Print || Trace)
+    {
+      FILE * out = Current.Print ? stdout : Trace;
+      fprintf(out,"%12.3f us  i2c %02X", t / 1000.0, Current.Addr);
+      for(loop=0;loop<Current.WriteCount;loop++)
+        fprintf(out," W%02X",Current.Write[loop]);
+      for(loop=0;loop<ReadIndex;loop++)
+        fprintf(out," R%02X",ReadBuf[loop]);
+      fprintf(out,"\n");
+    }
+}
+
+static void BusNextWrite(long long t)
+{
+  if(WriteIndex < Current.WriteCount)
+     BusClockOut(KIND_DATA_W,t);
+  else if(Current.ReadCount)
+     BusClockOut(KIND_ADDR_R,t + Scl());           // repeated start
+  else
+     BusStop(t);
+}
+
+// a byte reached the slave
+static void SlaveByte(unsigned char stat, unsigned char data, long long t)
+{
+  int full = BF;
+
+  SSP1STAT = (SSP1STAT & 0xc0) | (stat & 0xfe);
+  if(stat & 1)
+    {
+      if(full)
+         SSPOV=1;                  // the previous byte was not read
+      else
+         SspBufReg=data;
+      BF=1;
+    }
+  Raise(SRC_SSP1,t);
+}
+
+static void Stretching(long long t)
+{
+  CkpReg=0;
+  WatchCkp=0;
+  BusState=BUS_STRETCH;
+  BusNext=NEVER;
+  StretchStart=t;
+}
+
+static void BusEvent(long long t)
+{
+  unsigned char addr;
+
+  if(BusState==BUS_IDLE)
+    {  // start condition
+      if(QueueCount==0)
+        {
+          BusNext=NEVER;
+          return;
+        }
+      Current=Queue[QueueHead];
+      QueueHead = (QueueHead + 1) % QUEUE_SIZE;
+      QueueCount--;
+      WriteIndex=0;
+      ReadIndex=0;
+      BusStart=t;
+      BusClockOut(KIND_ADDR_W, t + Scl()/2);
+      return;
+    }
+
+  switch(ByteKind)
+   {
+     case KIND_ADDR_W:
+     case KIND_ADDR_R:
+          addr = (Current.Addr << 1) | (ByteKind==KIND_ADDR_R ? 1 : 0);
+          if(!((Current.Addr==0 && GCEN) || (Current.Addr == (SSP1ADD >> 1))))
+            {
+              Nacks++;
+              BusStop(t);
+              return;
+            }
+          SlaveByte(ByteKind==KIND_ADDR_R ? 0b00001101 : 0b00001001, addr, t);
+          Stretching(t);
+          return;
+
+     case KIND_DATA_W:
+          SlaveByte(0b00101001, Current.Write[WriteIndex++], t);
+          Stretching(t);
+          return;
+
+     case KIND_DATA_R:
+          ReadBuf[ReadIndex++]=SspBufReg;
+          if(ReadIndex < Current.ReadCount)
+            {  // ack, the slave hold the clock for the next byte
+              SlaveByte(0b00101100, 0, t);
+              Stretching(t);
+            }
+          else
+            {  // nack
+              SlaveByte(0b00101000, 0, t);
+              BusStop(t + Scl());
+            }
+          return;
+   }
+}
+
+// the firmware set CKP
+static void BusRelease(long long t)
+{
+  if(BusState != BUS_STRETCH) return;
+  StretchAdd(ByteKind,t);
+  switch(ByteKind)
+   {
+     case KIND_ADDR_W:
+     case KIND_DATA_W:
+          BusNextWrite(ByteHeld8 ? t + Scl() : t);
+          return;
+     default:                      // the slave byte is shifted out
+          ByteKind=KIND_DATA_R;
+          BusState=BUS_CLOCK;
+          BusNext = t + 9 * Scl();
+          return;
+   }
+}
+
+static void BusQueue(I2CTransaction * trans)
+{
+  if(QueueCount >= QUEUE_SIZE)
+    {
+      QueueDropped++;
+      return;
+    }
+  Queue[(QueueHead + QueueCount) % QUEUE_SIZE] = *trans;
+  QueueCount++;
+  if(BusState==BUS_IDLE && BusNext==NEVER)
+     BusNext=SimNow;
+}
+
+
+////////////  interrupt and main execution
+
+typedef struct{
+  int       Mask;
+  long long Calls;
+  unsigned long long Sum;
+  unsigned long long Max;
+}PathStat;
+
+#define MAX_PATH 64
+
+static PathStat         Path[MAX_PATH];
+static int              PathCount;
+static long long        IsrCount, IsrTime, StatStart;
+static int              LoopGuard;
+
+static ucontext_t       SimContext, MainContext;
+static char             MainStack[256*1024];
+
+int SimLoop(int condition)
+{
+  if(InIsr)
+    {
+      if(++LoopGuard > 100000)
+        {
+          fprintf(stderr,"PicSim: loop stuck inside the interrupt at %.3f us\n", SimNow / 1000.0);
+          exit(1);
+        }
+      return condition;
+    }
+  if(InMain && condition)
+     swapcontext(&MainContext,&SimContext);    // one main loop turn between events
+  return condition;
+}
+
+static void RunMain(void)
+{
+  InMain=1;
+  swapcontext(&SimContext,&MainContext);
+  InMain=0;
+}
+
+static void PathAdd(int mask, unsigned long long cycles)
+{
+  int loop;
+
+  for(loop=0;loop<PathCount;loop++)
+    if(Path[loop].Mask==mask) break;
+  if(loop==PathCount)
+    {
+      if(PathCount>=MAX_PATH) return;
+      Path[PathCount++].Mask=mask;
+    }
+  Path[loop].Calls++;
+  Path[loop].Sum+=cycles;
+  if(cycles > Path[loop].Max) Path[loop].Max=cycles;
+}
+
+static void RunIsr(long long t)
+{
+  int mask = PendingMask();
+  int src;
+  unsigned long long cycles;
+  long long latency;
+
+  for(src=0;src<SRC_COUNT;src++)
+    if((mask & (1<<src)) && !Source[src].Seen)
+      {
+        Source[src].Seen=1;
+        latency = t - Source[src].SetTime;
+        Source[src].Count++;
+        Source[src].Sum += latency;
+        if(latency > Source[src].Max) Source[src].Max=latency;
+      }
+
+  GIE=0;
+  InIsr=1;
+  LoopGuard=0;
+  CallDepth=0;
+  SliceStart = t + IsrEntry * CYCLE_NS;
+  SliceBlocks = Blocks;
+  SimIsr();
+  Watch();
+  cycles = IsrEntry + IsrExit + (unsigned long long) ((Blocks - SliceBlocks) * CyclesPerBlock);
+  InIsr=0;
+  GIE=1;
+
+  CpuFree = t + cycles * CYCLE_NS;
+  IsrCount++;
+  IsrTime += cycles * CYCLE_NS;
+  PathAdd(mask,cycles);
+  if(Trace)
+    {
+      fprintf(Trace,"%12.3f us  isr",t / 1000.0);
+      for(src=0;src<SRC_COUNT;src++)
+        if(mask & (1<<src)) fprintf(Trace," %s",SrcName[src]);
+      fprintf(Trace,"  %llu cycles\n",cycles);
+    }
+}
+
+
+////////////  periodic script commands
+
+typedef struct{
+  long long Period;
+  long long Next;
+  char      Line[128];
+}EveryStruct;
+
+#define MAX_EVERY 8
+
+static EveryStruct      Every[MAX_EVERY];
+static int              EveryCount;
+
+static int Execute(char * line, int quiet);
+
+static long long NextEvent(int * which)
+{
+  long long next=NEVER;
+  long long times[5];
+  int loop;
+
+  times[0]=T0Next;
+  times[1]=T2Next;
+  times[2]=T1Next;
+  times[3]=AdcNext;
+  times[4]=BusNext;
+  *which=-1;
+  for(loop=0;loop<5;loop++)
+    if(times[loop] < next)
+      {
+        next=times[loop];
+        *which=loop;
+      }
+  for(loop=0;loop<EveryCount;loop++)
+    if(Every[loop].Next < next)
+      {
+        next=Every[loop].Next;
+        *which=5+loop;
+      }
+  return next;
+}
+
+static void RunUntil(long long end)
+{
+  long long next, entry, t;
+  int which;
+
+  for(;;)
+   {
+     next = NextEvent(&which);
+     if(GIE && PendingMask())
+       {
+         entry = CpuFree > SimNow ? CpuFree : SimNow;
+         if(entry <= next && entry <= end)
+           {
+             SimNow=entry;
+             RunIsr(entry);
+             RunMain();
+             continue;
+           }
+       }
+     if(next > end)
+       {
+         if(SimNow < end) SimNow=end;
+         return;
+       }
+     // an event during an interrupt keep its own time
+     t=next;
+     if(t > SimNow) SimNow=t;
+     switch(which)
+      {
+        case 0: T0Event(t); break;
+        case 1: T2Event(t); break;
+        case 2: T1Event(t); break;
+        case 3: AdcEvent(t); break;
+        case 4: BusEvent(t); break;
+        default:
+                which-=5;
+                Every[which].Next += Every[which].Period;
+                Execute(Every[which].Line,1);
+                break;
+      }
+     if(!InIsr) RunMain();
+   }
+}
+
+
+////////////  report
+
+static void ResetStats(void)
+{
+  memset(Path,0,sizeof(Path));
+  PathCount=0;
+  memset(Function,0,sizeof(Function));
+  FunctionCount=0;
+  memset(Stretch,0,sizeof(Stretch));
+  memset(&AdcStart0,0,sizeof(AdcStart0));
+  memset(&AdcStart3,0,sizeof(AdcStart3));
+  {
+    int src;
+    for(src=0;src<SRC_COUNT;src++)
+      {
+        Source[src].Count=0;
+        Source[src].Sum=0;
+        Source[src].Max=0;
+        Source[src].ServiceMax=0;
+      }
+  }
+  IsrCount=IsrTime=0;
+  Conversions=Transactions=Nacks=QueueDropped=0;
+  RecordValid=RecordUnderrun=RecordOverrun=0;
+  BusBusy=0;
+  StatStart=SimNow;
+}
+
+static double Us(long long ns)
+{
+  return ns / 1000.0;
+}
+
+static void IntervalReport(const char * name, IntervalStat * stat)
+{
+  if(stat->Count < 2) return;
+  printf("  %-10s %8lld %10.2f %10.2f %10.2f %10.2f\n", name, stat->Count,
+         Us(stat->Min), Us(stat->Sum / (stat->Count-1)), Us(stat->Max), Us(stat->Max - stat->Min));
+}
+
+static void Report(void)
+{
+  long long span = SimNow - StatStart;
+  int loop, src;
+  char flags[64];
+
+  printf("\n==== %.6f s  (%.1f cycles/block, isr entry %d exit %d cycles)\n",
+         span / (double) SEC, CyclesPerBlock, IsrEntry, IsrExit);
+  printf("interrupts %lld   cpu in isr %.1f %%   i2c bus busy %.1f %%\n", IsrCount,
+         span ? 100.0 * IsrTime / span : 0, span ? 100.0 * BusBusy / span : 0);
+  printf("conversions %lld   records valid %lld  underrun %lld  overrun %lld   i2c %lld  nack %lld  dropped %lld\n",
+         Conversions, RecordValid, RecordUnderrun, RecordOverrun, Transactions, Nacks, QueueDropped);
+
+  printf("\nisr paths (pending flags at entry)\n");
+  printf("  %-20s %8s %8s %8s %8s\n","flags","calls","avg cyc","max cyc","max us");
+  for(loop=0;loop<PathCount;loop++)
+    {
+      flags[0]=0;
+      for(src=0;src<SRC_COUNT;src++)
+        if(Path[loop].Mask & (1<<src))
+          {
+            if(flags[0]) strcat(flags,"+");
+            strcat(flags,SrcName[src]);
+          }
+      if(flags[0]==0) strcpy(flags,"(none)");
+      printf("  %-20s %8lld %8llu %8llu %8.2f\n", flags, Path[loop].Calls,
+             Path[loop].Sum / Path[loop].Calls, Path[loop].Max, Us(Path[loop].Max * CYCLE_NS));
+    }
+
+  printf("\nfunctions called by the isr (inclusive)\n");
+  printf("  %-20s %8s %8s %8s\n","name","calls","avg cyc","max cyc");
+  for(loop=0;loop<FunctionCount;loop++)
+    if(Function[loop].Calls)
+      printf("  %-20s %8lld %8.0f %8.0f\n", Function[loop].Name, Function[loop].Calls,
+             Function[loop].Sum * CyclesPerBlock / Function[loop].Calls, Function[loop].Max * CyclesPerBlock);
+
+  printf("\ninterrupt latency (flag set to isr entry, flag set to flag cleared)\n");
+  printf("  %-10s %8s %10s %10s %10s\n","source","count","avg us","max us","clear us");
+  for(src=0;src<SRC_COUNT;src++)
+    if(Source[src].Count)
+      printf("  %-10s %8lld %10.2f %10.2f %10.2f\n", SrcName[src], Source[src].Count,
+             Us(Source[src].Sum / Source[src].Count), Us(Source[src].Max), Us(Source[src].ServiceMax));
+
+  printf("\ni2c clock stretch per byte\n");
+  printf("  %-10s %8s %10s %10s\n","byte","count","avg us","max us");
+  for(loop=0;loop<KIND_COUNT;loop++)
+    if(Stretch[loop].Count)
+      printf("  %-10s %8lld %10.2f %10.2f\n", KindName[loop], Stretch[loop].Count,
+             Us(Stretch[loop].Sum / Stretch[loop].Count), Us(Stretch[loop].Max));
+
+  printf("\nconversion start interval\n");
+  printf("  %-10s %8s %10s %10s %10s %10s\n","channel","count","min us","avg us","max us","jitter us");
+  IntervalReport("AN0",&AdcStart0);
+  IntervalReport("AN3",&AdcStart3);
+  printf("\n");
+  fflush(stdout);
+}
+
+
+////////////  script
+
+static long long ParseTime(const char * text)
+{
+  char * end;
+  double value = strtod(text,&end);
+
+  if(strcmp(end,"s")==0)  return (long long) (value * SEC);
+  if(strcmp(end,"ms")==0) return (long long) (value * MS);
+  if(strcmp(end,"ns")==0) return (long long) value;
+  return (long long) (value * US);                // default is us
+}
+
+static int Split(char * line, char ** arg, int max)
+{
+  int count=0;
+  char * token = strtok(line," \t\r\n");
+
+  while(token && count < max)
+    {
+      if(token[0]=='#') break;
+      arg[count++]=token;
+      token=strtok(NULL," \t\r\n");
+    }
+  return count;
+}
+
+static int Execute(char * text, int quiet)
+{
+  char line[256];
+  char * arg[48];
+  int count, loop, input;
+  I2CTransaction trans;
+
+  strncpy(line,text,sizeof(line)-1);
+  line[sizeof(line)-1]=0;
+  count=Split(line,arg,48);
+  if(count==0) return 0;
+
+  if(strcmp(arg[0],"wait")==0 && count==2)
+     RunUntil(SimNow + ParseTime(arg[1]));
+  else if((strcmp(arg[0],"write")==0 || strcmp(arg[0],"read")==0 || strcmp(arg[0],"broadcast")==0) && count>=2)
+    {
+      memset(&trans,0,sizeof(trans));
+      trans.Addr=SlaveAddress;
+      trans.Print=!quiet;
+      if(arg[0][0]=='b')
+        {  // general call with the tag
+          trans.Addr=0;
+          trans.Write[trans.WriteCount++]=0xE6;
+        }
+      trans.Write[trans.WriteCount++]=strtol(arg[1],NULL,0);
+      if(arg[0][0]=='r')
+         trans.ReadCount = count > 2 ? strtol(arg[2],NULL,0) : 1;
+      else
+        for(loop=2;loop<count && trans.WriteCount < 40;loop++)
+           trans.Write[trans.WriteCount++]=strtol(arg[loop],NULL,0);
+      if(trans.ReadCount > 40) trans.ReadCount=40;
+      BusQueue(&trans);
+    }
+  else if(strcmp(arg[0],"edge")==0)
+    {
+      Ra5Edge(SimNow,1);
+      Ra5Edge(SimNow+US,0);
+    }
+  else if(strcmp(arg[0],"every")==0 && count>=2)
+    {
+      if(strcmp(arg[1],"off")==0)
+         EveryCount=0;
+      else if(count>=3 && EveryCount < MAX_EVERY)
+        {
+          Every[EveryCount].Period=ParseTime(arg[1]);
+          Every[EveryCount].Next=SimNow;
+          Every[EveryCount].Line[0]=0;
+          for(loop=2;loop<count;loop++)
+            {
+              strncat(Every[EveryCount].Line,arg[loop],sizeof(Every[0].Line)-strlen(Every[EveryCount].Line)-2);
+              strcat(Every[EveryCount].Line," ");
+            }
+          EveryCount++;
+        }
+    }
+  else if(strcmp(arg[0],"signal")==0 && count>=4)
+    {
+      input = atoi(arg[1]) ? 1 : 0;
+      memset(&Signal[input],0,sizeof(SignalStruct));
+      Signal[input].A=atof(arg[3]);
+      if(count>=5) Signal[input].B=atof(arg[4]);
+      if(count>=6) Signal[input].Freq=atof(arg[5]);
+      if(strcmp(arg[2],"sine")==0)        Signal[input].Kind=SIGNAL_SINE;
+      else if(strcmp(arg[2],"square")==0) Signal[input].Kind=SIGNAL_SQUARE;
+      else if(strcmp(arg[2],"ramp")==0)   Signal[input].Kind=SIGNAL_RAMP;
+      else                                Signal[input].Kind=SIGNAL_CONST;
+    }
+  else if(strcmp(arg[0],"bus")==0 && count==2)
+     BusHz=atol(arg[1]) > 0 ? atol(arg[1]) : 100000;
+  else if(strcmp(arg[0],"address")==0 && count==2)
+     SlaveAddress=strtol(arg[1],NULL,0);
+  else if(strcmp(arg[0],"cycles")==0 && count>=2)
+    {
+      CyclesPerBlock=atof(arg[1]);
+      if(count>=3) IsrEntry=atoi(arg[2]);
+      if(count>=4) IsrExit=atoi(arg[3]);
+    }
+  else if(strcmp(arg[0],"report")==0)
+    {
+      Report();
+      ResetStats();
+    }
+  else if(strcmp(arg[0],"reset")==0)
+     ResetStats();
+  else if(strcmp(arg[0],"trace")==0 && count==2)
+    {
+      if(Trace && Trace!=stdout) fclose(Trace);
+      Trace=NULL;
+      if(strcmp(arg[1],"-")==0)
+         Trace=stdout;
+      else if(strcmp(arg[1],"off")!=0)
+         Trace=fopen(arg[1],"w");
+    }
+  else
+    {
+      fprintf(stderr,"PicSim: unknown command \"%s\"\n",text);
+      return -1;
+    }
+  return 0;
+}
+
+
+int main(int argc, char * argv[])
+{
+  FILE * script = stdin;
+  char line[256];
+  int lineno=0;
+  long long end;
+
+  if(argc>1)
+    {
+      script=fopen(argv[1],"r");
+      if(script==NULL)
+        {
+          perror(argv[1]);
+          return 1;
+        }
+    }
+
+  // power-up. The firmware runs up to its main loop
+  getcontext(&MainContext);
+  MainContext.uc_stack.ss_sp=MainStack;
+  MainContext.uc_stack.ss_size=sizeof(MainStack);
+  MainContext.uc_link=&SimContext;
+  makecontext(&MainContext,SimMain,0);
+  RunMain();
+  ResetStats();
+
+  while(fgets(line,sizeof(line),script))
+    {
+      lineno++;
+      if(Execute(line,0) < 0)
+        {
+          fprintf(stderr,"PicSim: line %d\n",lineno);
+          return 1;
+        }
+    }
+
+  // let the last transactions finish
+  EveryCount=0;
+  end = SimNow + SEC;
+  while((QueueCount || BusState!=BUS_IDLE) && (SimNow < end))
+     RunUntil(SimNow + MS);
+  if(IsrCount) Report();
+  return 0;
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+////////////////////////////////////////////
+//
+//    htc.h  (PicSim)
+//
+//    Host replacement of the Hitech C header for the PIC12F1840, used to build
+//    RpiA2D.c on Linux. Only the registers and bits used by the firmware are there.
+//    The registers live in PicSim.c where the peripherals are modelled.
+//
+//    A bit could be used alone (TRISA5) or as a member (TRISAbits.TRISA5), like
+//    with Hitech C. Both expand to the same access through SimRoot.
+//
+//    A few registers go through a function so the simulator knows when the
+//    firmware used them: clock release (CKP), SSP buffer (BF flag), Timer0 reload
+//    and Timer1 read.
+//
+
+#define near
+#define bit		unsigned char
+#define interrupt
+
+#define __CONFIG(x)		extern int SimConfigWord
+#define __IDLOC(x)		extern int SimIdLoc
+#define __EEPROM_DATA(a,b,c,d,e,f,g,h)	\
+   static void __attribute__((constructor)) SimEepromData(void)	\
+   { SimEepromInit(a,b,c,d,e,f,g,h); }
+
+#define FOSC_INTOSC	0
+#define WDTE_OFF	0
+#define PWRTE_OFF	0
+#define MCLRE_ON	0
+#define BOREN_OFF	0
+#define CP_OFF		0
+#define CPD_OFF		0
+#define CLKOUTEN_OFF	0
+#define IESO_OFF	0
+#define FCMEN_OFF	0
+#define WRT_OFF		0
+#define PLLEN_ON	0
+#define BORV_LO		0
+#define LVP_OFF		0
+
+void		SimEepromInit(unsigned char a, unsigned char b, unsigned char c, unsigned char d,
+			      unsigned char e, unsigned char f, unsigned char g, unsigned char h);
+unsigned char	eeprom_read(unsigned char address);
+void		eeprom_write(unsigned char address, unsigned char value);
+
+// every loop test goes to the simulator. The main loop yields there.
+int		SimLoop(int condition);
+#define while(...)	while(SimLoop(__VA_ARGS__))
+
+
+////////////  registers with bits
+
+typedef struct{
+  union{ unsigned char reg; struct{ unsigned x_IOCIF:1; unsigned x_INTF:1; unsigned x_TMR0IF:1; unsigned x_IOCIE:1; unsigned x_INTE:1; unsigned x_TMR0IE:1; unsigned x_PEIE:1; unsigned x_GIE:1; } bits; } r_INTCON;
+  union{ unsigned char reg; struct{ unsigned x_TMR1IF:1; unsigned x_TMR2IF:1; unsigned x_CCP1IF:1; unsigned x_SSP1IF:1; unsigned x_TXIF:1; unsigned x_RCIF:1; unsigned x_ADIF:1; unsigned x_TMR1GIF:1; } bits; } r_PIR1;
+  union{ unsigned char reg; struct{ unsigned x_TMR1IE:1; unsigned x_TMR2IE:1; unsigned x_CCP1IE:1; unsigned x_SSP1IE:1; unsigned x_TXIE:1; unsigned x_RCIE:1; unsigned x_ADIE:1; unsigned x_TMR1GIE:1; } bits; } r_PIE1;
+  union{ unsigned char reg; struct{ unsigned x_PS0:1; unsigned x_PS1:1; unsigned x_PS2:1; unsigned x_PSA:1; unsigned x_TMR0SE:1; unsigned x_TMR0CS:1; unsigned x_INTEDG:1; unsigned x_nWPUEN:1; } bits; } r_OPTION_REG;
+  union{ unsigned char reg; struct{ unsigned x_RA0:1; unsigned x_RA1:1; unsigned x_RA2:1; unsigned x_RA3:1; unsigned x_RA4:1; unsigned x_RA5:1; } bits; } r_PORTA;
+  union{ unsigned char reg; struct{ unsigned x_LATA0:1; unsigned x_LATA1:1; unsigned x_LATA2:1; unsigned x_LATA3:1; unsigned x_LATA4:1; unsigned x_LATA5:1; } bits; } r_LATA;
+  union{ unsigned char reg; struct{ unsigned x_TRISA0:1; unsigned x_TRISA1:1; unsigned x_TRISA2:1; unsigned x_TRISA3:1; unsigned x_TRISA4:1; unsigned x_TRISA5:1; } bits; } r_TRISA;
+  union{ unsigned char reg; struct{ unsigned x_IOCAP0:1; unsigned x_IOCAP1:1; unsigned x_IOCAP2:1; unsigned x_IOCAP3:1; unsigned x_IOCAP4:1; unsigned x_IOCAP5:1; } bits; } r_IOCAP;
+  union{ unsigned char reg; struct{ unsigned x_IOCAN0:1; unsigned x_IOCAN1:1; unsigned x_IOCAN2:1; unsigned x_IOCAN3:1; unsigned x_IOCAN4:1; unsigned x_IOCAN5:1; } bits; } r_IOCAN;
+  union{ unsigned char reg; struct{ unsigned x_IOCAF0:1; unsigned x_IOCAF1:1; unsigned x_IOCAF2:1; unsigned x_IOCAF3:1; unsigned x_IOCAF4:1; unsigned x_IOCAF5:1; } bits; } r_IOCAF;
+  union{ unsigned char reg; struct{ unsigned x_ADON:1; unsigned x_ADGO:1; unsigned x_CHS0:1; unsigned x_CHS1:1; unsigned x_CHS2:1; unsigned x_CHS3:1; unsigned x_CHS4:1; } bits; } r_ADCON0;
+  union{ unsigned char reg; struct{ unsigned x_SSPM0:1; unsigned x_SSPM1:1; unsigned x_SSPM2:1; unsigned x_SSPM3:1; unsigned x_CKP:1; unsigned x_SSPEN:1; unsigned x_SSPOV:1; unsigned x_WCOL:1; } bits; } r_SSP1CON1;
+  union{ unsigned char reg; struct{ unsigned x_BF:1; unsigned x_UA:1; unsigned x_R_nW:1; unsigned x_S:1; unsigned x_P:1; unsigned x_D_nA:1; unsigned x_CKE:1; unsigned x_SMP:1; } bits; } r_SSP1STAT;
+  union{ unsigned char reg; struct{ unsigned x_SEN:1; unsigned x_RSEN:1; unsigned x_PEN:1; unsigned x_RCEN:1; unsigned x_ACKEN:1; unsigned x_ACKDT:1; unsigned x_ACKSTAT:1; unsigned x_GCEN:1; } bits; } r_SSP1CON2;
+  union{ unsigned char reg; struct{ unsigned x_TMR1ON:1; unsigned x_T1_1:1; unsigned x_nT1SYNC:1; unsigned x_T1OSCEN:1; unsigned x_T1CKPS0:1; unsigned x_T1CKPS1:1; unsigned x_TMR1CS0:1; unsigned x_TMR1CS1:1; } bits; } r_T1CON;
+  union{ unsigned char reg; struct{ unsigned x_T2CKPS0:1; unsigned x_T2CKPS1:1; unsigned x_TMR2ON:1; unsigned x_T2OUTPS0:1; unsigned x_T2OUTPS1:1; unsigned x_T2OUTPS2:1; unsigned x_T2OUTPS3:1; } bits; } r_T2CON;
+}SimRegStruct;
+
+typedef struct{
+  volatile SimRegStruct * SimRoot;
+}SimBitsStruct;
+
+extern volatile SimRegStruct * const	SimRoot;
+extern const SimBitsStruct		SimBits;
+
+#define INTCON           SimRoot->r_INTCON.reg
+#define INTCONbits       SimBits
+#define IOCIF            SimRoot->r_INTCON.bits.x_IOCIF
+#define INTF             SimRoot->r_INTCON.bits.x_INTF
+#define TMR0IF           SimRoot->r_INTCON.bits.x_TMR0IF
+#define IOCIE            SimRoot->r_INTCON.bits.x_IOCIE
+#define INTE             SimRoot->r_INTCON.bits.x_INTE
+#define TMR0IE           SimRoot->r_INTCON.bits.x_TMR0IE
+#define PEIE             SimRoot->r_INTCON.bits.x_PEIE
+#define GIE              SimRoot->r_INTCON.bits.x_GIE
+
+#define PIR1             SimRoot->r_PIR1.reg
+#define PIR1bits         SimBits
+#define TMR1IF           SimRoot->r_PIR1.bits.x_TMR1IF
+#define TMR2IF           SimRoot->r_PIR1.bits.x_TMR2IF
+#define CCP1IF           SimRoot->r_PIR1.bits.x_CCP1IF
+#define SSP1IF           SimRoot->r_PIR1.bits.x_SSP1IF
+#define TXIF             SimRoot->r_PIR1.bits.x_TXIF
+#define RCIF             SimRoot->r_PIR1.bits.x_RCIF
+#define ADIF             SimRoot->r_PIR1.bits.x_ADIF
+#define TMR1GIF          SimRoot->r_PIR1.bits.x_TMR1GIF
+
+#define PIE1             SimRoot->r_PIE1.reg
+#define PIE1bits         SimBits
+#define TMR1IE           SimRoot->r_PIE1.bits.x_TMR1IE
+#define TMR2IE           SimRoot->r_PIE1.bits.x_TMR2IE
+#define CCP1IE           SimRoot->r_PIE1.bits.x_CCP1IE
+#define SSP1IE           SimRoot->r_PIE1.bits.x_SSP1IE
+#define TXIE             SimRoot->r_PIE1.bits.x_TXIE
+#define RCIE             SimRoot->r_PIE1.bits.x_RCIE
+#define ADIE             SimRoot->r_PIE1.bits.x_ADIE
+#define TMR1GIE          SimRoot->r_PIE1.bits.x_TMR1GIE
+
+#define OPTION_REG       SimRoot->r_OPTION_REG.reg
+#define OPTION_REGbits   SimBits
+#define PS0              SimRoot->r_OPTION_REG.bits.x_PS0
+#define PS1              SimRoot->r_OPTION_REG.bits.x_PS1
+#define PS2              SimRoot->r_OPTION_REG.bits.x_PS2
+#define PSA              SimRoot->r_OPTION_REG.bits.x_PSA
+#define TMR0SE           SimRoot->r_OPTION_REG.bits.x_TMR0SE
+#define TMR0CS           SimRoot->r_OPTION_REG.bits.x_TMR0CS
+#define INTEDG           SimRoot->r_OPTION_REG.bits.x_INTEDG
+#define nWPUEN           SimRoot->r_OPTION_REG.bits.x_nWPUEN
+
+#define PORTA            SimRoot->r_PORTA.reg
+#define PORTAbits        SimBits
+#define RA0              SimRoot->r_PORTA.bits.x_RA0
+#define RA1              SimRoot->r_PORTA.bits.x_RA1
+#define RA2              SimRoot->r_PORTA.bits.x_RA2
+#define RA3              SimRoot->r_PORTA.bits.x_RA3
+#define RA4              SimRoot->r_PORTA.bits.x_RA4
+#define RA5              SimRoot->r_PORTA.bits.x_RA5
+
+#define LATA             SimRoot->r_LATA.reg
+#define LATAbits         SimBits
+#define LATA0            SimRoot->r_LATA.bits.x_LATA0
+#define LATA1            SimRoot->r_LATA.bits.x_LATA1
+#define LATA2            SimRoot->r_LATA.bits.x_LATA2
+#define LATA3            SimRoot->r_LATA.bits.x_LATA3
+#define LATA4            SimRoot->r_LATA.bits.x_LATA4
+#define LATA5            SimRoot->r_LATA.bits.x_LATA5
+
+#define TRISA            SimRoot->r_TRISA.reg
+#define TRISAbits        SimBits
+#define TRISA0           SimRoot->r_TRISA.bits.x_TRISA0
+#define TRISA1           SimRoot->r_TRISA.bits.x_TRISA1
+#define TRISA2           SimRoot->r_TRISA.bits.x_TRISA2
+#define TRISA3           SimRoot->r_TRISA.bits.x_TRISA3
+#define TRISA4           SimRoot->r_TRISA.bits.x_TRISA4
+#define TRISA5           SimRoot->r_TRISA.bits.x_TRISA5
+
+#define IOCAP            SimRoot->r_IOCAP.reg
+#define IOCAPbits        SimBits
+#define IOCAP0           SimRoot->r_IOCAP.bits.x_IOCAP0
+#define IOCAP1           SimRoot->r_IOCAP.bits.x_IOCAP1
+#define IOCAP2           SimRoot->r_IOCAP.bits.x_IOCAP2
+#define IOCAP3           SimRoot->r_IOCAP.bits.x_IOCAP3
+#define IOCAP4           SimRoot->r_IOCAP.bits.x_IOCAP4
+#define IOCAP5           SimRoot->r_IOCAP.bits.x_IOCAP5
+
+#define IOCAN            SimRoot->r_IOCAN.reg
+#define IOCANbits        SimBits
+#define IOCAN0           SimRoot->r_IOCAN.bits.x_IOCAN0
+#define IOCAN1           SimRoot->r_IOCAN.bits.x_IOCAN1
+#define IOCAN2           SimRoot->r_IOCAN.bits.x_IOCAN2
+#define IOCAN3           SimRoot->r_IOCAN.bits.x_IOCAN3
+#define IOCAN4           SimRoot->r_IOCAN.bits.x_IOCAN4
+#define IOCAN5           SimRoot->r_IOCAN.bits.x_IOCAN5
+
+#define IOCAF            SimRoot->r_IOCAF.reg
+#define IOCAFbits        SimBits
+#define IOCAF0           SimRoot->r_IOCAF.bits.x_IOCAF0
+#define IOCAF1           SimRoot->r_IOCAF.bits.x_IOCAF1
+#define IOCAF2           SimRoot->r_IOCAF.bits.x_IOCAF2
+#define IOCAF3           SimRoot->r_IOCAF.bits.x_IOCAF3
+#define IOCAF4           SimRoot->r_IOCAF.bits.x_IOCAF4
+#define IOCAF5           SimRoot->r_IOCAF.bits.x_IOCAF5
+
+#define ADCON0           SimRoot->r_ADCON0.reg
+#define ADCON0bits       SimBits
+#define ADON             SimRoot->r_ADCON0.bits.x_ADON
+#define ADGO             SimRoot->r_ADCON0.bits.x_ADGO
+#define CHS0             SimRoot->r_ADCON0.bits.x_CHS0
+#define CHS1             SimRoot->r_ADCON0.bits.x_CHS1
+#define CHS2             SimRoot->r_ADCON0.bits.x_CHS2
+#define CHS3             SimRoot->r_ADCON0.bits.x_CHS3
+#define CHS4             SimRoot->r_ADCON0.bits.x_CHS4
+
+#define SSP1CON1         SimRoot->r_SSP1CON1.reg
+#define SSP1CON1bits     SimBits
+#define SSPM0            SimRoot->r_SSP1CON1.bits.x_SSPM0
+#define SSPM1            SimRoot->r_SSP1CON1.bits.x_SSPM1
+#define SSPM2            SimRoot->r_SSP1CON1.bits.x_SSPM2
+#define SSPM3            SimRoot->r_SSP1CON1.bits.x_SSPM3
+#define SSPEN            SimRoot->r_SSP1CON1.bits.x_SSPEN
+#define SSPOV            SimRoot->r_SSP1CON1.bits.x_SSPOV
+#define WCOL             SimRoot->r_SSP1CON1.bits.x_WCOL
+
+#define SSP1STAT         SimRoot->r_SSP1STAT.reg
+#define SSP1STATbits     SimBits
+#define BF               SimRoot->r_SSP1STAT.bits.x_BF
+#define UA               SimRoot->r_SSP1STAT.bits.x_UA
+#define R_nW             SimRoot->r_SSP1STAT.bits.x_R_nW
+#define S                SimRoot->r_SSP1STAT.bits.x_S
+#define P                SimRoot->r_SSP1STAT.bits.x_P
+#define D_nA             SimRoot->r_SSP1STAT.bits.x_D_nA
+#define CKE              SimRoot->r_SSP1STAT.bits.x_CKE
+#define SMP              SimRoot->r_SSP1STAT.bits.x_SMP
+
+#define SSP1CON2         SimRoot->r_SSP1CON2.reg
+#define SSP1CON2bits     SimBits
+#define SEN              SimRoot->r_SSP1CON2.bits.x_SEN
+#define RSEN             SimRoot->r_SSP1CON2.bits.x_RSEN
+#define PEN              SimRoot->r_SSP1CON2.bits.x_PEN
+#define RCEN             SimRoot->r_SSP1CON2.bits.x_RCEN
+#define ACKEN            SimRoot->r_SSP1CON2.bits.x_ACKEN
+#define ACKDT            SimRoot->r_SSP1CON2.bits.x_ACKDT
+#define ACKSTAT          SimRoot->r_SSP1CON2.bits.x_ACKSTAT
+#define GCEN             SimRoot->r_SSP1CON2.bits.x_GCEN
+
+#define T1CON            SimRoot->r_T1CON.reg
+#define T1CONbits        SimBits
+#define TMR1ON           SimRoot->r_T1CON.bits.x_TMR1ON
+#define nT1SYNC          SimRoot->r_T1CON.bits.x_nT1SYNC
+#define T1OSCEN          SimRoot->r_T1CON.bits.x_T1OSCEN
+#define T1CKPS0          SimRoot->r_T1CON.bits.x_T1CKPS0
+#define T1CKPS1          SimRoot->r_T1CON.bits.x_T1CKPS1
+#define TMR1CS0          SimRoot->r_T1CON.bits.x_TMR1CS0
+#define TMR1CS1          SimRoot->r_T1CON.bits.x_TMR1CS1
+
+#define T2CON            SimRoot->r_T2CON.reg
+#define T2CONbits        SimBits
+#define T2CKPS0          SimRoot->r_T2CON.bits.x_T2CKPS0
+#define T2CKPS1          SimRoot->r_T2CON.bits.x_T2CKPS1
+#define TMR2ON           SimRoot->r_T2CON.bits.x_TMR2ON
+#define T2OUTPS0         SimRoot->r_T2CON.bits.x_T2OUTPS0
+#define T2OUTPS1         SimRoot->r_T2CON.bits.x_T2OUTPS1
+#define T2OUTPS2         SimRoot->r_T2CON.bits.x_T2OUTPS2
+#define T2OUTPS3         SimRoot->r_T2CON.bits.x_T2OUTPS3
+
+#define SSPSTAT          SSP1STAT
+
+
+////////////  plain registers
+
+extern volatile unsigned char	ANSELA, WPUA, OSCCON, OSCTUNE, VREGCON, FVRCON, ADCON1;
+extern volatile unsigned char	SSP1ADD, SSP1MSK, SSP1CON3;
+extern volatile unsigned char	PR2, TMR2, CCP1CON, CCPR1H, CCPR1L;
+extern volatile unsigned short	ADRES;
+
+
+////////////  registers the simulator has to watch
+
+volatile unsigned char *	SimCkp(void);
+volatile unsigned char *	SimSspBuf(void);
+volatile unsigned char *	SimTmr0(void);
+volatile unsigned char *	SimTmr1(int high);
+
+#define CKP		(*SimCkp())
+#define SSPBUF		(*SimSspBuf())
+#define SSP1BUF		(*SimSspBuf())
+#define TMR0		(*SimTmr0())
+#define TMR1L		(*SimTmr1(0))
+#define TMR1H		(*SimTmr1(1))